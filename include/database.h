@@ -9,4 +9,7 @@
 #include <database/friend.h>
 #include <database/conversation.h>
 #include <database/message.h>
+#include <database/sequence.h>
+#include <database/write_pipeline.h>
+#include <database/message_cache.h>
 #include <database/group.h>
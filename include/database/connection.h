@@ -2,51 +2,193 @@
 
 #include <boost/mysql.hpp>
 #include <boost/asio.hpp>
+#include <database/statements.h>
+#include <database/types.h>
+#include <array>
+#include <optional>
 #include <string>
+#include <chrono>
 #include <cstddef>
 #include <cstdint>
+#include <exception>
 #include <memory>
+#include <utility>
+#include <vector>
 
 /// \brief 数据库连接和工具函数。
 namespace database
 {
     using Connection = boost::mysql::tcp_connection;
 
+    /// \brief 一个 MySQL 服务端地址。
+    struct DbEndpoint {
+        std::string host;
+        std::uint16_t port{ 3306 };
+    };
+
     struct PoolConfig {
         std::string host = "127.0.0.1";
         std::uint16_t port = 3307;
         std::string user = "kkkzbh";
         std::string password = "kkkzbh";
         std::string database = "chatdb";
+        /// \brief 连接数硬上限，池满时 acquire_handle 排队等待而不是新建连接；按核模式下由各核心均分。
         std::size_t pool_size = 8;
+        /// \brief 排队等待连接的最长时间，超时抛出 std::runtime_error。
+        std::chrono::milliseconds acquire_timeout{ 5000 };
+        /// \brief 空闲超过该时长的连接在交出前先 ping 一次，失败则重连。
+        std::chrono::seconds health_check_idle{ 30 };
+        /// \brief 只读副本地址，账号与库名同主库；为空时所有读请求都走主库。
+        std::vector<DbEndpoint> replicas{};
+        /// \brief 副本子池的连接数上限，多个副本共用，新建连接时轮询选择副本。
+        std::size_t replica_pool_size = 8;
+        /// \brief 从副本借连接（排队与新建连接各自）的最长时间，超时即改走主库。
+        std::chrono::milliseconds replica_acquire_timeout{ 200 };
+        /// \brief 副本借出失败后在该时长内直接走主库，不再尝试副本。
+        std::chrono::milliseconds replica_retry_after{ 5000 };
+        /// \brief 会话写入后在该时长内的读请求仍走主库，保证读到自己刚写入的数据（覆盖副本复制延迟）。
+        std::chrono::milliseconds read_your_writes_window{ 2000 };
+    };
+
+    /// \brief 连接池运行统计，计数类字段为进程启动以来的累计值。
+    struct PoolStats {
+        std::size_t in_use{ 0 };        ///< 当前借出的连接数
+        std::size_t idle{ 0 };          ///< 当前空闲的连接数
+        std::size_t waiting{ 0 };       ///< 当前排队等待的协程数
+        std::uint64_t acquires{ 0 };    ///< 成功借出次数
+        std::uint64_t waits{ 0 };       ///< 需要排队的借出次数
+        std::uint64_t timeouts{ 0 };    ///< 排队超时次数
+        std::uint64_t creates{ 0 };     ///< 新建连接次数（含重连）
+        std::uint64_t reconnects{ 0 };  ///< 健康检查或遗留事务回滚失败后的重连次数
+        std::uint64_t rollbacks{ 0 };   ///< 借出前回滚上一个借用者遗留事务的次数
+        std::uint64_t total_wait_us{ 0 }; ///< 借出等待累计耗时（微秒）
+        std::uint64_t max_wait_us{ 0 };   ///< 单次借出最大等待（微秒）
+        std::uint64_t fallbacks{ 0 };     ///< 副本不可用而改走主库的次数（含熔断期间，仅副本子池）
     };
 
     /// \brief 初始化全局连接配置（可选）。
     auto set_config(PoolConfig cfg) -> void;
 
-    /// \brief 初始化连接池（幂等）。
+    /// \brief 初始化连接池（幂等），所有连接都在 exec 上运行（线程池模式）。
     auto init_pool(boost::asio::any_io_executor exec, PoolConfig cfg = {}) -> void;
 
+    /// \brief 按核模式初始化连接池（幂等）：每个执行器一组主库 / 副本子池。
+    /// \details 连接数上限按执行器均分；acquire_handle 从调用方协程所在执行器的子池借出，
+    ///          连接的 I/O 始终留在借用它的核心上。
+    auto init_pool(std::vector<boost::asio::any_io_executor> const& execs, PoolConfig cfg = {}) -> void;
+
     /// \brief 建立一个已连接的 MySQL 连接。
     auto connect(boost::asio::any_io_executor exec) -> boost::asio::awaitable<Connection>;
 
-    /// \brief 从连接池获取连接（RAII 归还由调用方显式 co_await async_send）。
-    auto acquire_connection() -> boost::asio::awaitable<std::shared_ptr<Connection>>;
+    /// \brief 池中的一条连接及其预处理语句缓存。
+    struct PooledConnection {
+        explicit PooledConnection(boost::asio::any_io_executor exec) : conn(std::move(exec)) {}
+        Connection conn;
+        /// \brief 属于只读副本子池，归还时据此回到对应子池。
+        bool replica{ false };
+        /// \brief 所属执行器的子池下标。
+        std::size_t core{ 0 };
+        /// \brief 经 ConnectionHandle::begin 开启的事务尚未提交或回滚；归还后下次借出前先回滚。
+        bool in_transaction{ false };
+        /// \brief 按 StatementId 缓存的语句，随连接重建而清空。
+        std::array<std::optional<boost::mysql::statement>, STATEMENT_COUNT> statements{};
+    };
 
     /// \brief RAII 归还连接的句柄。
+    /// \details 析构或被赋值覆盖时把连接还给连接池，优先交给排队最久的等待者。
+    ///          若析构发生在异常传播途中，连接状态不可信，下次借出前会先做健康检查。
     struct ConnectionHandle {
-        std::shared_ptr<Connection> conn{};
+        std::shared_ptr<PooledConnection> pooled{};
         ConnectionHandle() = default;
-        explicit ConnectionHandle(std::shared_ptr<Connection> c) : conn(std::move(c)) {}
-        ConnectionHandle(ConnectionHandle&&) noexcept = default;
-        ConnectionHandle& operator=(ConnectionHandle&&) noexcept = default;
+        explicit ConnectionHandle(std::shared_ptr<PooledConnection> p) : pooled(std::move(p)) {}
+        ConnectionHandle(ConnectionHandle&& other) noexcept
+            : pooled(std::move(other.pooled)), uncaught_(other.uncaught_) {}
+        auto operator=(ConnectionHandle&& other) noexcept -> ConnectionHandle&;
         ~ConnectionHandle();
-        Connection& operator*() const { return *conn; }
-        Connection* operator->() const { return conn.get(); }
-        explicit operator bool() const { return static_cast<bool>(conn); }
+        Connection& operator*() const { return pooled->conn; }
+        Connection* operator->() const { return &pooled->conn; }
+        explicit operator bool() const { return static_cast<bool>(pooled); }
+
+        /// \brief 取本连接上的预处理语句，首次使用时 async_prepare_statement 并缓存。
+        /// \details 返回的 statement 用 bind(...) 绑定参数后交给 async_execute，走二进制协议。
+        auto prepare(StatementId id) -> boost::asio::awaitable<boost::mysql::statement>;
+
+        /// \brief 开启事务。
+        /// \details 事务状态记录在连接上；未 commit / rollback 就归还的连接（例如在 catch 中直接返回），
+        ///          下次借出前由连接池先回滚，半完成的修改不会被下一个借用者的事务隐式提交。
+        auto begin() -> boost::asio::awaitable<void>;
+
+        /// \brief 提交 begin 开启的事务。
+        auto commit() -> boost::asio::awaitable<void>;
+
+        /// \brief 回滚 begin 开启的事务。
+        auto rollback() -> boost::asio::awaitable<void>;
+
+        /// \brief 提前归还连接，之后句柄为空。
+        auto reset() noexcept -> void;
+
+    private:
+        int uncaught_{ std::uncaught_exceptions() };
     };
 
-    auto acquire_handle() -> boost::asio::awaitable<ConnectionHandle>;
+    /// \brief 在一次往返中执行多条以分号分隔的文本语句。
+    /// \details 连接握手时已开启 multi_queries。语句按顺序执行，第 i 条语句的结果为 results.at(i)；
+    ///          某条语句出错时其后的语句不再执行，抛出 error_with_diagnostics。
+    ///          适合彼此之间没有客户端侧依赖的语句，后一条需要前一条生成的 ID 时用 LAST_INSERT_ID() 在服务端衔接。
+    /// \param sql 带 {} 占位符的多条语句，参数由客户端格式化并转义。
+    template<typename... Args>
+    auto execute_batch(ConnectionHandle& conn_h, boost::mysql::constant_string_view sql, Args&&... args)
+        -> boost::asio::awaitable<boost::mysql::results>
+    {
+        boost::mysql::results r;
+        co_await conn_h->async_execute(
+            boost::mysql::with_params(sql, std::forward<Args>(args)...), r, boost::asio::use_awaitable
+        );
+        co_return r;
+    }
+
+    /// \brief 与 execute_batch 相同，但整批语句包在一个事务中，仍只有一次往返。
+    /// \details 结果集的第 0 个对应 START TRANSACTION，第 i 条语句的结果为 results.at(i + 1)。
+    ///          任一语句失败时先回滚（多一次往返）再重新抛出，连接不会带着未结束的事务回到连接池。
+    template<typename... Args>
+    auto execute_transaction(ConnectionHandle& conn_h, boost::mysql::constant_string_view sql, Args&&... args)
+        -> boost::asio::awaitable<boost::mysql::results>
+    {
+        auto const wrapped = std::string{ "START TRANSACTION; " } + std::string{ sql.get() } + "; COMMIT";
+        std::exception_ptr error;
+        conn_h.pooled->in_transaction = true;
+        try {
+            auto r = co_await execute_batch(conn_h, boost::mysql::runtime(wrapped), std::forward<Args>(args)...);
+            conn_h.pooled->in_transaction = false;
+            co_return r;
+        } catch(...) {
+            error = std::current_exception();
+        }
+
+        try {
+            co_await conn_h.rollback();
+        } catch(...) {
+            // 回滚失败时连接仍标记为事务未结束，下次借出前会再次回滚，失败则重连
+        }
+        std::rethrow_exception(error);
+    }
+
+    /// \brief 从连接池借出一个连接。
+    /// \details 有空闲连接直接复用；未达上限时新建；否则按 FIFO 排队等待归还，
+    ///          等待超过 PoolConfig::acquire_timeout 时抛出 std::runtime_error。
+    ///          Route::replica 从副本子池借出，副本未配置或不可用时退回主库；只读查询才能使用。
+    ///          副本使用更短的 replica_acquire_timeout，失败后 replica_retry_after 内直接走主库。
+    auto acquire_handle(Route route = Route::primary) -> boost::asio::awaitable<ConnectionHandle>;
+
+    /// \brief 按会话最近一次写入的时间选择读路由。
+    /// \return 未配置副本或仍在 read_your_writes_window 内时返回 Route::primary。
+    auto read_route_after_write(std::chrono::steady_clock::time_point last_write) -> Route;
+
+    /// \brief 是否配置了只读副本。
+    auto has_replicas() -> bool;
+
+    /// \brief 读取连接池统计快照。
+    auto pool_stats(Route route = Route::primary) -> PoolStats;
 
     /// \brief 生成一个随机昵称，例如"微信用户123456"。
     /// \details 使用线程安全的内部随机数引擎。
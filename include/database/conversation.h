@@ -3,6 +3,8 @@
 #include <string>
 #include <vector>
 #include <optional>
+#include <unordered_map>
+#include <cstddef>
 #include <boost/asio/awaitable.hpp>
 #include <database/types.h>
 
@@ -22,6 +24,7 @@ namespace database
         -> boost::asio::awaitable<i64>;
 
     /// \brief 创建群聊会话，返回会话 ID（不写入系统消息）。
+    /// \details 默认群名用一次 IN 查询取昵称；建群与全部成员的多行 INSERT 在同一事务中一次往返完成。
     /// \param creator_id 群主用户 ID。
     /// \param member_ids 需要加入群聊的用户 ID 列表（不包含自己，函数内部会去重并加入 creator）。
     /// \param name 群名称，空字符串时按默认规则生成。
@@ -32,12 +35,34 @@ namespace database
         std::string name
     ) -> boost::asio::awaitable<i64>;
 
+    /// \brief 以普通成员身份批量加入群聊，用于分块创建大群。
+    /// \details 多行 INSERT IGNORE，已在群中的成员保持原有角色；不存在的用户被忽略。
+    /// \param conversation_id 群聊会话 ID。
+    /// \param member_ids 需要加入的用户 ID 列表，函数内部会去重。
+    /// \return 实际新加入的成员数。
+    auto add_group_members(i64 conversation_id, std::vector<i64> member_ids)
+        -> boost::asio::awaitable<std::size_t>;
+
     /// \brief 加载某个用户所属的全部会话（群聊 + 单聊）。
     /// \param user_id 当前用户 ID。
+    /// \param route 连接路由，可走只读副本。
     /// \return 会话列表，包含类型和对当前用户的标题。
-    auto load_user_conversations(i64 user_id)
+    auto load_user_conversations(i64 user_id, Route route = Route::primary)
         -> boost::asio::awaitable<std::vector<ConversationInfo>>;
 
+    /// \brief 加载单个会话在若干成员视角下的列表项，用于会话列表的增量推送。
+    /// \details 一次查询按成员逐行返回，代价只与 user_ids 的数量有关，与各成员的会话总数无关。
+    /// \param conversation_id 会话 ID。
+    /// \param user_ids 需要列表项的用户，不是该会话成员的用户不返回。
+    /// \param route 连接路由。
+    /// \return user_id -> 该用户视角的会话信息（标题、未读数、预览与完整列表一致）。
+    auto load_conversation_for_members(i64 conversation_id, std::vector<i64> const& user_ids, Route route = Route::primary)
+        -> boost::asio::awaitable<std::unordered_map<i64, ConversationInfo>>;
+
+    /// \brief 加载用户所属全部会话的 ID，用于登录时建立在线订阅。
+    auto load_user_conversation_ids(i64 user_id)
+        -> boost::asio::awaitable<std::vector<i64>>;
+
     /// \brief 查询会话成员信息。
     auto get_conversation_member(i64 conversation_id, i64 user_id)
         -> boost::asio::awaitable<std::optional<MemberInfo>>;
@@ -16,15 +16,17 @@ namespace database
 
     /// \brief 加载某个用户的好友列表。
     /// \param user_id 当前用户 ID。
+    /// \param route 连接路由，可走只读副本。
     /// \return 好友信息列表。
-    auto load_user_friends(i64 user_id)
+    auto load_user_friends(i64 user_id, Route route = Route::primary)
         -> boost::asio::awaitable<std::vector<FriendInfo>>;
 
     /// \brief 按账号搜索用户，并判断是否为当前用户或已是好友。
     /// \param current_user_id 当前登录用户 ID。
     /// \param account 要搜索的账号。
+    /// \param route 连接路由，可走只读副本。
     /// \return 查询结果及好友关系标记。
-    auto search_friend_by_account(i64 current_user_id, std::string const& account)
+    auto search_friend_by_account(i64 current_user_id, std::string const& account, Route route = Route::primary)
         -> boost::asio::awaitable<SearchFriendResult>;
 
     /// \brief 创建一条好友申请，若已是好友或存在未处理申请则返回对应错误。
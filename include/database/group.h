@@ -11,8 +11,9 @@ namespace database
     /// \brief 按群聊 ID 搜索群聊信息。
     /// \param current_user_id 当前登录用户 ID。
     /// \param group_id 要搜索的群聊 ID。
+    /// \param route 连接路由，可走只读副本。
     /// \return 查询结果及成员状态标记。
-    auto search_group_by_id(i64 current_user_id, i64 group_id)
+    auto search_group_by_id(i64 current_user_id, i64 group_id, Route route = Route::primary)
         -> boost::asio::awaitable<SearchGroupResult>;
 
     /// \brief 创建一条入群申请，若已是成员或存在未处理申请则返回对应错误。
@@ -12,41 +12,59 @@ namespace database
     /// \param conversation_id 目标会话 ID。
     /// \param sender_id 发送者用户 ID。
     /// \param content 消息文本内容。
+    /// \param msg_type 消息类型，默认 TEXT，可选 SYSTEM。
+    /// \param sender_display_name 发送者当前昵称，用于写入热消息缓存；为空时丢弃该会话的缓存。
     /// \return 已写入消息的简要信息。
     auto append_text_message(
         i64 conversation_id,
         i64 sender_id,
         std::string const& content,
-        std::string const& msg_type = std::string{ "TEXT" }
+        std::string const& msg_type = std::string{ "TEXT" },
+        std::string const& sender_display_name = {}
     ) -> boost::asio::awaitable<StoredMessage>;
 
     /// \brief 在"世界"会话中追加一条文本消息。
     /// \param sender_id 发送者用户 ID。
     /// \param content 消息文本内容。
     /// \param msg_type 消息类型，默认 TEXT，可选 SYSTEM。
+    /// \param sender_display_name 发送者当前昵称，含义同 append_text_message。
     /// \return 已写入消息的简要信息。
     auto append_world_text_message(
         i64 sender_id,
         std::string const& content,
-        std::string const& msg_type = std::string{ "TEXT" }
+        std::string const& msg_type = std::string{ "TEXT" },
+        std::string const& sender_display_name = {}
     ) -> boost::asio::awaitable<StoredMessage>;
 
     /// \brief 拉取指定会话的一批历史消息（向上翻旧消息）。
     /// \param conversation_id 会话 ID。
     /// \param before_seq 当为 0 或以下时表示从最新开始，否则拉取 seq 小于该值的消息。
     /// \param limit 最大返回条数，建议为正数。
+    /// \param route 连接路由，可走只读副本；为热消息缓存建立快照时总是读主库。
     /// \return 按 seq 递增排序的消息列表。
-    auto load_user_conversation_history(i64 conversation_id, i64 before_seq, i64 limit)
+    auto load_user_conversation_history(i64 conversation_id, i64 before_seq, i64 limit, Route route = Route::primary)
         -> boost::asio::awaitable<std::vector<LoadedMessage>>;
 
     /// \brief 拉取指定会话中 seq 大于给定值的一批新消息（用于增量同步）。
     /// \param conversation_id 会话 ID。
     /// \param after_seq 仅返回 seq 大于该值的消息。
     /// \param limit 最大返回条数，建议为正数。
+    /// \param route 连接路由，可走只读副本。
     /// \return 按 seq 递增排序的消息列表。
-    auto load_user_conversation_since(i64 conversation_id, i64 after_seq, i64 limit)
+    auto load_user_conversation_since(i64 conversation_id, i64 after_seq, i64 limit, Route route = Route::primary)
         -> boost::asio::awaitable<std::vector<LoadedMessage>>;
 
+    /// \brief 一次拉取多个会话中 seq 大于各自进度的新消息（登录后的增量同步）。
+    /// \details 热消息缓存能覆盖的会话直接由缓存响应；其余会话连同成员校验合并为一次往返，
+    ///          每个会话各走一次 (conversation_id, seq) 索引查找，再一次性加载这些消息的反应。
+    /// \param user_id 请求者，只返回其所在的会话。
+    /// \param cursors 各会话的客户端进度，同一会话只应出现一次。
+    /// \param limit 每个会话最多返回的条数。
+    /// \param route 连接路由，可走只读副本。
+    /// \return 有新消息的会话，顺序与 cursors 一致；没有新消息或不属于该用户的会话不返回。
+    auto load_conversations_since(i64 user_id, std::vector<SyncCursor> const& cursors, i64 limit, Route route = Route::primary)
+        -> boost::asio::awaitable<std::vector<SyncedConversation>>;
+
     /// \brief 拉取"世界"会话的一批历史消息。
     /// \param before_seq 当为 0 或以下时表示从最新开始，否则拉取 seq 小于该值的消息。
     /// \param limit 最大返回条数，建议为正数。
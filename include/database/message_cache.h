@@ -0,0 +1,82 @@
+#pragma once
+
+#include <database/types.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+/// \brief 会话最新消息的内存环形缓存，用于直接响应历史消息请求。
+namespace database
+{
+    /// \brief 热消息缓存参数。
+    struct MessageCacheConfig {
+        /// \brief 每个会话保留的最新消息条数。
+        std::size_t ring_size = 200;
+        /// \brief 所有会话合计的内存上限（字节，估算值），超出时淘汰最久未访问的会话。
+        std::size_t max_bytes = 64 * 1024 * 1024;
+    };
+
+    /// \brief 热消息缓存统计，hits / misses / evictions 为进程启动以来的累计值。
+    struct MessageCacheStats {
+        std::uint64_t hits{ 0 };          ///< 由缓存直接响应的历史请求数
+        std::uint64_t misses{ 0 };        ///< 回落到数据库的历史请求数
+        std::uint64_t evictions{ 0 };     ///< 因内存上限被淘汰的会话数
+        std::size_t conversations{ 0 };   ///< 当前缓存的会话数
+        std::size_t messages{ 0 };        ///< 当前缓存的消息条数
+        std::size_t bytes{ 0 };           ///< 当前估算占用（字节）
+    };
+
+    /// \brief 设置热消息缓存参数（可选，未设置时使用默认值）。
+    auto set_message_cache_config(MessageCacheConfig cfg) -> void;
+
+    /// \brief 读取热消息缓存统计快照。
+    auto message_cache_stats() -> MessageCacheStats;
+
+    /// \brief 从缓存取 seq 小于 before_seq 的最新 limit 条消息（before_seq <= 0 表示从最新开始）。
+    /// \return 缓存不能完整覆盖该范围时返回空，调用方应回落到数据库。
+    auto message_cache_history(i64 conversation_id, i64 before_seq, i64 limit)
+        -> std::optional<std::vector<LoadedMessage>>;
+
+    /// \brief 从缓存取 seq 大于 after_seq 的最早 limit 条消息。
+    /// \return 缓存不能完整覆盖该范围时返回空，调用方应回落到数据库。
+    auto message_cache_since(i64 conversation_id, i64 after_seq, i64 limit)
+        -> std::optional<std::vector<LoadedMessage>>;
+
+    /// \brief 为未缓存的会话开始建立缓存。
+    /// \details 成功后调用方从数据库读取最新的 ring_size 条消息并交给 message_cache_finish_prime；
+    ///          读取期间写入的新消息会被暂存并在建立时合并，期间发生撤回、反应变化或改名则放弃本次建立。
+    /// \return 建立所需的条数；会话已缓存或已有协程在建立时返回 0。
+    auto message_cache_begin_prime(i64 conversation_id) -> std::size_t;
+
+    /// \brief 用数据库读出的最新消息（seq 递增）建立缓存。
+    /// \param requested 请求的条数，返回条数少于该值说明已覆盖会话全部历史。
+    auto message_cache_finish_prime(i64 conversation_id, std::vector<LoadedMessage> const& latest, std::size_t requested)
+        -> void;
+
+    /// \brief 读取失败时撤销 message_cache_begin_prime。
+    auto message_cache_abort_prime(i64 conversation_id) -> void;
+
+    /// \brief 新消息写入后追加到缓存，会话未缓存时忽略。
+    auto message_cache_append(LoadedMessage msg) -> void;
+
+    /// \brief 标记缓存中的消息已撤回。
+    auto message_cache_recall(i64 conversation_id, i64 message_id) -> void;
+
+    /// \brief 替换缓存中消息的反应列表。
+    auto message_cache_set_reactions(i64 conversation_id, i64 message_id, std::vector<MessageReaction> reactions)
+        -> void;
+
+    /// \brief 用户改名后更新缓存中该用户作为发送者与反应者的昵称。
+    auto message_cache_rename_user(i64 user_id, std::string const& display_name) -> void;
+
+    /// \brief 丢弃会话的缓存（会话解散或无法精确更新时调用）。
+    auto message_cache_forget(i64 conversation_id) -> void;
+
+    /// \brief 会话历史的版本号，会话内任何消息的写入、撤回、反应变化或发送者改名都会使其增大。
+    /// \details 与会话是否已建立缓存无关；调用方应在读取历史之前取版本号，
+    ///          用它标记由读取结果派生的数据，版本号变化即说明该数据可能已过期。
+    auto message_cache_version(i64 conversation_id) -> u64;
+} // namespace database
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <boost/asio/awaitable.hpp>
+#include <database/types.h>
+
+/// \brief 会话消息序列号分配。
+namespace database
+{
+    /// \brief 为会话分配下一条消息的 seq。
+    /// \details 序列号按块从 conversation_sequences 预留（一条 UPDATE ... LAST_INSERT_ID），
+    ///          之后在内存中递增发放，同一会话的 seq 严格递增；块用完时只有一个协程回源，
+    ///          其余协程排队等待新块。热点会话会自动放大块大小。
+    ///          本进程首次触达某会话时按 messages 中的 MAX(seq) 校准计数器，
+    ///          回收上次运行未用完的区间，因此同一会话只应由一个服务进程分配。
+    /// \param conversation_id 会话 ID。
+    /// \return 新的 seq。
+    auto next_message_seq(i64 conversation_id) -> boost::asio::awaitable<i64>;
+
+    /// \brief 丢弃会话的内存计数器（会话解散后调用）。
+    auto forget_conversation_sequence(i64 conversation_id) -> void;
+} // namespace database
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace database
+{
+    /// \brief 热路径查询的预处理语句编号。
+    /// \details 每个连接按编号懒加载并缓存 boost::mysql::statement，之后走二进制协议执行：
+    ///          MySQL 不再重复解析 SQL，结果行也省去文本到数值的转换。
+    ///          新增语句时在末尾追加编号，并在 STATEMENT_SQL 同一位置追加 SQL。
+    enum class StatementId : std::uint8_t
+    {
+        get_conversation_member,
+        get_conversation_type,
+        get_single_peer_user_id,
+        is_friend,
+        append_message,
+        history_latest,
+        history_before,
+        history_since_start,
+        history_since,
+        message_reactions,
+        update_last_read_seq,
+        sequence_sync,
+        sequence_reserve,
+        load_user_conversations,
+        load_user_conversation_ids,
+        count_,
+    };
+
+    inline constexpr auto STATEMENT_COUNT = static_cast<std::size_t>(StatementId::count_);
+
+    namespace detail
+    {
+        template<std::string_view const&... Parts>
+        struct JoinedSql
+        {
+            static constexpr auto storage = [] {
+                std::array<char, (Parts.size() + ...)> out{};
+                auto it = out.begin();
+                ((it = std::copy(Parts.begin(), Parts.end(), it)), ...);
+                return out;
+            }();
+            static constexpr std::string_view value{ storage.data(), storage.size() };
+        };
+    } // namespace detail
+
+    /// \brief 编译期拼接若干 SQL 片段，结果可直接用作语句文本或 with_params 的格式串。
+    template<std::string_view const&... Parts>
+    inline constexpr std::string_view join_sql = detail::JoinedSql<Parts...>::value;
+
+    /// \brief 会话列表查询的列与连接，会话列表和按成员加载单个会话共用，调用方只追加 WHERE 子句。
+    /// \details 列顺序即 conversation_from_row 的解析顺序，最后一列为该行对应的成员；
+    ///          单聊对端按该行成员自身排除，最新消息取自 conversation_summaries。
+    inline constexpr std::string_view CONVERSATION_SELECT =
+        "SELECT c.id, c.type, c.name, peer.display_name AS peer_name,"
+        " COALESCE(s.last_seq, 0) AS last_seq, COALESCE(s.last_server_time_ms, 0) AS last_time,"
+        " CASE WHEN c.type = 'GROUP' THEN c.avatar_path ELSE peer.avatar_path END AS avatar_path,"
+        " cm.last_read_seq,"
+        " GREATEST(0, COALESCE(s.last_seq, 0) - cm.last_read_seq) AS unread_count,"
+        " s.last_content, s.last_msg_type, s.last_sender_id, sender.display_name AS sender_name,"
+        " cm.user_id "
+        "FROM conversation_members cm "
+        "JOIN conversations c ON c.id = cm.conversation_id "
+        "LEFT JOIN conversation_summaries s ON s.conversation_id = c.id "
+        "LEFT JOIN conversation_members pm ON pm.conversation_id = c.id AND c.type = 'SINGLE' AND pm.user_id <> cm.user_id "
+        "LEFT JOIN users peer ON peer.id = pm.user_id "
+        "LEFT JOIN users sender ON sender.id = s.last_sender_id ";
+
+    inline constexpr std::string_view USER_CONVERSATIONS_WHERE = "WHERE cm.user_id = ? ORDER BY c.id ASC";
+
+    /// \brief 各语句的 SQL 文本，下标与 StatementId 一致。
+    inline constexpr auto STATEMENT_SQL = std::to_array<std::string_view>({
+        // get_conversation_member(conversation_id, user_id)
+        "SELECT cm.role, cm.muted_until_ms, u.display_name "
+        "FROM conversation_members cm JOIN users u ON u.id = cm.user_id "
+        "WHERE cm.conversation_id = ? AND cm.user_id = ? LIMIT 1",
+        // get_conversation_type(conversation_id)
+        "SELECT type FROM conversations WHERE id = ? LIMIT 1",
+        // get_single_peer_user_id(conversation_id, current_user_id)
+        "SELECT user_id FROM conversation_members WHERE conversation_id = ? AND user_id <> ? LIMIT 1",
+        // is_friend(user_id, peer_id)
+        "SELECT 1 FROM friends WHERE user_id = ? AND friend_user_id = ? LIMIT 1",
+        // append_message(conversation_id, sender_id, seq, msg_type, content, server_time_ms)
+        "INSERT INTO messages (conversation_id, sender_id, seq, msg_type, content, server_time_ms)"
+        " VALUES (?, ?, ?, ?, ?, ?)",
+        // history_latest(conversation_id, limit)
+        "SELECT m.id, m.conversation_id, m.sender_id, u.display_name, m.seq, m.msg_type,"
+        " m.content, m.server_time_ms, m.is_recalled "
+        "FROM messages m JOIN users u ON u.id = m.sender_id "
+        "WHERE m.conversation_id = ? "
+        "ORDER BY m.seq DESC LIMIT ?",
+        // history_before(conversation_id, before_seq, limit)
+        "SELECT m.id, m.conversation_id, m.sender_id, u.display_name, m.seq, m.msg_type,"
+        " m.content, m.server_time_ms, m.is_recalled "
+        "FROM messages m JOIN users u ON u.id = m.sender_id "
+        "WHERE m.conversation_id = ? AND m.seq < ? "
+        "ORDER BY m.seq DESC LIMIT ?",
+        // history_since_start(conversation_id, limit)
+        "SELECT m.id, m.conversation_id, m.sender_id, u.display_name, m.seq, m.msg_type,"
+        " m.content, m.server_time_ms, m.is_recalled "
+        "FROM messages m JOIN users u ON u.id = m.sender_id "
+        "WHERE m.conversation_id = ? "
+        "ORDER BY m.seq ASC LIMIT ?",
+        // history_since(conversation_id, after_seq, limit)
+        "SELECT m.id, m.conversation_id, m.sender_id, u.display_name, m.seq, m.msg_type,"
+        " m.content, m.server_time_ms, m.is_recalled "
+        "FROM messages m JOIN users u ON u.id = m.sender_id "
+        "WHERE m.conversation_id = ? AND m.seq > ? "
+        "ORDER BY m.seq ASC LIMIT ?",
+        // message_reactions(message_id)
+        "SELECT mr.id, mr.message_id, mr.user_id, mr.reaction_type, u.display_name "
+        "FROM message_reactions mr "
+        "JOIN users u ON u.id = mr.user_id "
+        "WHERE mr.message_id = ? "
+        "ORDER BY mr.id ASC",
+        // update_last_read_seq(last_read_seq, conversation_id, user_id)
+        "UPDATE conversation_members SET last_read_seq = ?"
+        " WHERE conversation_id = ? AND user_id = ?",
+        // sequence_sync(conversation_id, conversation_id)：按已有消息校准计数器
+        "INSERT INTO conversation_sequences (conversation_id, next_seq)"
+        " SELECT * FROM (SELECT ? AS cid, COALESCE(MAX(seq), 0) + 1 AS nseq"
+        " FROM messages WHERE conversation_id = ?) AS src"
+        " ON DUPLICATE KEY UPDATE next_seq = src.nseq",
+        // sequence_reserve(count, conversation_id)：预留后通过 LAST_INSERT_ID 带回新的 next_seq
+        "UPDATE conversation_sequences SET next_seq = LAST_INSERT_ID(next_seq + ?)"
+        " WHERE conversation_id = ?",
+        // load_user_conversations(user_id)：会话列表
+        join_sql<CONVERSATION_SELECT, USER_CONVERSATIONS_WHERE>,
+        // load_user_conversation_ids(user_id)
+        "SELECT conversation_id FROM conversation_members WHERE user_id = ?",
+    });
+
+    static_assert(STATEMENT_SQL.size() == STATEMENT_COUNT, "STATEMENT_SQL must match StatementId");
+
+    /// \brief 取语句编号对应的 SQL 文本。
+    constexpr auto statement_sql(StatementId id) noexcept -> std::string_view
+    {
+        return STATEMENT_SQL[static_cast<std::size_t>(id)];
+    }
+} // namespace database
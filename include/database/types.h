@@ -1,11 +1,20 @@
 #pragma once
 
 #include <string>
+#include <vector>
 #include <utility.h>
 
 /// \brief 与数据库相关的数据类型定义。
 namespace database
 {
+    /// \brief 借连接的目标：主库，或只读副本（未配置副本时等同主库）。
+    /// \details 带 Route 参数的函数只做查询，调用方可按 read_route_after_write 选择副本。
+    enum class Route : u8
+    {
+        primary,
+        replica,
+    };
+
     /// \brief 用户基础信息，用于登录 / 注册结果返回。
     struct UserInfo
     {
@@ -239,10 +248,30 @@ namespace database
         std::string content{};
         /// \brief 服务器时间戳（毫秒）。
         i64 server_time_ms{};
+        /// \brief 是否已被撤回。
+        bool is_recalled{};
         /// \brief 消息反应列表。
         std::vector<MessageReaction> reactions{};
     };
 
+    /// \brief 多会话增量同步中单个会话的客户端进度。
+    struct SyncCursor
+    {
+        /// \brief 会话 ID。
+        i64 conversation_id{};
+        /// \brief 客户端本地已有的最新 seq，只同步比它新的消息。
+        i64 after_seq{};
+    };
+
+    /// \brief 多会话增量同步中单个有新消息的会话。
+    struct SyncedConversation
+    {
+        /// \brief 会话 ID。
+        i64 conversation_id{};
+        /// \brief 按 seq 递增排序的新消息，最多为请求的单会话上限条。
+        std::vector<LoadedMessage> messages{};
+    };
+
     /// \brief 群聊搜索结果。
     struct SearchGroupResult
     {
@@ -273,6 +302,8 @@ namespace database
         std::string error_msg{};
         /// \brief 成功时的申请 ID。
         i64 request_id{};
+        /// \brief 目标群聊名称，用于向管理员推送新申请。
+        std::string group_name{};
     };
 
     /// \brief 入群申请信息，用于"新的朋友"列表中显示入群申请。
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <boost/asio/awaitable.hpp>
+#include <database/types.h>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/// \brief 消息写入的组提交管线。
+namespace database
+{
+    /// \brief 组提交参数。
+    struct WritePipelineConfig {
+        /// \brief 单个批次最多合并的消息条数。
+        std::size_t max_batch = 64;
+        /// \brief 首条消息入队后等待更多消息加入的时长；为 0 时立即写入。
+        std::chrono::microseconds linger{ 300 };
+        /// \brief 同时在途的批次数上限，积压超过一个批次时才会开启第二个写入协程。
+        std::size_t max_inflight = 2;
+    };
+
+    /// \brief 组提交统计，均为进程启动以来的累计值。
+    struct WritePipelineStats {
+        std::uint64_t batches{ 0 };         ///< 已提交的批次数
+        std::uint64_t rows{ 0 };            ///< 已写入的消息条数
+        std::uint64_t max_batch{ 0 };       ///< 单批最大条数
+        std::uint64_t fallbacks{ 0 };       ///< 批量插入失败后逐条重试的批次数
+        std::uint64_t failures{ 0 };        ///< 最终写入失败的消息条数
+        std::uint64_t total_commit_us{ 0 }; ///< 批次提交累计耗时（微秒，含借连接）
+        std::uint64_t max_commit_us{ 0 };   ///< 单批最大提交耗时（微秒）
+    };
+
+    /// \brief 一条待写入的消息，seq 已由 next_message_seq 分配。
+    struct PendingMessage {
+        i64 conversation_id{};
+        i64 sender_id{};
+        i64 seq{};
+        std::string msg_type;
+        std::string content;
+        i64 server_time_ms{};
+    };
+
+    /// \brief 设置组提交参数（可选，未设置时使用默认值）。
+    auto set_write_pipeline_config(WritePipelineConfig cfg) -> void;
+
+    /// \brief 把一条消息交给组提交管线，写入完成后返回其消息 ID。
+    /// \details 多个会话并发发送的消息在短暂的 linger 窗口内合并为一条多行 INSERT，
+    ///          一次往返、一次事务提交；批量失败时退化为逐条写入，只有出错的那条抛出异常。
+    ///          返回前已按各会话最新的消息更新 conversation_summaries。
+    auto enqueue_message_insert(PendingMessage msg) -> boost::asio::awaitable<i64>;
+
+    /// \brief 读取组提交统计快照。
+    auto write_pipeline_stats() -> WritePipelineStats;
+} // namespace database
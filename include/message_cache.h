@@ -47,6 +47,14 @@ public:
         QJsonObject const& reactions = QJsonObject()
     ) -> void;
 
+    /// \brief 追加一批消息到本地缓存，只读写一次文件。
+    /// \details 缓存中已有相同 seq 的消息（例如同步期间先经 MSG_PUSH 到达）会被跳过，
+    ///          写入后的消息按 seq 递增排列。
+    /// \param conversationId 会话 ID。
+    /// \param messages 按 seq 递增排列的消息（HISTORY_RESP / SYNC_RESP 格式）。
+    /// \return 实际写入的新消息，失败或全部重复时为空。
+    auto appendMessages(QString const& conversationId, QJsonArray const& messages) -> QJsonArray;
+
     /// \brief 从本地缓存加载指定会话的消息。
     /// \param conversationId 会话 ID。
     /// \return 消息数组和最大 seq 的 pair，失败时返回空数组和 0。
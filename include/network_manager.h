@@ -30,6 +30,16 @@ public:
     /// \param payload JSON 对象负载。
     auto sendCommand(QString const& command, QJsonObject const& payload) -> void;
 
+    /// \brief 发送一条携带二进制附件的命令（仅 v2 帧支持）。
+    /// \param command 命令名。
+    /// \param payload JSON 对象负载。
+    /// \param attachment 原始字节，例如头像文件内容。
+    /// \return 当前连接未协商到 v2 时不发送并返回 false，调用方应退回 base64。
+    auto sendCommandWithAttachment(QString const& command, QJsonObject const& payload, QByteArray const& attachment) -> bool;
+
+    /// \brief 当前连接是否已协商为 v2 二进制帧。
+    auto isBinaryProtocol() const -> bool;
+
 signals:
     /// \brief 连接成功时发出。
     void connected();
@@ -53,6 +63,14 @@ private slots:
     void onErrorOccurred(QAbstractSocket::SocketError socketError);
 
 private:
+    /// \brief 写出一帧，按协商结果选择 v1 文本行或 v2 二进制帧。
+    auto writeFrame(QString const& command, QByteArray const& json, QByteArray const& attachment = {}) -> void;
+
+    /// \brief 分发一条已拆出的命令，HELLO_RESP 在此消化，不再向上层发出。
+    auto dispatchCommand(QString const& command, QByteArray const& jsonText) -> void;
+
     QTcpSocket socket_;
     QByteArray buffer_;
+    /// \brief 出站帧编码版本，收到 HELLO_RESP 后切换。
+    int protocol_version_{ 1 };
 };
@@ -1,8 +1,13 @@
 #pragma once
 
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
 #include <string>
 #include <string_view>
 #include <stdexcept>
+#include <utility>
 
 /// \brief 文本协议的最小解析 / 拼装工具。
 namespace protocol
@@ -15,16 +20,31 @@ namespace protocol
         std::string payload;
     };
 
-    /// \brief 解析一行形如 "COMMAND:{...}\\n" 的文本。
-    /// \param line 包含命令和负载的整行字符串视图。
-    /// \return 拆分后的 Frame 结构。
-    /// \throws std::runtime_error 当行为空或缺少冒号时抛出。
-    auto inline parse_line(std::string_view line) -> Frame
+    /// \brief 指向接收缓冲区的零拷贝帧视图，仅在缓冲区下次被改写前有效。
+    struct FrameView
+    {
+        /// \brief 命令名，例如 SEND_MSG / PING。
+        std::string_view command;
+        /// \brief 冒号后的 JSON 文本。
+        std::string_view payload;
+    };
+
+    /// \brief 去掉行尾的 '\r' '\n'。
+    constexpr auto trim_line_end(std::string_view line) noexcept -> std::string_view
     {
-        // 去掉结尾的 '\r' '\n'
         while(not line.empty() and (line.back() == '\n' or line.back() == '\r')) {
             line.remove_suffix(1);
         }
+        return line;
+    }
+
+    /// \brief 在原缓冲区上拆分一行形如 "COMMAND:{...}\\n" 的文本，不产生任何拷贝。
+    /// \param line 包含命令和负载的整行字符串视图。
+    /// \return 指向 line 内部的 FrameView。
+    /// \throws std::runtime_error 当行为空或缺少冒号时抛出。
+    auto inline parse_line_view(std::string_view line) -> FrameView
+    {
+        line = trim_line_end(line);
         if(line.empty()) {
             throw std::runtime_error{ "empty line" };
         }
@@ -34,10 +54,17 @@ namespace protocol
             throw std::runtime_error{ "protocol error: missing ':'" };
         }
 
-        return {
-            std::string(line.substr(0, pos)),
-            std::string(line.substr(pos + 1))
-        };
+        return { line.substr(0, pos), line.substr(pos + 1) };
+    }
+
+    /// \brief 解析一行形如 "COMMAND:{...}\\n" 的文本。
+    /// \param line 包含命令和负载的整行字符串视图。
+    /// \return 拆分后的 Frame 结构。
+    /// \throws std::runtime_error 当行为空或缺少冒号时抛出。
+    auto inline parse_line(std::string_view line) -> Frame
+    {
+        auto const view = parse_line_view(line);
+        return { std::string(view.command), std::string(view.payload) };
     }
 
     /// \brief 组装一行 "COMMAND:{...}\\n"。
@@ -50,4 +77,201 @@ namespace protocol
         using namespace std::string_view_literals;
         return ""s + command + ":"sv + payload + "\n"sv;
     }
+
+    /// \brief 文本行协议（v1）。
+    inline constexpr int VERSION_LINE = 1;
+    /// \brief 定长帧头的二进制帧协议（v2），连接建立后通过 HELLO 协商。
+    inline constexpr int VERSION_BINARY = 2;
+
+    /// \brief 命令编号表，v2 帧头中以 "下标 + 1" 作为数字命令 ID，0 表示未知命令。
+    /// \note 只允许在末尾追加，已有条目的顺序不可修改，否则新旧两端的 ID 会错位。
+    inline constexpr auto COMMAND_NAMES = std::to_array<std::string_view>({
+        "PING", "PONG", "ECHO", "ERROR", "HELLO", "HELLO_RESP",
+        "REGISTER", "REGISTER_RESP", "LOGIN", "LOGIN_RESP",
+        "SEND_MSG", "SEND_ACK", "SEND_FAILED", "MSG_PUSH",
+        "HISTORY_REQ", "HISTORY_RESP", "CONV_LIST_REQ", "CONV_LIST_RESP",
+        "MARK_READ_REQ", "MARK_READ_RESP",
+        "PROFILE_UPDATE", "PROFILE_UPDATE_RESP",
+        "AVATAR_UPDATE", "AVATAR_UPDATE_RESP",
+        "GROUP_AVATAR_UPDATE", "GROUP_AVATAR_UPDATE_RESP",
+        "FRIEND_LIST_REQ", "FRIEND_LIST_RESP",
+        "FRIEND_SEARCH_REQ", "FRIEND_SEARCH_RESP",
+        "FRIEND_ADD_REQ", "FRIEND_ADD_RESP",
+        "FRIEND_REQ_LIST_REQ", "FRIEND_REQ_LIST_RESP",
+        "FRIEND_ACCEPT_REQ", "FRIEND_ACCEPT_RESP",
+        "FRIEND_REJECT_REQ", "FRIEND_REJECT_RESP",
+        "FRIEND_DELETE_REQ", "FRIEND_DELETE_RESP",
+        "CREATE_GROUP_REQ", "CREATE_GROUP_RESP",
+        "OPEN_SINGLE_CONV_REQ", "OPEN_SINGLE_CONV_RESP",
+        "MUTE_MEMBER_REQ", "MUTE_MEMBER_RESP",
+        "UNMUTE_MEMBER_REQ", "UNMUTE_MEMBER_RESP",
+        "SET_ADMIN_REQ", "SET_ADMIN_RESP",
+        "CONV_MEMBERS_REQ", "CONV_MEMBERS_RESP",
+        "LEAVE_CONV_REQ", "LEAVE_CONV_RESP",
+        "GROUP_SEARCH_REQ", "GROUP_SEARCH_RESP",
+        "GROUP_JOIN_REQ", "GROUP_JOIN_RESP",
+        "GROUP_JOIN_REQ_LIST_REQ", "GROUP_JOIN_REQ_LIST_RESP",
+        "GROUP_JOIN_ACCEPT_REQ", "GROUP_JOIN_ACCEPT_RESP",
+        "RENAME_GROUP_REQ", "RENAME_GROUP_RESP",
+        "RECALL_MSG_REQ", "RECALL_MSG_RESP", "MSG_RECALLED_PUSH",
+        "MSG_REACTION_REQ", "MSG_REACTION_RESP",
+        "MSG_UNREACTION_REQ", "MSG_UNREACTION_RESP", "MSG_REACTION_PUSH",
+        "GROUP_MEMBERS_ADD_REQ", "GROUP_MEMBERS_ADD_RESP",
+        "MSG_PUSH_BATCH",
+        "SYNC_REQ", "SYNC_RESP",
+        "CONV_UPSERT_PUSH", "CONV_REMOVE_PUSH",
+        "FRIEND_UPSERT_PUSH", "FRIEND_REMOVE_PUSH",
+        "FRIEND_REQ_UPSERT_PUSH", "FRIEND_REQ_REMOVE_PUSH",
+        "GROUP_JOIN_REQ_UPSERT_PUSH",
+    });
+
+    /// \brief 由命令名查数字 ID，未知命令返回 0。
+    constexpr auto command_id(std::string_view name) noexcept -> std::uint16_t
+    {
+        for(std::size_t i = 0; i < COMMAND_NAMES.size(); ++i) {
+            if(COMMAND_NAMES[i] == name) {
+                return static_cast<std::uint16_t>(i + 1);
+            }
+        }
+        return 0;
+    }
+
+    /// \brief 由数字 ID 查命令名，未知 ID 返回空串。
+    constexpr auto command_name(std::uint16_t id) noexcept -> std::string_view
+    {
+        if(id == 0 || id > COMMAND_NAMES.size()) {
+            return {};
+        }
+        return COMMAND_NAMES[id - 1];
+    }
+
+    /// \brief v2 二进制帧：8 字节定长帧头 + 负载。
+    /// \details 帧头布局（多字节字段均为网络字节序）：
+    ///          [0] 魔数 0xB2 | [1] 标志位 | [2..3] 命令 ID | [4..7] 负载长度。
+    ///          v1 文本行总以大写字母开头，因此收端只看首字节即可区分两种帧。
+    namespace v2
+    {
+        inline constexpr std::uint8_t MAGIC = 0xB2;
+        inline constexpr std::size_t HEADER_SIZE = 8;
+        /// \brief 单帧负载上限，防止恶意长度字段导致超大内存分配。
+        inline constexpr std::uint32_t MAX_PAYLOAD_SIZE = 16 * 1024 * 1024;
+
+        /// \brief 负载带二进制附件：[u32 JSON 长度][JSON][原始字节]，用于头像等数据免 base64。
+        inline constexpr std::uint8_t FLAG_ATTACHMENT = 0x01;
+
+        struct Header
+        {
+            std::uint8_t flags{ 0 };
+            std::uint16_t command_id{ 0 };
+            std::uint32_t length{ 0 };
+        };
+
+        /// \brief 判断首字节是否为 v2 帧起始。
+        constexpr auto is_frame_start(char first) noexcept -> bool
+        {
+            return static_cast<std::uint8_t>(first) == MAGIC;
+        }
+
+        /// \brief 编码帧头。
+        auto inline encode_header(Header h) noexcept -> std::array<char, HEADER_SIZE>
+        {
+            return {
+                static_cast<char>(MAGIC),
+                static_cast<char>(h.flags),
+                static_cast<char>((h.command_id >> 8) & 0xFF),
+                static_cast<char>(h.command_id & 0xFF),
+                static_cast<char>((h.length >> 24) & 0xFF),
+                static_cast<char>((h.length >> 16) & 0xFF),
+                static_cast<char>((h.length >> 8) & 0xFF),
+                static_cast<char>(h.length & 0xFF),
+            };
+        }
+
+        /// \brief 解码帧头。
+        /// \param data 至少 HEADER_SIZE 字节的数据。
+        /// \throws std::runtime_error 魔数不符或负载长度超限时抛出。
+        auto inline decode_header(char const* data) -> Header
+        {
+            auto const byte = [data](std::size_t i) {
+                return static_cast<std::uint32_t>(static_cast<std::uint8_t>(data[i]));
+            };
+            if(byte(0) != MAGIC) {
+                throw std::runtime_error{ "protocol error: bad frame magic" };
+            }
+            Header h;
+            h.flags = static_cast<std::uint8_t>(byte(1));
+            h.command_id = static_cast<std::uint16_t>((byte(2) << 8) | byte(3));
+            h.length = (byte(4) << 24) | (byte(5) << 16) | (byte(6) << 8) | byte(7);
+            if(h.length > MAX_PAYLOAD_SIZE) {
+                throw std::runtime_error{ "protocol error: frame too large" };
+            }
+            return h;
+        }
+
+        /// \brief 拆分带附件的负载，返回 {JSON, 附件}。
+        /// \throws std::runtime_error 长度字段越界时抛出。
+        auto inline split_attachment(std::string_view payload) -> std::pair<std::string_view, std::string_view>
+        {
+            if(payload.size() < 4) {
+                throw std::runtime_error{ "protocol error: truncated attachment frame" };
+            }
+            auto const byte = [payload](std::size_t i) {
+                return static_cast<std::uint32_t>(static_cast<std::uint8_t>(payload[i]));
+            };
+            auto const json_len = (byte(0) << 24) | (byte(1) << 16) | (byte(2) << 8) | byte(3);
+            if(json_len > payload.size() - 4) {
+                throw std::runtime_error{ "protocol error: bad attachment length" };
+            }
+            return { payload.substr(4, json_len), payload.substr(4 + json_len) };
+        }
+    } // namespace v2
+
+    /// \brief 出站帧：负载只保存一份，写出时按连接协商的版本选择 v1 行前缀或 v2 帧头。
+    struct OutboundFrame
+    {
+        /// \brief v1 行前缀 "COMMAND:"。
+        std::string prefix;
+        /// \brief v2 帧头，命令未登记编号时 command_id 为 0，只能按 v1 写出。
+        std::array<char, v2::HEADER_SIZE> header{};
+        std::uint16_t command_id{ 0 };
+        /// \brief JSON 负载（不含换行）。
+        std::string payload;
+
+        /// \brief 按指定版本写出时占用的字节数。
+        auto wire_size(bool binary) const noexcept -> std::size_t
+        {
+            return binary ? v2::HEADER_SIZE + payload.size() : prefix.size() + payload.size() + 1;
+        }
+    };
+
+    /// \brief 引用计数的只读出站帧，广播时所有接收方共享同一份内存。
+    using SharedFrame = std::shared_ptr<OutboundFrame const>;
+
+    /// \brief 组装出站帧。
+    /// \param command 命令名。
+    /// \param payload JSON 负载字符串。
+    auto inline make_frame(std::string_view command, std::string payload) -> OutboundFrame
+    {
+        OutboundFrame frame;
+        frame.prefix.reserve(command.size() + 1);
+        frame.prefix.append(command);
+        frame.prefix.push_back(':');
+        frame.command_id = command_id(command);
+        frame.header = v2::encode_header({
+            .flags = 0,
+            .command_id = frame.command_id,
+            .length = static_cast<std::uint32_t>(payload.size()),
+        });
+        frame.payload = std::move(payload);
+        return frame;
+    }
+
+    /// \brief 组装出站帧并包装为可共享的只读负载。
+    /// \param command 命令名。
+    /// \param payload JSON 负载字符串。
+    /// \return 指向出站帧的共享指针。
+    auto inline make_shared_frame(std::string_view command, std::string payload) -> SharedFrame
+    {
+        return std::make_shared<OutboundFrame const>(make_frame(command, std::move(payload)));
+    }
 } // namespace protocol
@@ -1,11 +1,14 @@
 #pragma once
 
 #include <QObject>
+#include <QJsonArray>
 #include <QJsonObject>
 #include <QVariantList>
 #include <QVariantMap>
 #include <QHash>
 
+#include <optional>
+
 class NetworkManager;
 class MessageCache;
 
@@ -185,8 +188,12 @@ private:
     void handleAvatarUpdateResponse(QJsonObject const& obj);
     void handleGroupAvatarUpdateResponse(QJsonObject const& obj);
     void handleMessagePush(QJsonObject const& obj);
+    void handleMessagePushBatch(QJsonObject const& obj);
     void handleHistoryResponse(QJsonObject const& obj);
     void handleConversationListResponse(QJsonObject const& obj);
+    void handleConversationUpsertPush(QJsonObject const& obj);
+    void handleConversationRemovePush(QJsonObject const& obj);
+    void handleSyncResponse(QJsonObject const& obj);
     void handleMarkReadResponse(QJsonObject const& obj);
     void handleConversationMembersResponse(QJsonObject const& obj);
     void handleLeaveConversationResponse(QJsonObject const& obj);
@@ -195,7 +202,11 @@ private:
     void handleSetAdminResponse(QJsonObject const& obj);
     void handleErrorResponse(QJsonObject const& obj);
     void handleFriendListResponse(QJsonObject const& obj);
+    void handleFriendUpsertPush(QJsonObject const& obj);
+    void handleFriendRemovePush(QJsonObject const& obj);
     void handleFriendRequestListResponse(QJsonObject const& obj);
+    void handleFriendRequestUpsertPush(QJsonObject const& obj);
+    void handleFriendRequestRemovePush(QJsonObject const& obj);
     void handleFriendSearchResponse(QJsonObject const& obj);
     void handleFriendAddResponse(QJsonObject const& obj);
     void handleFriendAcceptResponse(QJsonObject const& obj);
@@ -206,6 +217,7 @@ private:
     void handleGroupSearchResponse(QJsonObject const& obj);
     void handleGroupJoinResponse(QJsonObject const& obj);
     void handleGroupJoinRequestListResponse(QJsonObject const& obj);
+    void handleGroupJoinRequestUpsertPush(QJsonObject const& obj);
     void handleGroupJoinAcceptResponse(QJsonObject const& obj);
     void handleRenameGroupResponse(QJsonObject const& obj);
     void handleRecallMessageResponse(QJsonObject const& obj);
@@ -214,6 +226,15 @@ private:
     void handleUnreactionResponse(QJsonObject const& obj);
     void handleReactionPush(QJsonObject const& obj);
 
+    /// \brief 发送 SYNC_REQ，cursors 每项为 [conversationId, localLastSeq]。
+    void requestSync(QJsonArray const& cursors);
+
+    /// \brief 由保存的原始列表重新生成并发出对应的 *Reset 信号。
+    void emitConversations();
+    void emitFriends();
+    void emitFriendRequests();
+    void emitGroupJoinRequests();
+
     NetworkManager* network_manager_;
     MessageCache* message_cache_;
 
@@ -227,4 +248,14 @@ private:
     QHash<QString, qint64> conv_last_seq_;
     /// \brief 本地缓存中每个会话的最新 seq。
     QHash<QString, qint64> local_last_seq_;
+    /// \brief 本轮 SYNC_RESP 中被截断的会话，同步结束后以新的 seq 再请求一次。
+    QJsonArray sync_followup_;
+    /// \brief 是否有尚未收到 done 的 SYNC_REQ。
+    bool sync_in_flight_ = false;
+
+    /// \brief 最近一次完整列表响应的原始数据，增量推送在其上合并；尚未拉取时为空。
+    std::optional<QJsonArray> conversations_;
+    std::optional<QJsonArray> friends_;
+    std::optional<QJsonArray> friend_requests_;
+    std::optional<QJsonArray> group_join_requests_;
 };
@@ -10,15 +10,25 @@ namespace asio = boost::asio;
 #include <asioexec/use_sender.hpp>
 #include <exec/task.hpp>
 
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <list>
 #include <memory>
+#include <optional>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
+#include <utility>
 #include <ranges>
 #include <vector>
 #include <mutex>
 #include <chrono>
+#include <algorithm>
+#include <thread>
 
 #include <utility.h>
+#include <protocol.h>
 #include <database/conversation.h>
 
 namespace database
@@ -33,85 +43,251 @@ struct Session;
 /// \brief 简单 TCP 服务器：监听端口并为每个连接创建一个 Session。
 struct Server : std::enable_shared_from_this<Server>
 {
-    /// rief 使用给定执行器和端口构造服务器。
+    /// \brief 使用给定执行器和端口构造服务器（线程池模式）。
     /// \param exec 关联的 Asio 执行器。
     /// \param port 要监听的本地端口。
-    Server(asio::any_io_executor exec, u16 port) 
-        : acceptor_(exec, asio::ip::tcp::endpoint{ asio::ip::tcp::v4(), port })
-        , strand_(exec)
-    {}
+    /// \param shard_count 会话注册表分片数，0 表示使用硬件并发数。
+    Server(asio::any_io_executor exec, u16 port, std::size_t shard_count = 0)
+        : exec_(exec)
+    {
+        acceptors_.push_back(make_acceptor(exec, port, false));
+        if(shard_count == 0) {
+            shard_count = std::max(1u, std::thread::hardware_concurrency());
+        }
+        shards_.reserve(shard_count);
+        for(std::size_t i = 0; i < shard_count; ++i) {
+            shards_.push_back(std::make_unique<SessionShard>(exec));
+        }
+    }
+
+    /// \brief 按核构造服务器（thread-per-core 模式）。
+    /// \details 每个核心一个 io_context：各自拥有一个 SO_REUSEPORT acceptor，
+    ///          由内核在其间分发新连接，连接及其 Session 只在接受它的核心上运行；
+    ///          注册表每核一个分片，只有推送给其他核心上的会话时才跨核投递。
+    /// \param core_execs 每个核心 io_context 的执行器，不能为空。
+    /// \param port 要监听的本地端口。
+    Server(std::vector<asio::any_io_executor> const& core_execs, u16 port)
+        : exec_(core_execs.front())
+        , per_core_(true)
+    {
+        acceptors_.reserve(core_execs.size());
+        shards_.reserve(core_execs.size());
+        for(auto const& exec : core_execs) {
+            acceptors_.push_back(make_acceptor(exec, port, true));
+            shards_.push_back(std::make_unique<SessionShard>(exec));
+        }
+    }
 
     /// \brief 接收连接并为每个连接启动一个 Session 协程。
     /// \return 协程完成时返回 void（通常不会返回）。
     auto run() -> asio::awaitable<void>;
 
 private:
-    template<typename Fn>
-    void dispatch_on_strand(Fn&& fn)
+    friend struct Session;
+
+    /// \brief 创建并开始监听一个 acceptor。
+    /// \param reuse_port 是否设置 SO_REUSEPORT，使多个 acceptor 共享同一端口。
+    static auto make_acceptor(asio::any_io_executor exec, u16 port, bool reuse_port) -> asio::ip::tcp::acceptor;
+
+    /// \brief 单个 acceptor 的接受循环，新连接绑定在该 acceptor 所在的执行器上。
+    /// \param index acceptor 下标；按核模式下即核心下标，新连接登记到同一核心的分片。
+    auto accept_loop(std::size_t index) -> asio::awaitable<void>;
+
+    /// \brief 周期性输出运行统计（按命令的调用次数 / 耗时等）。
+    auto stats_loop() -> asio::awaitable<void>;
+
+    /// \brief 每隔 CACHE_CLEANUP_INTERVAL 调用一次 cleanup_expired_cache。
+    auto cache_cleanup_loop() -> asio::awaitable<void>;
+
+public:
+    /// \brief 统计输出间隔，由 --stats-sec 设置，为 0 时不输出。
+    static inline std::chrono::seconds stats_interval{ 60 };
+
+private:
+
+    /// \brief 一次扇出在各分片间共享的状态，定义见 fanout.cpp。
+    struct FanoutJob;
+
+    /// \brief 一次扇出在某个分片上的部分：该分片内的接收者及投递进度。
+    struct FanoutTask
+    {
+        std::shared_ptr<FanoutJob> job;
+        std::vector<i64> user_ids;
+        /// \brief 下一个待投递接收者的下标。
+        std::size_t next{ 0 };
+    };
+
+    /// \brief 会话注册表的一个分片。
+    /// \details 每个分片拥有独立 strand，分片之间的登录、下线与推送互不阻塞。
+    struct SessionShard
+    {
+        explicit SessionShard(asio::any_io_executor exec)
+            : strand(std::move(exec))
+        {}
+
+        /// \brief strand 保证本分片 sessions / sessions_by_user 的线程安全访问。
+        asio::strand<asio::any_io_executor> strand;
+        /// \brief 按 Session* 存储会话,支持 O(1) 删除（按核模式下为接受连接的核心，否则按指针哈希分片）。
+        std::unordered_map<Session*, std::shared_ptr<Session>> sessions{};
+        /// \brief 按 user_id 建立的在线会话索引,一位多连时存多条 weak_ptr（按 user_id 哈希分片）。
+        std::unordered_multimap<i64, std::weak_ptr<Session>> sessions_by_user{};
+        /// \brief 在线订阅索引：会话 -> 本分片内订阅它的在线用户。
+        std::unordered_map<i64, std::unordered_set<i64>> subscribers{};
+        /// \brief 反向索引：本分片的在线用户 -> 其所属会话；有条目即表示用户在线。
+        std::unordered_map<i64, std::unordered_set<i64>> subscriptions{};
+        /// \brief 待投递的扇出任务，按入队顺序逐块投递。
+        std::deque<FanoutTask> fanout_queue{};
+        /// \brief 是否已有投递在进行，避免重复启动 drain_fan_out。
+        bool fanout_draining{ false };
+    };
+
+    /// \brief 计算用户所属分片下标。
+    auto shard_index(i64 user_id) const noexcept -> std::size_t
+    {
+        return static_cast<std::size_t>(static_cast<u64>(user_id) % shards_.size());
+    }
+
+    /// \brief 用户维度索引所在的分片。
+    auto shard_for_user(i64 user_id) -> SessionShard&
+    {
+        return *shards_[shard_index(user_id)];
+    }
+
+    /// \brief 为新连接选择登记的分片（登录前没有 user_id）。
+    /// \details 按核模式下为接受它的核心，连接的登记与清理不跨核；线程池模式按指针哈希打散。
+    auto home_shard_index(Session const* ptr, std::size_t acceptor_index) const noexcept -> std::size_t
     {
-        if(strand_.running_in_this_thread()) {
-            fn();
-        } else {
-            asio::dispatch(strand_, std::forward<Fn>(fn));
+        if(per_core_) {
+            return acceptor_index;
         }
+        auto const h = std::hash<Session const*>{}(ptr) >> 4;
+        return h % shards_.size();
     }
 
-    friend struct Session;
+    /// \brief 连接本身所在的分片，即接受时记录的 Session::home_shard_。
+    auto shard_for_session(Session const& session) -> SessionShard&;
+
+    /// \brief 将新连接登记到所属分片。
+    auto add_session(std::shared_ptr<Session> const& session) -> void;
 
     /// \brief 从会话列表中移除一个已经结束的 Session。
     auto remove_session(Session* ptr) -> void;
 
-    /// \brief 将已鉴权的会话加入 user_id 索引。
-    auto index_authenticated_session(std::shared_ptr<Session> const& session) -> void;
+    /// \brief 将已鉴权的会话加入 user_id 索引，在分片上登记完成后才返回。
+    auto index_authenticated_session(std::shared_ptr<Session> session) -> asio::awaitable<void>;
 
-    /// \brief 遍历指定用户的在线会话。
+    /// \brief 在用户所属分片的 strand 上遍历其在线会话。
+    /// \details 调用是异步的，fn 必须按值持有其所需的数据。
     template<typename Fn>
     auto for_user_sessions(i64 user_id, Fn fn) -> void
     {
-        for(auto [it,end] = sessions_by_user_.equal_range(user_id); it != end; ) {
-            if(auto s = it->second.lock()) {
-                fn(s);
-                ++it;
-            } else {
-                it = sessions_by_user_.erase(it);
+        auto& shard = shard_for_user(user_id);
+        asio::dispatch(shard.strand, [&shard, user_id, fn = std::move(fn)]() mutable {
+            for(auto [it,end] = shard.sessions_by_user.equal_range(user_id); it != end; ) {
+                if(auto s = it->second.lock()) {
+                    fn(s);
+                    ++it;
+                } else {
+                    it = shard.sessions_by_user.erase(it);
+                }
             }
-        }
+        });
     }
 
-    /// \brief 遍历所有已鉴权会话，过程中过滤空指针并清理失效 weak_ptr 索引。
+    /// \brief 在每个分片的 strand 上并行遍历所有已鉴权会话，顺带清理失效 weak_ptr 索引。
+    /// \details 调用是异步的，fn 会被复制到每个分片，必须按值持有其所需的数据。
     template<typename Fn>
     auto for_all_authenticated_sessions(Fn fn) -> void
     {
-        for(auto const& session_ptr : sessions_ | std::views::values) {
-            if(not session_ptr or not session_ptr->is_authenticated()) {
-                continue;
-            }
-            fn(session_ptr);
+        for(auto& shard_ptr : shards_) {
+            auto& shard = *shard_ptr;
+            asio::post(shard.strand, [&shard, fn]() mutable {
+                for(auto const& session_ptr : shard.sessions | std::views::values) {
+                    if(not session_ptr or not session_ptr->is_authenticated()) {
+                        continue;
+                    }
+                    fn(session_ptr);
+                }
+
+                std::erase_if (
+                    shard.sessions_by_user,
+                    [](auto const& p) {
+                        auto const& [_,wptr] = p;
+                        return wptr.expired();
+                    }
+                );
+            });
         }
-
-        std::erase_if (
-            sessions_by_user_,
-            [](auto const& p) {
-                auto const& [_,wptr] = p;
-                return wptr.expired();
-            }
-        );
     }
 
-    /// \brief 主动向指定用户推送一份最新的“新的朋友”列表。
-    /// \details 用 FRIEND_REQ_LIST_RESP 的形式下发，复用现有前端处理逻辑。
-    auto send_friend_request_list_to(i64 target_user_id) -> void;
+    /// \brief 将一帧推送给一组用户的所有在线会话。
+    /// \details 接收者按分片分桶后排入各分片的扇出队列，各分片并行、分块投递，
+    ///          同一用户重复出现只推送一次。
+    /// \param user_ids 接收者用户 ID 列表。
+    /// \param frame 共享的只读出站帧。
+    auto fan_out(std::vector<i64> user_ids, protocol::SharedFrame frame) -> void;
+
+    /// \brief 将一帧推送给订阅了该会话的所有在线会话。
+    /// \details 各分片取自己的订阅者快照后排入扇出队列，开销与在线成员数成正比。
+    auto publish_conversation(i64 conversation_id, protocol::SharedFrame frame) -> void;
+
+    /// \brief 把一个扇出任务排入分片队列（调用方已位于分片 strand 上）。
+    auto enqueue_fan_out(SessionShard& shard, FanoutTask task) -> void;
+
+    /// \brief 在分片 strand 上投递队首任务的下一块，队列未空时重新 post 自己。
+    auto drain_fan_out(SessionShard& shard) -> void;
+
+    /// \brief 一次扇出的最后一块投递完成后记录统计。
+    auto finish_fan_out(FanoutJob const& job) -> void;
+
+    /// \brief 将一帧推送给所有已鉴权会话。
+    auto fan_out_all(protocol::SharedFrame frame) -> void;
+
+    /// \brief 用户最后一个连接下线后移除其全部订阅（调用方已位于分片 strand 上）。
+    auto drop_user_subscriptions(SessionShard& shard, i64 user_id) -> void;
+
+public:
+    /// \brief 登录后用用户所属的全部会话建立其在线订阅。
+    /// \details 须在 index_authenticated_session 完成之后读取会话列表，保证与并发的加入操作合并后不遗漏。
+    auto subscribe_user(i64 user_id, std::vector<i64> conversation_ids) -> void;
+
+    /// \brief 成员加入会话后为其中在线的用户增加订阅。
+    auto subscribe_conversation(i64 conversation_id, std::vector<i64> user_ids) -> void;
+
+    /// \brief 成员离开会话后移除其订阅。
+    auto unsubscribe_conversation(i64 conversation_id, std::vector<i64> user_ids) -> void;
+
+    /// \brief 会话解散后移除所有订阅，此前发出的推送仍会送达。
+    auto close_conversation_topic(i64 conversation_id) -> void;
+
+private:
+
+    /// \brief 向若干成员推送某个会话在各自视角下的列表项（CONV_UPSERT_PUSH）。
+    /// \details 一次查询取得全部成员的该行，只推送变化的一项，不再重新加载整张会话列表。
+    auto push_conv_upsert(i64 conversation_id, std::vector<i64> user_ids) -> void;
+
+    /// \brief 向会话的在线成员推送新的群名（只含 title 字段的 CONV_UPSERT_PUSH）。
+    auto push_conv_title(i64 conversation_id, std::string const& title) -> void;
+
+    /// \brief 通知若干用户从会话列表中移除该会话（CONV_REMOVE_PUSH）。
+    auto push_conv_remove(i64 conversation_id, std::vector<i64> user_ids) -> void;
+
+    /// \brief 向指定用户推送新增或变化的一位好友（FRIEND_UPSERT_PUSH）。
+    auto push_friend_upsert(i64 target_user_id, database::FriendInfo const& info) -> void;
 
-    /// \brief 主动向指定用户推送一份最新的好友列表。
-    /// \details 复用 FRIEND_LIST_RESP 结构，便于前端直接重建模型。
-    auto send_friend_list_to(i64 target_user_id) -> void;
+    /// \brief 通知指定用户从好友列表中移除一位好友（FRIEND_REMOVE_PUSH）。
+    auto push_friend_remove(i64 target_user_id, i64 friend_user_id) -> void;
 
-    /// \brief 主动下发会话列表给指定用户，结构同 CONV_LIST_RESP。
-    auto send_conv_list_to(i64 target_user_id) -> void;
+    /// \brief 向指定用户推送新增或状态变化的一条好友申请（FRIEND_REQ_UPSERT_PUSH）。
+    /// \details 空字符串字段不下发，客户端保留原值。
+    auto push_friend_request_upsert(i64 target_user_id, database::FriendRequestInfo const& info) -> void;
 
-    /// \brief 主动向指定用户推送一份最新的入群申请列表。
-    /// \details 用 GROUP_JOIN_REQ_LIST_RESP 的形式下发。
-    auto send_group_join_request_list_to(i64 target_user_id) -> void;
+    /// \brief 通知指定用户从“新的朋友”中移除一条申请（FRIEND_REQ_REMOVE_PUSH）。
+    auto push_friend_request_remove(i64 target_user_id, i64 request_id) -> void;
+
+    /// \brief 向群主与管理员推送新增或状态变化的一条入群申请（GROUP_JOIN_REQ_UPSERT_PUSH）。
+    /// \details 空字符串字段不下发，客户端保留原值。
+    auto push_group_join_request_upsert(std::vector<i64> admin_ids, database::GroupJoinRequestInfo const& info) -> void;
 
     /// \brief 推送指定会话的成员列表给会话成员（或指定用户）。
     /// \param conversation_id 会话 ID。
@@ -140,22 +316,24 @@ private:
     /// \param reactions 反应列表。
     auto broadcast_message_reaction(i64 conversation_id, i64 message_id, std::vector<database::MessageReaction> const& reactions) -> void;
 
-    asio::ip::tcp::acceptor acceptor_;
-    
-    /// \brief strand 保证 sessions_ 和 sessions_by_user_ 的线程安全访问。
-    asio::strand<asio::any_io_executor> strand_;
-    
-    /// \brief 按 Session* 存储会话,支持 O(1) 删除。
-    std::unordered_map<Session*, std::shared_ptr<Session>> sessions_{};
-    
-    /// \brief 按 user_id 建立的在线会话索引,一位多连时存多条 weak_ptr。
-    std::unordered_multimap<i64, std::weak_ptr<Session>> sessions_by_user_{};
+    /// \brief 监听套接字；线程池模式只有一个，按核模式每核一个。
+    std::vector<asio::ip::tcp::acceptor> acceptors_{};
+
+    /// \brief 运行推送加载协程等后台任务的执行器。
+    asio::any_io_executor exec_;
+
+    /// \brief 会话注册表分片，构造后数量固定；按核模式下与 acceptor 一一对应。
+    std::vector<std::unique_ptr<SessionShard>> shards_{};
+
+    /// \brief 是否为按核模式。
+    bool per_core_{ false };
 
 public:
     /// \brief 会话缓存条目,包含成员列表和类型。
     struct ConversationCache {
         std::vector<i64> member_ids;          ///< 会话成员ID列表
         std::string type;                      ///< 会话类型 ("SINGLE" 或 "GROUP")
+        std::unordered_map<i64, i64> muted_until_ms; ///< 被禁言成员的禁言截止时间，未禁言者不记录
         std::chrono::steady_clock::time_point last_access; ///< 最后访问时间
     };
 
@@ -165,15 +343,58 @@ public:
         std::chrono::steady_clock::time_point last_access;
     };
 
-    /// \brief 获取会话缓存(带自动加载和更新)。
+    /// \brief 按会话类型构造推送帧，返回空帧表示不推送。
+    using ConversationFrameBuilder = std::function<protocol::SharedFrame(std::string const& type)>;
+
+    /// \brief 获取会话缓存(读穿:未命中时回源数据库)。
+    /// \details 同一会话的并发未命中合并为一次加载，其余调用方等待该次结果。
+    /// \param conversation_id 会话ID。
+    /// \return 可选的缓存条目,会话不存在或加载失败时返回空。
+    auto get_conversation_cache(i64 conversation_id) -> asio::awaitable<std::optional<ConversationCache>>;
+
+    /// \brief 与 get_conversation_cache 相同，但回源查询失败时抛出 std::runtime_error，
+    ///        供必须区分“会话不存在”与“加载失败”的鉴权路径使用。
+    auto get_conversation_cache_checked(i64 conversation_id) -> asio::awaitable<std::optional<ConversationCache>>;
+
+    /// \brief 向会话的在线成员推送一帧，帧内容可依赖会话类型。
+    /// \details 会话类型命中缓存时立即投递；未命中时由一个后台协程回源，
+    ///          回源期间同一会话的推送按调用顺序排队，加载完成后依次投递。
+    ///          接收者取自在线订阅索引（publish_conversation）。
     /// \param conversation_id 会话ID。
-    /// \return 可选的缓存条目,失败时返回空。
-    auto get_conversation_cache(i64 conversation_id) -> std::optional<ConversationCache>;
+    /// \param build 帧构造函数，可能在其他线程上调用，须按值持有所需数据。
+    auto fan_out_conversation(i64 conversation_id, ConversationFrameBuilder build) -> void;
 
-    /// \brief 清除指定会话的缓存(当成员变动时调用)。
+    /// \brief 清除指定会话的缓存(会话解散或成员变化无法精确描述时调用)。
     /// \param conversation_id 会话ID。
     auto invalidate_conversation_cache(i64 conversation_id) -> void;
 
+    /// \brief 成员加入后就地更新会话缓存，未缓存时不做处理。
+    auto add_conversation_cache_member(i64 conversation_id, i64 user_id) -> void;
+
+    /// \brief 成员离开后就地更新会话缓存，未缓存时不做处理。
+    auto remove_conversation_cache_member(i64 conversation_id, i64 user_id) -> void;
+
+    /// \brief 禁言状态变化后就地更新会话缓存，muted_until_ms 为 0 表示解除。
+    auto set_conversation_cache_mute(i64 conversation_id, i64 user_id, i64 muted_until_ms) -> void;
+
+    /// \brief SEND_MSG 所需的鉴权信息，取自会话缓存。
+    struct SendContext {
+        std::string type;             ///< 会话类型
+        i64 muted_until_ms{ 0 };      ///< 发送者的禁言截止时间，0 表示未禁言
+        i64 peer_id{ -1 };            ///< 单聊对端用户 ID，非单聊或无对端时为 -1
+    };
+
+    /// \brief 取发送者在会话中的鉴权信息，稳态下只读内存。
+    /// \return 会话不存在时返回空。
+    /// \throws std::runtime_error 回源查询失败。
+    auto get_send_context(i64 conversation_id, i64 user_id) -> asio::awaitable<std::optional<SendContext>>;
+
+    /// \brief 查询两人是否为好友，结果按无序用户对缓存。
+    auto is_friend_cached(i64 user_id, i64 peer_id) -> asio::awaitable<bool>;
+
+    /// \brief 好友关系建立或解除后更新缓存。
+    auto set_friend_cache(i64 user_id, i64 peer_id, bool is_friend) -> void;
+
     /// \brief 清理过期缓存(超过5分钟未访问)。
     auto cleanup_expired_cache() -> void;
 
@@ -186,15 +407,137 @@ public:
     /// \brief 使成员列表缓存失效。
     auto invalidate_member_list_cache(i64 conversation_id) -> void;
 
+    /// \brief 一页历史消息的请求参数。
+    struct HistoryPageKey {
+        i64 conversation_id{};
+        i64 before_seq{};
+        i64 after_seq{};
+        i64 limit{};
+
+        auto operator==(HistoryPageKey const&) const -> bool = default;
+    };
+
+    /// \brief 历史页缓存统计，hits / misses 为进程启动以来的累计值。
+    struct HistoryPageStats {
+        u64 hits{ 0 };
+        u64 misses{ 0 };
+        std::size_t pages{ 0 };
+        std::size_t bytes{ 0 };
+    };
+
+    /// \brief 取已序列化的 HISTORY_RESP 帧。
+    /// \param version 会话当前的历史版本号（database::message_cache_version），与缓存时不一致视为未命中。
+    /// \return 未命中时返回空帧。
+    auto get_history_page(HistoryPageKey const& key, u64 version) -> protocol::SharedFrame;
+
+    /// \brief 缓存一页已序列化的 HISTORY_RESP 帧。
+    /// \param version 读取该页之前取得的会话历史版本号。
+    auto put_history_page(HistoryPageKey const& key, u64 version, protocol::SharedFrame frame) -> void;
+
+    /// \brief 读取历史页缓存统计快照。
+    auto history_page_stats() -> HistoryPageStats;
+
+    /// \brief 历史页缓存的内存上限（字节），超出时淘汰最久未访问的页。
+    static inline std::size_t history_page_cache_bytes{ 32 * 1024 * 1024 };
+
+    /// \brief 扇出统计，均为进程启动以来的累计值。
+    struct FanoutStats {
+        u64 fanouts{ 0 };         ///< 已完成的扇出次数
+        u64 chunks{ 0 };          ///< 已投递的块数
+        u64 deliveries{ 0 };      ///< 已投递的会话数
+        u64 total_span_us{ 0 };   ///< 首个接收者到最后一个接收者的累计耗时（微秒）
+        u64 max_span_us{ 0 };     ///< 单次扇出最大耗时（微秒）
+        u64 total_delay_us{ 0 };  ///< 发起扇出到首块开始投递的累计排队耗时（微秒）
+        u64 max_delay_us{ 0 };    ///< 单次扇出最大排队耗时（微秒）
+    };
+
+    /// \brief 读取扇出统计快照。
+    auto fanout_stats() const -> FanoutStats;
+
+    /// \brief 扇出时每块的接收者数，投递完一块后让出分片 strand。
+    static inline std::size_t fan_out_chunk_size{ 256 };
+
 private:
+    /// \brief 一次进行中的会话缓存回源，定义见 cache.cpp。
+    struct ConversationCacheLoad;
+
+    /// \brief 回源协程：加载会话类型与成员，写入缓存并投递排队的推送。
+    auto load_conversation_cache(i64 conversation_id) -> asio::awaitable<void>;
+
+    /// \brief 在后台执行器上启动 load_conversation_cache。
+    auto start_conversation_cache_load(i64 conversation_id) -> void;
+
+    /// \brief 在 cache_mutex_ 内登记一次未命中。
+    /// \param started 本次调用新建了回源时置为 true，调用方须在解锁后调用 start_conversation_cache_load。
+    /// \return 该会话进行中的回源。
+    auto join_conversation_cache_load(i64 conversation_id, bool& started) -> std::shared_ptr<ConversationCacheLoad>;
+
     /// \brief 会话成员列表缓存。
     std::unordered_map<i64, ConversationCache> conv_cache_{};
+    /// \brief 进行中的回源，同一会话至多一个。
+    std::unordered_map<i64, std::shared_ptr<ConversationCacheLoad>> conv_cache_loads_{};
     /// \brief 成员详情缓存。
     std::unordered_map<i64, MemberListCache> member_cache_{};
+
+    /// \brief 无序用户对 (min, max) 的哈希。
+    struct FriendPairHash {
+        auto operator()(std::pair<i64, i64> const& p) const noexcept -> std::size_t
+        {
+            return std::hash<i64>{}(p.first) * 31 + std::hash<i64>{}(p.second);
+        }
+    };
+    /// \brief 好友关系缓存条目。
+    struct FriendCacheEntry {
+        bool is_friend{ false };
+        std::chrono::steady_clock::time_point last_access;
+    };
+    /// \brief 好友关系缓存，键为 (较小 ID, 较大 ID)，好友关系总是双向建立与解除。
+    /// \details 与会话缓存一同按 CACHE_EXPIRE_DURATION 过期清理，条目数不超过 MAX_FRIEND_CACHE_ENTRIES。
+    std::unordered_map<std::pair<i64, i64>, FriendCacheEntry, FriendPairHash> friend_cache_{};
+    /// \brief 好友关系每次变更递增，回源结果在期间发生变更时不写入缓存。
+    u64 friend_cache_epoch_{ 0 };
+    /// \brief HistoryPageKey 的哈希。
+    struct HistoryPageKeyHash {
+        auto operator()(HistoryPageKey const& k) const noexcept -> std::size_t
+        {
+            auto h = std::hash<i64>{}(k.conversation_id);
+            h = h * 31 + std::hash<i64>{}(k.before_seq);
+            h = h * 31 + std::hash<i64>{}(k.after_seq);
+            return h * 31 + std::hash<i64>{}(k.limit);
+        }
+    };
+    /// \brief 一页缓存的历史消息帧。
+    struct HistoryPage {
+        u64 version{ 0 };
+        protocol::SharedFrame frame;
+        std::list<HistoryPageKey>::iterator lru;
+    };
+    /// \brief 已序列化的历史页，与会话缓存分开加锁，热点页的读取不与推送争用 cache_mutex_。
+    std::unordered_map<HistoryPageKey, HistoryPage, HistoryPageKeyHash> history_pages_{};
+    /// \brief 历史页访问顺序，表头为最近访问。
+    std::list<HistoryPageKey> history_lru_{};
+    std::size_t history_bytes_{ 0 };
+    HistoryPageStats history_stats_{};
+    std::mutex history_mutex_{};
+    /// \brief 扇出统计计数，在各分片 strand 上并发累加。
+    struct FanoutCounters {
+        std::atomic<u64> fanouts{ 0 };
+        std::atomic<u64> chunks{ 0 };
+        std::atomic<u64> deliveries{ 0 };
+        std::atomic<u64> total_span_us{ 0 };
+        std::atomic<u64> max_span_us{ 0 };
+        std::atomic<u64> total_delay_us{ 0 };
+        std::atomic<u64> max_delay_us{ 0 };
+    };
+    FanoutCounters fanout_counters_{};
     /// \brief 保护缓存的互斥锁。
     std::mutex cache_mutex_{};
     /// \brief 缓存过期时间(5分钟)。
     static constexpr auto CACHE_EXPIRE_DURATION = std::chrono::minutes(5);
+    /// \brief 过期缓存的清理周期。
+    static constexpr auto CACHE_CLEANUP_INTERVAL = std::chrono::minutes(1);
+    /// \brief 好友关系缓存的条目上限，已满时回源结果不再写入，直到下一轮清理腾出空间。
+    static constexpr std::size_t MAX_FRIEND_CACHE_ENTRIES = 1 << 20;
 };
 
 /// \brief 方便 main 调用的启动入口，返回服务器运行协程。
@@ -211,3 +554,19 @@ auto inline async_start_server(asio::any_io_executor exec, u16 port) -> stdexec:
         asioexec::use_sender
     );
 }
+
+/// \brief 按核模式的启动入口，返回服务器运行协程。
+/// \param core_execs 每个核心 io_context 的执行器。
+/// \param port 要监听的本地端口。
+auto inline async_start_server_per_core(std::vector<asio::any_io_executor> core_execs, u16 port) -> stdexec::sender auto
+{
+    auto exec = core_execs.front();
+    return asio::co_spawn (
+        exec,
+        [core_execs = std::move(core_execs), port] -> asio::awaitable<void> {
+            auto server = std::make_shared<Server>(core_execs, port);
+            co_await server->run();
+        },
+        asioexec::use_sender
+    );
+}
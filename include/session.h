@@ -9,24 +9,79 @@ namespace asio = boost::asio;
 #include <nlohmann/json.hpp>
 
 #include <print>
+#include <array>
 #include <deque>
-#include <istream>
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
 #include <memory>
 #include <string>
+#include <string_view>
 #include <cctype>
 #include <atomic>
+#include <chrono>
+#include <unordered_map>
+#include <vector>
 
+#include <database/types.h>
 #include <protocol.h>
 #include <utility.h>
 
 /// \brief 与聊天会话相关的网络组件。
 /// \details 使用 asio::awaitable / use_awaitable 实现的协程式会话。
 struct Server;
+struct CommandRegistry;
+
+/// \brief 命令处理函数的返回值：响应负载及本次处理是否失败。
+/// \details 失败由处理函数显式标记，命令统计据此计数，而不是从负载文本推断。
+struct CommandReply
+{
+    /// \brief 响应负载；为空表示不回包。
+    std::string payload;
+    bool failed{ false };
+
+    CommandReply() = default;
+    CommandReply(std::string payload, bool failed = false) : payload{ std::move(payload) }, failed{ failed } {}
+
+    /// \brief 处理函数已自行写回 ERROR / SEND_FAILED 等错误帧，只记失败、不再回包。
+    static auto failed_sent() -> CommandReply
+    {
+        return { std::string{}, true };
+    }
+};
 
 /// \brief 单个 TCP 连接会话，负责收发一条线路上的文本协议。
 struct Session : std::enable_shared_from_this<Session>
 {
     friend struct Server;
+    friend struct CommandRegistry;
+
+    /// \brief 单个命令的累计统计快照。
+    struct CommandStats
+    {
+        std::string_view command;
+        u64 calls{ 0 };       ///< 调用次数
+        u64 errors{ 0 };      ///< 处理函数标记失败或抛出异常的次数
+        u64 rejected{ 0 };    ///< 因未登录被拒绝的次数
+        u64 total_us{ 0 };    ///< 累计耗时（微秒）
+        u64 max_us{ 0 };      ///< 单次最大耗时（微秒）
+    };
+
+    /// \brief 读取所有已注册命令的统计，按注册表顺序返回。
+    static auto command_stats() -> std::vector<CommandStats>;
+
+    /// \brief MSG_PUSH_BATCH 合并统计，均为进程启动以来的累计值。
+    struct PushBatchStats
+    {
+        u64 frames{ 0 };      ///< 写出的 MSG_PUSH_BATCH 帧数
+        u64 messages{ 0 };    ///< 这些帧合计携带的推送条数
+    };
+
+    /// \brief 读取推送合并统计。
+    static auto push_batch_stats() -> PushBatchStats;
+
+    /// \brief 客户端可申请的推送合并周期上限（毫秒）。
+    static constexpr i64 MAX_PUSH_BATCH_MS = 50;
 
     /// \brief 使用一个已建立连接的 socket 构造会话。
     /// \param socket 已经 accept 完成的 TCP socket。
@@ -61,180 +116,53 @@ struct Session : std::enable_shared_from_this<Session>
     }
 
     /// \brief 以协程形式运行会话主循环。
-    /// \details 使用 async_read_until / async_write 配合 use_awaitable。
+    /// \details 按首字节区分 v1 文本行与 v2 二进制帧，两种格式可在同一连接上混用。
+    ///          帧直接在 read_buf_ 上解析，交给处理函数的 string_view 在下一次读取前有效。
     /// \return 协程完成时返回 void。
     auto run() -> asio::awaitable<void>
     {
         try {
             while(true) {
-                co_await asio::async_read_until (
-                    socket_, buffer_, '\n', asio::use_awaitable
-                );
-
-                std::string line;
-                {
-                    std::istream is{ &buffer_ };
-                    std::getline(is, line);
+                auto const pending = std::string_view{ read_buf_.data() + read_pos_, read_end_ - read_pos_ };
+                if(pending.empty()) {
+                    co_await read_more(1);
+                    continue;
                 }
 
-                if(line.empty()) {
+                if(protocol::v2::is_frame_start(pending.front())) {
+                    constexpr auto header_size = protocol::v2::HEADER_SIZE;
+                    if(pending.size() < header_size) {
+                        co_await read_more(header_size);
+                        continue;
+                    }
+                    auto const header = protocol::v2::decode_header(pending.data());
+                    auto const total = header_size + header.length;
+                    if(pending.size() < total) {
+                        co_await read_more(total);
+                        continue;
+                    }
+                    read_pos_ += total;
+                    co_await dispatch_binary_frame(header, pending.substr(header_size, header.length));
                     continue;
                 }
 
-                auto frame = protocol::parse_line(line);
-                if(frame.command == "PING") {
-                    auto msg = protocol::make_line("PONG", "{}");
-                    send_text(std::move(msg));
-                } else if(frame.command == "REGISTER") {
-                    auto payload = co_await handle_register(frame.payload);
-                    auto msg = protocol::make_line("REGISTER_RESP", payload);
-                    send_text(std::move(msg));
-                } else if(frame.command == "LOGIN") {
-                    auto payload = co_await handle_login(frame.payload);
-                    auto msg = protocol::make_line("LOGIN_RESP", payload);
-                    send_text(std::move(msg));
-                } else if(frame.command == "SEND_MSG") {
-                    auto self = shared_from_this();
-                    ++self->pending_ops_;  // 增加未完成操作计数
-                    asio::co_spawn(
-                        strand_,  // 使用 strand_ 而非 socket_.get_executor()，避免 socket 关闭后 executor 失效
-                        [self, payload = frame.payload]() mutable -> asio::awaitable<void> {
-                            // RAII 守卫：确保无论如何都会减少计数
-                            struct PendingGuard {
-                                std::shared_ptr<Session> s;
-                                ~PendingGuard() { --s->pending_ops_; }
-                            } guard{ self };
-                            
-                            try {
-                                // 检查 session 是否正在关闭
-                                if(self->closing_.load() || !self->socket_.is_open()) {
-                                    co_return;
-                                }
-                                co_await self->handle_send_msg(std::move(payload));
-                            } catch (std::exception const& e) {
-                                std::println("SEND_MSG unhandled exception: {}", e.what());
-                            }
-                        },
-                        asio::detached
-                    );
-                } else if(frame.command == "HISTORY_REQ") {
-                    auto payload = co_await handle_history_req(frame.payload);
-                    auto msg = protocol::make_line("HISTORY_RESP", payload);
-                    send_text(std::move(msg));
-                } else if(frame.command == "CONV_LIST_REQ") {
-                    auto payload = co_await handle_conv_list_req(frame.payload);
-                    auto msg = protocol::make_line("CONV_LIST_RESP", payload);
-                    send_text(std::move(msg));
-                } else if(frame.command == "MARK_READ_REQ") {
-                    auto payload = co_await handle_mark_read_req(frame.payload);
-                    auto msg = protocol::make_line("MARK_READ_RESP", payload);
-                    send_text(std::move(msg));
-                } else if(frame.command == "PROFILE_UPDATE") {
-                    auto payload = co_await handle_profile_update(frame.payload);
-                    auto msg = protocol::make_line("PROFILE_UPDATE_RESP", payload);
-                    send_text(std::move(msg));
-                } else if(frame.command == "AVATAR_UPDATE") {
-                    auto payload = co_await handle_avatar_update(frame.payload);
-                    auto msg = protocol::make_line("AVATAR_UPDATE_RESP", payload);
-                    send_text(std::move(msg));
-                } else if(frame.command == "GROUP_AVATAR_UPDATE") {
-                    auto payload = co_await handle_group_avatar_update(frame.payload);
-                    auto msg = protocol::make_line("GROUP_AVATAR_UPDATE_RESP", payload);
-                    send_text(std::move(msg));
-                } else if(frame.command == "FRIEND_LIST_REQ") {
-                    auto payload = co_await handle_friend_list_req(frame.payload);
-                    auto msg = protocol::make_line("FRIEND_LIST_RESP", payload);
-                    send_text(std::move(msg));
-                } else if(frame.command == "FRIEND_SEARCH_REQ") {
-                    auto payload = co_await handle_friend_search_req(frame.payload);
-                    auto msg = protocol::make_line("FRIEND_SEARCH_RESP", payload);
-                    send_text(std::move(msg));
-                } else if(frame.command == "FRIEND_ADD_REQ") {
-                    auto payload = co_await handle_friend_add_req(frame.payload);
-                    auto msg = protocol::make_line("FRIEND_ADD_RESP", payload);
-                    send_text(std::move(msg));
-                } else if(frame.command == "FRIEND_REQ_LIST_REQ") {
-                    auto payload = co_await handle_friend_req_list_req(frame.payload);
-                    auto msg = protocol::make_line("FRIEND_REQ_LIST_RESP", payload);
-                    send_text(std::move(msg));
-                } else if(frame.command == "FRIEND_ACCEPT_REQ") {
-                    auto payload = co_await handle_friend_accept_req(frame.payload);
-                    auto msg = protocol::make_line("FRIEND_ACCEPT_RESP", payload);
-                    send_text(std::move(msg));
-                } else if(frame.command == "FRIEND_REJECT_REQ") {
-                    auto payload = co_await handle_friend_reject_req(frame.payload);
-                    auto msg = protocol::make_line("FRIEND_REJECT_RESP", payload);
-                    send_text(std::move(msg));
-                } else if(frame.command == "FRIEND_DELETE_REQ") {
-                    auto payload = co_await handle_friend_delete_req(frame.payload);
-                    auto msg = protocol::make_line("FRIEND_DELETE_RESP", payload);
-                    send_text(std::move(msg));
-                } else if(frame.command == "CREATE_GROUP_REQ") {
-                    auto payload = co_await handle_create_group_req(frame.payload);
-                    auto msg = protocol::make_line("CREATE_GROUP_RESP", payload);
-                    send_text(std::move(msg));
-                } else if(frame.command == "OPEN_SINGLE_CONV_REQ") {
-                    auto payload = co_await handle_open_single_conv_req(frame.payload);
-                    auto msg = protocol::make_line("OPEN_SINGLE_CONV_RESP", payload);
-                    send_text(std::move(msg));
-                } else if(frame.command == "MUTE_MEMBER_REQ") {
-                    auto payload = co_await handle_mute_member_req(frame.payload);
-                    auto msg = protocol::make_line("MUTE_MEMBER_RESP", payload);
-                    send_text(std::move(msg));
-                } else if(frame.command == "UNMUTE_MEMBER_REQ") {
-                    auto payload = co_await handle_unmute_member_req(frame.payload);
-                    auto msg = protocol::make_line("UNMUTE_MEMBER_RESP", payload);
-                    send_text(std::move(msg));
-                } else if(frame.command == "SET_ADMIN_REQ") {
-                    auto payload = co_await handle_set_admin_req(frame.payload);
-                    auto msg = protocol::make_line("SET_ADMIN_RESP", payload);
-                    send_text(std::move(msg));
-                } else if(frame.command == "CONV_MEMBERS_REQ") {
-                    auto payload = co_await handle_conv_members_req(frame.payload);
-                    auto msg = protocol::make_line("CONV_MEMBERS_RESP", payload);
-                    send_text(std::move(msg));
-                } else if(frame.command == "LEAVE_CONV_REQ") {
-                    auto payload = co_await handle_leave_conv_req(frame.payload);
-                    auto msg = protocol::make_line("LEAVE_CONV_RESP", payload);
-                    send_text(std::move(msg));
-                } else if(frame.command == "GROUP_SEARCH_REQ") {
-                    auto payload = co_await handle_group_search_req(frame.payload);
-                    auto msg = protocol::make_line("GROUP_SEARCH_RESP", payload);
-                    send_text(std::move(msg));
-                } else if(frame.command == "GROUP_JOIN_REQ") {
-                    auto payload = co_await handle_group_join_req(frame.payload);
-                    auto msg = protocol::make_line("GROUP_JOIN_RESP", payload);
-                    send_text(std::move(msg));
-                } else if(frame.command == "GROUP_JOIN_REQ_LIST_REQ") {
-                    auto payload = co_await handle_group_join_req_list_req(frame.payload);
-                    auto msg = protocol::make_line("GROUP_JOIN_REQ_LIST_RESP", payload);
-                    send_text(std::move(msg));
-                } else if(frame.command == "GROUP_JOIN_ACCEPT_REQ") {
-                    auto payload = co_await handle_group_join_accept_req(frame.payload);
-                    auto msg = protocol::make_line("GROUP_JOIN_ACCEPT_RESP", payload);
-                    send_text(std::move(msg));
-                } else if(frame.command == "RENAME_GROUP_REQ") {
-                    auto payload = co_await handle_rename_group_req(frame.payload);
-                    auto msg = protocol::make_line("RENAME_GROUP_RESP", payload);
-                    send_text(std::move(msg));
-                } else if(frame.command == "RECALL_MSG_REQ") {
-                    auto payload = co_await handle_recall_msg_req(frame.payload);
-                    auto msg = protocol::make_line("RECALL_MSG_RESP", payload);
-                    send_text(std::move(msg));
-                } else if(frame.command == "MSG_REACTION_REQ") {
-                    auto payload = co_await handle_msg_reaction_req(frame.payload);
-                    auto msg = protocol::make_line("MSG_REACTION_RESP", payload);
-                    send_text(std::move(msg));
-                } else if(frame.command == "MSG_UNREACTION_REQ") {
-                    auto payload = co_await handle_msg_unreaction_req(frame.payload);
-                    auto msg = protocol::make_line("MSG_UNREACTION_RESP", payload);
-                    send_text(std::move(msg));
-                } else {
-                    // 默认 echo，方便用 nc 观察未知命令。
-                    auto payload = std::string{ "{\"command\":\"" + frame.command + "\"}" };
-                    auto msg = protocol::make_line("ECHO", payload);
-                    send_text(std::move(msg));
+                // 只扫描上次之后新到的字节，长行分多次到达时总代价仍是线性的
+                auto const newline = pending.find('\n', line_scanned_);
+                if(newline == std::string_view::npos) {
+                    line_scanned_ = pending.size();
+                    co_await read_more(pending.size() + 1);
+                    continue;
                 }
+                read_pos_ += newline + 1;
+                line_scanned_ = 0;
+
+                auto const line = protocol::trim_line_end(pending.substr(0, newline));
+                if(line.empty()) {
+                    continue;
+                }
+
+                auto const frame = protocol::parse_line_view(line);
+                co_await dispatch_frame(frame.command, frame.payload);
             }
         } catch(boost::system::system_error const& ex) {
             if(ex.code() == asio::error::eof) {
@@ -273,124 +201,219 @@ struct Session : std::enable_shared_from_this<Session>
     }
 
 private:
+    /// \brief 保证 read_buf_ 中至少有 min_pending 字节未处理数据。
+    /// \details 只在上一帧处理完毕后调用：先把未处理数据搬到缓冲区头部，
+    ///          必要时按倍数扩容，再循环 async_read_some 直到满足要求。
+    ///          搬移会使此前交出的 string_view 失效。
+    auto read_more(std::size_t min_pending) -> asio::awaitable<void>
+    {
+        if(min_pending > MAX_READ_BUFFER_BYTES) {
+            throw std::runtime_error{ "protocol error: frame exceeds read buffer limit" };
+        }
+
+        auto const pending = read_end_ - read_pos_;
+        if(read_pos_ > 0) {
+            if(pending > 0) {
+                std::memmove(read_buf_.data(), read_buf_.data() + read_pos_, pending);
+            }
+            read_pos_ = 0;
+            read_end_ = pending;
+        }
+
+        // 大帧处理完后收缩回初始大小，避免空闲连接长期占用大块内存
+        if(pending == 0 && read_buf_.size() > INITIAL_READ_BUFFER_BYTES && min_pending <= INITIAL_READ_BUFFER_BYTES) {
+            read_buf_.resize(INITIAL_READ_BUFFER_BYTES);
+            read_buf_.shrink_to_fit();
+        }
+
+        if(min_pending > read_buf_.size()) {
+            read_buf_.resize(std::min(std::max(min_pending, read_buf_.size() * 2), MAX_READ_BUFFER_BYTES));
+        }
+
+        while(read_end_ < min_pending) {
+            auto const n = co_await socket_.async_read_some (
+                asio::buffer(read_buf_.data() + read_end_, read_buf_.size() - read_end_), asio::use_awaitable
+            );
+            read_end_ += n;
+        }
+    }
+
+    /// \brief 处理一个已完整接收的 v2 二进制帧。
+    /// \param header 已解码的帧头。
+    /// \param body 指向 read_buf_ 的负载视图。
+    auto dispatch_binary_frame(protocol::v2::Header header, std::string_view body) -> asio::awaitable<void>
+    {
+        auto const command = protocol::command_name(header.command_id);
+        if(command.empty()) {
+            std::println("session received unknown command id {}", header.command_id);
+            co_return;
+        }
+
+        if(header.flags & protocol::v2::FLAG_ATTACHMENT) {
+            auto const [json_part, attachment] = protocol::v2::split_attachment(body);
+            attachment_ = attachment;
+            co_await dispatch_frame(command, json_part);
+            attachment_ = {};
+            co_return;
+        }
+        co_await dispatch_frame(command, body);
+    }
+
+    /// \brief 解析 HELLO 请求中的期望版本，返回双方都支持的最高版本。
+    static auto negotiate_protocol(std::string_view payload) -> int
+    {
+        auto const j = nlohmann::json::parse(payload, nullptr, false);
+        if(j.is_discarded() || !j.is_object() || !j.contains("protocol") || !j["protocol"].is_number_integer()) {
+            return protocol::VERSION_LINE;
+        }
+        auto const requested = j["protocol"].get<int>();
+        return requested >= protocol::VERSION_BINARY ? protocol::VERSION_BINARY : protocol::VERSION_LINE;
+    }
+
+    /// \brief 按命令名查注册表分发一帧请求并写回响应，v1 / v2 共用。
+    /// \details 鉴权、内联执行或派生协程、响应命令名均由 CommandRegistry 中的元数据决定。
+    /// \param command 命令名。
+    /// \param payload JSON 负载，指向接收缓冲区，处理函数返回前有效。
+    auto dispatch_frame(std::string_view command, std::string_view payload) -> asio::awaitable<void>;
+
+    /// \brief 处理心跳，返回 PONG 的 JSON 串。
+    auto handle_ping(std::string_view payload) -> asio::awaitable<CommandReply>;
+
+    /// \brief 处理协议协商，自行写出 HELLO_RESP 后切换出站编码，返回空串。
+    auto handle_hello(std::string_view payload) -> asio::awaitable<CommandReply>;
+
     /// \brief 处理注册命令，返回 REGISTER_RESP 的 JSON 串。
-    auto handle_register(std::string const& payload) -> asio::awaitable<std::string>;
+    auto handle_register(std::string_view payload) -> asio::awaitable<CommandReply>;
 
     /// \brief 处理登录命令，返回 LOGIN_RESP 的 JSON 串。
-    auto handle_login(std::string const& payload) -> asio::awaitable<std::string>;
+    auto handle_login(std::string_view payload) -> asio::awaitable<CommandReply>;
 
     /// \brief 处理发送消息命令，在“世界”会话中写入并广播。
     /// \param payload SEND_MSG 的 JSON 文本。
-    /// \note 异步协程，在数据库线程池上执行阻塞操作。
-    auto handle_send_msg(std::string payload) -> asio::awaitable<void>;
+    /// \return 总是空串：SEND_ACK / SEND_FAILED 由处理函数自行写出。
+    /// \note 由 dispatch_frame 派生到独立协程执行，payload 指向派生协程持有的副本。
+    auto handle_send_msg(std::string_view payload) -> asio::awaitable<CommandReply>;
 
-    /// \brief 处理历史消息请求，返回 HISTORY_RESP 的 JSON 串。
+    /// \brief 处理历史消息请求，HISTORY_RESP 帧经服务器的历史页缓存直接写回，出错时返回错误 JSON。
     /// \param payload HISTORY_REQ 的 JSON 文本。
-    auto handle_history_req(std::string const& payload) -> asio::awaitable<std::string>;
+    auto handle_history_req(std::string_view payload) -> asio::awaitable<CommandReply>;
+
+    /// \brief 处理多会话增量同步请求，只返回有新消息的会话，SYNC_RESP 分块自行写回，出错时返回错误 JSON。
+    /// \param payload SYNC_REQ 的 JSON 文本。
+    auto handle_sync_req(std::string_view payload) -> asio::awaitable<CommandReply>;
 
     /// \brief 处理会话列表请求，返回 CONV_LIST_RESP 的 JSON 串。
     /// \param payload CONV_LIST_REQ 的 JSON 文本。
-    auto handle_conv_list_req(std::string const& payload) -> asio::awaitable<std::string>;
+    auto handle_conv_list_req(std::string_view payload) -> asio::awaitable<CommandReply>;
 
     /// \brief 处理标记会话已读请求，返回 MARK_READ_RESP 的 JSON 串。
     /// \param payload MARK_READ_REQ 的 JSON 文本。
-    auto handle_mark_read_req(std::string const& payload) -> asio::awaitable<std::string>;
+    auto handle_mark_read_req(std::string_view payload) -> asio::awaitable<CommandReply>;
 
     /// \brief 处理资料更新请求，返回 PROFILE_UPDATE_RESP 的 JSON 串。
     /// \param payload PROFILE_UPDATE 的 JSON 文本。
-    auto handle_profile_update(std::string const& payload) -> asio::awaitable<std::string>;
+    auto handle_profile_update(std::string_view payload) -> asio::awaitable<CommandReply>;
 
     /// \brief 处理头像更新请求，返回 AVATAR_UPDATE_RESP 的 JSON 串。
     /// \param payload AVATAR_UPDATE 的 JSON 文本。
-    auto handle_avatar_update(std::string const& payload) -> asio::awaitable<std::string>;
+    auto handle_avatar_update(std::string_view payload) -> asio::awaitable<CommandReply>;
 
     /// \brief 处理群聊头像更新请求，返回 GROUP_AVATAR_UPDATE_RESP 的 JSON 串。
     /// \param payload GROUP_AVATAR_UPDATE 的 JSON 文本。
-    auto handle_group_avatar_update(std::string const& payload) -> asio::awaitable<std::string>;
+    auto handle_group_avatar_update(std::string_view payload) -> asio::awaitable<CommandReply>;
 
     /// \brief 处理好友列表请求，返回 FRIEND_LIST_RESP 的 JSON 串。
     /// \param payload FRIEND_LIST_REQ 的 JSON 文本。
-    auto handle_friend_list_req(std::string const& payload) -> asio::awaitable<std::string>;
+    auto handle_friend_list_req(std::string_view payload) -> asio::awaitable<CommandReply>;
 
     /// \brief 处理按账号搜索好友的请求，返回 FRIEND_SEARCH_RESP 的 JSON 串。
     /// \param payload FRIEND_SEARCH_REQ 的 JSON 文本。
-    auto handle_friend_search_req(std::string const& payload) -> asio::awaitable<std::string>;
+    auto handle_friend_search_req(std::string_view payload) -> asio::awaitable<CommandReply>;
 
     /// \brief 处理创建好友申请的请求，返回 FRIEND_ADD_RESP 的 JSON 串。
     /// \param payload FRIEND_ADD_REQ 的 JSON 文本。
-    auto handle_friend_add_req(std::string const& payload) -> asio::awaitable<std::string>;
+    auto handle_friend_add_req(std::string_view payload) -> asio::awaitable<CommandReply>;
 
     /// \brief 处理“新的朋友”列表请求，返回 FRIEND_REQ_LIST_RESP 的 JSON 串。
     /// \param payload FRIEND_REQ_LIST_REQ 的 JSON 文本。
-    auto handle_friend_req_list_req(std::string const& payload) -> asio::awaitable<std::string>;
+    auto handle_friend_req_list_req(std::string_view payload) -> asio::awaitable<CommandReply>;
 
     /// \brief 处理同意好友申请的请求，返回 FRIEND_ACCEPT_RESP 的 JSON 串。
     /// \param payload FRIEND_ACCEPT_REQ 的 JSON 文本。
-    auto handle_friend_accept_req(std::string const& payload) -> asio::awaitable<std::string>;
+    auto handle_friend_accept_req(std::string_view payload) -> asio::awaitable<CommandReply>;
 
     /// \brief 处理拒绝好友申请的请求，返回 FRIEND_REJECT_RESP 的 JSON 串。
     /// \param payload FRIEND_REJECT_REQ 的 JSON 文本。
-    auto handle_friend_reject_req(std::string const& payload) -> asio::awaitable<std::string>;
+    auto handle_friend_reject_req(std::string_view payload) -> asio::awaitable<CommandReply>;
 
     /// \brief 处理删除好友的请求，返回 FRIEND_DELETE_RESP 的 JSON 串。
     /// \param payload FRIEND_DELETE_REQ 的 JSON 文本。
-    auto handle_friend_delete_req(std::string const& payload) -> asio::awaitable<std::string>;
+    auto handle_friend_delete_req(std::string_view payload) -> asio::awaitable<CommandReply>;
 
     /// \brief 处理创建群聊的请求，返回 CREATE_GROUP_RESP 的 JSON 串。
     /// \param payload CREATE_GROUP_REQ 的 JSON 文本。
-    auto handle_create_group_req(std::string const& payload) -> asio::awaitable<std::string>;
+    auto handle_create_group_req(std::string_view payload) -> asio::awaitable<CommandReply>;
+
+    /// \brief 向分块创建中的群追加一块成员，返回 GROUP_MEMBERS_ADD_RESP 的 JSON 串。
+    /// \details 只接受本会话以 pending 方式创建、尚未收到 final 块的群；final 块写入建群系统消息并推送会话列表。
+    /// \param payload GROUP_MEMBERS_ADD_REQ 的 JSON 文本。
+    auto handle_group_members_add_req(std::string_view payload) -> asio::awaitable<CommandReply>;
+
+    /// \brief 写入建群系统消息，并向群主与成员推送会话列表与该消息。
+    auto announce_group_created(i64 conv_id, std::string const& title, std::vector<i64> const& members)
+        -> asio::awaitable<void>;
 
     /// \brief 处理打开单聊会话的请求，返回 OPEN_SINGLE_CONV_RESP 的 JSON 串。
     /// \param payload OPEN_SINGLE_CONV_REQ 的 JSON 文本。
-    auto handle_open_single_conv_req(std::string const& payload) -> asio::awaitable<std::string>;
+    auto handle_open_single_conv_req(std::string_view payload) -> asio::awaitable<CommandReply>;
 
     /// \brief 处理群成员禁言请求。
-    auto handle_mute_member_req(std::string const& payload) -> asio::awaitable<std::string>;
+    auto handle_mute_member_req(std::string_view payload) -> asio::awaitable<CommandReply>;
 
     /// \brief 处理群成员解禁请求。
-    auto handle_unmute_member_req(std::string const& payload) -> asio::awaitable<std::string>;
+    auto handle_unmute_member_req(std::string_view payload) -> asio::awaitable<CommandReply>;
 
     /// \brief 处理设置/取消管理员请求。
-    auto handle_set_admin_req(std::string const& payload) -> asio::awaitable<std::string>;
+    auto handle_set_admin_req(std::string_view payload) -> asio::awaitable<CommandReply>;
 
     /// \brief 处理会话成员列表请求。
-    auto handle_conv_members_req(std::string const& payload) -> asio::awaitable<std::string>;
+    auto handle_conv_members_req(std::string_view payload) -> asio::awaitable<CommandReply>;
 
     /// \brief 处理退群 / 解散群聊请求。
     /// \param payload LEAVE_CONV_REQ 的 JSON 文本。
-    auto handle_leave_conv_req(std::string const& payload) -> asio::awaitable<std::string>;
+    auto handle_leave_conv_req(std::string_view payload) -> asio::awaitable<CommandReply>;
 
     /// \brief 处理群聊搜索请求，返回 GROUP_SEARCH_RESP 的 JSON 串。
     /// \param payload GROUP_SEARCH_REQ 的 JSON 文本。
-    auto handle_group_search_req(std::string const& payload) -> asio::awaitable<std::string>;
+    auto handle_group_search_req(std::string_view payload) -> asio::awaitable<CommandReply>;
 
     /// \brief 处理入群申请请求，返回 GROUP_JOIN_RESP 的 JSON 串。
     /// \param payload GROUP_JOIN_REQ 的 JSON 文本。
-    auto handle_group_join_req(std::string const& payload) -> asio::awaitable<std::string>;
+    auto handle_group_join_req(std::string_view payload) -> asio::awaitable<CommandReply>;
 
     /// \brief 处理入群申请列表请求，返回 GROUP_JOIN_REQ_LIST_RESP 的 JSON 串。
     /// \param payload GROUP_JOIN_REQ_LIST_REQ 的 JSON 文本。
-    auto handle_group_join_req_list_req(std::string const& payload) -> asio::awaitable<std::string>;
+    auto handle_group_join_req_list_req(std::string_view payload) -> asio::awaitable<CommandReply>;
 
     /// \brief 处理入群申请（同意/拒绝），返回 GROUP_JOIN_ACCEPT_RESP 的 JSON 串。
     /// \param payload GROUP_JOIN_ACCEPT_REQ 的 JSON 文本。
-    auto handle_group_join_accept_req(std::string const& payload) -> asio::awaitable<std::string>;
+    auto handle_group_join_accept_req(std::string_view payload) -> asio::awaitable<CommandReply>;
 
     /// \brief 处理群组重命名请求，返回 RENAME_GROUP_RESP 的 JSON 串。
     /// \param payload RENAME_GROUP_REQ 的 JSON 文本。
-    auto handle_rename_group_req(std::string const& payload) -> asio::awaitable<std::string>;
+    auto handle_rename_group_req(std::string_view payload) -> asio::awaitable<CommandReply>;
 
     /// \brief 处理消息撤回请求，返回 RECALL_MSG_RESP 的 JSON 串。
     /// \param payload RECALL_MSG_REQ 的 JSON 文本。
-    auto handle_recall_msg_req(std::string const& payload) -> asio::awaitable<std::string>;
+    auto handle_recall_msg_req(std::string_view payload) -> asio::awaitable<CommandReply>;
 
     /// \brief 处理消息反应(点赞/踩)请求，返回 MSG_REACTION_RESP 的 JSON 串。
     /// \param payload MSG_REACTION_REQ 的 JSON 文本。
-    auto handle_msg_reaction_req(std::string const& payload) -> asio::awaitable<std::string>;
+    auto handle_msg_reaction_req(std::string_view payload) -> asio::awaitable<CommandReply>;
 
     /// \brief 处理取消消息反应请求，返回 MSG_UNREACTION_RESP 的 JSON 串。
     /// \param payload MSG_UNREACTION_REQ 的 JSON 文本。
-    auto handle_msg_unreaction_req(std::string const& payload) -> asio::awaitable<std::string>;
+    auto handle_msg_unreaction_req(std::string_view payload) -> asio::awaitable<CommandReply>;
 
     /// \brief 构造带错误码的通用错误响应 JSON 串。
     auto make_error_payload(std::string const& code, std::string const& msg) const -> std::string
@@ -402,35 +425,91 @@ private:
         return j.dump();
     }
 
-    /// \brief 向当前会话异步发送一行文本。
-    /// \param line 已经包含换行符的完整协议行。
-    auto send_text(std::string line) -> void
+    /// \brief 以错误响应结束一次命令处理，同时标记为失败。
+    auto fail(std::string const& code, std::string const& msg) const -> CommandReply
+    {
+        return { make_error_payload(code, msg), true };
+    }
+
+    /// \brief 向当前会话异步发送一帧。
+    /// \param command 命令名。
+    /// \param payload JSON 负载（不含换行）。
+    auto send_frame(std::string_view command, std::string payload) -> void
+    {
+        send_frame(protocol::make_shared_frame(command, std::move(payload)));
+    }
+
+    /// \brief 向当前会话异步发送一帧共享的只读负载。
+    /// \details 广播场景下多个会话持有同一份负载，入队与写出都不复制字符串。
+    /// \param frame 出站帧。
+    auto send_frame(protocol::SharedFrame frame) -> void
     {
         // 将所有对 outgoing_ 的访问都放在 strand 上执行，保证线程安全
-        asio::dispatch(strand_, [this, self = shared_from_this(), line = std::move(line)]() mutable {
-            send_text_impl(std::move(line));
+        asio::dispatch(strand_, [this, self = shared_from_this(), frame = std::move(frame)]() mutable {
+            send_frame_impl(std::move(frame));
         });
     }
 
 private:
-    /// \brief send_text 的实际实现，必须在 strand_ 上调用。
-    auto send_text_impl(std::string line) -> void
+    /// \brief 待写出的一帧，入队时即确定按 v1 还是 v2 编码。
+    struct OutgoingFrame
     {
+        protocol::SharedFrame frame;
+        bool binary{ false };
+    };
+
+    static constexpr auto MSG_PUSH_ID = protocol::command_id("MSG_PUSH");
+
+    /// \brief 缓冲一条 MSG_PUSH，首条入缓冲时启动合并计时，必须在 strand_ 上调用。
+    auto buffer_push(protocol::SharedFrame frame) -> void;
+
+    /// \brief 把缓冲的推送合并为一帧 MSG_PUSH_BATCH 写出（只有一条时原样写出），必须在 strand_ 上调用。
+    auto flush_push_batch() -> void;
+
+    /// \brief send_frame 的实际实现，必须在 strand_ 上调用。
+    auto send_frame_impl(protocol::SharedFrame frame) -> void
+    {
+        if(!frame) {
+            return;
+        }
+
         // 如果 socket 已关闭，直接返回
         if(!socket_.is_open()) {
             return;
         }
-        
+
+        if(push_batch_tick_.count() > 0) {
+            if(frame->command_id == MSG_PUSH_ID) {
+                buffer_push(std::move(frame));
+                return;
+            }
+            // 其他帧不能越过已缓冲的推送，先把缓冲写出
+            flush_push_batch();
+        }
+        write_frame(std::move(frame));
+    }
+
+    /// \brief 把一帧排入写队列，必要时启动写协程，必须在 strand_ 上调用。
+    auto write_frame(protocol::SharedFrame frame) -> void
+    {
+        if(!socket_.is_open()) {
+            return;
+        }
+
+        // 未登记编号的命令只能按 v1 写出，对端按首字节自动识别
+        auto const binary = protocol_version_ >= protocol::VERSION_BINARY && frame->command_id != 0;
+        auto const size = frame->wire_size(binary);
+
         // 检查缓冲区是否超限,防止慢客户端导致内存无限增长
-        if(outgoing_bytes_ + line.size() > MAX_OUTGOING_BYTES) {
+        if(outgoing_bytes_ + size > MAX_OUTGOING_BYTES) {
             std::println("session write buffer overflow ({}MB), closing connection",
-                        (outgoing_bytes_ + line.size()) / (1024 * 1024));
+                        (outgoing_bytes_ + size) / (1024 * 1024));
             socket_.close();
             return;
         }
         
-        outgoing_bytes_ += line.size();
-        outgoing_.push_back(std::move(line));
+        outgoing_bytes_ += size;
+        outgoing_.push_back({ std::move(frame), binary });
         if(writing_) {
             return;
         }
@@ -441,13 +520,43 @@ private:
         asio::co_spawn(
             strand_,
             [self]() -> asio::awaitable<void> {
+                static constexpr char newline = '\n';
                 try {
+                    // 每轮把队列中积压的多帧一次性取出，用 scatter/gather 写合并成一次系统调用
+                    std::vector<OutgoingFrame> batch;
+                    std::vector<asio::const_buffer> buffers;
                     while(!self->outgoing_.empty() && self->socket_.is_open()) {
-                        auto current = std::move(self->outgoing_.front());
-                        self->outgoing_.pop_front();
-                        self->outgoing_bytes_ -= current.size();
+                        batch.clear();
+                        buffers.clear();
+                        size_t batch_bytes = 0;
+                        while(!self->outgoing_.empty() && batch.size() < MAX_WRITE_BATCH_FRAMES) {
+                            auto& front = self->outgoing_.front();
+                            auto const size = front.frame->wire_size(front.binary);
+                            // 至少取一帧，超大单帧也能独立发出
+                            if(!batch.empty() && batch_bytes + size > max_write_batch_bytes) {
+                                break;
+                            }
+                            batch_bytes += size;
+                            batch.push_back(std::move(front));
+                            self->outgoing_.pop_front();
+                        }
+                        self->outgoing_bytes_ -= batch_bytes;
+
+                        // batch 在写完成前不再变动，const_buffer 指向的内存保持有效
+                        buffers.reserve(batch.size() * 3);
+                        for(auto const& item : batch) {
+                            auto const& f = *item.frame;
+                            if(item.binary) {
+                                buffers.push_back(asio::buffer(f.header));
+                                buffers.push_back(asio::buffer(f.payload));
+                            } else {
+                                buffers.push_back(asio::buffer(f.prefix));
+                                buffers.push_back(asio::buffer(f.payload));
+                                buffers.push_back(asio::buffer(&newline, 1));
+                            }
+                        }
                         co_await asio::async_write (
-                            self->socket_, asio::buffer(current), asio::use_awaitable
+                            self->socket_, buffers, asio::use_awaitable
                         );
                     }
                 } catch(std::exception const& ex) {
@@ -476,12 +585,38 @@ public:
     asio::ip::tcp::socket socket_;
     /// \brief strand 保证 outgoing_ 队列的线程安全访问。
     asio::strand<asio::any_io_executor> strand_;
-    asio::streambuf buffer_;
+    /// \brief 可复用的接收缓冲区，[read_pos_, read_end_) 为尚未处理的数据。
+    std::vector<char> read_buf_ = std::vector<char>(INITIAL_READ_BUFFER_BYTES);
+    std::size_t read_pos_{ 0 };
+    std::size_t read_end_{ 0 };
+    /// \brief 未处理数据中已确认不含换行的字节数，相对 read_pos_，搬移缓冲区后仍然有效。
+    std::size_t line_scanned_{ 0 };
+    static constexpr std::size_t INITIAL_READ_BUFFER_BYTES = 8 * 1024; ///< 初始 8KB
+    /// \brief 接收缓冲区上限：一个最大 v2 帧，也作为 v1 单行长度上限。
+    static constexpr std::size_t MAX_READ_BUFFER_BYTES = protocol::v2::HEADER_SIZE + protocol::v2::MAX_PAYLOAD_SIZE;
     std::weak_ptr<Server> server_; ///< 所属服务器的弱引用，避免服务器销毁后悬垂指针。
-    std::deque<std::string> outgoing_{};
+    std::size_t home_shard_{ 0 }; ///< 连接登记所在的注册表分片，接受连接时确定，之后不变
+    std::deque<OutgoingFrame> outgoing_{}; ///< 待写出的帧，广播帧在多个会话间共享
     size_t outgoing_bytes_{ 0 }; ///< 当前缓冲区总字节数
     static constexpr size_t MAX_OUTGOING_BYTES = 10 * 1024 * 1024; ///< 最大缓冲区 10MB
+    /// \brief 单次合并写的字节上限，启动时由 --write-batch-kb 调整（默认 256KB）。
+    static inline size_t max_write_batch_bytes{ 256 * 1024 };
+    /// \brief 单次合并写的帧数上限，每帧最多 3 个缓冲区，总数低于常见的 IOV_MAX(1024)。
+    static constexpr size_t MAX_WRITE_BATCH_FRAMES = 256;
     bool writing_{ false };
+    /// \brief 出站帧编码版本，HELLO 协商后在 strand 上切换。
+    int protocol_version_{ protocol::VERSION_LINE };
+    /// \brief 当前 v2 帧携带的二进制附件，仅在处理该帧期间有效。
+    std::string_view attachment_{};
+    /// \brief LOGIN 时协商的推送合并周期，为 0 表示逐条写出 MSG_PUSH。
+    std::chrono::milliseconds push_batch_tick_{ 0 };
+    /// \brief 等待合并的 MSG_PUSH 帧及其负载总字节数。
+    std::vector<protocol::SharedFrame> push_batch_{};
+    size_t push_batch_bytes_{ 0 };
+    /// \brief 合并计时是否已启动。
+    bool push_batch_armed_{ false };
+    /// \brief 单个 MSG_PUSH_BATCH 最多携带的推送条数，达到后立即写出。
+    static constexpr size_t MAX_PUSH_BATCH_MESSAGES = 256;
     
     /// \brief 追踪未完成的异步操作数量（如 handle_send_msg）。
     std::atomic<int> pending_ops_{ 0 };
@@ -498,4 +633,30 @@ public:
     std::string display_name_{};
     /// \brief 当前会话绑定的头像路径。
     std::string avatar_path_{};
+
+    /// \brief 以 pending 方式创建、等待后续成员块的群。
+    struct PendingGroup
+    {
+        std::string title;
+        /// \brief 已加入的成员（不含群主），建群完成时据此推送会话列表。
+        std::vector<i64> member_ids;
+    };
+    /// \brief 分块创建中的群，键为会话 ID；只在读循环中按序访问。
+    std::unordered_map<i64, PendingGroup> pending_groups_{};
+    /// \brief GROUP_MEMBERS_ADD_REQ 单块成员数上限。
+    static constexpr std::size_t MAX_GROUP_MEMBERS_CHUNK = 1000;
+
+    /// \brief SYNC_REQ 单次最多同步的会话数，超出部分忽略。
+    static constexpr std::size_t MAX_SYNC_CONVERSATIONS = 500;
+    /// \brief SYNC_REQ 每个会话默认与最多返回的消息条数。
+    static constexpr i64 DEFAULT_SYNC_LIMIT = 50;
+    static constexpr i64 MAX_SYNC_LIMIT = 200;
+    /// \brief 单个 SYNC_RESP 帧携带的会话数上限，大响应分多帧写出。
+    static constexpr std::size_t SYNC_RESP_CHUNK = 32;
+
+    /// \brief 最近一次执行写命令的时间（steady_clock 计数），SEND_MSG 在独立协程中执行，故用原子量。
+    std::atomic<i64> last_write_ticks_{ 0 };
+
+    /// \brief 本会话读请求使用的连接目标：刚执行过写命令时走主库，保证读到自己的写入。
+    auto read_route() const -> database::Route;
 };
@@ -2,6 +2,7 @@
 
 #include <boost/asio/experimental/awaitable_operators.hpp>
 
+#include <algorithm>
 #include <iostream>
 #include <format>
 
@@ -110,21 +111,45 @@ namespace benchmark
         std::vector<std::string> const& member_ids
     ) -> asio::awaitable<std::string>
     {
+        auto const chunked = member_ids.size() > GROUP_MEMBER_CHUNK;
+        auto const first_end = member_ids.begin() + static_cast<std::ptrdiff_t>(std::min(member_ids.size(), GROUP_MEMBER_CHUNK));
+
         json payload;
         payload["name"] = name;
-        payload["memberUserIds"] = member_ids;
+        payload["memberUserIds"] = std::vector<std::string>(member_ids.begin(), first_end);
+        if(chunked) {
+            payload["pending"] = true;
+        }
 
         co_await send_command("CREATE_GROUP_REQ", payload);
 
         auto resp = co_await wait_for_response("CREATE_GROUP_RESP");
 
-        if(resp.contains("ok") && resp["ok"].get<bool>()) {
-            if(resp.contains("conversationId")) {
-                co_return resp["conversationId"].get<std::string>();
+        if(!resp.contains("ok") || !resp["ok"].get<bool>() || !resp.contains("conversationId")) {
+            co_return "";
+        }
+        auto conversation_id = resp["conversationId"].get<std::string>();
+
+        // 大群其余成员分块追加，最后一块带 final 触发建群通知
+        for(auto it = first_end; it != member_ids.end();) {
+            auto const end = it + static_cast<std::ptrdiff_t>(
+                std::min<std::size_t>(static_cast<std::size_t>(member_ids.end() - it), GROUP_MEMBER_CHUNK)
+            );
+
+            json chunk;
+            chunk["conversationId"] = conversation_id;
+            chunk["memberUserIds"] = std::vector<std::string>(it, end);
+            chunk["final"] = end == member_ids.end();
+
+            co_await send_command("GROUP_MEMBERS_ADD_REQ", chunk);
+            auto chunk_resp = co_await wait_for_response("GROUP_MEMBERS_ADD_RESP");
+            if(!chunk_resp.contains("ok") || !chunk_resp["ok"].get<bool>()) {
+                co_return "";
             }
+            it = end;
         }
 
-        co_return "";
+        co_return conversation_id;
     }
 
     auto BenchmarkClient::generate_client_msg_id() -> std::string
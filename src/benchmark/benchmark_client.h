@@ -74,10 +74,14 @@ namespace benchmark
             -> asio::awaitable<std::string>;
 
         /// \brief 异步创建群聊（协程）
+        /// \details 成员超过 GROUP_MEMBER_CHUNK 时先以 pending 建群，其余成员经 GROUP_MEMBERS_ADD_REQ 分块追加
         /// \return 成功时返回 conversationId，失败返回空字符串
         auto async_create_group(std::string const& name, std::vector<std::string> const& member_ids)
             -> asio::awaitable<std::string>;
 
+        /// \brief 建群时单帧携带的成员数上限
+        static constexpr std::size_t GROUP_MEMBER_CHUNK = 500;
+
         /// \brief 发送消息（发送即成功模式）
         /// 立即返回，不等待 ACK，ACK 在后台异步处理
         auto send_message_fire_and_forget(std::string const& conversation_id, std::string const& content)
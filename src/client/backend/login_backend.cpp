@@ -224,15 +224,19 @@ void LoginBackend::updateAvatar(QString const& avatarPath)
     auto const data = file.readAll();
     file.close();
 
-    auto const base64 = QString::fromLatin1(data.toBase64());
     auto const extension = QFileInfo(avatarPath).suffix();
 
     QJsonObject obj;
-    // 发送 Base64 数据而非本地路径
-    obj.insert(QStringLiteral("avatarData"), base64);
     // 同时也发送扩展名，以便服务器保存正确的文件类型
     obj.insert(QStringLiteral("extension"), extension.isEmpty() ? QStringLiteral("jpg") : extension);
-    
+
+    // v2 连接直接以二进制附件发送原始字节
+    if(network_manager_->sendCommandWithAttachment(QStringLiteral("AVATAR_UPDATE"), obj, data)) {
+        return;
+    }
+
+    // 发送 Base64 数据而非本地路径
+    obj.insert(QStringLiteral("avatarData"), QString::fromLatin1(data.toBase64()));
     network_manager_->sendCommand(QStringLiteral("AVATAR_UPDATE"), obj);
 }
 
@@ -266,14 +270,17 @@ void LoginBackend::updateGroupAvatar(QString const& conversationId, QString cons
     auto const data = file.readAll();
     file.close();
 
-    auto const base64 = QString::fromLatin1(data.toBase64());
     auto const extension = QFileInfo(avatarPath).suffix();
 
     QJsonObject obj;
     obj.insert(QStringLiteral("conversationId"), conversationId.toLongLong());
-    obj.insert(QStringLiteral("avatarData"), base64);
     obj.insert(QStringLiteral("extension"), extension.isEmpty() ? QStringLiteral("jpg") : extension);
-    
+
+    if(network_manager_->sendCommandWithAttachment(QStringLiteral("GROUP_AVATAR_UPDATE"), obj, data)) {
+        return;
+    }
+
+    obj.insert(QStringLiteral("avatarData"), QString::fromLatin1(data.toBase64()));
     network_manager_->sendCommand(QStringLiteral("GROUP_AVATAR_UPDATE"), obj);
 }
 
@@ -715,6 +722,8 @@ void LoginBackend::sendCurrentCommand()
         command = QStringLiteral("LOGIN");
         obj.insert(QStringLiteral("account"), pending_account_);
         obj.insert(QStringLiteral("password"), pending_password_);
+        // 声明支持 MSG_PUSH_BATCH：推送最多延迟 10ms，换取突发时更少的帧与解析开销
+        obj.insert(QStringLiteral("pushBatchMs"), 10);
     } else if(pending_command_ == PendingCommand::Register) {
         command = QStringLiteral("REGISTER");
         obj.insert(QStringLiteral("account"), pending_account_);
@@ -5,6 +5,10 @@
 #include <QFile>
 #include <QJsonDocument>
 #include <QJsonObject>
+#include <QSet>
+
+#include <algorithm>
+#include <vector>
 
 auto MessageCache::setUserId(QString const& userId) -> void
 {
@@ -105,6 +109,53 @@ auto MessageCache::appendMessage(
     writeMessages(conversationId, messages);
 }
 
+auto MessageCache::appendMessages(QString const& conversationId, QJsonArray const& messages) -> QJsonArray
+{
+    if(user_id_.isEmpty()) {
+        return QJsonArray{};
+    }
+
+    auto const seq_of = [](QJsonValue const& v) {
+        return static_cast<qint64>(v.toObject().value(QStringLiteral("seq")).toDouble(0.0));
+    };
+
+    auto const cached = loadMessages(conversationId).first;
+    QSet<qint64> known;
+    auto cached_max = qint64{};
+    for(auto const& item : cached) {
+        auto const seq = seq_of(item);
+        known.insert(seq);
+        cached_max = std::max(cached_max, seq);
+    }
+
+    QJsonArray appended;
+    for(auto const& item : messages) {
+        auto const seq = seq_of(item);
+        if(known.contains(seq)) {
+            continue;
+        }
+        known.insert(seq);
+        appended.append(item);
+    }
+    if(appended.isEmpty()) {
+        return appended;
+    }
+
+    std::vector<QJsonValue> merged{ cached.begin(), cached.end() };
+    merged.insert(merged.end(), appended.begin(), appended.end());
+    // 同步期间先到的推送 seq 更大，补上的消息需要排到它之前。
+    if(seq_of(appended.first()) < cached_max) {
+        std::ranges::stable_sort(merged, {}, seq_of);
+    }
+
+    QJsonArray out;
+    for(auto const& item : merged) {
+        out.append(item);
+    }
+    writeMessages(conversationId, out);
+    return appended;
+}
+
 auto MessageCache::loadMessages(QString const& conversationId) -> QPair<QJsonArray, qint64>
 {
     if(user_id_.isEmpty()) {
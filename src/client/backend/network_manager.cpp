@@ -1,8 +1,22 @@
 #include "network_manager.h"
 
+#include <protocol.h>
+
 #include <QJsonDocument>
 #include <print>
 
+namespace
+{
+    /// \brief 以网络字节序追加一个 32 位整数。
+    auto appendU32(QByteArray& out, quint32 value) -> void
+    {
+        out.append(static_cast<char>((value >> 24) & 0xFF));
+        out.append(static_cast<char>((value >> 16) & 0xFF));
+        out.append(static_cast<char>((value >> 8) & 0xFF));
+        out.append(static_cast<char>(value & 0xFF));
+    }
+}
+
 NetworkManager::NetworkManager(QObject* parent)
     : QObject(parent)
 {
@@ -17,6 +31,11 @@ auto NetworkManager::isConnected() const -> bool
     return socket_.state() == QAbstractSocket::ConnectedState;
 }
 
+auto NetworkManager::isBinaryProtocol() const -> bool
+{
+    return protocol_version_ >= protocol::VERSION_BINARY;
+}
+
 auto NetworkManager::connectToServer(QString const& host, quint16 port) -> void
 {
     if(socket_.state() == QAbstractSocket::ConnectedState) {
@@ -39,25 +58,77 @@ auto NetworkManager::sendCommand(QString const& command, QJsonObject const& payl
     }
 
     QJsonDocument doc{ payload };
-    auto const json = doc.toJson(QJsonDocument::Compact);
+    writeFrame(command, doc.toJson(QJsonDocument::Compact));
+}
+
+auto NetworkManager::sendCommandWithAttachment(QString const& command, QJsonObject const& payload, QByteArray const& attachment) -> bool
+{
+    if(socket_.state() != QAbstractSocket::ConnectedState || !isBinaryProtocol()) {
+        return false;
+    }
+
+    QJsonDocument doc{ payload };
+    writeFrame(command, doc.toJson(QJsonDocument::Compact), attachment);
+    return true;
+}
+
+auto NetworkManager::writeFrame(QString const& command, QByteArray const& json, QByteArray const& attachment) -> void
+{
+    auto const name = command.toUtf8();
+    auto const id = protocol::command_id(std::string_view{ name.constData(), static_cast<std::size_t>(name.size()) });
+
+    // 未协商 v2 或命令未登记编号时按 v1 文本行发送，服务器按首字节自动识别
+    if(!isBinaryProtocol() || id == 0) {
+        QByteArray line;
+        line.reserve(name.size() + 1 + json.size() + 1);
+        line.append(name);
+        line.append(':');
+        line.append(json);
+        line.append('\n');
+        socket_.write(line);
+        return;
+    }
 
-    QByteArray line;
-    line.reserve(command.toUtf8().size() + 1 + json.size() + 1);
-    line.append(command.toUtf8());
-    line.append(':');
-    line.append(json);
-    line.append('\n');
+    QByteArray body;
+    auto flags = std::uint8_t{ 0 };
+    if(attachment.isEmpty()) {
+        body = json;
+    } else {
+        flags |= protocol::v2::FLAG_ATTACHMENT;
+        body.reserve(4 + json.size() + attachment.size());
+        appendU32(body, static_cast<quint32>(json.size()));
+        body.append(json);
+        body.append(attachment);
+    }
 
-    socket_.write(line);
+    auto const header = protocol::v2::encode_header({
+        .flags = flags,
+        .command_id = id,
+        .length = static_cast<std::uint32_t>(body.size()),
+    });
+
+    QByteArray frame;
+    frame.reserve(static_cast<qsizetype>(header.size()) + body.size());
+    frame.append(header.data(), static_cast<qsizetype>(header.size()));
+    frame.append(body);
+    socket_.write(frame);
 }
 
 void NetworkManager::onConnected()
 {
+    // 每条新连接都从 v1 开始，先发 HELLO 申请 v2；旧服务器会回 ECHO，保持 v1 即可
+    protocol_version_ = protocol::VERSION_LINE;
+    buffer_.clear();
+    QJsonObject hello;
+    hello.insert(QStringLiteral("protocol"), protocol::VERSION_BINARY);
+    sendCommand(QStringLiteral("HELLO"), hello);
+
     emit connected();
 }
 
 void NetworkManager::onDisconnected()
 {
+    protocol_version_ = protocol::VERSION_LINE;
     emit disconnected();
 }
 
@@ -65,7 +136,48 @@ void NetworkManager::onReadyRead()
 {
     buffer_.append(socket_.readAll());
 
-    while(true) {
+    while(!buffer_.isEmpty()) {
+        // 首字节为魔数的是 v2 二进制帧，否则是 v1 文本行
+        if(protocol::v2::is_frame_start(buffer_.front())) {
+            if(buffer_.size() < static_cast<qsizetype>(protocol::v2::HEADER_SIZE)) {
+                break;
+            }
+
+            protocol::v2::Header header;
+            try {
+                header = protocol::v2::decode_header(buffer_.constData());
+            } catch(std::exception const& ex) {
+                std::println("NetworkManager frame error: {}", ex.what());
+                socket_.abort();
+                buffer_.clear();
+                return;
+            }
+
+            auto const total = static_cast<qsizetype>(protocol::v2::HEADER_SIZE + header.length);
+            if(buffer_.size() < total) {
+                break;
+            }
+
+            auto body = buffer_.mid(static_cast<qsizetype>(protocol::v2::HEADER_SIZE), static_cast<qsizetype>(header.length));
+            buffer_.remove(0, total);
+
+            auto const name = protocol::command_name(header.command_id);
+            if(name.empty()) {
+                continue;
+            }
+            if(header.flags & protocol::v2::FLAG_ATTACHMENT) {
+                try {
+                    auto const [json, _] = protocol::v2::split_attachment({ body.constData(), static_cast<std::size_t>(body.size()) });
+                    body = QByteArray{ json.data(), static_cast<qsizetype>(json.size()) };
+                } catch(std::exception const&) {
+                    continue;
+                }
+            }
+
+            dispatchCommand(QString::fromLatin1(name.data(), static_cast<qsizetype>(name.size())), body);
+            continue;
+        }
+
         auto const index = buffer_.indexOf('\n');
         if(index < 0) {
             break;
@@ -80,16 +192,26 @@ void NetworkManager::onReadyRead()
             continue;
         }
 
-        auto const command = line.left(colon);
-        auto const jsonText = line.mid(colon + 1).toUtf8();
+        dispatchCommand(line.left(colon), line.mid(colon + 1).toUtf8());
+    }
+}
 
-        auto const doc = QJsonDocument::fromJson(jsonText);
-        if(!doc.isObject()) {
-            continue;
-        }
+auto NetworkManager::dispatchCommand(QString const& command, QByteArray const& jsonText) -> void
+{
+    auto const doc = QJsonDocument::fromJson(jsonText);
+    if(!doc.isObject()) {
+        return;
+    }
 
-        emit commandReceived(command, doc.object());
+    auto const obj = doc.object();
+    if(command == QStringLiteral("HELLO_RESP")) {
+        if(obj.value(QStringLiteral("ok")).toBool()) {
+            protocol_version_ = obj.value(QStringLiteral("protocol")).toInt(protocol::VERSION_LINE);
+        }
+        return;
     }
+
+    emit commandReceived(command, obj);
 }
 
 void NetworkManager::onErrorOccurred(QAbstractSocket::SocketError socketError)
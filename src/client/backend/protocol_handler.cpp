@@ -4,6 +4,49 @@
 
 #include <QJsonArray>
 #include <algorithm>
+#include <utility>
+
+namespace
+{
+    // 按主键字段查找列表项的下标，找不到时返回 -1。
+    auto indexOfItem(QJsonArray const& items, QString const& key, QString const& id) -> qsizetype
+    {
+        for(qsizetype i = 0; i < items.size(); ++i) {
+            if(items.at(i).toObject().value(key).toString() == id) {
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    // 合并一条增量推送：已有项只覆盖推送中出现的字段，新项插到表头或表尾。
+    void upsertItem(QJsonArray& items, QString const& key, QJsonObject const& patch, bool prepend)
+    {
+        auto const index = indexOfItem(items, key, patch.value(key).toString());
+        if(index < 0) {
+            if(prepend) {
+                items.prepend(patch);
+            } else {
+                items.append(patch);
+            }
+            return;
+        }
+        auto item = items.at(index).toObject();
+        for(auto it = patch.begin(); it != patch.end(); ++it) {
+            item.insert(it.key(), it.value());
+        }
+        items.replace(index, item);
+    }
+
+    // 按主键移除列表项。
+    void removeItem(QJsonArray& items, QString const& key, QString const& id)
+    {
+        auto const index = indexOfItem(items, key, id);
+        if(index >= 0) {
+            items.removeAt(index);
+        }
+    }
+} // namespace
 
 ProtocolHandler::ProtocolHandler(NetworkManager* networkManager, MessageCache* messageCache, QObject* parent)
     : QObject(parent)
@@ -93,10 +136,18 @@ void ProtocolHandler::handleCommand(QString command, QJsonObject payload)
         handleRegisterResponse(payload);
     } else if(command == QStringLiteral("MSG_PUSH")) {
         handleMessagePush(payload);
+    } else if(command == QStringLiteral("MSG_PUSH_BATCH")) {
+        handleMessagePushBatch(payload);
     } else if(command == QStringLiteral("HISTORY_RESP")) {
         handleHistoryResponse(payload);
     } else if(command == QStringLiteral("CONV_LIST_RESP")) {
         handleConversationListResponse(payload);
+    } else if(command == QStringLiteral("SYNC_RESP")) {
+        handleSyncResponse(payload);
+    } else if(command == QStringLiteral("CONV_UPSERT_PUSH")) {
+        handleConversationUpsertPush(payload);
+    } else if(command == QStringLiteral("CONV_REMOVE_PUSH")) {
+        handleConversationRemovePush(payload);
     } else if(command == QStringLiteral("MARK_READ_RESP")) {
         handleMarkReadResponse(payload);
     } else if(command == QStringLiteral("PROFILE_UPDATE_RESP")) {
@@ -109,6 +160,14 @@ void ProtocolHandler::handleCommand(QString command, QJsonObject payload)
         handleFriendListResponse(payload);
     } else if(command == QStringLiteral("FRIEND_REQ_LIST_RESP")) {
         handleFriendRequestListResponse(payload);
+    } else if(command == QStringLiteral("FRIEND_UPSERT_PUSH")) {
+        handleFriendUpsertPush(payload);
+    } else if(command == QStringLiteral("FRIEND_REMOVE_PUSH")) {
+        handleFriendRemovePush(payload);
+    } else if(command == QStringLiteral("FRIEND_REQ_UPSERT_PUSH")) {
+        handleFriendRequestUpsertPush(payload);
+    } else if(command == QStringLiteral("FRIEND_REQ_REMOVE_PUSH")) {
+        handleFriendRequestRemovePush(payload);
     } else if(command == QStringLiteral("FRIEND_SEARCH_RESP")) {
         handleFriendSearchResponse(payload);
     } else if(command == QStringLiteral("FRIEND_ADD_RESP")) {
@@ -139,6 +198,8 @@ void ProtocolHandler::handleCommand(QString command, QJsonObject payload)
         handleGroupJoinResponse(payload);
     } else if(command == QStringLiteral("GROUP_JOIN_REQ_LIST_RESP")) {
         handleGroupJoinRequestListResponse(payload);
+    } else if(command == QStringLiteral("GROUP_JOIN_REQ_UPSERT_PUSH")) {
+        handleGroupJoinRequestUpsertPush(payload);
     } else if(command == QStringLiteral("GROUP_JOIN_ACCEPT_RESP")) {
         handleGroupJoinAcceptResponse(payload);
     } else if(command == QStringLiteral("RENAME_GROUP_RESP")) {
@@ -208,6 +269,16 @@ void ProtocolHandler::handleLoginResponse(QJsonObject const& obj)
     avatar_path_ = avatar;
     setWorldConversationId(world_id);
 
+    // 新连接上不会再收到旧连接未完成的 SYNC_RESP。
+    sync_in_flight_ = false;
+    sync_followup_ = QJsonArray{};
+
+    // 断线期间错过的增量推送无从补齐，列表以登录后重新拉取的完整响应为基准。
+    conversations_.reset();
+    friends_.reset();
+    friend_requests_.reset();
+    group_join_requests_.reset();
+
     emit loginSucceeded(id, name, avatar, world_id);
 }
 
@@ -297,6 +368,32 @@ void ProtocolHandler::handleMessagePush(QJsonObject const& obj)
 
     // 更新已知的最新 seq。
     conv_last_seq_[conversation_id] = std::max(conv_last_seq_.value(conversation_id, 0), seq);
+
+    // 同步更新保存的会话行，之后由增量推送重建列表时不会回退到旧的预览与未读数。
+    if(conversations_) {
+        auto const index = indexOfItem(*conversations_, QStringLiteral("conversationId"), conversation_id);
+        if(index >= 0) {
+            auto conv = conversations_->at(index).toObject();
+            if(seq > static_cast<qint64>(conv.value(QStringLiteral("lastSeq")).toDouble(0.0))) {
+                conv.insert(QStringLiteral("lastSeq"), seq);
+                conv.insert(QStringLiteral("lastServerTimeMs"), server_time_ms);
+                conv.insert(QStringLiteral("preview"), content);
+                if(sender_id != user_id_) {
+                    conv.insert(QStringLiteral("unreadCount"), conv.value(QStringLiteral("unreadCount")).toDouble(0.0) + 1);
+                }
+                conversations_->replace(index, conv);
+            }
+        }
+    }
+}
+
+void ProtocolHandler::handleMessagePushBatch(QJsonObject const& obj)
+{
+    // 服务器在一个合并周期内缓冲的多条 MSG_PUSH，按原顺序逐条处理。
+    auto const messages = obj.value(QStringLiteral("messages")).toArray();
+    for(auto const& item : messages) {
+        handleMessagePush(item.toObject());
+    }
 }
 
 void ProtocolHandler::handleHistoryResponse(QJsonObject const& obj)
@@ -343,7 +440,30 @@ void ProtocolHandler::handleConversationListResponse(QJsonObject const& obj)
         return;
     }
 
-    auto const array = obj.value(QStringLiteral("conversations")).toArray();
+    conversations_ = obj.value(QStringLiteral("conversations")).toArray();
+    emitConversations();
+
+    // 有本地缓存但落后于服务器的会话合并为一个 SYNC_REQ，没有本地缓存的会话等打开时再拉最新一页。
+    // 上一轮同步未结束时不重复请求，避免同一批消息两次追加到本地缓存。
+    if(sync_in_flight_) {
+        return;
+    }
+    QJsonArray cursors;
+    for(auto it = conv_last_seq_.cbegin(); it != conv_last_seq_.cend(); ++it) {
+        auto local_seq = local_last_seq_.value(it.key(), 0);
+        if(local_seq <= 0 && it.value() > 0) {
+            local_seq = message_cache_->loadMessages(it.key()).second;
+        }
+        if(local_seq > 0 && it.value() > local_seq) {
+            cursors.append(QJsonArray{ it.key(), local_seq });
+        }
+    }
+    requestSync(cursors);
+}
+
+void ProtocolHandler::emitConversations()
+{
+    auto const& array = *conversations_;
 
     QVariantList list;
     list.reserve(array.size());
@@ -390,12 +510,142 @@ void ProtocolHandler::handleConversationListResponse(QJsonObject const& obj)
         list.push_back(map);
 
         // 更新服务器端已知的该会话最新 seq。
-        conv_last_seq_[id] = last_seq;
+        conv_last_seq_[id] = std::max(conv_last_seq_.value(id, 0), last_seq);
     }
 
     emit conversationsReset(list);
 }
 
+void ProtocolHandler::handleConversationUpsertPush(QJsonObject const& obj)
+{
+    // 尚未拉取过完整列表时忽略，之后的 CONV_LIST_RESP 已包含这次变化。
+    if(!conversations_) {
+        return;
+    }
+
+    auto const conv = obj.value(QStringLiteral("conversation")).toObject();
+    auto const id = conv.value(QStringLiteral("conversationId")).toString();
+    if(id.isEmpty()) {
+        return;
+    }
+
+    // 列表中没有该会话且推送只含部分字段（例如新群名）时，改为请求完整列表。
+    auto const index = indexOfItem(*conversations_, QStringLiteral("conversationId"), id);
+    if(index < 0 && !conv.contains(QStringLiteral("conversationType"))) {
+        emit needRequestConversationList();
+        return;
+    }
+
+    // 推送在服务端查询后才发出，可能晚于已处理的消息推送或本地已读；
+    // 比本地旧的最新消息与已读字段不覆盖，其余字段（标题、头像等）照常合并。
+    auto patch = conv;
+    if(index >= 0) {
+        auto const current = conversations_->at(index).toObject();
+        auto const seq_of = [](QJsonObject const& o, QString const& key) {
+            return static_cast<qint64>(o.value(key).toDouble(0.0));
+        };
+        if(patch.contains(QStringLiteral("lastSeq"))
+           && seq_of(patch, QStringLiteral("lastSeq")) < seq_of(current, QStringLiteral("lastSeq"))) {
+            for(auto const& key : { QStringLiteral("lastSeq"), QStringLiteral("lastServerTimeMs"),
+                                    QStringLiteral("preview"), QStringLiteral("time"),
+                                    QStringLiteral("unreadCount") }) {
+                patch.remove(key);
+            }
+        }
+        if(patch.contains(QStringLiteral("lastReadSeq"))
+           && seq_of(patch, QStringLiteral("lastReadSeq")) < seq_of(current, QStringLiteral("lastReadSeq"))) {
+            patch.remove(QStringLiteral("lastReadSeq"));
+            patch.remove(QStringLiteral("unreadCount"));
+        }
+    }
+
+    upsertItem(*conversations_, QStringLiteral("conversationId"), patch, false);
+    emitConversations();
+}
+
+void ProtocolHandler::handleConversationRemovePush(QJsonObject const& obj)
+{
+    if(!conversations_) {
+        return;
+    }
+
+    auto const id = obj.value(QStringLiteral("conversationId")).toString();
+    removeItem(*conversations_, QStringLiteral("conversationId"), id);
+    conv_last_seq_.remove(id);
+    emitConversations();
+}
+
+void ProtocolHandler::handleSyncResponse(QJsonObject const& obj)
+{
+    auto const ok = obj.value(QStringLiteral("ok")).toBool(true);
+    if(!ok) {
+        sync_in_flight_ = false;
+        sync_followup_ = QJsonArray{};
+        return;
+    }
+
+    auto const conversations = obj.value(QStringLiteral("conversations")).toArray();
+    for(auto const& item : conversations) {
+        auto const conv = item.toObject();
+        auto const conversation_id = conv.value(QStringLiteral("conversationId")).toString();
+        auto const messages = conv.value(QStringLiteral("messages")).toArray();
+
+        // 本地已有的消息（同步期间先经 MSG_PUSH 到达）不再写入和通知。
+        auto const appended = message_cache_->appendMessages(conversation_id, messages);
+
+        // 只有已加载到界面的会话才逐条通知，其余会话打开时从本地缓存加载。
+        auto const loaded = local_last_seq_.contains(conversation_id);
+        if(loaded) {
+            for(auto const& m : appended) {
+                auto const message_obj = m.toObject();
+                emit messageReceived(
+                    conversation_id,
+                    message_obj.value(QStringLiteral("senderId")).toString(),
+                    message_obj.value(QStringLiteral("senderDisplayName")).toString(),
+                    message_obj.value(QStringLiteral("content")).toString(),
+                    message_obj.value(QStringLiteral("msgType")).toString(),
+                    static_cast<qint64>(message_obj.value(QStringLiteral("serverTimeMs")).toDouble(0.0)),
+                    static_cast<qint64>(message_obj.value(QStringLiteral("seq")).toDouble(0.0)),
+                    message_obj.value(QStringLiteral("serverMsgId")).toString(),
+                    message_obj.value(QStringLiteral("reactions")).toObject().toVariantMap()
+                );
+            }
+        }
+
+        auto max_seq = qint64{};
+        for(auto const& m : messages) {
+            max_seq = std::max(max_seq, static_cast<qint64>(m.toObject().value(QStringLiteral("seq")).toDouble(0.0)));
+        }
+        if(max_seq > 0) {
+            if(loaded) {
+                local_last_seq_[conversation_id] = std::max(local_last_seq_.value(conversation_id, 0), max_seq);
+            }
+            conv_last_seq_[conversation_id] = std::max(conv_last_seq_.value(conversation_id, 0), max_seq);
+        }
+
+        if(conv.value(QStringLiteral("hasMore")).toBool(false) && max_seq > 0) {
+            sync_followup_.append(QJsonArray{ conversation_id, max_seq });
+        }
+    }
+
+    if(obj.value(QStringLiteral("done")).toBool(true)) {
+        sync_in_flight_ = false;
+        requestSync(std::exchange(sync_followup_, QJsonArray{}));
+    }
+}
+
+void ProtocolHandler::requestSync(QJsonArray const& cursors)
+{
+    if(cursors.isEmpty() || !network_manager_->isConnected()) {
+        return;
+    }
+
+    QJsonObject obj;
+    obj.insert(QStringLiteral("conversations"), cursors);
+    network_manager_->sendCommand(QStringLiteral("SYNC_REQ"), obj);
+    sync_in_flight_ = true;
+}
+
 void ProtocolHandler::handleConversationMembersResponse(QJsonObject const& obj)
 {
     auto const ok = obj.value(QStringLiteral("ok")).toBool(false);
@@ -505,7 +755,13 @@ void ProtocolHandler::handleFriendListResponse(QJsonObject const& obj)
         return;
     }
 
-    auto const array = obj.value(QStringLiteral("friends")).toArray();
+    friends_ = obj.value(QStringLiteral("friends")).toArray();
+    emitFriends();
+}
+
+void ProtocolHandler::emitFriends()
+{
+    auto const& array = *friends_;
 
     QVariantList list;
     list.reserve(array.size());
@@ -528,6 +784,31 @@ void ProtocolHandler::handleFriendListResponse(QJsonObject const& obj)
     emit friendsReset(list);
 }
 
+void ProtocolHandler::handleFriendUpsertPush(QJsonObject const& obj)
+{
+    if(!friends_) {
+        return;
+    }
+
+    auto const u = obj.value(QStringLiteral("friend")).toObject();
+    if(u.value(QStringLiteral("userId")).toString().isEmpty()) {
+        return;
+    }
+
+    upsertItem(*friends_, QStringLiteral("userId"), u, false);
+    emitFriends();
+}
+
+void ProtocolHandler::handleFriendRemovePush(QJsonObject const& obj)
+{
+    if(!friends_) {
+        return;
+    }
+
+    removeItem(*friends_, QStringLiteral("userId"), obj.value(QStringLiteral("userId")).toString());
+    emitFriends();
+}
+
 void ProtocolHandler::handleFriendRequestListResponse(QJsonObject const& obj)
 {
     auto const ok = obj.value(QStringLiteral("ok")).toBool(true);
@@ -539,7 +820,13 @@ void ProtocolHandler::handleFriendRequestListResponse(QJsonObject const& obj)
         return;
     }
 
-    auto const array = obj.value(QStringLiteral("requests")).toArray();
+    friend_requests_ = obj.value(QStringLiteral("requests")).toArray();
+    emitFriendRequests();
+}
+
+void ProtocolHandler::emitFriendRequests()
+{
+    auto const& array = *friend_requests_;
 
     QVariantList list;
     list.reserve(array.size());
@@ -562,6 +849,32 @@ void ProtocolHandler::handleFriendRequestListResponse(QJsonObject const& obj)
     emit friendRequestsReset(list);
 }
 
+void ProtocolHandler::handleFriendRequestUpsertPush(QJsonObject const& obj)
+{
+    if(!friend_requests_) {
+        return;
+    }
+
+    auto const r = obj.value(QStringLiteral("request")).toObject();
+    if(r.value(QStringLiteral("requestId")).toString().isEmpty()) {
+        return;
+    }
+
+    // 新申请与列表一致，按时间倒序排在最前。
+    upsertItem(*friend_requests_, QStringLiteral("requestId"), r, true);
+    emitFriendRequests();
+}
+
+void ProtocolHandler::handleFriendRequestRemovePush(QJsonObject const& obj)
+{
+    if(!friend_requests_) {
+        return;
+    }
+
+    removeItem(*friend_requests_, QStringLiteral("requestId"), obj.value(QStringLiteral("requestId")).toString());
+    emitFriendRequests();
+}
+
 void ProtocolHandler::handleFriendSearchResponse(QJsonObject const& obj)
 {
     QVariantMap result;
@@ -616,9 +929,7 @@ void ProtocolHandler::handleFriendAcceptResponse(QJsonObject const& obj)
         return;
     }
 
-    // 同意成功后，刷新"新的朋友"列表和好友列表。
-    emit needRequestFriendRequestList();
-    emit needRequestFriendList();
+    // 好友、申请状态与单聊会话的变化由服务器以增量推送送达。
 }
 
 void ProtocolHandler::handleFriendRejectResponse(QJsonObject const& obj)
@@ -631,9 +942,6 @@ void ProtocolHandler::handleFriendRejectResponse(QJsonObject const& obj)
         }
         return;
     }
-
-    // 拒绝成功后，刷新"新的朋友"列表。
-    emit needRequestFriendRequestList();
 }
 
 void ProtocolHandler::handleFriendDeleteResponse(QJsonObject const& obj)
@@ -646,9 +954,6 @@ void ProtocolHandler::handleFriendDeleteResponse(QJsonObject const& obj)
         }
         return;
     }
-
-    // 删除成功后，刷新好友列表。
-    emit needRequestFriendList();
 }
 
 void ProtocolHandler::handleOpenSingleConvResponse(QJsonObject const& obj)
@@ -687,7 +992,6 @@ void ProtocolHandler::handleCreateGroupResponse(QJsonObject const& obj)
     auto const conv_id = obj.value(QStringLiteral("conversationId")).toString();
     auto const title = obj.value(QStringLiteral("title")).toString();
 
-    emit needRequestConversationList();
     emit groupCreated(conv_id, title);
 }
 
@@ -739,7 +1043,13 @@ void ProtocolHandler::handleGroupJoinRequestListResponse(QJsonObject const& obj)
         return;
     }
 
-    auto const array = obj.value(QStringLiteral("requests")).toArray();
+    group_join_requests_ = obj.value(QStringLiteral("requests")).toArray();
+    emitGroupJoinRequests();
+}
+
+void ProtocolHandler::emitGroupJoinRequests()
+{
+    auto const& array = *group_join_requests_;
 
     QVariantList list;
     list.reserve(array.size());
@@ -762,6 +1072,21 @@ void ProtocolHandler::handleGroupJoinRequestListResponse(QJsonObject const& obj)
     emit groupJoinRequestsReset(list);
 }
 
+void ProtocolHandler::handleGroupJoinRequestUpsertPush(QJsonObject const& obj)
+{
+    if(!group_join_requests_) {
+        return;
+    }
+
+    auto const r = obj.value(QStringLiteral("request")).toObject();
+    if(r.value(QStringLiteral("requestId")).toString().isEmpty()) {
+        return;
+    }
+
+    upsertItem(*group_join_requests_, QStringLiteral("requestId"), r, true);
+    emitGroupJoinRequests();
+}
+
 void ProtocolHandler::handleGroupJoinAcceptResponse(QJsonObject const& obj)
 {
     auto const ok = obj.value(QStringLiteral("ok")).toBool(false);
@@ -772,9 +1097,6 @@ void ProtocolHandler::handleGroupJoinAcceptResponse(QJsonObject const& obj)
         }
         return;
     }
-
-    // 成功后，刷新入群申请列表
-    emit needRequestGroupJoinRequestList();
 }
 
 void ProtocolHandler::handleRenameGroupResponse(QJsonObject const& obj)
@@ -858,6 +1180,15 @@ void ProtocolHandler::handleMarkReadResponse(QJsonObject const& obj)
     // 标记已读成功，发出信号通知本地更新未读数
     auto const convId = obj.value(QStringLiteral("conversationId")).toString();
     if(!convId.isEmpty()) {
+        if(conversations_) {
+            auto const index = indexOfItem(*conversations_, QStringLiteral("conversationId"), convId);
+            if(index >= 0) {
+                auto conv = conversations_->at(index).toObject();
+                conv.insert(QStringLiteral("unreadCount"), 0);
+                conv.insert(QStringLiteral("lastReadSeq"), conv.value(QStringLiteral("lastSeq")));
+                conversations_->replace(index, conv);
+            }
+        }
         emit conversationUnreadCleared(convId);
     }
 }
@@ -1,5 +1,6 @@
 #include <database/auth.h>
 #include <database/connection.h>
+#include <database/message_cache.h>
 #include <utility.h>
 
 #include <boost/mysql.hpp>
@@ -17,46 +18,33 @@ namespace database
     {
         RegisterResult res{};
         auto handle = co_await acquire_handle();
-        auto& conn = *handle;
         mysql::results rows;
 
         try {
-            co_await conn.async_execute(
-                mysql::with_params(
-                    "SELECT id, display_name FROM users WHERE account = {} LIMIT 1",
-                    account),
-                rows,
-                asio::use_awaitable
-            );
-            if(!rows.rows().empty()) {
+            // 一次往返：插入用户，并用 LAST_INSERT_ID() 在服务端把新用户加入世界频道。
+            // 账号重复时由 account 的唯一索引拒绝，后一条语句不会执行
+            auto display_name = generate_random_display_name();
+            try {
+                rows = co_await execute_batch(
+                    handle,
+                    "INSERT INTO users (account, password_hash, display_name) VALUES ({}, {}, {}); "
+                    "INSERT IGNORE INTO conversation_members (conversation_id, user_id, role)"
+                    " SELECT id, LAST_INSERT_ID(), 'MEMBER' FROM conversations"
+                    " WHERE type='GROUP' AND name='世界' LIMIT 1",
+                    account,
+                    password,
+                    display_name
+                );
+            } catch(mysql::error_with_diagnostics const& ex) {
+                if(ex.code() != mysql::common_server_errc::er_dup_entry) {
+                    throw;
+                }
                 res.ok = false;
                 res.error_code = "ACCOUNT_EXISTS";
                 res.error_msg = "账号已存在";
                 co_return res;
             }
-
-            auto display_name = generate_random_display_name();
-            co_await conn.async_execute(
-                mysql::with_params(
-                    "INSERT INTO users (account, password_hash, display_name) "
-                    "VALUES ({}, {}, {})",
-                    account,
-                    password,
-                    display_name),
-                rows,
-                asio::use_awaitable
-            );
-            auto const user_id = static_cast<i64>(rows.last_insert_id());
-
-            co_await conn.async_execute(
-                mysql::with_params(
-                    "INSERT IGNORE INTO conversation_members (conversation_id, user_id, role)"
-                    " VALUES ((SELECT id FROM conversations WHERE type='GROUP' AND name='世界'"
-                    " LIMIT 1), {}, 'MEMBER')",
-                    user_id),
-                rows,
-                asio::use_awaitable
-            );
+            auto const user_id = static_cast<i64>(rows.at(0).last_insert_id());
 
             res.ok = true;
             res.user.id = user_id;
@@ -122,6 +110,7 @@ namespace database
             res.user.account = r.at(1).as_string();
             res.user.display_name = r.at(2).as_string();
             res.user.avatar_path = r.at(3).is_null() ? "" : std::string(r.at(3).as_string());
+            message_cache_rename_user(res.user.id, res.user.display_name);
             co_return res;
         } catch(std::exception const& ex) {
             res.ok = false;
@@ -2,9 +2,16 @@
 
 #include <boost/asio/use_awaitable.hpp>
 #include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/redirect_error.hpp>
+#include <boost/asio/this_coro.hpp>
+#include <boost/asio/experimental/awaitable_operators.hpp>
+#include <boost/asio/experimental/concurrent_channel.hpp>
 #include <boost/mysql.hpp>
 
+#include <algorithm>
 #include <chrono>
+#include <deque>
 #include <mutex>
 #include <random>
 #include <string>
@@ -18,14 +25,68 @@ namespace database
 {
     namespace
     {
+        using clock = std::chrono::steady_clock;
+
+        /// \brief 池中空闲的连接。
+        struct IdleConnection
+        {
+            std::shared_ptr<PooledConnection> conn{};
+            clock::time_point last_used{};
+            /// \brief 上次归还时处于异常传播中，状态不可信。
+            bool suspect{ false };
+        };
+
+        /// \brief 排队等待连接的协程。
+        /// \details 归还方在锁内把连接（或新建名额）写入 grant，再通过 channel 唤醒等待方；
+        ///          等待方超时后同样在锁内检查 granted，二者不会同时成立。
+        struct Waiter
+        {
+            explicit Waiter(asio::any_io_executor exec)
+                : signal(std::move(exec), 1)
+            {}
+
+            asio::experimental::concurrent_channel<void(boost::system::error_code)> signal;
+            /// \brief 归还的连接；为空且 granted 时表示获得了一个新建连接的名额。
+            IdleConnection grant{};
+            bool granted{ false };
+        };
+
+        /// \brief 一组同构端点上的连接池：每个执行器上主库一个，只读副本一个。
+        struct SubPool
+        {
+            /// \brief 本子池连接所在的执行器，连接只由该执行器上的协程借用。
+            asio::any_io_executor exec{};
+            /// \brief 所属执行器在 PoolState::cores 中的下标，归还时据此找回子池。
+            std::size_t core{ 0 };
+            /// \brief 新建连接时按轮询选择的端点。
+            std::vector<DbEndpoint> endpoints;
+            std::size_t next_endpoint{ 0 };
+            std::size_t size{ 0 };
+            bool replica{ false };
+            /// \brief 熔断截止时间：此前借出失败，在该时刻之前不再尝试本子池。
+            clock::time_point skip_until{};
+            /// \brief 已占用的连接名额（空闲 + 借出 + 正在建立）。
+            std::size_t slots{ 0 };
+            std::size_t in_use{ 0 };
+            std::vector<IdleConnection> idle;
+            std::deque<std::shared_ptr<Waiter>> waiters;
+            PoolStats stats{};
+            std::mutex mutex;
+        };
+
+        /// \brief 一个执行器上的主库与副本子池。
+        struct CorePools
+        {
+            SubPool primary;
+            SubPool replica;
+        };
+
         struct PoolState
         {
             PoolConfig cfg{};
-            asio::any_io_executor exec{};
-            std::size_t created{ 0 };
             bool initialized{ false };
-            std::vector<std::shared_ptr<Connection>> idle;
-            std::mutex mutex;
+            /// \brief 每个执行器一组子池；线程池模式只有一组。
+            std::vector<std::unique_ptr<CorePools>> cores;
         };
 
         PoolState& state()
@@ -34,18 +95,148 @@ namespace database
             return s;
         }
 
-        auto make_connection() -> asio::awaitable<std::shared_ptr<Connection>>
+        auto sub_pool(std::size_t core, bool replica) -> SubPool&
+        {
+            auto& pools = *state().cores[core];
+            return replica ? pools.replica : pools.primary;
+        }
+
+        /// \brief 选出与调用方协程同一执行上下文的子池组，找不到时用第一组。
+        /// \details 按核模式下每个 io_context 只由一个线程驱动且不加锁，连接只能在所属核心上使用；
+        ///          按执行上下文比较，会话 strand 包装过的执行器也能找到所在核心。
+        auto pools_for(asio::any_io_executor const& exec) -> CorePools&
         {
+            auto& st = state();
+            if(st.cores.size() > 1) {
+                auto const& ctx = asio::query(exec, asio::execution::context_as<asio::execution_context&>);
+                for(auto const& pools : st.cores) {
+                    if(&asio::query(pools->primary.exec, asio::execution::context_as<asio::execution_context&>) == &ctx) {
+                        return *pools;
+                    }
+                }
+            }
+            return *st.cores.front();
+        }
+
+        /// \brief 新建一个连接。
+        /// \param connect_timeout 为 0 时不限时（主库）；副本使用较短的超时，超时抛出 std::runtime_error。
+        auto make_connection(SubPool& pool, std::chrono::milliseconds connect_timeout = {})
+            -> asio::awaitable<std::shared_ptr<PooledConnection>>
+        {
+            using namespace asio::experimental::awaitable_operators;
+
             auto& st = state();
             mysql::handshake_params params{ st.cfg.user, st.cfg.password, st.cfg.database };
+            // execute_batch 依赖多语句执行
+            params.set_multi_queries(true);
 
-            auto conn = std::make_shared<Connection>(st.exec);
-            asio::ip::tcp::resolver resolver{ st.exec };
+            DbEndpoint target;
+            {
+                std::lock_guard lock{ pool.mutex };
+                target = pool.endpoints[pool.next_endpoint++ % pool.endpoints.size()];
+            }
+
+            auto pooled = std::make_shared<PooledConnection>(pool.exec);
+            pooled->replica = pool.replica;
+            pooled->core = pool.core;
+            asio::ip::tcp::resolver resolver{ pool.exec };
             auto endpoints = co_await resolver.async_resolve(
-                st.cfg.host, std::to_string(st.cfg.port), asio::use_awaitable);
+                target.host, std::to_string(target.port), asio::use_awaitable);
             auto ep = endpoints.begin()->endpoint();
-            co_await conn->async_connect(ep, params, asio::use_awaitable);
-            co_return conn;
+            if(connect_timeout.count() <= 0) {
+                co_await pooled->conn.async_connect(ep, params, asio::use_awaitable);
+                co_return pooled;
+            }
+
+            // 不可达的副本可能让 TCP 连接挂起很久，超时后取消并交给调用方改走主库
+            asio::steady_timer timer{ pool.exec };
+            timer.expires_after(connect_timeout);
+            auto const result = co_await (
+                pooled->conn.async_connect(ep, params, asio::use_awaitable)
+                || timer.async_wait(asio::use_awaitable)
+            );
+            if(result.index() == 1) {
+                throw std::runtime_error("database connect timeout");
+            }
+            co_return pooled;
+        }
+
+        /// \brief 把一个名额或连接交给队首等待者，调用方须持有锁。
+        /// \return 被唤醒的等待者，由调用方在解锁后发送信号。
+        auto grant_front_waiter(SubPool& st, IdleConnection grant) -> std::shared_ptr<Waiter>
+        {
+            if(st.waiters.empty()) {
+                return nullptr;
+            }
+            auto waiter = std::move(st.waiters.front());
+            st.waiters.pop_front();
+            waiter->grant = std::move(grant);
+            waiter->granted = true;
+            return waiter;
+        }
+
+        auto wake(std::shared_ptr<Waiter> const& waiter) -> void
+        {
+            if(waiter) {
+                waiter->signal.try_send(boost::system::error_code{});
+            }
+        }
+
+        /// \brief 归还连接：优先交给排队最久的等待者，否则放回空闲列表。
+        auto release_connection(std::shared_ptr<PooledConnection> conn, bool suspect) -> void
+        {
+            auto& st = sub_pool(conn->core, conn->replica);
+            std::shared_ptr<Waiter> waiter;
+            {
+                std::lock_guard lock{ st.mutex };
+                if(st.in_use > 0) {
+                    --st.in_use;
+                }
+                IdleConnection entry{ std::move(conn), clock::now(), suspect };
+                waiter = grant_front_waiter(st, std::move(entry));
+                if(!waiter) {
+                    st.idle.push_back(std::move(entry));
+                }
+            }
+            wake(waiter);
+        }
+
+        /// \brief 放弃一个连接名额（新建失败或连接已损坏），名额转交给等待者。
+        auto release_slot(SubPool& st) -> void
+        {
+            std::shared_ptr<Waiter> waiter;
+            {
+                std::lock_guard lock{ st.mutex };
+                waiter = grant_front_waiter(st, IdleConnection{});
+                if(!waiter && st.slots > 0) {
+                    --st.slots;
+                }
+            }
+            wake(waiter);
+        }
+
+        /// \brief 回滚上一个借用者遗留的事务，失败说明连接已不可用。
+        auto discard_transaction(PooledConnection& pooled) -> asio::awaitable<bool>
+        {
+            try {
+                mysql::results r;
+                co_await pooled.conn.async_execute("ROLLBACK", r, asio::use_awaitable);
+                pooled.in_transaction = false;
+                co_return true;
+            } catch(std::exception const&) {
+                co_return false;
+            }
+        }
+
+        /// \brief 校验空闲连接是否可用。
+        auto is_healthy(Connection& conn) -> asio::awaitable<bool>
+        {
+            try {
+                co_await conn.async_ping(asio::use_awaitable);
+                co_return true;
+            } catch(std::exception const&) {
+                co_return false;
+            }
         }
     }
 
@@ -56,12 +247,41 @@ namespace database
     }
 
     auto init_pool(asio::any_io_executor exec, PoolConfig cfg) -> void
+    {
+        init_pool(std::vector<asio::any_io_executor>{ std::move(exec) }, std::move(cfg));
+    }
+
+    auto init_pool(std::vector<asio::any_io_executor> const& execs, PoolConfig cfg) -> void
     {
         auto& st = state();
-        if(st.initialized) return;
-        st.exec = exec;
+        if(st.initialized || execs.empty()) return;
         st.cfg = std::move(cfg);
-        st.created = 0;
+
+        // 连接数上限按执行器均分（向上取整），总连接数与单池时相当
+        auto const n = execs.size();
+        auto const primary_size = std::max<std::size_t>((st.cfg.pool_size + n - 1) / n, 1);
+        auto const replica_size = std::max<std::size_t>((st.cfg.replica_pool_size + n - 1) / n, 1);
+
+        st.cores.reserve(n);
+        for(std::size_t i = 0; i < n; ++i) {
+            auto pools = std::make_unique<CorePools>();
+
+            pools->primary.exec = execs[i];
+            pools->primary.core = i;
+            pools->primary.endpoints = { DbEndpoint{ st.cfg.host, st.cfg.port } };
+            pools->primary.size = primary_size;
+
+            pools->replica.exec = execs[i];
+            pools->replica.core = i;
+            pools->replica.endpoints = st.cfg.replicas;
+            // 各核心从不同的副本开始轮询，避免都先连第一个副本
+            pools->replica.next_endpoint = i;
+            pools->replica.size = replica_size;
+            pools->replica.replica = true;
+
+            st.cores.push_back(std::move(pools));
+        }
+
         st.initialized = true;
     }
 
@@ -71,49 +291,221 @@ namespace database
         if(!st.initialized) {
             init_pool(exec, PoolConfig{});
         }
-        auto conn_sp = co_await make_connection();
-        co_return std::move(*conn_sp);
+        auto pooled = co_await make_connection(st.cores.front()->primary);
+        co_return std::move(pooled->conn);
     }
 
-    auto acquire_connection() -> asio::awaitable<std::shared_ptr<Connection>>
+    namespace
+    {
+        /// \brief 从指定子池借出一个连接，逻辑见 acquire_handle。
+        /// \param timeout 排队等待与新建连接各自的时限；新建连接仅在副本子池上限时。
+        auto acquire_from(SubPool& pool, std::chrono::milliseconds timeout) -> asio::awaitable<ConnectionHandle>
+        {
+            using namespace asio::experimental::awaitable_operators;
+
+            auto& st = state();
+            auto const start = clock::now();
+            IdleConnection entry{};
+            std::shared_ptr<Waiter> waiter;
+            {
+                std::lock_guard lock{ pool.mutex };
+                if(!pool.idle.empty()) {
+                    // 后进先出：最近用过的连接最可能仍然存活
+                    entry = std::move(pool.idle.back());
+                    pool.idle.pop_back();
+                } else if(pool.slots < pool.size) {
+                    ++pool.slots;
+                } else {
+                    waiter = std::make_shared<Waiter>(pool.exec);
+                    pool.waiters.push_back(waiter);
+                    ++pool.stats.waits;
+                }
+            }
+
+            if(waiter) {
+                asio::steady_timer timer{ co_await asio::this_coro::executor };
+                timer.expires_after(timeout);
+                boost::system::error_code ec;
+                co_await (
+                    waiter->signal.async_receive(asio::redirect_error(asio::use_awaitable, ec))
+                    || timer.async_wait(asio::redirect_error(asio::use_awaitable, ec))
+                );
+
+                std::lock_guard lock{ pool.mutex };
+                if(!waiter->granted) {
+                    std::erase(pool.waiters, waiter);
+                    ++pool.stats.timeouts;
+                    throw std::runtime_error("database pool acquire timeout");
+                }
+                entry = std::move(waiter->grant);
+            }
+
+            // 带着未结束事务归还的连接先回滚，否则下一个借用者的 START TRANSACTION 会隐式提交它
+            if(entry.conn && entry.conn->in_transaction) {
+                if(co_await discard_transaction(*entry.conn)) {
+                    std::lock_guard lock{ pool.mutex };
+                    ++pool.stats.rollbacks;
+                } else {
+                    entry.conn.reset();
+                    std::lock_guard lock{ pool.mutex };
+                    ++pool.stats.reconnects;
+                }
+            }
+
+            // 长时间空闲或上次异常归还的连接先 ping，失败则在同一名额上重连
+            if(entry.conn && (entry.suspect || clock::now() - entry.last_used > st.cfg.health_check_idle)) {
+                if(!co_await is_healthy(entry.conn->conn)) {
+                    entry.conn.reset();
+                    std::lock_guard lock{ pool.mutex };
+                    ++pool.stats.reconnects;
+                }
+            }
+
+            if(!entry.conn) {
+                try {
+                    entry.conn = co_await make_connection(pool, pool.replica ? timeout : std::chrono::milliseconds{});
+                } catch(...) {
+                    release_slot(pool);
+                    throw;
+                }
+                std::lock_guard lock{ pool.mutex };
+                ++pool.stats.creates;
+            }
+
+            auto const waited_us = static_cast<std::uint64_t>(
+                std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - start).count()
+            );
+            {
+                std::lock_guard lock{ pool.mutex };
+                ++pool.in_use;
+                ++pool.stats.acquires;
+                pool.stats.total_wait_us += waited_us;
+                pool.stats.max_wait_us = std::max(pool.stats.max_wait_us, waited_us);
+            }
+            co_return ConnectionHandle{ std::move(entry.conn) };
+        }
+    } // namespace
+
+    auto acquire_handle(Route route) -> asio::awaitable<ConnectionHandle>
     {
         auto& st = state();
         if(!st.initialized) {
             throw std::runtime_error("pool not initialized");
         }
 
-        // Fast path: reuse idle
-        {
-            std::lock_guard lock{ st.mutex };
-            if(!st.idle.empty()) {
-                auto conn = st.idle.back();
-                st.idle.pop_back();
-                co_return conn;
+        auto& pools = pools_for(co_await asio::this_coro::executor);
+        if(route == Route::replica && !pools.replica.endpoints.empty()) {
+            bool skip = false;
+            {
+                std::lock_guard lock{ pools.replica.mutex };
+                skip = clock::now() < pools.replica.skip_until;
             }
-            if(st.created < st.cfg.pool_size) {
-                ++st.created;
-                co_return co_await make_connection();
+            if(!skip) {
+                try {
+                    co_return co_await acquire_from(pools.replica, st.cfg.replica_acquire_timeout);
+                } catch(std::exception const&) {
+                    // 副本不可用时退回主库，读请求只是多占一个主库连接；
+                    // 熔断一段时间，避免之后的每个读请求都先等满副本的超时
+                    std::lock_guard lock{ pools.replica.mutex };
+                    pools.replica.skip_until = clock::now() + st.cfg.replica_retry_after;
+                }
             }
+            std::lock_guard lock{ pools.replica.mutex };
+            ++pools.replica.stats.fallbacks;
+        }
+        co_return co_await acquire_from(pools.primary, st.cfg.acquire_timeout);
+    }
+
+    auto read_route_after_write(std::chrono::steady_clock::time_point last_write) -> Route
+    {
+        auto& st = state();
+        if(st.cfg.replicas.empty() || clock::now() - last_write < st.cfg.read_your_writes_window) {
+            return Route::primary;
+        }
+        return Route::replica;
+    }
+
+    auto has_replicas() -> bool
+    {
+        return !state().cfg.replicas.empty();
+    }
+
+    auto pool_stats(Route route) -> PoolStats
+    {
+        // 各执行器子池的统计之和，最大值取各子池中的最大者
+        PoolStats total{};
+        auto& st = state();
+        for(std::size_t core = 0; core < st.cores.size(); ++core) {
+            auto& pool = sub_pool(core, route == Route::replica);
+            std::lock_guard lock{ pool.mutex };
+            auto const& s = pool.stats;
+            total.in_use += pool.in_use;
+            total.idle += pool.idle.size();
+            total.waiting += pool.waiters.size();
+            total.acquires += s.acquires;
+            total.waits += s.waits;
+            total.timeouts += s.timeouts;
+            total.creates += s.creates;
+            total.reconnects += s.reconnects;
+            total.rollbacks += s.rollbacks;
+            total.total_wait_us += s.total_wait_us;
+            total.max_wait_us = std::max(total.max_wait_us, s.max_wait_us);
+            total.fallbacks += s.fallbacks;
+        }
+        return total;
+    }
+
+    auto ConnectionHandle::operator=(ConnectionHandle&& other) noexcept -> ConnectionHandle&
+    {
+        if(this != &other) {
+            reset();
+            pooled = std::move(other.pooled);
+            uncaught_ = other.uncaught_;
         }
-        // Pool saturated, create a temporary connection (could be tuned to wait instead).
-        co_return co_await make_connection();
+        return *this;
     }
 
     ConnectionHandle::~ConnectionHandle()
     {
-        if(!conn) return;
+        reset();
+    }
+
+    auto ConnectionHandle::reset() noexcept -> void
+    {
+        if(!pooled) return;
         auto& st = state();
         if(!st.initialized) return;
-        std::lock_guard lock{ st.mutex };
-        if(st.idle.size() < st.cfg.pool_size) {
-            st.idle.push_back(std::move(conn));
-        }
+        release_connection(std::move(pooled), std::uncaught_exceptions() > uncaught_);
+    }
+
+    auto ConnectionHandle::begin() -> asio::awaitable<void>
+    {
+        mysql::results r;
+        pooled->in_transaction = true;
+        co_await pooled->conn.async_execute("START TRANSACTION", r, asio::use_awaitable);
     }
 
-    auto acquire_handle() -> asio::awaitable<ConnectionHandle>
+    auto ConnectionHandle::commit() -> asio::awaitable<void>
     {
-        auto c = co_await acquire_connection();
-        co_return ConnectionHandle{ std::move(c) };
+        mysql::results r;
+        co_await pooled->conn.async_execute("COMMIT", r, asio::use_awaitable);
+        pooled->in_transaction = false;
+    }
+
+    auto ConnectionHandle::rollback() -> asio::awaitable<void>
+    {
+        mysql::results r;
+        co_await pooled->conn.async_execute("ROLLBACK", r, asio::use_awaitable);
+        pooled->in_transaction = false;
+    }
+
+    auto ConnectionHandle::prepare(StatementId id) -> asio::awaitable<mysql::statement>
+    {
+        auto& slot = pooled->statements[static_cast<std::size_t>(id)];
+        if(!slot) {
+            slot = co_await pooled->conn.async_prepare_statement(statement_sql(id), asio::use_awaitable);
+        }
+        co_return *slot;
     }
 
     auto generate_random_display_name() -> std::string
@@ -1,5 +1,7 @@
 #include <database/conversation.h>
 #include <database/connection.h>
+#include <database/sequence.h>
+#include <database/message_cache.h>
 #include <utility.h>
 
 #include <boost/mysql.hpp>
@@ -12,6 +14,8 @@
 #include <ctime>
 #include <iomanip>
 #include <sstream>
+#include <span>
+#include <unordered_map>
 
 namespace asio = boost::asio;
 namespace mysql = boost::mysql;
@@ -131,9 +135,90 @@ namespace database
         return preview;
     }
 
+    // 默认群名只取前三个有昵称的成员，候选数量封顶，避免大群把全部成员 ID 放进 IN 列表
+    static constexpr std::size_t DEFAULT_NAME_CANDIDATES = 16;
+
+    // 按成员加载单个会话时追加在 CONVERSATION_SELECT 之后的条件
+    static constexpr std::string_view MEMBER_CONVERSATION_WHERE = "WHERE cm.conversation_id = {} AND cm.user_id IN ({})";
+
+    // 辅助函数：把会话列表查询的一行（列顺序见 CONVERSATION_SELECT）转换为 viewer_id 视角的会话信息
+    static auto conversation_from_row(mysql::row_view row, i64 viewer_id) -> ConversationInfo
+    {
+        ConversationInfo info{};
+        info.id = row.at(0).as_int64();
+        info.type = row.at(1).as_string();
+        auto stored_name = row.at(2).as_string();
+        if(info.type == "GROUP") {
+            info.title = stored_name;
+        } else if(info.type == "SINGLE") {
+            if(!row.at(3).is_null()) {
+                info.title = row.at(3).as_string();
+            } else {
+                info.title = stored_name;
+            }
+        } else {
+            info.title = stored_name;
+        }
+        info.last_seq = row.at(4).as_int64();
+        info.last_server_time_ms = row.at(5).as_int64();
+        if(!row.at(6).is_null()) {
+            info.avatar_path = std::string(row.at(6).as_string());
+        }
+        info.last_read_seq = row.at(7).as_int64();
+        info.unread_count = row.at(8).as_int64();
+
+        // 处理最新消息预览（索引 9-12）
+        if(!row.at(9).is_null() && !row.at(10).is_null()) {
+            auto content = std::string(row.at(9).as_string());
+            auto msg_type = std::string(row.at(10).as_string());
+            auto sender_id = row.at(11).as_int64();
+            auto sender_name = !row.at(12).is_null() ? std::string(row.at(12).as_string()) : "";
+
+            info.last_message_preview = generate_message_preview(
+                msg_type, content, sender_name, info.type, viewer_id, sender_id
+            );
+        }
+
+        // 格式化时间
+        info.last_message_time = format_message_time(info.last_server_time_ms);
+        return info;
+    }
+
+    // 每条多行 INSERT 写入的成员数上限，避免单条语句超过 max_allowed_packet
+    static constexpr std::size_t MEMBER_INSERT_CHUNK = 1000;
+
+    // 辅助函数：按 MEMBER_INSERT_CHUNK 切分成员列表
+    static auto member_chunks(std::vector<i64> const& member_ids) -> std::vector<std::span<i64 const>>
+    {
+        std::vector<std::span<i64 const>> chunks;
+        for(std::size_t i = 0; i < member_ids.size(); i += MEMBER_INSERT_CHUNK) {
+            chunks.push_back(std::span{ member_ids }.subspan(i, std::min(MEMBER_INSERT_CHUNK, member_ids.size() - i)));
+        }
+        return chunks;
+    }
+
+    // 辅助函数：把各块成员格式化为以分号分隔的多行 INSERT，会话 ID 取自会话变量 @conv_id
+    static auto member_insert_statements(bool ignore_existing, std::vector<std::span<i64 const>> chunks)
+    {
+        return mysql::sequence(
+            std::move(chunks),
+            [ignore_existing](std::span<i64 const> chunk, mysql::format_context_base& ctx) {
+                auto const rows = mysql::sequence(chunk, [](i64 uid, mysql::format_context_base& row_ctx) {
+                    mysql::format_sql_to(row_ctx, "(@conv_id, {}, 'MEMBER')", uid);
+                });
+                if(ignore_existing) {
+                    mysql::format_sql_to(ctx, "INSERT IGNORE INTO conversation_members (conversation_id, user_id, role) VALUES {}", rows);
+                } else {
+                    mysql::format_sql_to(ctx, "INSERT INTO conversation_members (conversation_id, user_id, role) VALUES {}", rows);
+                }
+            },
+            "; "
+        );
+    }
+
     auto get_world_conversation_id() -> asio::awaitable<i64>
     {
-        auto conn_h = co_await acquire_connection();
+        auto conn_h = co_await acquire_handle();
 
         mysql::results r;
         co_await conn_h->async_execute(
@@ -158,10 +243,10 @@ namespace database
         auto a = std::min(user1, user2);
         auto b = std::max(user1, user2);
 
-        auto conn_h = co_await acquire_connection();
+        auto conn_h = co_await acquire_handle();
         mysql::results r;
 
-        co_await conn_h->async_execute("START TRANSACTION", r, asio::use_awaitable);
+        co_await conn_h.begin();
 
         // 1) 直接查是否已有
         co_await conn_h->async_execute(
@@ -175,7 +260,7 @@ namespace database
         );
         if(!r.rows().empty()) {
             auto const existing_conv_id = r.rows().front().at(0).as_int64();
-            co_await conn_h->async_execute("COMMIT", r, asio::use_awaitable);
+            co_await conn_h.commit();
             co_return existing_conv_id;
         }
 
@@ -216,7 +301,7 @@ namespace database
             asio::use_awaitable
         );
 
-        co_await conn_h->async_execute("COMMIT", r, asio::use_awaitable);
+        co_await conn_h.commit();
         co_return conv_id;
     }
 
@@ -236,22 +321,7 @@ namespace database
             throw std::runtime_error{ "群成员不足（至少需要群主 + 2 位好友）" };
         }
 
-        auto conn_h = co_await acquire_connection();
-        mysql::results r;
-
-        auto pick_display_name = [&](i64 uid) -> asio::awaitable<std::string>
-        {
-            mysql::results local;
-            co_await conn_h->async_execute(
-                mysql::with_params(
-                    "SELECT display_name FROM users WHERE id={} LIMIT 1",
-                    uid),
-                local,
-                asio::use_awaitable
-            );
-            if(local.rows().empty()) co_return std::string{};
-            co_return local.rows().front().at(0).as_string();
-        };
+        auto conn_h = co_await acquire_handle();
 
         if(name.empty()) {
             std::vector<i64> order;
@@ -259,11 +329,23 @@ namespace database
             order.push_back(creator_id);
             order.insert(order.end(), member_ids.begin(), member_ids.end());
 
+            // 一次 IN 查询取回候选成员的昵称，再按 creator + 成员的顺序挑前三个
+            auto const candidates = std::span{ order }.first(std::min(order.size(), DEFAULT_NAME_CANDIDATES));
+            mysql::results r;
+            co_await conn_h->async_execute(
+                mysql::with_params("SELECT id, display_name FROM users WHERE id IN ({})", candidates),
+                r,
+                asio::use_awaitable
+            );
+            std::unordered_map<i64, std::string> names;
+            for(auto const& row : r.rows()) {
+                names.emplace(row.at(0).as_int64(), row.at(1).as_string());
+            }
+
             std::vector<std::string> picked;
-            for(size_t i = 0; i < order.size() && picked.size() < 3; ++i) {
-                auto display = co_await pick_display_name(order[i]);
-                if(!display.empty()) {
-                    picked.push_back(std::move(display));
+            for(size_t i = 0; i < candidates.size() && picked.size() < 3; ++i) {
+                if(auto it = names.find(candidates[i]); it != names.end() && !it->second.empty()) {
+                    picked.push_back(it->second);
                 }
             }
 
@@ -277,144 +359,113 @@ namespace database
             name = std::move(joined);
         }
 
-        co_await conn_h->async_execute("START TRANSACTION", r, asio::use_awaitable);
-
-        // 创建群聊
-        co_await conn_h->async_execute(
-            mysql::with_params(
-                "INSERT INTO conversations (type, name, owner_user_id)"
-                " VALUES ('GROUP', {}, {})",
-                name,
-                creator_id),
-            r,
-            asio::use_awaitable
+        // 建群、插入群主与全部成员在同一事务中一次往返完成，成员按块写成多行 INSERT
+        auto const r = co_await execute_transaction(
+            conn_h,
+            "INSERT INTO conversations (type, name, owner_user_id) VALUES ('GROUP', {}, {}); "
+            "SET @conv_id = LAST_INSERT_ID(); "
+            "INSERT INTO conversation_members (conversation_id, user_id, role) VALUES (@conv_id, {}, 'OWNER'); "
+            "{}",
+            name,
+            creator_id,
+            creator_id,
+            member_insert_statements(false, member_chunks(member_ids))
         );
-        auto conv_id = static_cast<i64>(r.last_insert_id());
+        co_return static_cast<i64>(r.at(1).last_insert_id());
+    }
 
-        // 插入群主
-        co_await conn_h->async_execute(
-            mysql::with_params(
-                "INSERT INTO conversation_members (conversation_id, user_id, role)"
-                " VALUES ({}, {}, 'OWNER')",
-                conv_id,
-                creator_id),
-            r,
-            asio::use_awaitable
+    auto add_group_members(i64 conversation_id, std::vector<i64> member_ids) -> asio::awaitable<std::size_t>
+    {
+        std::sort(member_ids.begin(), member_ids.end());
+        member_ids.erase(std::unique(member_ids.begin(), member_ids.end()), member_ids.end());
+        std::erase_if(member_ids, [](i64 id) { return id <= 0; });
+        if(conversation_id <= 0 || member_ids.empty()) {
+            co_return 0;
+        }
+
+        // 已在群中的成员由主键忽略，不影响其原有角色
+        auto const chunks = member_chunks(member_ids);
+        auto conn_h = co_await acquire_handle();
+        auto const r = co_await execute_transaction(
+            conn_h,
+            "SET @conv_id = {}; {}",
+            conversation_id,
+            member_insert_statements(true, chunks)
         );
 
-        // 插入成员
-        for(auto uid : member_ids) {
-            co_await conn_h->async_execute(
-                mysql::with_params(
-                    "INSERT INTO conversation_members (conversation_id, user_id, role)"
-                    " VALUES ({}, {}, 'MEMBER')",
-                    conv_id,
-                    uid),
-                r,
-                asio::use_awaitable
-            );
+        std::size_t added = 0;
+        for(std::size_t i = 0; i < chunks.size(); ++i) {
+            // 结果集依次为 START TRANSACTION、SET、各块 INSERT、COMMIT
+            added += static_cast<std::size_t>(r.at(i + 2).affected_rows());
         }
-
-        co_await conn_h->async_execute("COMMIT", r, asio::use_awaitable);
-        co_return conv_id;
+        co_return added;
     }
 
-    auto load_user_conversations(i64 user_id) -> asio::awaitable<std::vector<ConversationInfo>>
+    auto load_user_conversations(i64 user_id, Route route) -> asio::awaitable<std::vector<ConversationInfo>>
     {
-        auto conn_h = co_await acquire_connection();
+        auto conn_h = co_await acquire_handle(route);
+        auto const stmt = co_await conn_h.prepare(StatementId::load_user_conversations);
         mysql::results r;
 
-        co_await conn_h->async_execute(
-            mysql::with_params(
-                "SELECT c.id, c.type, c.name, peer.display_name AS peer_name,"
-                " COALESCE(msg_stats.max_seq, 0) AS last_seq, COALESCE(msg_stats.max_time, 0) AS last_time, "
-                " CASE WHEN c.type = 'GROUP' THEN c.avatar_path ELSE peer.avatar_path END AS avatar_path, "
-                " cm.last_read_seq, "
-                " GREATEST(0, COALESCE(msg_stats.max_seq, 0) - cm.last_read_seq) AS unread_count, "
-                " last_msg.content, last_msg.msg_type, last_msg.sender_id, sender.display_name AS sender_name "
-                "FROM conversations c "
-                "JOIN conversation_members cm ON cm.conversation_id = c.id "
-                "LEFT JOIN ("
-                "  SELECT cm2.conversation_id, u.display_name, u.avatar_path "
-                "  FROM conversation_members cm2 "
-                "  JOIN users u ON u.id = cm2.user_id "
-                "  WHERE cm2.user_id <> {}"
-                ") peer ON peer.conversation_id = c.id AND c.type = 'SINGLE' "
-                "LEFT JOIN ("
-                "  SELECT conversation_id, MAX(seq) AS max_seq, MAX(server_time_ms) AS max_time "
-                "  FROM messages GROUP BY conversation_id"
-                ") msg_stats ON msg_stats.conversation_id = c.id "
-                "LEFT JOIN messages last_msg ON last_msg.conversation_id = c.id AND last_msg.seq = msg_stats.max_seq "
-                "LEFT JOIN users sender ON sender.id = last_msg.sender_id "
-                "WHERE cm.user_id = {} ORDER BY c.id ASC",
-                user_id,
-                user_id),
-            r,
-            asio::use_awaitable
-        );
+        // 最新消息来自 conversation_summaries，查询成本只与该用户的会话数有关，与消息总量无关
+        co_await conn_h->async_execute(stmt.bind(user_id), r, asio::use_awaitable);
 
         std::vector<ConversationInfo> result;
         result.reserve(r.rows().size());
         for(auto const& row : r.rows()) {
-            ConversationInfo info{};
-            info.id = row.at(0).as_int64();
-            info.type = row.at(1).as_string();
-            auto stored_name = row.at(2).as_string();
-            if(info.type == "GROUP") {
-                info.title = stored_name;
-            } else if(info.type == "SINGLE") {
-                if(!row.at(3).is_null()) {
-                    info.title = row.at(3).as_string();
-                } else {
-                    info.title = stored_name;
-                }
-            } else {
-                info.title = stored_name;
-            }
-            info.last_seq = row.at(4).as_int64();
-            info.last_server_time_ms = row.at(5).as_int64();
-            if(!row.at(6).is_null()) {
-                info.avatar_path = std::string(row.at(6).as_string());
-            }
-            info.last_read_seq = row.at(7).as_int64();
-            info.unread_count = row.at(8).as_int64();
-
-            // 处理最新消息预览（索引 9-12）
-            if(!row.at(9).is_null() && !row.at(10).is_null()) {
-                auto content = std::string(row.at(9).as_string());
-                auto msg_type = std::string(row.at(10).as_string());
-                auto sender_id = row.at(11).as_int64();
-                auto sender_name = !row.at(12).is_null() ? std::string(row.at(12).as_string()) : "";
-
-                info.last_message_preview = generate_message_preview(
-                    msg_type, content, sender_name, info.type, user_id, sender_id
-                );
-            }
+            result.push_back(conversation_from_row(row, user_id));
+        }
+        co_return result;
+    }
 
-            // 格式化时间
-            info.last_message_time = format_message_time(info.last_server_time_ms);
+    auto load_conversation_for_members(i64 conversation_id, std::vector<i64> const& user_ids, Route route)
+        -> asio::awaitable<std::unordered_map<i64, ConversationInfo>>
+    {
+        std::unordered_map<i64, ConversationInfo> result;
+        if(conversation_id <= 0 || user_ids.empty()) {
+            co_return result;
+        }
+
+        // 与会话列表相同的列，但只取一个会话、按成员逐行返回，走 conversation_members 主键
+        auto conn_h = co_await acquire_handle(route);
+        auto const r = co_await execute_batch(
+            conn_h, join_sql<CONVERSATION_SELECT, MEMBER_CONVERSATION_WHERE>, conversation_id, user_ids
+        );
 
-            result.push_back(std::move(info));
+        for(auto const& row : r.rows()) {
+            auto const viewer_id = row.at(13).as_int64();
+            result.emplace(viewer_id, conversation_from_row(row, viewer_id));
         }
         co_return result;
     }
 
+    auto load_user_conversation_ids(i64 user_id) -> asio::awaitable<std::vector<i64>>
+    {
+        std::vector<i64> ids;
+        if(user_id <= 0) {
+            co_return ids;
+        }
+
+        auto conn_h = co_await acquire_handle();
+        auto const stmt = co_await conn_h.prepare(StatementId::load_user_conversation_ids);
+        mysql::results r;
+        co_await conn_h->async_execute(stmt.bind(user_id), r, asio::use_awaitable);
+
+        ids.reserve(r.rows().size());
+        for(auto const& row : r.rows()) {
+            ids.push_back(row.at(0).as_int64());
+        }
+        co_return ids;
+    }
+
     auto get_conversation_member(i64 conversation_id, i64 user_id)
         -> asio::awaitable<std::optional<MemberInfo>>
     {
-        auto conn_h = co_await acquire_connection();
+        auto conn_h = co_await acquire_handle();
+        auto const stmt = co_await conn_h.prepare(StatementId::get_conversation_member);
         mysql::results r;
 
-        co_await conn_h->async_execute(
-            mysql::with_params(
-                "SELECT cm.role, cm.muted_until_ms, u.display_name "
-                "FROM conversation_members cm JOIN users u ON u.id = cm.user_id "
-                "WHERE cm.conversation_id = {} AND cm.user_id = {} LIMIT 1",
-                conversation_id,
-                user_id),
-            r,
-            asio::use_awaitable
-        );
+        co_await conn_h->async_execute(stmt.bind(conversation_id, user_id), r, asio::use_awaitable);
 
         if(r.rows().empty()) {
             co_return std::nullopt;
@@ -432,7 +483,7 @@ namespace database
     auto set_member_mute_until(i64 conversation_id, i64 user_id, i64 muted_until_ms)
         -> asio::awaitable<void>
     {
-        auto conn_h = co_await acquire_connection();
+        auto conn_h = co_await acquire_handle();
         mysql::results r;
 
         co_await conn_h->async_execute(
@@ -451,7 +502,7 @@ namespace database
     auto set_member_role(i64 conversation_id, i64 user_id, std::string const& role)
         -> asio::awaitable<void>
     {
-        auto conn_h = co_await acquire_connection();
+        auto conn_h = co_await acquire_handle();
         mysql::results r;
 
         co_await conn_h->async_execute(
@@ -469,7 +520,7 @@ namespace database
 
     auto load_conversation_members(i64 conversation_id) -> asio::awaitable<std::vector<MemberInfo>>
     {
-        auto conn_h = co_await acquire_connection();
+        auto conn_h = co_await acquire_handle();
         mysql::results r;
 
         co_await conn_h->async_execute(
@@ -498,7 +549,7 @@ namespace database
 
     auto remove_conversation_member(i64 conversation_id, i64 user_id) -> asio::awaitable<void>
     {
-        auto conn_h = co_await acquire_connection();
+        auto conn_h = co_await acquire_handle();
         mysql::results r;
 
         co_await conn_h->async_execute(
@@ -516,52 +567,19 @@ namespace database
     {
         if(conversation_id <= 0) co_return;
 
-        auto conn_h = co_await acquire_connection();
-        mysql::results r;
-
-        co_await conn_h->async_execute("START TRANSACTION", r, asio::use_awaitable);
-
-        co_await conn_h->async_execute(
-            mysql::with_params(
-                "DELETE FROM messages WHERE conversation_id={}",
-                conversation_id),
-            r,
-            asio::use_awaitable
-        );
-
-        co_await conn_h->async_execute(
-            mysql::with_params(
-                "DELETE FROM conversation_members WHERE conversation_id={}",
-                conversation_id),
-            r,
-            asio::use_awaitable
-        );
-
-        co_await conn_h->async_execute(
-            mysql::with_params(
-                "DELETE FROM single_conversations WHERE conversation_id={}",
-                conversation_id),
-            r,
-            asio::use_awaitable
-        );
-
-        co_await conn_h->async_execute(
-            mysql::with_params(
-                "DELETE FROM conversation_sequences WHERE conversation_id={}",
-                conversation_id),
-            r,
-            asio::use_awaitable
-        );
-
-        co_await conn_h->async_execute(
-            mysql::with_params(
-                "DELETE FROM conversations WHERE id={}",
-                conversation_id),
-            r,
-            asio::use_awaitable
+        // 整个事务一次往返，conversation_summaries 随 conversations 级联删除
+        auto conn_h = co_await acquire_handle();
+        co_await execute_transaction(
+            conn_h,
+            "DELETE FROM messages WHERE conversation_id={0}; "
+            "DELETE FROM conversation_members WHERE conversation_id={0}; "
+            "DELETE FROM single_conversations WHERE conversation_id={0}; "
+            "DELETE FROM conversation_sequences WHERE conversation_id={0}; "
+            "DELETE FROM conversations WHERE id={0}",
+            conversation_id
         );
-
-        co_await conn_h->async_execute("COMMIT", r, asio::use_awaitable);
+        forget_conversation_sequence(conversation_id);
+        message_cache_forget(conversation_id);
     }
 
     auto find_single_conversation(i64 user1, i64 user2) -> asio::awaitable<std::optional<i64>>
@@ -573,7 +591,7 @@ namespace database
         auto a = std::min(user1, user2);
         auto b = std::max(user1, user2);
 
-        auto conn_h = co_await acquire_connection();
+        auto conn_h = co_await acquire_handle();
         mysql::results r;
 
         co_await conn_h->async_execute(
@@ -598,16 +616,11 @@ namespace database
             co_return "";
         }
 
-        auto conn_h = co_await acquire_connection();
+        auto conn_h = co_await acquire_handle();
+        auto const stmt = co_await conn_h.prepare(StatementId::get_conversation_type);
         mysql::results r;
 
-        co_await conn_h->async_execute(
-            mysql::with_params(
-                "SELECT type FROM conversations WHERE id={} LIMIT 1",
-                conversation_id),
-            r,
-            asio::use_awaitable
-        );
+        co_await conn_h->async_execute(stmt.bind(conversation_id), r, asio::use_awaitable);
 
         if(r.rows().empty()) {
             co_return "";
@@ -621,18 +634,11 @@ namespace database
             co_return -1;
         }
 
-        auto conn_h = co_await acquire_connection();
+        auto conn_h = co_await acquire_handle();
+        auto const stmt = co_await conn_h.prepare(StatementId::get_single_peer_user_id);
         mysql::results r;
 
-        co_await conn_h->async_execute(
-            mysql::with_params(
-                "SELECT user_id FROM conversation_members"
-                " WHERE conversation_id={} AND user_id<>{} LIMIT 1",
-                conversation_id,
-                current_user_id),
-            r,
-            asio::use_awaitable
-        );
+        co_await conn_h->async_execute(stmt.bind(conversation_id, current_user_id), r, asio::use_awaitable);
 
         if(r.rows().empty()) {
             co_return -1;
@@ -647,7 +653,7 @@ namespace database
             co_return false;
         }
 
-        auto conn_h = co_await acquire_connection();
+        auto conn_h = co_await acquire_handle();
         mysql::results r;
 
         try {
@@ -668,19 +674,11 @@ namespace database
     auto update_last_read_seq(i64 user_id, i64 conversation_id, i64 seq)
         -> asio::awaitable<void>
     {
-        auto conn_h = co_await acquire_connection();
+        auto conn_h = co_await acquire_handle();
+        auto const stmt = co_await conn_h.prepare(StatementId::update_last_read_seq);
         mysql::results r;
 
-        co_await conn_h->async_execute(
-            mysql::with_params(
-                "UPDATE conversation_members SET last_read_seq = {}"
-                " WHERE conversation_id = {} AND user_id = {}",
-                seq,
-                conversation_id,
-                user_id),
-            r,
-            asio::use_awaitable
-        );
+        co_await conn_h->async_execute(stmt.bind(seq, conversation_id, user_id), r, asio::use_awaitable);
         co_return;
     }
 } // namespace database
@@ -19,22 +19,16 @@ namespace database
         if(user_id <= 0 || peer_id <= 0 || user_id == peer_id) {
             co_return false;
         }
-        auto conn_h = co_await acquire_connection();
+        auto conn_h = co_await acquire_handle();
+        auto const stmt = co_await conn_h.prepare(StatementId::is_friend);
         mysql::results r;
-        co_await conn_h->async_execute(
-            mysql::with_params(
-                "SELECT 1 FROM friends WHERE user_id={} AND friend_user_id={} LIMIT 1",
-                user_id,
-                peer_id),
-            r,
-            asio::use_awaitable
-        );
+        co_await conn_h->async_execute(stmt.bind(user_id, peer_id), r, asio::use_awaitable);
         co_return !r.rows().empty();
     }
 
-    auto load_user_friends(i64 user_id) -> asio::awaitable<std::vector<FriendInfo>>
+    auto load_user_friends(i64 user_id, Route route) -> asio::awaitable<std::vector<FriendInfo>>
     {
-        auto conn_h = co_await acquire_connection();
+        auto conn_h = co_await acquire_handle(route);
         mysql::results r;
         co_await conn_h->async_execute(
             mysql::with_params(
@@ -59,7 +53,7 @@ namespace database
         co_return result;
     }
 
-    auto search_friend_by_account(i64 current_user_id, std::string const& account)
+    auto search_friend_by_account(i64 current_user_id, std::string const& account, Route route)
         -> asio::awaitable<SearchFriendResult>
     {
         SearchFriendResult res{};
@@ -70,7 +64,7 @@ namespace database
             co_return res;
         }
 
-        auto conn_h = co_await acquire_connection();
+        auto conn_h = co_await acquire_handle(route);
         mysql::results r;
         co_await conn_h->async_execute(
             mysql::with_params(
@@ -97,6 +91,7 @@ namespace database
         res.user.display_name = row.at(2).as_string();
         res.user.avatar_path = row.at(3).is_null() ? "" : std::string(row.at(3).as_string());
         res.is_self = (current_user_id == target_id);
+        conn_h.reset();  // is_friend 自行借连接，先归还避免嵌套占用
         res.is_friend = !res.is_self && co_await is_friend(current_user_id, target_id);
         co_return res;
     }
@@ -117,11 +112,11 @@ namespace database
             co_return res;
         }
 
-        auto conn_h = co_await acquire_connection();
+        auto conn_h = co_await acquire_handle();
         mysql::results r;
 
         try {
-            co_await conn_h->async_execute("START TRANSACTION", r, asio::use_awaitable);
+            co_await conn_h.begin();
 
             // 用户存在性
             co_await conn_h->async_execute(
@@ -135,16 +130,24 @@ namespace database
                 res.ok = false;
                 res.error_code = "NOT_FOUND";
                 res.error_msg = "目标用户不存在";
-                co_await conn_h->async_execute("ROLLBACK", r, asio::use_awaitable);
+                co_await conn_h.rollback();
                 co_return res;
             }
 
-            // 已是好友
-            if(co_await is_friend(from_user_id, to_user_id)) {
+            // 已是好友（在同一事务连接上查询）
+            co_await conn_h->async_execute(
+                mysql::with_params(
+                    "SELECT 1 FROM friends WHERE user_id={} AND friend_user_id={} LIMIT 1",
+                    from_user_id,
+                    to_user_id),
+                r,
+                asio::use_awaitable
+            );
+            if(!r.rows().empty()) {
                 res.ok = false;
                 res.error_code = "ALREADY_FRIEND";
                 res.error_msg = "已是好友";
-                co_await conn_h->async_execute("ROLLBACK", r, asio::use_awaitable);
+                co_await conn_h.rollback();
                 co_return res;
             }
 
@@ -165,7 +168,7 @@ namespace database
                 res.ok = false;
                 res.error_code = "ALREADY_PENDING";
                 res.error_msg = "已存在待处理的好友申请";
-                co_await conn_h->async_execute("ROLLBACK", r, asio::use_awaitable);
+                co_await conn_h.rollback();
                 co_return res;
             }
 
@@ -185,7 +188,7 @@ namespace database
             res.ok = true;
             res.request_id = static_cast<i64>(r.last_insert_id());
 
-            co_await conn_h->async_execute("COMMIT", r, asio::use_awaitable);
+            co_await conn_h.commit();
             co_return res;
         } catch(std::exception const& ex) {
             res.ok = false;
@@ -197,7 +200,7 @@ namespace database
 
     auto load_incoming_friend_requests(i64 user_id) -> asio::awaitable<std::vector<FriendRequestInfo>>
     {
-        auto conn_h = co_await acquire_connection();
+        auto conn_h = co_await acquire_handle();
         mysql::results r;
 
         co_await conn_h->async_execute(
@@ -241,7 +244,7 @@ namespace database
             co_return res;
         }
 
-        auto conn_h = co_await acquire_connection();
+        auto conn_h = co_await acquire_handle();
         mysql::results r;
 
         i64 from_user_id{};
@@ -249,7 +252,7 @@ namespace database
         std::string status;
 
         try {
-            co_await conn_h->async_execute("START TRANSACTION", r, asio::use_awaitable);
+            co_await conn_h.begin();
 
             // 锁定申请
             co_await conn_h->async_execute(
@@ -265,7 +268,7 @@ namespace database
                 res.ok = false;
                 res.error_code = "NOT_FOUND";
                 res.error_msg = "好友申请不存在";
-                co_await conn_h->async_execute("ROLLBACK", r, asio::use_awaitable);
+                co_await conn_h.rollback();
                 co_return res;
             }
 
@@ -278,14 +281,14 @@ namespace database
                 res.ok = false;
                 res.error_code = "FORBIDDEN";
                 res.error_msg = "无权处理该好友申请";
-                co_await conn_h->async_execute("ROLLBACK", r, asio::use_awaitable);
+                co_await conn_h.rollback();
                 co_return res;
             }
             if(status != "PENDING") {
                 res.ok = false;
                 res.error_code = "INVALID_STATE";
                 res.error_msg = "好友申请状态已变更";
-                co_await conn_h->async_execute("ROLLBACK", r, asio::use_awaitable);
+                co_await conn_h.rollback();
                 co_return res;
             }
 
@@ -312,7 +315,7 @@ namespace database
                 asio::use_awaitable
             );
 
-            co_await conn_h->async_execute("COMMIT", r, asio::use_awaitable);
+            co_await conn_h.commit();
         } catch(std::exception const& ex) {
             res.ok = false;
             res.error_code = "SERVER_ERROR";
@@ -342,7 +345,8 @@ namespace database
             res.friend_user.id = from_user_id;
         }
 
-        // 确保单聊会话
+        // 确保单聊会话（先归还连接，get_or_create_single_conversation 会自行借用）
+        conn_h.reset();
         try {
             res.conversation_id = co_await get_or_create_single_conversation(from_user_id, to_user_id);
         } catch(std::exception const& ex) {
@@ -365,7 +369,7 @@ namespace database
             co_return res;
         }
 
-        auto conn_h = co_await acquire_connection();
+        auto conn_h = co_await acquire_handle();
         mysql::results r;
 
         // 查询申请详情
@@ -423,7 +427,7 @@ namespace database
             co_return false;
         }
 
-        auto conn_h = co_await acquire_connection();
+        auto conn_h = co_await acquire_handle();
         mysql::results r;
 
         // 删除双向好友关系
@@ -12,7 +12,7 @@ namespace mysql = boost::mysql;
 
 namespace database
 {
-    auto search_group_by_id(i64 current_user_id, i64 group_id)
+    auto search_group_by_id(i64 current_user_id, i64 group_id, Route route)
         -> asio::awaitable<SearchGroupResult>
     {
         SearchGroupResult res{};
@@ -23,7 +23,7 @@ namespace database
             co_return res;
         }
 
-        auto conn_h = co_await acquire_connection();
+        auto conn_h = co_await acquire_handle(route);
         mysql::results r;
 
         // 查询群聊信息（仅 GROUP 类型）
@@ -79,16 +79,16 @@ namespace database
             co_return res;
         }
 
-        auto conn_h = co_await acquire_connection();
+        auto conn_h = co_await acquire_handle();
         mysql::results r;
 
         try {
-            co_await conn_h->async_execute("START TRANSACTION", r, asio::use_awaitable);
+            co_await conn_h.begin();
 
             // 群聊存在性检查
             co_await conn_h->async_execute(
                 mysql::with_params(
-                    "SELECT 1 FROM conversations WHERE id = {} AND type = 'GROUP' LIMIT 1",
+                    "SELECT name FROM conversations WHERE id = {} AND type = 'GROUP' LIMIT 1",
                     group_id),
                 r,
                 asio::use_awaitable
@@ -97,9 +97,10 @@ namespace database
                 res.ok = false;
                 res.error_code = "NOT_FOUND";
                 res.error_msg = "群聊不存在";
-                co_await conn_h->async_execute("ROLLBACK", r, asio::use_awaitable);
+                co_await conn_h.rollback();
                 co_return res;
             }
+            res.group_name = r.rows().front().at(0).as_string();
 
             // 已是群成员
             co_await conn_h->async_execute(
@@ -114,7 +115,7 @@ namespace database
                 res.ok = false;
                 res.error_code = "ALREADY_MEMBER";
                 res.error_msg = "你已经是群成员";
-                co_await conn_h->async_execute("ROLLBACK", r, asio::use_awaitable);
+                co_await conn_h.rollback();
                 co_return res;
             }
 
@@ -132,7 +133,7 @@ namespace database
                 res.ok = false;
                 res.error_code = "ALREADY_PENDING";
                 res.error_msg = "已存在待处理的入群申请";
-                co_await conn_h->async_execute("ROLLBACK", r, asio::use_awaitable);
+                co_await conn_h.rollback();
                 co_return res;
             }
 
@@ -151,7 +152,7 @@ namespace database
             res.ok = true;
             res.request_id = static_cast<i64>(r.last_insert_id());
 
-            co_await conn_h->async_execute("COMMIT", r, asio::use_awaitable);
+            co_await conn_h.commit();
         } catch(std::exception const& ex) {
             // Note: Transaction will be rolled back automatically when connection is released
             res.ok = false;
@@ -164,7 +165,7 @@ namespace database
     auto load_group_join_requests_for_admin(i64 user_id)
         -> asio::awaitable<std::vector<GroupJoinRequestInfo>>
     {
-        auto conn_h = co_await acquire_connection();
+        auto conn_h = co_await acquire_handle();
         mysql::results r;
 
         // 查询当前用户作为群主或管理员的所有群聊的入群申请
@@ -214,7 +215,7 @@ namespace database
             co_return res;
         }
 
-        auto conn_h = co_await acquire_connection();
+        auto conn_h = co_await acquire_handle();
         mysql::results r;
 
         i64 from_user_id{};
@@ -222,7 +223,7 @@ namespace database
         std::string status;
 
         try {
-            co_await conn_h->async_execute("START TRANSACTION", r, asio::use_awaitable);
+            co_await conn_h.begin();
 
             // 锁定申请
             co_await conn_h->async_execute(
@@ -237,7 +238,7 @@ namespace database
                 res.ok = false;
                 res.error_code = "NOT_FOUND";
                 res.error_msg = "入群申请不存在";
-                co_await conn_h->async_execute("ROLLBACK", r, asio::use_awaitable);
+                co_await conn_h.rollback();
                 co_return res;
             }
 
@@ -260,7 +261,7 @@ namespace database
                 res.ok = false;
                 res.error_code = "NO_PERMISSION";
                 res.error_msg = "你不是该群成员";
-                co_await conn_h->async_execute("ROLLBACK", r, asio::use_awaitable);
+                co_await conn_h.rollback();
                 co_return res;
             }
 
@@ -269,7 +270,7 @@ namespace database
                 res.ok = false;
                 res.error_code = "NO_PERMISSION";
                 res.error_msg = "只有群主或管理员可以处理入群申请";
-                co_await conn_h->async_execute("ROLLBACK", r, asio::use_awaitable);
+                co_await conn_h.rollback();
                 co_return res;
             }
 
@@ -278,7 +279,7 @@ namespace database
                 res.ok = false;
                 res.error_code = "ALREADY_HANDLED";
                 res.error_msg = "该申请已被处理";
-                co_await conn_h->async_execute("ROLLBACK", r, asio::use_awaitable);
+                co_await conn_h.rollback();
                 co_return res;
             }
 
@@ -338,7 +339,7 @@ namespace database
             res.ok = true;
             res.group_id = group_id;
 
-            co_await conn_h->async_execute("COMMIT", r, asio::use_awaitable);
+            co_await conn_h.commit();
         } catch(std::exception const& ex) {
             // Note: Transaction will be rolled back automatically when connection is released
             res.ok = false;
@@ -351,7 +352,7 @@ namespace database
     auto get_group_admins(i64 group_id)
         -> asio::awaitable<std::vector<i64>>
     {
-        auto conn_h = co_await acquire_connection();
+        auto conn_h = co_await acquire_handle();
         mysql::results r;
 
         co_await conn_h->async_execute(
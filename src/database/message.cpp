@@ -1,6 +1,9 @@
 #include <database/message.h>
 #include <database/connection.h>
 #include <database/conversation.h>
+#include <database/sequence.h>
+#include <database/write_pipeline.h>
+#include <database/message_cache.h>
 #include <utility.h>
 
 #include <boost/mysql.hpp>
@@ -9,60 +12,147 @@
 #include <chrono>
 #include <stdexcept>
 #include <algorithm>
+#include <ranges>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 namespace asio = boost::asio;
 namespace mysql = boost::mysql;
 
 namespace database
 {
+    namespace
+    {
+        /// \brief 解析 (id, message_id, user_id, reaction_type, display_name) 形式的反应行。
+        auto parse_reactions(mysql::rows_view rows) -> std::vector<MessageReaction>
+        {
+            std::vector<MessageReaction> reactions;
+            reactions.reserve(rows.size());
+            for(auto const& row : rows) {
+                MessageReaction reaction{};
+                reaction.id = row.at(0).as_int64();
+                reaction.message_id = row.at(1).as_int64();
+                reaction.user_id = row.at(2).as_int64();
+                reaction.reaction_type = row.at(3).as_string();
+                reaction.display_name = row.at(4).as_string();
+                reactions.push_back(std::move(reaction));
+            }
+            return reactions;
+        }
+
+        /// \brief 在调用方已借出的连接上查询消息反应，避免持有连接时再向连接池借第二个。
+        auto query_message_reactions(ConnectionHandle& conn_h, i64 message_id)
+            -> asio::awaitable<std::vector<MessageReaction>>
+        {
+            auto const stmt = co_await conn_h.prepare(StatementId::message_reactions);
+            mysql::results r;
+            co_await conn_h->async_execute(stmt.bind(message_id), r, asio::use_awaitable);
+            co_return parse_reactions(r.rows());
+        }
+
+        /// \brief 一次查询加载一批消息的全部反应，按消息 ID 分组。
+        /// \details 使用 message_id IN (...) 命中 idx_message_reactions_msg，
+        ///          组内顺序与单条查询一致（按反应 ID 递增）。
+        auto query_reactions_for_messages(ConnectionHandle& conn_h, std::vector<i64> const& message_ids)
+            -> asio::awaitable<std::unordered_map<i64, std::vector<MessageReaction>>>
+        {
+            std::unordered_map<i64, std::vector<MessageReaction>> grouped;
+            if(message_ids.empty()) {
+                co_return grouped;
+            }
+
+            mysql::results r;
+            co_await conn_h->async_execute(
+                mysql::with_params(
+                    "SELECT mr.id, mr.message_id, mr.user_id, mr.reaction_type, u.display_name "
+                    "FROM message_reactions mr "
+                    "JOIN users u ON u.id = mr.user_id "
+                    "WHERE mr.message_id IN ({}) "
+                    "ORDER BY mr.message_id ASC, mr.id ASC",
+                    message_ids
+                ),
+                r,
+                asio::use_awaitable
+            );
+
+            for(auto& reaction : parse_reactions(r.rows())) {
+                grouped[reaction.message_id].push_back(std::move(reaction));
+            }
+            co_return grouped;
+        }
+
+        /// \brief 把历史查询的结果行转换为消息，并一次性加载整页消息的反应。
+        auto collect_loaded_messages(ConnectionHandle& conn_h, mysql::rows_view rows)
+            -> asio::awaitable<std::vector<LoadedMessage>>
+        {
+            std::vector<LoadedMessage> messages;
+            std::vector<i64> message_ids;
+            messages.reserve(rows.size());
+            message_ids.reserve(rows.size());
+            for(auto const& row : rows) {
+                LoadedMessage msg{};
+                msg.id = row.at(0).as_int64();
+                msg.conversation_id = row.at(1).as_int64();
+                msg.sender_id = row.at(2).as_int64();
+                msg.sender_display_name = row.at(3).as_string();
+                msg.seq = row.at(4).as_int64();
+                msg.msg_type = row.at(5).as_string();
+                msg.content = row.at(6).as_string();
+                msg.server_time_ms = row.at(7).as_int64();
+                msg.is_recalled = row.at(8).as_int64() != 0;
+                message_ids.push_back(msg.id);
+                messages.push_back(std::move(msg));
+            }
+
+            // 整页一次往返，而不是每条消息各查一次
+            auto reactions = co_await query_reactions_for_messages(conn_h, message_ids);
+            for(auto& msg : messages) {
+                if(auto it = reactions.find(msg.id); it != reactions.end()) {
+                    msg.reactions = std::move(it->second);
+                }
+            }
+            co_return messages;
+        }
+    } // namespace
+
     auto append_text_message(
         i64 conversation_id,
         i64 sender_id,
         std::string const& content,
-        std::string const& msg_type
+        std::string const& msg_type,
+        std::string const& sender_display_name
     ) -> asio::awaitable<StoredMessage>
     {
-        auto conn_h = co_await acquire_connection();
+        // seq 由内存分配器发放，取号后交给组提交管线，与其他会话的消息合并写入
+        auto const seq = co_await next_message_seq(conversation_id);
 
         auto now_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
                           std::chrono::system_clock::now().time_since_epoch())
                           .count();
 
-        // 使用原子性的 INSERT ... SELECT 避免并发 seq 冲突
-        mysql::results r;
-        co_await conn_h->async_execute(
-            mysql::with_params(
-                "INSERT INTO messages (conversation_id, sender_id, seq, msg_type, content, server_time_ms)"
-                " SELECT {}, {}, COALESCE(MAX(seq), 0) + 1, {}, {}, {}"
-                " FROM messages WHERE conversation_id = {}",
-                conversation_id,
-                sender_id,
-                msg_type,
-                content,
-                now_ms,
-                conversation_id),
-            r,
-            asio::use_awaitable
-        );
-
-        auto msg_id = static_cast<i64>(r.last_insert_id());
-
-        // 查询实际分配的 seq
-        co_await conn_h->async_execute(
-            mysql::with_params(
-                "SELECT seq FROM messages WHERE id = {}",
-                msg_id),
-            r,
-            asio::use_awaitable
-        );
-
-        i64 seq = 1;
-        if(!r.rows().empty()) {
-            auto const& fv = r.rows().front().at(0);
-            if(fv.is_int64()) {
-                seq = fv.as_int64();
-            } else if(fv.is_uint64()) {
-                seq = static_cast<i64>(fv.as_uint64());
-            }
+        auto msg_id = co_await enqueue_message_insert(PendingMessage{
+            .conversation_id = conversation_id,
+            .sender_id = sender_id,
+            .seq = seq,
+            .msg_type = msg_type,
+            .content = content,
+            .server_time_ms = now_ms,
+        });
+
+        if(sender_display_name.empty()) {
+            // 没有昵称就无法构造与数据库一致的缓存条目，直接丢弃该会话的缓存
+            message_cache_forget(conversation_id);
+        } else {
+            LoadedMessage cached{};
+            cached.id = msg_id;
+            cached.conversation_id = conversation_id;
+            cached.sender_id = sender_id;
+            cached.sender_display_name = sender_display_name;
+            cached.seq = seq;
+            cached.msg_type = msg_type;
+            cached.content = content;
+            cached.server_time_ms = now_ms;
+            message_cache_append(std::move(cached));
         }
 
         StoredMessage stored{};
@@ -77,130 +167,169 @@ namespace database
     auto append_world_text_message(
         i64 sender_id,
         std::string const& content,
-        std::string const& msg_type
+        std::string const& msg_type,
+        std::string const& sender_display_name
     ) -> asio::awaitable<StoredMessage>
     {
         auto conversation_id = co_await get_world_conversation_id();
-        co_return co_await append_text_message(conversation_id, sender_id, content, msg_type);
+        co_return co_await append_text_message(conversation_id, sender_id, content, msg_type, sender_display_name);
     }
 
-    auto load_user_conversation_history(i64 conversation_id, i64 before_seq, i64 limit)
+    auto load_user_conversation_history(i64 conversation_id, i64 before_seq, i64 limit, Route route)
         -> asio::awaitable<std::vector<LoadedMessage>>
     {
         if(limit <= 0) limit = 50;
 
-        auto conn_h = co_await acquire_connection();
-        mysql::results r;
-        if(before_seq > 0) {
-            co_await conn_h->async_execute(
-                mysql::with_params(
-                    "SELECT m.id, m.conversation_id, m.sender_id, u.display_name, m.seq, m.msg_type,"
-                    " m.content, m.server_time_ms "
-                    "FROM messages m JOIN users u ON u.id = m.sender_id "
-                    "WHERE m.conversation_id = {} AND m.seq < {} "
-                    "ORDER BY m.seq DESC LIMIT {}",
-                    conversation_id,
-                    before_seq,
-                    limit),
-                r,
-                asio::use_awaitable
-            );
-        } else {
-            co_await conn_h->async_execute(
-                mysql::with_params(
-                    "SELECT m.id, m.conversation_id, m.sender_id, u.display_name, m.seq, m.msg_type,"
-                    " m.content, m.server_time_ms "
-                    "FROM messages m JOIN users u ON u.id = m.sender_id "
-                    "WHERE m.conversation_id = {} "
-                    "ORDER BY m.seq DESC LIMIT {}",
-                    conversation_id,
-                    limit),
-                r,
-                asio::use_awaitable
-            );
+        if(auto cached = message_cache_history(conversation_id, before_seq, limit)) {
+            co_return std::move(*cached);
         }
 
+        // 最新一页未命中时顺带为该会话建立热消息缓存：多读到 ring_size 条
+        auto const prime = before_seq > 0 ? std::size_t{ 0 } : message_cache_begin_prime(conversation_id);
+        auto const fetch = std::max(limit, static_cast<i64>(prime));
+
         std::vector<LoadedMessage> messages;
-        messages.reserve(r.rows().size());
-
-        for(auto const& row : r.rows()) {
-            LoadedMessage msg{};
-            msg.id = row.at(0).as_int64();
-            msg.conversation_id = row.at(1).as_int64();
-            msg.sender_id = row.at(2).as_int64();
-            msg.sender_display_name = row.at(3).as_string();
-            msg.seq = row.at(4).as_int64();
-            msg.msg_type = row.at(5).as_string();
-            msg.content = row.at(6).as_string();
-            msg.server_time_ms = row.at(7).as_int64();
-            
-            // 加载该消息的反应
-            msg.reactions = co_await get_message_reactions(msg.id);
-            
-            messages.push_back(std::move(msg));
+        try {
+            // 缓存要求快照包含全部已写入消息，建立缓存时不能读可能滞后的副本
+            auto conn_h = co_await acquire_handle(prime > 0 ? Route::primary : route);
+            mysql::results r;
+            if(before_seq > 0) {
+                auto const stmt = co_await conn_h.prepare(StatementId::history_before);
+                co_await conn_h->async_execute(stmt.bind(conversation_id, before_seq, fetch), r, asio::use_awaitable);
+            } else {
+                auto const stmt = co_await conn_h.prepare(StatementId::history_latest);
+                co_await conn_h->async_execute(stmt.bind(conversation_id, fetch), r, asio::use_awaitable);
+            }
+
+            messages = co_await collect_loaded_messages(conn_h, r.rows());
+        } catch(...) {
+            if(prime > 0) {
+                message_cache_abort_prime(conversation_id);
+            }
+            throw;
         }
 
         // We queried in DESC order; return results sorted by seq ascending.
         std::reverse(messages.begin(), messages.end());
 
+        if(prime > 0) {
+            message_cache_finish_prime(conversation_id, messages, static_cast<std::size_t>(fetch));
+        }
+        if(static_cast<i64>(messages.size()) > limit) {
+            messages.erase(messages.begin(), messages.end() - limit);
+        }
+
         co_return messages;
     }
 
-    auto load_user_conversation_since(i64 conversation_id, i64 after_seq, i64 limit)
+    auto load_user_conversation_since(i64 conversation_id, i64 after_seq, i64 limit, Route route)
         -> asio::awaitable<std::vector<LoadedMessage>>
     {
         if(limit <= 0) limit = 100;
 
-        auto conn_h = co_await acquire_connection();
+        if(auto cached = message_cache_since(conversation_id, after_seq, limit)) {
+            co_return std::move(*cached);
+        }
+
+        auto conn_h = co_await acquire_handle(route);
         mysql::results r;
         if(after_seq > 0) {
-            co_await conn_h->async_execute(
-                mysql::with_params(
-                    "SELECT m.id, m.conversation_id, m.sender_id, u.display_name, m.seq, m.msg_type,"
-                    " m.content, m.server_time_ms "
-                    "FROM messages m JOIN users u ON u.id = m.sender_id "
-                    "WHERE m.conversation_id = {} AND m.seq > {} "
-                    "ORDER BY m.seq ASC LIMIT {}",
-                    conversation_id,
-                    after_seq,
-                    limit),
-                r,
-                asio::use_awaitable
+            auto const stmt = co_await conn_h.prepare(StatementId::history_since);
+            co_await conn_h->async_execute(stmt.bind(conversation_id, after_seq, limit), r, asio::use_awaitable);
+        } else {
+            auto const stmt = co_await conn_h.prepare(StatementId::history_since_start);
+            co_await conn_h->async_execute(stmt.bind(conversation_id, limit), r, asio::use_awaitable);
+        }
+
+        co_return co_await collect_loaded_messages(conn_h, r.rows());
+    }
+
+    auto load_conversations_since(i64 user_id, std::vector<SyncCursor> const& cursors, i64 limit, Route route)
+        -> asio::awaitable<std::vector<SyncedConversation>>
+    {
+        if(limit <= 0) limit = 100;
+
+        std::vector<SyncedConversation> synced;
+        if(user_id <= 0 || cursors.empty()) {
+            co_return synced;
+        }
+
+        // 先查热消息缓存，缓存不能覆盖的会话再合并查询数据库
+        std::unordered_map<i64, std::vector<LoadedMessage>> found;
+        std::vector<SyncCursor> misses;
+        std::vector<i64> conversation_ids;
+        conversation_ids.reserve(cursors.size());
+        for(auto const& cursor : cursors) {
+            conversation_ids.push_back(cursor.conversation_id);
+            if(auto cached = message_cache_since(cursor.conversation_id, cursor.after_seq, limit)) {
+                if(!cached->empty()) {
+                    found.emplace(cursor.conversation_id, std::move(*cached));
+                }
+            } else {
+                misses.push_back(cursor);
+            }
+        }
+
+        // 一次往返：请求者所在的会话，以及每个未命中会话各自的 (conversation_id, seq) 范围查询
+        auto conn_h = co_await acquire_handle(route);
+        mysql::results r;
+        if(misses.empty()) {
+            r = co_await execute_batch(
+                conn_h,
+                "SELECT conversation_id FROM conversation_members WHERE user_id = {} AND conversation_id IN ({})",
+                user_id,
+                conversation_ids
             );
         } else {
-            co_await conn_h->async_execute(
-                mysql::with_params(
-                    "SELECT m.id, m.conversation_id, m.sender_id, u.display_name, m.seq, m.msg_type,"
-                    " m.content, m.server_time_ms "
-                    "FROM messages m JOIN users u ON u.id = m.sender_id "
-                    "WHERE m.conversation_id = {} "
-                    "ORDER BY m.seq ASC LIMIT {}",
-                    conversation_id,
-                    limit),
-                r,
-                asio::use_awaitable
+            auto const ranges = mysql::sequence(
+                std::move(misses),
+                [limit](SyncCursor const& cursor, mysql::format_context_base& ctx) {
+                    mysql::format_sql_to(
+                        ctx,
+                        "(SELECT m.id, m.conversation_id, m.sender_id, u.display_name, m.seq, m.msg_type,"
+                        " m.content, m.server_time_ms, m.is_recalled "
+                        "FROM messages m JOIN users u ON u.id = m.sender_id "
+                        "WHERE m.conversation_id = {} AND m.seq > {} "
+                        "ORDER BY m.seq ASC LIMIT {})",
+                        cursor.conversation_id,
+                        cursor.after_seq,
+                        limit
+                    );
+                },
+                " UNION ALL "
+            );
+            r = co_await execute_batch(
+                conn_h,
+                "SELECT conversation_id FROM conversation_members WHERE user_id = {} AND conversation_id IN ({}); {}",
+                user_id,
+                conversation_ids,
+                ranges
             );
+
+            // UNION ALL 不保证各分支的行序，按会话分组后再按 seq 排序
+            for(auto& msg : co_await collect_loaded_messages(conn_h, r.at(1).rows())) {
+                found[msg.conversation_id].push_back(std::move(msg));
+            }
+            for(auto& messages : found | std::views::values) {
+                std::ranges::sort(messages, {}, &LoadedMessage::seq);
+            }
         }
 
-        std::vector<LoadedMessage> messages;
-        messages.reserve(r.rows().size());
-        for(auto const& row : r.rows()) {
-            LoadedMessage msg{};
-            msg.id = row.at(0).as_int64();
-            msg.conversation_id = row.at(1).as_int64();
-            msg.sender_id = row.at(2).as_int64();
-            msg.sender_display_name = row.at(3).as_string();
-            msg.seq = row.at(4).as_int64();
-            msg.msg_type = row.at(5).as_string();
-            msg.content = row.at(6).as_string();
-            msg.server_time_ms = row.at(7).as_int64();
-            
-            // 加载该消息的反应
-            msg.reactions = co_await get_message_reactions(msg.id);
-            
-            messages.push_back(std::move(msg));
+        std::unordered_set<i64> members;
+        for(auto const& row : r.at(0).rows()) {
+            members.insert(row.at(0).as_int64());
         }
-        co_return messages;
+
+        for(auto const& cursor : cursors) {
+            if(!members.contains(cursor.conversation_id)) {
+                continue;
+            }
+            if(auto it = found.find(cursor.conversation_id); it != found.end()) {
+                synced.push_back({ cursor.conversation_id, std::move(it->second) });
+                found.erase(it);
+            }
+        }
+        co_return synced;
     }
 
     auto load_world_history(i64 before_seq, i64 limit) -> asio::awaitable<std::vector<LoadedMessage>>
@@ -211,19 +340,20 @@ namespace database
 
     auto recall_message(i64 message_id, i64 recaller_id) -> asio::awaitable<RecallMessageResult>
     {
-        auto conn_h = co_await acquire_connection();
-        
-        // 1. 查询消息是否存在及所属会话
-        mysql::results r_msg;
-        co_await conn_h->async_execute(
-            mysql::with_params(
-                "SELECT conversation_id, sender_id FROM messages WHERE id = {}",
-                message_id),
-            r_msg,
-            asio::use_awaitable
+        auto conn_h = co_await acquire_handle();
+
+        // 三条语句互不依赖，一次往返：消息所属会话、撤回者昵称、设置 is_recalled 标记。
+        // 消息不存在时 UPDATE 不影响任何行
+        auto const r = co_await execute_batch(
+            conn_h,
+            "SELECT conversation_id, sender_id FROM messages WHERE id = {0}; "
+            "SELECT display_name FROM users WHERE id = {1}; "
+            "UPDATE messages SET is_recalled = TRUE WHERE id = {0}",
+            message_id,
+            recaller_id
         );
 
-        if(r_msg.rows().empty()) {
+        if(r.at(0).rows().empty()) {
             RecallMessageResult result{};
             result.ok = false;
             result.error_code = "MESSAGE_NOT_FOUND";
@@ -231,31 +361,10 @@ namespace database
             co_return result;
         }
 
-        auto row = r_msg.rows().at(0);
-        auto conversation_id = row.at(0).as_int64();
-        auto sender_id = row.at(1).as_int64();
-
-        // 2. 查询撤回者昵称
-        mysql::results r_user;
-        co_await conn_h->async_execute(
-            mysql::with_params(
-                "SELECT display_name FROM users WHERE id = {}",
-                recaller_id),
-            r_user,
-            asio::use_awaitable
-        );
-
-        std::string recaller_name = r_user.rows().empty() ? "" : r_user.rows().at(0).at(0).as_string();
+        auto conversation_id = r.at(0).rows().at(0).at(0).as_int64();
+        std::string recaller_name = r.at(1).rows().empty() ? "" : r.at(1).rows().at(0).at(0).as_string();
 
-        // 3. 设置消息的 is_recalled 标记
-        mysql::results r_update;
-        co_await conn_h->async_execute(
-            mysql::with_params(
-                "UPDATE messages SET is_recalled = TRUE WHERE id = {}",
-                message_id),
-            r_update,
-            asio::use_awaitable
-        );
+        message_cache_recall(conversation_id, message_id);
 
         RecallMessageResult result{};
         result.ok = true;
@@ -269,19 +378,25 @@ namespace database
     auto add_message_reaction(i64 message_id, i64 user_id, std::string const& reaction_type)
         -> asio::awaitable<MessageReactionResult>
     {
-        auto conn_h = co_await acquire_connection();
-
-        // 1. 查询消息所属会话
-        mysql::results r_msg;
-        co_await conn_h->async_execute(
-            mysql::with_params(
-                "SELECT conversation_id FROM messages WHERE id = {}",
-                message_id),
-            r_msg,
-            asio::use_awaitable
+        auto conn_h = co_await acquire_handle();
+
+        // 一次往返：消息所属会话、插入或更新反应、该消息的全部反应。
+        // INSERT ... SELECT 在消息不存在时不插入任何行，因此无需先确认消息存在
+        auto const r = co_await execute_batch(
+            conn_h,
+            "SELECT conversation_id FROM messages WHERE id = {0}; "
+            "INSERT INTO message_reactions (message_id, user_id, reaction_type) "
+            "SELECT id, {1}, {2} FROM messages WHERE id = {0} "
+            "ON DUPLICATE KEY UPDATE reaction_type = {2}; "
+            "SELECT mr.id, mr.message_id, mr.user_id, mr.reaction_type, u.display_name "
+            "FROM message_reactions mr JOIN users u ON u.id = mr.user_id "
+            "WHERE mr.message_id = {0} ORDER BY mr.id ASC",
+            message_id,
+            user_id,
+            reaction_type
         );
 
-        if(r_msg.rows().empty()) {
+        if(r.at(0).rows().empty()) {
             MessageReactionResult result{};
             result.ok = false;
             result.error_code = "MESSAGE_NOT_FOUND";
@@ -289,25 +404,9 @@ namespace database
             co_return result;
         }
 
-        auto conversation_id = r_msg.rows().at(0).at(0).as_int64();
-
-        // 2. 插入或更新反应 (使用 INSERT ... ON DUPLICATE KEY UPDATE)
-        mysql::results r_insert;
-        co_await conn_h->async_execute(
-            mysql::with_params(
-                "INSERT INTO message_reactions (message_id, user_id, reaction_type) "
-                "VALUES ({}, {}, {}) "
-                "ON DUPLICATE KEY UPDATE reaction_type = {}",
-                message_id,
-                user_id,
-                reaction_type,
-                reaction_type),
-            r_insert,
-            asio::use_awaitable
-        );
-
-        // 3. 查询该消息的所有反应
-        auto reactions = co_await get_message_reactions(message_id);
+        auto conversation_id = r.at(0).rows().at(0).at(0).as_int64();
+        auto reactions = parse_reactions(r.at(2).rows());
+        message_cache_set_reactions(conversation_id, message_id, reactions);
 
         MessageReactionResult result{};
         result.ok = true;
@@ -320,19 +419,22 @@ namespace database
     auto remove_message_reaction(i64 message_id, i64 user_id, std::string const& reaction_type)
         -> asio::awaitable<MessageReactionResult>
     {
-        auto conn_h = co_await acquire_connection();
-
-        // 1. 查询消息所属会话
-        mysql::results r_msg;
-        co_await conn_h->async_execute(
-            mysql::with_params(
-                "SELECT conversation_id FROM messages WHERE id = {}",
-                message_id),
-            r_msg,
-            asio::use_awaitable
+        auto conn_h = co_await acquire_handle();
+
+        // 一次往返：消息所属会话、删除反应、该消息的全部反应
+        auto const r = co_await execute_batch(
+            conn_h,
+            "SELECT conversation_id FROM messages WHERE id = {0}; "
+            "DELETE FROM message_reactions WHERE message_id = {0} AND user_id = {1} AND reaction_type = {2}; "
+            "SELECT mr.id, mr.message_id, mr.user_id, mr.reaction_type, u.display_name "
+            "FROM message_reactions mr JOIN users u ON u.id = mr.user_id "
+            "WHERE mr.message_id = {0} ORDER BY mr.id ASC",
+            message_id,
+            user_id,
+            reaction_type
         );
 
-        if(r_msg.rows().empty()) {
+        if(r.at(0).rows().empty()) {
             MessageReactionResult result{};
             result.ok = false;
             result.error_code = "MESSAGE_NOT_FOUND";
@@ -340,22 +442,9 @@ namespace database
             co_return result;
         }
 
-        auto conversation_id = r_msg.rows().at(0).at(0).as_int64();
-
-        // 2. 删除反应
-        mysql::results r_delete;
-        co_await conn_h->async_execute(
-            mysql::with_params(
-                "DELETE FROM message_reactions WHERE message_id = {} AND user_id = {} AND reaction_type = {}",
-                message_id,
-                user_id,
-                reaction_type),
-            r_delete,
-            asio::use_awaitable
-        );
-
-        // 3. 查询该消息的所有反应
-        auto reactions = co_await get_message_reactions(message_id);
+        auto conversation_id = r.at(0).rows().at(0).at(0).as_int64();
+        auto reactions = parse_reactions(r.at(2).rows());
+        message_cache_set_reactions(conversation_id, message_id, reactions);
 
         MessageReactionResult result{};
         result.ok = true;
@@ -367,32 +456,7 @@ namespace database
 
     auto get_message_reactions(i64 message_id) -> asio::awaitable<std::vector<MessageReaction>>
     {
-        auto conn_h = co_await acquire_connection();
-
-        mysql::results r;
-        co_await conn_h->async_execute(
-            mysql::with_params(
-                "SELECT mr.id, mr.message_id, mr.user_id, mr.reaction_type, u.display_name "
-                "FROM message_reactions mr "
-                "JOIN users u ON u.id = mr.user_id "
-                "WHERE mr.message_id = {} "
-                "ORDER BY mr.id ASC",
-                message_id),
-            r,
-            asio::use_awaitable
-        );
-
-        std::vector<MessageReaction> reactions;
-        reactions.reserve(r.rows().size());
-        for(auto const& row : r.rows()) {
-            MessageReaction reaction{};
-            reaction.id = row.at(0).as_int64();
-            reaction.message_id = row.at(1).as_int64();
-            reaction.user_id = row.at(2).as_int64();
-            reaction.reaction_type = row.at(3).as_string();
-            reaction.display_name = row.at(4).as_string();
-            reactions.push_back(std::move(reaction));
-        }
-        co_return reactions;
+        auto conn_h = co_await acquire_handle();
+        co_return co_await query_message_reactions(conn_h, message_id);
     }
 } // namespace database
@@ -0,0 +1,380 @@
+#include <database/message_cache.h>
+
+#include <algorithm>
+#include <deque>
+#include <iterator>
+#include <list>
+#include <mutex>
+#include <ranges>
+#include <unordered_map>
+
+namespace database
+{
+    namespace
+    {
+        /// \brief 单个会话的最新消息，按 seq 递增排列。
+        /// \details 不变式：缓存包含该会话 seq > floor_seq 的全部已写入消息；floor_seq 为 0 表示覆盖全部历史。
+        struct Ring
+        {
+            std::deque<LoadedMessage> messages{};
+            i64 floor_seq{ 0 };
+            std::size_t bytes{ 0 };
+            std::list<i64>::iterator lru{};
+        };
+
+        /// \brief 正在从数据库建立缓存的会话。
+        struct Priming
+        {
+            /// \brief 读取期间写入的新消息，建立时合并。
+            std::vector<LoadedMessage> appended{};
+            /// \brief 读取期间有撤回、反应或改名，读出的快照可能已过期。
+            bool dirty{ false };
+        };
+
+        struct CacheState
+        {
+            MessageCacheConfig cfg{};
+            std::unordered_map<i64, Ring> rings;
+            std::unordered_map<i64, Priming> priming;
+            /// \brief 会话访问顺序，表头为最近访问。
+            std::list<i64> lru;
+            std::size_t bytes{ 0 };
+            std::size_t messages{ 0 };
+            /// \brief 全局单调递增的变更序号，会话版本号取自该序号。
+            u64 generation{ 0 };
+            /// \brief 各会话最近一次变更时的序号，会话被淘汰或丢弃时移除。
+            std::unordered_map<i64, u64> versions;
+            /// \brief 已移除条目的最大序号，没有条目的会话以它为版本号，保证版本号单调。
+            u64 version_floor{ 0 };
+            /// \brief 最近一次改名时的序号，改名可能影响任意会话。
+            u64 rename_generation{ 0 };
+            MessageCacheStats stats{};
+            std::mutex mutex;
+        };
+
+        CacheState& state()
+        {
+            static CacheState s{};
+            return s;
+        }
+
+        /// \brief 估算一条消息占用的内存。
+        auto message_bytes(LoadedMessage const& msg) -> std::size_t
+        {
+            auto bytes = sizeof(LoadedMessage) + msg.sender_display_name.size() + msg.msg_type.size() + msg.content.size();
+            for(auto const& r : msg.reactions) {
+                bytes += sizeof(MessageReaction) + r.reaction_type.size() + r.display_name.size();
+            }
+            return bytes;
+        }
+
+        /// \brief 不对应任何缓存会话的版本条目上限，超出时整体清理。
+        constexpr std::size_t MAX_UNTRACKED_VERSIONS = 1 << 16;
+
+        /// \brief 移除会话的版本条目，其序号并入 version_floor。
+        auto drop_version(CacheState& st, i64 conversation_id) -> void
+        {
+            if(auto it = st.versions.find(conversation_id); it != st.versions.end()) {
+                st.version_floor = std::max(st.version_floor, it->second);
+                st.versions.erase(it);
+            }
+        }
+
+        auto touch(CacheState& st, Ring& ring) -> void
+        {
+            st.lru.splice(st.lru.begin(), st.lru, ring.lru);
+        }
+
+        auto erase_ring(CacheState& st, std::unordered_map<i64, Ring>::iterator it) -> void
+        {
+            st.bytes -= it->second.bytes;
+            st.messages -= it->second.messages.size();
+            st.lru.erase(it->second.lru);
+            drop_version(st, it->first);
+            st.rings.erase(it);
+        }
+
+        /// \brief 超出内存上限时从最久未访问的会话开始淘汰。
+        auto enforce_limit(CacheState& st) -> void
+        {
+            while(st.bytes > st.cfg.max_bytes && !st.lru.empty()) {
+                erase_ring(st, st.rings.find(st.lru.back()));
+                ++st.stats.evictions;
+            }
+        }
+
+        /// \brief 按 seq 插入一条消息，超出 ring_size 时丢弃最旧的并抬高 floor_seq。
+        auto insert_message(CacheState& st, Ring& ring, LoadedMessage msg) -> void
+        {
+            if(msg.seq <= ring.floor_seq) {
+                return;
+            }
+            // 新消息几乎总是最新的，从尾部向前找插入位置
+            auto pos = ring.messages.end();
+            while(pos != ring.messages.begin() && std::prev(pos)->seq > msg.seq) {
+                --pos;
+            }
+            if(pos != ring.messages.begin() && std::prev(pos)->seq == msg.seq) {
+                return;
+            }
+
+            auto const bytes = message_bytes(msg);
+            ring.messages.insert(pos, std::move(msg));
+            ring.bytes += bytes;
+            st.bytes += bytes;
+            ++st.messages;
+
+            while(ring.messages.size() > st.cfg.ring_size) {
+                auto const& oldest = ring.messages.front();
+                auto const oldest_bytes = message_bytes(oldest);
+                ring.floor_seq = oldest.seq;
+                ring.bytes -= oldest_bytes;
+                st.bytes -= oldest_bytes;
+                --st.messages;
+                ring.messages.pop_front();
+            }
+        }
+
+        auto bump_version(CacheState& st, i64 conversation_id) -> void
+        {
+            st.versions[conversation_id] = ++st.generation;
+            // 未缓存的会话也有写入，条目过多时清理既无缓存也不在建立中的会话
+            if(st.versions.size() > st.rings.size() + st.priming.size() + MAX_UNTRACKED_VERSIONS) {
+                std::erase_if(st.versions, [&](auto const& entry) {
+                    auto const [id, version] = entry;
+                    if(id == conversation_id || st.rings.contains(id) || st.priming.contains(id)) {
+                        return false;
+                    }
+                    st.version_floor = std::max(st.version_floor, version);
+                    return true;
+                });
+            }
+        }
+
+        /// \brief 就地修改缓存中的一条消息并重新计算占用。
+        template<typename Fn>
+        auto update_message(CacheState& st, i64 conversation_id, i64 message_id, Fn fn) -> void
+        {
+            bump_version(st, conversation_id);
+            if(auto p = st.priming.find(conversation_id); p != st.priming.end()) {
+                p->second.dirty = true;
+            }
+            auto it = st.rings.find(conversation_id);
+            if(it == st.rings.end()) {
+                return;
+            }
+            auto& ring = it->second;
+            auto msg = std::ranges::find(ring.messages, message_id, &LoadedMessage::id);
+            if(msg == ring.messages.end()) {
+                return;
+            }
+            auto const before = message_bytes(*msg);
+            fn(*msg);
+            auto const after = message_bytes(*msg);
+            ring.bytes = ring.bytes - before + after;
+            st.bytes = st.bytes - before + after;
+        }
+    } // namespace
+
+    auto set_message_cache_config(MessageCacheConfig cfg) -> void
+    {
+        auto& st = state();
+        std::lock_guard lock{ st.mutex };
+        st.cfg = cfg;
+        enforce_limit(st);
+    }
+
+    auto message_cache_stats() -> MessageCacheStats
+    {
+        auto& st = state();
+        std::lock_guard lock{ st.mutex };
+        auto stats = st.stats;
+        stats.conversations = st.rings.size();
+        stats.messages = st.messages;
+        stats.bytes = st.bytes;
+        return stats;
+    }
+
+    auto message_cache_history(i64 conversation_id, i64 before_seq, i64 limit)
+        -> std::optional<std::vector<LoadedMessage>>
+    {
+        auto& st = state();
+        std::lock_guard lock{ st.mutex };
+        auto it = st.rings.find(conversation_id);
+        if(it == st.rings.end() || limit <= 0) {
+            ++st.stats.misses;
+            return std::nullopt;
+        }
+
+        auto& ring = it->second;
+        auto const end = before_seq > 0
+            ? std::ranges::lower_bound(ring.messages, before_seq, {}, &LoadedMessage::seq)
+            : ring.messages.end();
+        auto const available = end - ring.messages.begin();
+        // 不足 limit 条时，只有缓存覆盖了全部历史才能确定没有更早的消息
+        if(available < limit && ring.floor_seq > 0) {
+            ++st.stats.misses;
+            return std::nullopt;
+        }
+
+        ++st.stats.hits;
+        touch(st, ring);
+        return std::vector<LoadedMessage>(end - std::min<std::ptrdiff_t>(available, limit), end);
+    }
+
+    auto message_cache_since(i64 conversation_id, i64 after_seq, i64 limit)
+        -> std::optional<std::vector<LoadedMessage>>
+    {
+        auto& st = state();
+        std::lock_guard lock{ st.mutex };
+        auto it = st.rings.find(conversation_id);
+        if(it == st.rings.end() || limit <= 0 || std::max<i64>(after_seq, 0) < it->second.floor_seq) {
+            ++st.stats.misses;
+            return std::nullopt;
+        }
+
+        auto& ring = it->second;
+        auto const begin = std::ranges::upper_bound(ring.messages, after_seq, {}, &LoadedMessage::seq);
+        auto const available = ring.messages.end() - begin;
+
+        ++st.stats.hits;
+        touch(st, ring);
+        return std::vector<LoadedMessage>(begin, begin + std::min<std::ptrdiff_t>(available, limit));
+    }
+
+    auto message_cache_begin_prime(i64 conversation_id) -> std::size_t
+    {
+        auto& st = state();
+        std::lock_guard lock{ st.mutex };
+        if(st.cfg.ring_size == 0 || st.rings.contains(conversation_id) || st.priming.contains(conversation_id)) {
+            return 0;
+        }
+        st.priming.emplace(conversation_id, Priming{});
+        return st.cfg.ring_size;
+    }
+
+    auto message_cache_finish_prime(i64 conversation_id, std::vector<LoadedMessage> const& latest, std::size_t requested)
+        -> void
+    {
+        auto& st = state();
+        std::lock_guard lock{ st.mutex };
+        auto p = st.priming.find(conversation_id);
+        if(p == st.priming.end()) {
+            return;
+        }
+        auto priming = std::move(p->second);
+        st.priming.erase(p);
+        if(priming.dirty || st.rings.contains(conversation_id)) {
+            return;
+        }
+
+        st.lru.push_front(conversation_id);
+        auto& ring = st.rings[conversation_id];
+        ring.lru = st.lru.begin();
+        // 读满 requested 条说明更早还有消息，缓存只覆盖读到的最旧一条之后
+        ring.floor_seq = latest.size() < requested ? 0 : latest.front().seq - 1;
+        for(auto const& msg : latest) {
+            insert_message(st, ring, msg);
+        }
+        for(auto& msg : priming.appended) {
+            insert_message(st, ring, std::move(msg));
+        }
+        enforce_limit(st);
+    }
+
+    auto message_cache_abort_prime(i64 conversation_id) -> void
+    {
+        auto& st = state();
+        std::lock_guard lock{ st.mutex };
+        st.priming.erase(conversation_id);
+    }
+
+    auto message_cache_append(LoadedMessage msg) -> void
+    {
+        auto& st = state();
+        std::lock_guard lock{ st.mutex };
+        bump_version(st, msg.conversation_id);
+        if(auto p = st.priming.find(msg.conversation_id); p != st.priming.end()) {
+            p->second.appended.push_back(std::move(msg));
+            return;
+        }
+        auto it = st.rings.find(msg.conversation_id);
+        if(it == st.rings.end()) {
+            return;
+        }
+        insert_message(st, it->second, std::move(msg));
+        touch(st, it->second);
+        enforce_limit(st);
+    }
+
+    auto message_cache_recall(i64 conversation_id, i64 message_id) -> void
+    {
+        auto& st = state();
+        std::lock_guard lock{ st.mutex };
+        update_message(st, conversation_id, message_id, [](LoadedMessage& msg) {
+            msg.is_recalled = true;
+        });
+    }
+
+    auto message_cache_set_reactions(i64 conversation_id, i64 message_id, std::vector<MessageReaction> reactions)
+        -> void
+    {
+        auto& st = state();
+        std::lock_guard lock{ st.mutex };
+        update_message(st, conversation_id, message_id, [&](LoadedMessage& msg) {
+            msg.reactions = std::move(reactions);
+        });
+        enforce_limit(st);
+    }
+
+    auto message_cache_rename_user(i64 user_id, std::string const& display_name) -> void
+    {
+        auto& st = state();
+        std::lock_guard lock{ st.mutex };
+        st.rename_generation = ++st.generation;
+        for(auto& priming : st.priming | std::views::values) {
+            priming.dirty = true;
+        }
+        for(auto& ring : st.rings | std::views::values) {
+            for(auto& msg : ring.messages) {
+                auto const before = message_bytes(msg);
+                if(msg.sender_id == user_id) {
+                    msg.sender_display_name = display_name;
+                }
+                for(auto& r : msg.reactions) {
+                    if(r.user_id == user_id) {
+                        r.display_name = display_name;
+                    }
+                }
+                auto const after = message_bytes(msg);
+                ring.bytes = ring.bytes - before + after;
+                st.bytes = st.bytes - before + after;
+            }
+        }
+        enforce_limit(st);
+    }
+
+    auto message_cache_forget(i64 conversation_id) -> void
+    {
+        auto& st = state();
+        std::lock_guard lock{ st.mutex };
+        bump_version(st, conversation_id);
+        if(auto p = st.priming.find(conversation_id); p != st.priming.end()) {
+            p->second.dirty = true;
+        }
+        if(auto it = st.rings.find(conversation_id); it != st.rings.end()) {
+            erase_ring(st, it);
+        }
+        // 丢弃后不再需要单独的条目，上面的变更序号已并入 version_floor
+        drop_version(st, conversation_id);
+    }
+
+    auto message_cache_version(i64 conversation_id) -> u64
+    {
+        auto& st = state();
+        std::lock_guard lock{ st.mutex };
+        auto const it = st.versions.find(conversation_id);
+        auto const version = it == st.versions.end() ? st.version_floor : it->second;
+        return std::max(version, st.rename_generation);
+    }
+} // namespace database
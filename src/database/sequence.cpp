@@ -0,0 +1,186 @@
+#include <database/sequence.h>
+#include <database/connection.h>
+
+#include <boost/mysql.hpp>
+#include <boost/asio/use_awaitable.hpp>
+#include <boost/asio/redirect_error.hpp>
+#include <boost/asio/this_coro.hpp>
+#include <boost/asio/experimental/concurrent_channel.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+namespace asio = boost::asio;
+namespace mysql = boost::mysql;
+
+namespace database
+{
+    namespace
+    {
+        using clock = std::chrono::steady_clock;
+
+        /// \brief 冷会话每次预留的序列号数量。
+        constexpr i64 MIN_BLOCK = 32;
+        /// \brief 热点会话（如世界频道）块大小的上限。
+        constexpr i64 MAX_BLOCK = 4096;
+        /// \brief 上一块在该时间内耗尽即视为热点，下一块翻倍。
+        constexpr auto HOT_REFILL_INTERVAL = std::chrono::seconds{ 1 };
+
+        /// \brief 等待其他协程回源新块的协程。
+        struct Waiter
+        {
+            explicit Waiter(asio::any_io_executor exec)
+                : signal(std::move(exec), 1)
+            {}
+
+            asio::experimental::concurrent_channel<void(boost::system::error_code)> signal;
+        };
+
+        /// \brief 单个会话的内存计数器：[next, limit) 为已预留、尚未发放的区间。
+        struct SequenceState
+        {
+            i64 next{ 0 };
+            i64 limit{ 0 };
+            i64 block{ 0 };
+            clock::time_point last_refill{};
+            /// \brief 本进程是否已按 messages 校准过 conversation_sequences。
+            bool synced{ false };
+            /// \brief 是否已有协程在回源，其余协程进入 waiters 等待。
+            bool refilling{ false };
+            std::vector<std::shared_ptr<Waiter>> waiters{};
+        };
+
+        struct SequenceRegistry
+        {
+            std::mutex mutex;
+            std::unordered_map<i64, SequenceState> states;
+        };
+
+        SequenceRegistry& registry()
+        {
+            static SequenceRegistry r{};
+            return r;
+        }
+
+        /// \brief 计算下一块大小：上一块很快耗尽则翻倍，否则回落到最小值。
+        auto next_block_size(SequenceState& st) -> i64
+        {
+            if(st.block > 0 && clock::now() - st.last_refill < HOT_REFILL_INTERVAL) {
+                st.block = std::min(st.block * 2, MAX_BLOCK);
+            } else {
+                st.block = MIN_BLOCK;
+            }
+            return st.block;
+        }
+
+        /// \brief 在 conversation_sequences 中预留 count 个序列号，返回区间起点。
+        /// \param sync 是否先按 messages 的 MAX(seq) 校准（本进程首次触达该会话时）。
+        auto reserve_block(i64 conversation_id, i64 count, bool sync) -> asio::awaitable<i64>
+        {
+            auto conn_h = co_await acquire_handle();
+            mysql::results r;
+            if(sync) {
+                auto const stmt = co_await conn_h.prepare(StatementId::sequence_sync);
+                co_await conn_h->async_execute(stmt.bind(conversation_id, conversation_id), r, asio::use_awaitable);
+            }
+
+            // LAST_INSERT_ID(expr) 让 UPDATE 在 OK 包里带回更新后的 next_seq，一次往返完成预留
+            auto const stmt = co_await conn_h.prepare(StatementId::sequence_reserve);
+            co_await conn_h->async_execute(stmt.bind(count, conversation_id), r, asio::use_awaitable);
+            if(r.affected_rows() == 0) {
+                throw std::runtime_error{ "conversation sequence row missing" };
+            }
+            co_return static_cast<i64>(r.last_insert_id()) - count;
+        }
+
+        auto wake_all(std::vector<std::shared_ptr<Waiter>> waiters) -> void
+        {
+            for(auto const& waiter : waiters) {
+                waiter->signal.try_send(boost::system::error_code{});
+            }
+        }
+    }
+
+    auto next_message_seq(i64 conversation_id) -> asio::awaitable<i64>
+    {
+        auto& reg = registry();
+        auto const exec = co_await asio::this_coro::executor;
+
+        while(true) {
+            std::shared_ptr<Waiter> waiter;
+            i64 count = 0;
+            bool sync = false;
+            {
+                std::lock_guard lock{ reg.mutex };
+                auto& st = reg.states[conversation_id];
+                if(st.next < st.limit) {
+                    co_return st.next++;
+                }
+                if(st.refilling) {
+                    waiter = std::make_shared<Waiter>(exec);
+                    st.waiters.push_back(waiter);
+                } else {
+                    st.refilling = true;
+                    count = next_block_size(st);
+                    sync = !st.synced;
+                }
+            }
+
+            if(waiter) {
+                // 新块就绪（或回源失败）后重新抢号
+                boost::system::error_code ec;
+                co_await waiter->signal.async_receive(asio::redirect_error(asio::use_awaitable, ec));
+                continue;
+            }
+
+            std::vector<std::shared_ptr<Waiter>> waiters;
+            i64 first = 0;
+            try {
+                first = co_await reserve_block(conversation_id, count, sync);
+            } catch(...) {
+                {
+                    std::lock_guard lock{ reg.mutex };
+                    auto& st = reg.states[conversation_id];
+                    st.refilling = false;
+                    waiters = std::move(st.waiters);
+                }
+                wake_all(std::move(waiters));
+                throw;
+            }
+
+            {
+                std::lock_guard lock{ reg.mutex };
+                auto& st = reg.states[conversation_id];
+                st.next = first + 1;
+                st.limit = first + count;
+                st.synced = true;
+                st.refilling = false;
+                st.last_refill = clock::now();
+                waiters = std::move(st.waiters);
+            }
+            wake_all(std::move(waiters));
+            co_return first;
+        }
+    }
+
+    auto forget_conversation_sequence(i64 conversation_id) -> void
+    {
+        auto& reg = registry();
+        std::vector<std::shared_ptr<Waiter>> waiters;
+        {
+            std::lock_guard lock{ reg.mutex };
+            auto it = reg.states.find(conversation_id);
+            if(it == reg.states.end()) {
+                return;
+            }
+            waiters = std::move(it->second.waiters);
+            reg.states.erase(it);
+        }
+        wake_all(std::move(waiters));
+    }
+} // namespace database
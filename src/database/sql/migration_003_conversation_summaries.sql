@@ -0,0 +1,25 @@
+-- 迁移脚本：会话摘要表，随消息写入维护，会话列表不再按 messages 聚合
+-- 适用版本：MySQL 8.4+
+
+CREATE TABLE IF NOT EXISTS conversation_summaries (
+    conversation_id BIGINT NOT NULL PRIMARY KEY,
+    last_seq BIGINT NOT NULL,
+    last_message_id BIGINT NOT NULL,
+    last_sender_id BIGINT NOT NULL,
+    last_msg_type VARCHAR(32) NOT NULL,
+    last_content VARCHAR(64) NOT NULL,  -- 最新消息正文的前 64 个字符，仅用于预览
+    last_server_time_ms BIGINT NOT NULL,
+    CONSTRAINT fk_conv_summary_conv FOREIGN KEY (conversation_id) REFERENCES conversations(id) ON DELETE CASCADE
+) ENGINE=InnoDB DEFAULT CHARSET=utf8mb4;
+
+-- 根据现有 messages 表回填每个会话的最新消息
+INSERT INTO conversation_summaries
+    (conversation_id, last_seq, last_message_id, last_sender_id, last_msg_type, last_content, last_server_time_ms)
+SELECT m.conversation_id, m.seq, m.id, m.sender_id, m.msg_type, LEFT(m.content, 64), m.server_time_ms
+FROM messages m
+JOIN (
+    SELECT conversation_id, MAX(seq) AS max_seq
+    FROM messages
+    GROUP BY conversation_id
+) latest ON latest.conversation_id = m.conversation_id AND latest.max_seq = m.seq
+ON DUPLICATE KEY UPDATE conversation_id = conversation_summaries.conversation_id;
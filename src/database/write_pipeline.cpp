@@ -0,0 +1,423 @@
+#include <database/write_pipeline.h>
+#include <database/connection.h>
+
+#include <boost/mysql.hpp>
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/detached.hpp>
+#include <boost/asio/use_awaitable.hpp>
+#include <boost/asio/redirect_error.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/this_coro.hpp>
+#include <boost/asio/experimental/concurrent_channel.hpp>
+
+#include <algorithm>
+#include <exception>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <print>
+#include <stdexcept>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace asio = boost::asio;
+namespace mysql = boost::mysql;
+
+namespace database
+{
+    namespace
+    {
+        using clock = std::chrono::steady_clock;
+
+        /// \brief 一条排队中的写入请求，写入协程填好结果后通过 channel 唤醒发起方。
+        struct PendingInsert
+        {
+            PendingInsert(asio::any_io_executor exec, PendingMessage m)
+                : msg(std::move(m)), signal(std::move(exec), 1)
+            {}
+
+            PendingMessage msg;
+            asio::experimental::concurrent_channel<void(boost::system::error_code)> signal;
+            i64 id{ 0 };
+            std::exception_ptr error{};
+        };
+
+        struct PipelineState
+        {
+            WritePipelineConfig cfg{};
+            std::vector<std::shared_ptr<PendingInsert>> queue;
+            /// \brief 正在运行的写入协程数。
+            std::size_t flushers{ 0 };
+            WritePipelineStats stats{};
+            std::mutex mutex;
+        };
+
+        PipelineState& state()
+        {
+            static PipelineState s{};
+            return s;
+        }
+
+        auto complete(std::vector<std::shared_ptr<PendingInsert>> const& batch) -> void
+        {
+            for(auto const& p : batch) {
+                p->signal.try_send(boost::system::error_code{});
+            }
+        }
+
+        /// \brief 更新 conversation_summaries 的语句，VALUES 为各会话最新的一条消息。
+        /// \details 多个批次可能并行提交，只有 seq 更大的消息才会覆盖摘要，last_seq 最后赋值。
+        ///          消息 ID 由子查询按唯一键 uk_messages_conv_seq 取得，与消息同一事务写入时还未读回。
+        constexpr std::string_view SUMMARY_UPSERT_SQL =
+            "INSERT INTO conversation_summaries (conversation_id, last_seq, last_message_id, last_sender_id,"
+            " last_msg_type, last_content, last_server_time_ms) VALUES {} AS new "
+            "ON DUPLICATE KEY UPDATE"
+            " last_message_id = IF(new.last_seq > conversation_summaries.last_seq, new.last_message_id, conversation_summaries.last_message_id),"
+            " last_sender_id = IF(new.last_seq > conversation_summaries.last_seq, new.last_sender_id, conversation_summaries.last_sender_id),"
+            " last_msg_type = IF(new.last_seq > conversation_summaries.last_seq, new.last_msg_type, conversation_summaries.last_msg_type),"
+            " last_content = IF(new.last_seq > conversation_summaries.last_seq, new.last_content, conversation_summaries.last_content),"
+            " last_server_time_ms = IF(new.last_seq > conversation_summaries.last_seq, new.last_server_time_ms, conversation_summaries.last_server_time_ms),"
+            " last_seq = GREATEST(conversation_summaries.last_seq, new.last_seq)";
+
+        constexpr std::string_view MESSAGE_INSERT_SQL =
+            "INSERT INTO messages (conversation_id, sender_id, seq, msg_type, content, server_time_ms) VALUES {}; ";
+
+        /// \brief 批次中各会话 seq 最大且未失败的消息。
+        auto latest_per_conversation(std::vector<std::shared_ptr<PendingInsert>> const& batch)
+            -> std::vector<PendingInsert const*>
+        {
+            std::unordered_map<i64, PendingInsert const*> latest;
+            for(auto const& p : batch) {
+                if(p->error) {
+                    continue;
+                }
+                auto& slot = latest[p->msg.conversation_id];
+                if(!slot || p->msg.seq > slot->msg.seq) {
+                    slot = p.get();
+                }
+            }
+
+            std::vector<PendingInsert const*> rows;
+            rows.reserve(latest.size());
+            for(auto const& [_, p] : latest) {
+                rows.push_back(p);
+            }
+            return rows;
+        }
+
+        auto summary_values(std::vector<PendingInsert const*> const& rows)
+        {
+            return mysql::sequence(
+                rows,
+                [](PendingInsert const* p, mysql::format_context_base& ctx) {
+                    auto const& m = p->msg;
+                    mysql::format_sql_to(
+                        ctx, "({}, {}, (SELECT id FROM messages WHERE conversation_id = {} AND seq = {}), {}, {}, LEFT({}, 64), {})",
+                        m.conversation_id, m.seq, m.conversation_id, m.seq, m.sender_id, m.msg_type, m.content, m.server_time_ms
+                    );
+                }
+            );
+        }
+
+        /// \brief 多行 INSERT 写入整个批次，会话摘要在同一事务中更新：一次往返、一次 redo log 刷盘，
+        ///        摘要也不会与消息不一致。单行批次直接取 last_insert_id，多行批次之后由 read_back_ids 读回。
+        auto commit_batch(ConnectionHandle& conn_h, std::vector<std::shared_ptr<PendingInsert>> const& batch)
+            -> asio::awaitable<void>
+        {
+            auto const summaries = latest_per_conversation(batch);
+            auto const r = co_await execute_transaction(
+                conn_h,
+                join_sql<MESSAGE_INSERT_SQL, SUMMARY_UPSERT_SQL>,
+                mysql::sequence(
+                    batch,
+                    [](std::shared_ptr<PendingInsert> const& p, mysql::format_context_base& ctx) {
+                        auto const& m = p->msg;
+                        mysql::format_sql_to(
+                            ctx, "({}, {}, {}, {}, {}, {})",
+                            m.conversation_id, m.sender_id, m.seq, m.msg_type, m.content, m.server_time_ms
+                        );
+                    }
+                ),
+                summary_values(summaries)
+            );
+            if(batch.size() == 1) {
+                batch.front()->id = static_cast<i64>(r.at(1).last_insert_id());
+            }
+        }
+
+        /// \brief 按 (conversation_id, seq) 读回已提交消息的 ID，返回仍未找到的条数。
+        /// \details innodb_autoinc_lock_mode=2 或 auto_increment_increment>1 时多行 INSERT 的自增 ID 不保证连续，
+        ///          因此不能由 last_insert_id 推算；seq 由本进程预留，找到的行即是本批写入的那条。
+        auto read_back_ids(ConnectionHandle& conn_h, std::vector<std::shared_ptr<PendingInsert>> const& batch)
+            -> asio::awaitable<std::size_t>
+        {
+            std::map<std::pair<i64, i64>, PendingInsert*> by_key;
+            for(auto const& p : batch) {
+                if(!p->error && p->id == 0) {
+                    by_key.emplace(std::pair{ p->msg.conversation_id, p->msg.seq }, p.get());
+                }
+            }
+            if(by_key.empty()) {
+                co_return 0;
+            }
+
+            auto const r = co_await execute_batch(
+                conn_h,
+                "SELECT conversation_id, seq, id FROM messages WHERE (conversation_id, seq) IN ({})",
+                mysql::sequence(
+                    by_key,
+                    [](auto const& entry, mysql::format_context_base& ctx) {
+                        mysql::format_sql_to(ctx, "({}, {})", entry.first.first, entry.first.second);
+                    }
+                )
+            );
+            auto missing = by_key.size();
+            for(auto const row : r.rows()) {
+                auto const it = by_key.find({ row.at(0).as_int64(), row.at(1).as_int64() });
+                if(it != by_key.end() && it->second->id == 0) {
+                    it->second->id = row.at(2).as_int64();
+                    --missing;
+                }
+            }
+            co_return missing;
+        }
+
+        /// \brief 批量插入被服务器拒绝时逐条写入，把错误限定在出错的那条消息上。
+        auto insert_each(ConnectionHandle& conn_h, std::vector<std::shared_ptr<PendingInsert>> const& batch)
+            -> asio::awaitable<std::size_t>
+        {
+            std::size_t failed = 0;
+            for(auto const& p : batch) {
+                try {
+                    auto const& m = p->msg;
+                    auto const stmt = co_await conn_h.prepare(StatementId::append_message);
+                    mysql::results r;
+                    co_await conn_h->async_execute(
+                        stmt.bind(m.conversation_id, m.sender_id, m.seq, m.msg_type, m.content, m.server_time_ms),
+                        r,
+                        asio::use_awaitable
+                    );
+                    p->id = static_cast<i64>(r.last_insert_id());
+                } catch(...) {
+                    p->error = std::current_exception();
+                    ++failed;
+                }
+            }
+            co_return failed;
+        }
+
+        /// \brief 逐条写入后单独更新会话摘要。
+        auto upsert_summaries(ConnectionHandle& conn_h, std::vector<std::shared_ptr<PendingInsert>> const& batch)
+            -> asio::awaitable<void>
+        {
+            auto const rows = latest_per_conversation(batch);
+            if(rows.empty()) {
+                co_return;
+            }
+            co_await execute_batch(conn_h, SUMMARY_UPSERT_SQL, summary_values(rows));
+        }
+
+        /// \brief 错误来自服务器执行语句（约束冲突、死锁等），此时事务已回滚，整批都没有写入；
+        ///        网络或客户端错误时无法确定 COMMIT 是否已生效。
+        auto rejected_by_server(mysql::error_with_diagnostics const& ex) -> bool
+        {
+            auto const& category = ex.code().category();
+            return category == mysql::get_common_server_category()
+                || category == mysql::get_mysql_server_category()
+                || category == mysql::get_mariadb_server_category();
+        }
+
+        /// \brief 把仍没有 ID 的消息标记为失败，返回标记的条数。
+        auto fail_unresolved(std::vector<std::shared_ptr<PendingInsert>> const& batch, std::exception_ptr error)
+            -> std::size_t
+        {
+            std::size_t failed = 0;
+            for(auto const& p : batch) {
+                if(!p->error && p->id == 0) {
+                    p->error = error;
+                    ++failed;
+                }
+            }
+            return failed;
+        }
+
+        /// \brief 记录批次统计并唤醒其中所有发起方。
+        auto finish_batch(
+            std::vector<std::shared_ptr<PendingInsert>> const& batch,
+            clock::time_point start,
+            std::size_t failed,
+            bool fallback
+        ) -> void
+        {
+            auto& st = state();
+            auto const elapsed_us = static_cast<std::uint64_t>(
+                std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - start).count()
+            );
+            {
+                std::lock_guard lock{ st.mutex };
+                ++st.stats.batches;
+                st.stats.rows += batch.size() - failed;
+                st.stats.max_batch = std::max<std::uint64_t>(st.stats.max_batch, batch.size());
+                st.stats.failures += failed;
+                st.stats.fallbacks += fallback ? 1 : 0;
+                st.stats.total_commit_us += elapsed_us;
+                st.stats.max_commit_us = std::max(st.stats.max_commit_us, elapsed_us);
+            }
+            complete(batch);
+        }
+
+        /// \brief 写入一个批次并更新会话摘要，之后唤醒其中所有发起方。
+        /// \details 只有服务器拒绝了事务时才逐条重试；已提交或提交结果未知时按 (conversation_id, seq) 查回 ID，
+        ///          不重复插入，避免已写入的消息被报告为失败后由客户端重发。
+        auto flush_batch(std::vector<std::shared_ptr<PendingInsert>> batch) -> asio::awaitable<void>
+        {
+            auto const start = clock::now();
+            bool fallback = false;
+            std::size_t failed = 0;
+
+            bool committing = false;
+            try {
+                auto conn_h = co_await acquire_handle();
+                committing = true;
+                try {
+                    co_await commit_batch(conn_h, batch);
+                } catch(mysql::error_with_diagnostics const& ex) {
+                    if(!rejected_by_server(ex)) {
+                        throw;
+                    }
+                    // 通常是个别行违反约束，整个事务已回滚，逐条重试即可
+                    fallback = true;
+                }
+
+                if(fallback) {
+                    failed = co_await insert_each(conn_h, batch);
+                    // 摘要失败不影响消息本身，由该会话的下一条消息覆盖
+                    try {
+                        co_await upsert_summaries(conn_h, batch);
+                    } catch(std::exception const& ex) {
+                        std::println("[write_pipeline] update conversation summaries failed: {}", ex.what());
+                    }
+                    finish_batch(batch, start, failed, fallback);
+                    co_return;
+                }
+
+                try {
+                    if(co_await read_back_ids(conn_h, batch) == 0) {
+                        finish_batch(batch, start, failed, fallback);
+                        co_return;
+                    }
+                } catch(std::exception const& ex) {
+                    std::println("[write_pipeline] read back message ids failed: {}", ex.what());
+                }
+            } catch(std::exception const& ex) {
+                if(!committing) {
+                    // 借连接失败：整批都没有写入
+                    auto const error = std::current_exception();
+                    for(auto const& p : batch) {
+                        p->error = error;
+                    }
+                    finish_batch(batch, start, batch.size(), fallback);
+                    co_return;
+                }
+                // 连接在提交途中中断：是否已提交未知，下面换一个连接查回
+                std::println("[write_pipeline] batch commit interrupted: {}", ex.what());
+            }
+
+            // 消息已提交（或可能已提交）但 ID 未读回：换一个连接按唯一键再查一次，查不到的才算失败
+            auto error = std::exception_ptr{};
+            try {
+                auto conn_h = co_await acquire_handle();
+                co_await read_back_ids(conn_h, batch);
+                error = std::make_exception_ptr(std::runtime_error{ "message batch insert was not committed" });
+            } catch(...) {
+                error = std::current_exception();
+            }
+            failed = fail_unresolved(batch, error);
+            finish_batch(batch, start, failed, fallback);
+        }
+
+        /// \brief 写入协程：先等待 linger 攒批，之后持续取批写入直到队列为空。
+        /// \details 退出判断与入队在同一把锁内完成，不会出现入队后无人写入的情况。
+        auto flush_loop() -> asio::awaitable<void>
+        {
+            auto& st = state();
+
+            std::chrono::microseconds linger{};
+            {
+                std::lock_guard lock{ st.mutex };
+                if(st.queue.size() < st.cfg.max_batch) {
+                    linger = st.cfg.linger;
+                }
+            }
+            if(linger.count() > 0) {
+                asio::steady_timer timer{ co_await asio::this_coro::executor };
+                timer.expires_after(linger);
+                boost::system::error_code ec;
+                co_await timer.async_wait(asio::redirect_error(asio::use_awaitable, ec));
+            }
+
+            while(true) {
+                std::vector<std::shared_ptr<PendingInsert>> batch;
+                {
+                    std::lock_guard lock{ st.mutex };
+                    if(st.queue.empty()) {
+                        --st.flushers;
+                        co_return;
+                    }
+                    auto const n = std::min(st.queue.size(), std::max<std::size_t>(st.cfg.max_batch, 1));
+                    batch.assign(
+                        std::make_move_iterator(st.queue.begin()),
+                        std::make_move_iterator(st.queue.begin() + static_cast<std::ptrdiff_t>(n))
+                    );
+                    st.queue.erase(st.queue.begin(), st.queue.begin() + static_cast<std::ptrdiff_t>(n));
+                }
+                co_await flush_batch(std::move(batch));
+            }
+        }
+    } // namespace
+
+    auto set_write_pipeline_config(WritePipelineConfig cfg) -> void
+    {
+        auto& st = state();
+        std::lock_guard lock{ st.mutex };
+        st.cfg = cfg;
+    }
+
+    auto enqueue_message_insert(PendingMessage msg) -> asio::awaitable<i64>
+    {
+        auto& st = state();
+        auto const exec = co_await asio::this_coro::executor;
+        auto pending = std::make_shared<PendingInsert>(exec, std::move(msg));
+
+        bool spawn = false;
+        {
+            std::lock_guard lock{ st.mutex };
+            st.queue.push_back(pending);
+            // 没有写入协程时启动一个；已有写入协程但积压超过一批时再并行开一个
+            if(st.flushers == 0
+               || (st.flushers < st.cfg.max_inflight && st.queue.size() >= st.cfg.max_batch)) {
+                ++st.flushers;
+                spawn = true;
+            }
+        }
+        if(spawn) {
+            asio::co_spawn(exec, flush_loop(), asio::detached);
+        }
+
+        // 发起方被取消时写入仍会完成，这里只是不再等待结果
+        co_await pending->signal.async_receive(asio::use_awaitable);
+        if(pending->error) {
+            std::rethrow_exception(pending->error);
+        }
+        co_return pending->id;
+    }
+
+    auto write_pipeline_stats() -> WritePipelineStats
+    {
+        auto& st = state();
+        std::lock_guard lock{ st.mutex };
+        return st.stats;
+    }
+} // namespace database
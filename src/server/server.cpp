@@ -1,8 +1,18 @@
-
 #include <print>
+#include <algorithm>
 #include <charconv>
 #include <cstring>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
 #include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
 
 #include <stdexec/execution.hpp>
 #include <execpools/asio/asio_thread_pool.hpp>
@@ -12,28 +22,188 @@
 #include <session.h>
 #include <server.h>
 #include <database/connection.h>
+#include <database/write_pipeline.h>
+
+namespace
+{
+    /// \brief 服务端运行模式。
+    enum class RunMode
+    {
+        /// 单个共享线程池 + 单个 acceptor（默认）。
+        pool,
+        /// 每核一个 io_context + SO_REUSEPORT acceptor。
+        per_core,
+    };
+
+    /// \brief 将当前线程绑定到指定 CPU，失败时静默忽略。
+    auto pin_current_thread(std::size_t cpu) -> void
+    {
+#if defined(__linux__)
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(static_cast<int>(cpu % CPU_SETSIZE), &set);
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+        (void)cpu;
+#endif
+    }
+
+    /// \brief 线程池模式：所有连接共享 8 * 核数 个线程。
+    auto run_pool_mode(u16 port, database::PoolConfig db_cfg) -> void
+    {
+        auto thread_count = 8 * std::thread::hardware_concurrency();
+        auto pool = execpools::asio_thread_pool{ thread_count };
+        auto exec = pool.get_executor();
+
+        database::init_pool(exec, std::move(db_cfg));
+        std::println("chat server listening on port {}, mode is pool, thread_count is {}", port, thread_count);
+
+        // 使用 stdexec sender 模型启动并同步等待服务器协程结束
+        auto server_sender = async_start_server(exec, port);
+        stdexec::sync_wait(server_sender);
+    }
+
+    /// \brief 按核模式：每个核心一个单线程 io_context，线程绑核运行。
+    auto run_per_core_mode(u16 port, std::size_t core_count, database::PoolConfig db_cfg) -> void
+    {
+        using work_guard = asio::executor_work_guard<asio::io_context::executor_type>;
+
+        std::vector<std::unique_ptr<asio::io_context>> contexts;
+        std::vector<work_guard> guards;
+        std::vector<asio::any_io_executor> execs;
+        contexts.reserve(core_count);
+        guards.reserve(core_count);
+        execs.reserve(core_count);
+        for(std::size_t i = 0; i < core_count; ++i) {
+            // 并发提示为 1：每个 io_context 只由一个线程驱动，内部可省去锁
+            contexts.push_back(std::make_unique<asio::io_context>(1));
+            guards.push_back(asio::make_work_guard(*contexts.back()));
+            execs.push_back(contexts.back()->get_executor());
+        }
+
+        std::vector<std::jthread> threads;
+        threads.reserve(core_count);
+        for(std::size_t i = 0; i < core_count; ++i) {
+            threads.emplace_back([&ctx = *contexts[i], i] {
+                pin_current_thread(i);
+                ctx.run();
+            });
+        }
+
+        // 每个核心一组连接子池，数据库 I/O 留在发起查询的核心上
+        database::init_pool(execs, std::move(db_cfg));
+        std::println("chat server listening on port {}, mode is per-core, core_count is {}", port, core_count);
+
+        auto server_sender = async_start_server_per_core(execs, port);
+        stdexec::sync_wait(server_sender);
+
+        guards.clear();
+        for(auto& ctx : contexts) {
+            ctx->stop();
+        }
+    }
+
+    /// \brief 解析 host[:port] 形式的数据库地址，省略端口时为 3306。
+    auto parse_endpoint(std::string_view value) -> std::optional<database::DbEndpoint>
+    {
+        auto endpoint = database::DbEndpoint{};
+        auto const colon = value.rfind(':');
+        endpoint.host = std::string{ value.substr(0, colon) };
+        if(colon != std::string_view::npos) {
+            auto const digits = value.substr(colon + 1);
+            auto const [ptr, ec] = std::from_chars(digits.data(), digits.data() + digits.size(), endpoint.port, 10);
+            if(ec != std::errc{} || ptr != digits.data() + digits.size()) {
+                return std::nullopt;
+            }
+        }
+        if(endpoint.host.empty()) {
+            return std::nullopt;
+        }
+        return endpoint;
+    }
+}
 
 /// \brief 程序入口：启动 IoRunner 和 TCP 服务器，便于用 nc 调试协议。
 /// \param argc 命令行参数个数。
-/// \param argv 命令行参数数组，argv[1] 可选指定端口。
+/// \param argv 命令行参数数组：[端口] [--mode pool|per-core] [--cores N]
+///             [--db-replica host[:port]]... [--ryw-ms N]
+///             [--msg-batch N] [--msg-linger-us N] [--msg-inflight N] [--write-batch-kb N]
+///             [--stats-sec N]。
 /// \return 进程退出码，正常情况下为 0。
 auto main(int argc, char** argv) -> int
 {
     auto port = u16(5555);
-    if(argc > 1) {
-        auto _ = std::from_chars(argv[1], argv[1] + std::strlen(argv[1]), port, 10);
-    }
+    auto mode = RunMode::pool;
+    auto core_count = std::size_t{ std::max(1u, std::thread::hardware_concurrency()) };
+    auto db_cfg = database::PoolConfig{};
+    auto write_cfg = database::WritePipelineConfig{};
 
-    auto thread_count = 8 * std::thread::hardware_concurrency();
-    auto pool = execpools::asio_thread_pool{ thread_count };
-    auto exec = pool.get_executor();
+    for(int i = 1; i < argc; ++i) {
+        auto const arg = std::string_view{ argv[i] };
+        if(arg == "--mode" && i + 1 < argc) {
+            auto const value = std::string_view{ argv[++i] };
+            if(value == "per-core") {
+                mode = RunMode::per_core;
+            } else if(value == "pool") {
+                mode = RunMode::pool;
+            } else {
+                std::println("unknown mode '{}', expected pool or per-core", value);
+                return 1;
+            }
+        } else if(arg == "--cores" && i + 1 < argc) {
+            auto _ = std::from_chars(argv[i + 1], argv[i + 1] + std::strlen(argv[i + 1]), core_count, 10);
+            ++i;
+            if(core_count == 0) {
+                core_count = 1;
+            }
+        } else if(arg == "--db-replica" && i + 1 < argc) {
+            auto const value = std::string_view{ argv[++i] };
+            auto endpoint = parse_endpoint(value);
+            if(!endpoint) {
+                std::println("invalid replica address '{}', expected host[:port]", value);
+                return 1;
+            }
+            db_cfg.replicas.push_back(std::move(*endpoint));
+        } else if(arg == "--ryw-ms" && i + 1 < argc) {
+            auto ms = i64{ 0 };
+            auto _ = std::from_chars(argv[i + 1], argv[i + 1] + std::strlen(argv[i + 1]), ms, 10);
+            ++i;
+            db_cfg.read_your_writes_window = std::chrono::milliseconds{ std::max<i64>(ms, 0) };
+        } else if(arg == "--msg-batch" && i + 1 < argc) {
+            auto _ = std::from_chars(argv[i + 1], argv[i + 1] + std::strlen(argv[i + 1]), write_cfg.max_batch, 10);
+            ++i;
+            write_cfg.max_batch = std::max<std::size_t>(write_cfg.max_batch, 1);
+        } else if(arg == "--msg-linger-us" && i + 1 < argc) {
+            auto us = i64{ 0 };
+            auto _ = std::from_chars(argv[i + 1], argv[i + 1] + std::strlen(argv[i + 1]), us, 10);
+            ++i;
+            write_cfg.linger = std::chrono::microseconds{ std::max<i64>(us, 0) };
+        } else if(arg == "--msg-inflight" && i + 1 < argc) {
+            auto _ = std::from_chars(argv[i + 1], argv[i + 1] + std::strlen(argv[i + 1]), write_cfg.max_inflight, 10);
+            ++i;
+            write_cfg.max_inflight = std::max<std::size_t>(write_cfg.max_inflight, 1);
+        } else if(arg == "--write-batch-kb" && i + 1 < argc) {
+            auto kb = std::size_t{ 0 };
+            auto _ = std::from_chars(argv[i + 1], argv[i + 1] + std::strlen(argv[i + 1]), kb, 10);
+            ++i;
+            Session::max_write_batch_bytes = std::max<std::size_t>(kb, 1) * 1024;
+        } else if(arg == "--stats-sec" && i + 1 < argc) {
+            auto sec = i64{ 0 };
+            auto _ = std::from_chars(argv[i + 1], argv[i + 1] + std::strlen(argv[i + 1]), sec, 10);
+            ++i;
+            Server::stats_interval = std::chrono::seconds{ std::max<i64>(sec, 0) };
+        } else {
+            auto _ = std::from_chars(argv[i], argv[i] + std::strlen(argv[i]), port, 10);
+        }
+    }
 
-    database::init_pool(exec);
-    std::println("chat server listening on port {}, thread_count is {}", port, thread_count);
+    database::set_write_pipeline_config(write_cfg);
 
-    // 使用 stdexec sender 模型启动并同步等待服务器协程结束
-    auto server_sender = async_start_server(exec, port);
-    stdexec::sync_wait(server_sender);
+    if(mode == RunMode::per_core) {
+        run_per_core_mode(port, core_count, std::move(db_cfg));
+    } else {
+        run_pool_mode(port, std::move(db_cfg));
+    }
 
     return 0;
 }
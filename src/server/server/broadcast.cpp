@@ -7,14 +7,15 @@
 #include <nlohmann/json.hpp>
 #include <asioexec/use_sender.hpp>
 #include <exec/task.hpp>
+#include <boost/asio/co_spawn.hpp>
 #include <boost/asio/use_awaitable.hpp>
 #include <boost/asio/redirect_error.hpp>
 #include <boost/asio/steady_timer.hpp>
 namespace asio = boost::asio;
 
+#include <algorithm>
 #include <optional>
 #include <print>
-#include <unordered_set>
 #include <vector>
 #include <chrono>
 
@@ -23,33 +24,111 @@ using asio::use_awaitable;
 
 // ---------------------------------------------------------------------------
 // 本文件负责：
-//   - 管理服务器上所有在线 Session 的生命周期与索引（sessions_ / sessions_by_user_）
-//   - 根据会话（conversation）及用户维度高效查找在线 Session
+//   - 管理服务器上所有在线 Session 的生命周期与索引（分片内的 sessions / sessions_by_user）
+//   - 根据会话（conversation）订阅索引及用户维度高效查找在线 Session
 //   - 构造并向相关在线客户端广播系统消息 / 普通消息
 //
 // 并发约定：
-//   - 所有对 sessions_ 与 sessions_by_user_ 的读写都应在同一个 asio strand 上执行，
-//     本文件中的接口默认在该 strand 上被调用，以避免手动加锁。
-//   - Session::send_text 本身是非阻塞的，只负责将数据投递到底层写协程。
+//   - 注册表被拆分为若干 SessionShard，连接按 Session* 哈希、用户索引按 user_id 哈希
+//     落到分片；每个分片的数据只在该分片的 strand 上读写，分片之间互不阻塞。
+//   - 广播在调用线程上序列化一次负载，再交给扇出队列按分片分块投递（见 fanout.cpp）。
+//   - Session::send_frame 本身是非阻塞的，只负责将数据投递到底层写协程。
 // ---------------------------------------------------------------------------
 
+/**
+ * @brief 创建并开始监听一个 acceptor。
+ *
+ * 按核模式下每个核心各持有一个绑定到同一端口的 acceptor，需要 SO_REUSEPORT
+ * 让内核在它们之间分发新连接；不支持该选项的平台上退化为普通监听。
+ *
+ * @param exec acceptor 所在的执行器。
+ * @param port 要监听的本地端口。
+ * @param reuse_port 是否设置 SO_REUSEPORT。
+ * @return 已进入监听状态的 acceptor。
+ */
+auto Server::make_acceptor(asio::any_io_executor exec, u16 port, bool reuse_port) -> asio::ip::tcp::acceptor
+{
+    auto const endpoint = asio::ip::tcp::endpoint{ asio::ip::tcp::v4(), port };
+    asio::ip::tcp::acceptor acceptor{ exec };
+    acceptor.open(endpoint.protocol());
+    acceptor.set_option(asio::socket_base::reuse_address(true));
+#if defined(SO_REUSEPORT)
+    if(reuse_port) {
+        using reuse_port_option = asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>;
+        acceptor.set_option(reuse_port_option(true));
+    }
+#else
+    (void)reuse_port;
+#endif
+    acceptor.bind(endpoint);
+    acceptor.listen();
+    return acceptor;
+}
+
 /**
  * @brief 启动服务器主协程，持续接受来自客户端的新连接。
  *
- * 使用 `acceptor_` 异步接受 TCP 连接，为每个连接创建 `Session`，
- * 在 `strand_` 上 `co_spawn` 会话协程以保证对共享状态的串行访问，
- * 会话结束时通过 `remove_session` 进行清理。
+ * 除第一个 acceptor 外，其余 acceptor（按核模式）的接受循环在各自核心的
+ * 执行器上独立 `co_spawn`；当前协程负责第一个 acceptor。
  *
  * @return `asio::awaitable<void>` 可被上层 `co_spawn` 或 `co_await`。
  */
 auto Server::run() -> asio::awaitable<void>
 {
-    std::println("Server::run enter");
+    std::println("Server::run enter, acceptors: {}, shards: {}", acceptors_.size(), shards_.size());
+    auto self = shared_from_this();
+
+    for(std::size_t i = 1; i < acceptors_.size(); ++i) {
+        asio::co_spawn(
+            acceptors_[i].get_executor(),
+            [self, i]() -> asio::awaitable<void> {
+                co_await self->accept_loop(i);
+            },
+            asio::detached
+        );
+    }
+
+    asio::co_spawn(
+        exec_,
+        [self]() -> asio::awaitable<void> {
+            co_await self->cache_cleanup_loop();
+        },
+        asio::detached
+    );
+
+    if(stats_interval.count() > 0) {
+        asio::co_spawn(
+            exec_,
+            [self]() -> asio::awaitable<void> {
+                co_await self->stats_loop();
+            },
+            asio::detached
+        );
+    }
+
+    co_await accept_loop(0);
+    std::println("Server::run exit");
+}
+
+/**
+ * @brief 单个 acceptor 的接受循环。
+ *
+ * 异步接受 TCP 连接，为每个连接创建 `Session`，登记到所属分片后
+ * 在会话自己的 strand 上 `co_spawn` 会话协程，会话结束时通过 `remove_session` 进行清理。
+ * 新 socket 绑定在 acceptor 的执行器上，因此按核模式下会话始终留在接受它的核心。
+ *
+ * 按核模式下会话登记到同一核心的分片，登记与下线清理都不离开该核心。
+ *
+ * @param index 要驱动的 acceptor 下标，acceptor 生命周期由 Server 持有。
+ */
+auto Server::accept_loop(std::size_t index) -> asio::awaitable<void>
+{
     auto self = shared_from_this();
+    auto& acceptor = acceptors_[index];
 
     while(true) {
         boost::system::error_code ec;
-        auto socket = co_await acceptor_.async_accept(asio::redirect_error(use_awaitable, ec));
+        auto socket = co_await acceptor.async_accept(asio::redirect_error(use_awaitable, ec));
 
         if(ec) {
             if(ec == asio::error::operation_aborted) {
@@ -57,7 +136,7 @@ auto Server::run() -> asio::awaitable<void>
                 break;
             }
             std::println("accept error: {} ({})", ec.message(), ec.value());
-            asio::steady_timer timer{ acceptor_.get_executor() };
+            asio::steady_timer timer{ acceptor.get_executor() };
             timer.expires_after(std::chrono::milliseconds{ 50 });
             co_await timer.async_wait(use_awaitable);
             continue;
@@ -69,37 +148,51 @@ auto Server::run() -> asio::awaitable<void>
         }
 
         auto session = std::make_shared<Session>(std::move(socket), self);
+        session->home_shard_ = home_shard_index(session.get(), index);
         
-        // 在 Server 的 strand 上注册 session
-        asio::dispatch(strand_, [self, session]() {
-            self->sessions_[session.get()] = session;
-        });
+        // 在所属分片的 strand 上注册 session
+        add_session(session);
         
-        // Session 的 run() 在自己的 strand 上执行，避免阻塞 Server strand
+        // Session 的 run() 在自己的 strand 上执行，避免阻塞分片 strand
         asio::co_spawn(
             session->strand_,
             [weak = std::weak_ptr<Server>(self), session]() -> asio::awaitable<void> {
                 co_await session->run();
-                // 清理时需要回到 Server 的 strand
+                // remove_session 内部会回到对应分片的 strand
                 if(auto srv = weak.lock()) {
-                    asio::dispatch(srv->strand_, [srv, raw_ptr = session.get()]() {
-                        srv->remove_session(raw_ptr);
-                    });
+                    srv->remove_session(session.get());
                 }
             },
             asio::detached
         );
     }
-    std::println("Server::run exit");
+}
+
+auto Server::shard_for_session(Session const& session) -> SessionShard&
+{
+    return *shards_[session.home_shard_];
+}
+
+/**
+ * @brief 将新建立的连接登记到其 home 分片。
+ *
+ * @param session 新建立的会话。
+ */
+auto Server::add_session(std::shared_ptr<Session> const& session) -> void
+{
+    auto& shard = shard_for_session(*session);
+    asio::dispatch(shard.strand, [&shard, session]() {
+        shard.sessions[session.get()] = session;
+    });
 }
 
 /**
  * @brief 从在线会话索引中移除指定的 Session。
  *
- * 仅在 Session 存在于 `sessions_` 中时执行删除；若会话已认证，
- * 则进一步在 `sessions_by_user_` 中按用户维度清理对应条目。
+ * 先在连接所属分片中删除；若会话已认证，再投递到其 user_id 所属分片，
+ * 在 `sessions_by_user` 中按用户维度清理对应条目；该用户已无在线连接时一并移除其会话订阅。
  *
- * @param ptr 需要移除的 Session 裸指针，允许为 `nullptr` 或已失效指针。
+ * @param ptr 需要移除的 Session 裸指针，允许为 `nullptr`；调用方须保证会话对象仍然存活。
  */
 auto Server::remove_session(Session* ptr) -> void
 {
@@ -107,63 +200,80 @@ auto Server::remove_session(Session* ptr) -> void
         return;
     }
 
-    // O(1) 从主 map 中删除
-    auto it = sessions_.find(ptr);
-    if(it == sessions_.end()) {
-        return;
-    }
+    auto& shard = shard_for_session(*ptr);
+    asio::dispatch(shard.strand, [this, &shard, ptr]() {
+        // O(1) 从分片 map 中删除
+        auto it = shard.sessions.find(ptr);
+        if(it == shard.sessions.end()) {
+            return;
+        }
 
-    // 如果已认证,记录其 user_id 以便高效清理 sessions_by_user_
-    std::optional<i64> uid;
-    if(it->second && it->second->is_authenticated()) {
-        uid = it->second->user_id();
-    }
+        // 如果已认证,记录其 user_id 以便高效清理 sessions_by_user
+        std::optional<i64> uid;
+        if(it->second && it->second->is_authenticated()) {
+            uid = it->second->user_id();
+        }
 
-    sessions_.erase(it);
+        shard.sessions.erase(it);
 
-    // 仅在已认证的情况下清理 sessions_by_user_
-    // 优化: 仅遍历该用户的会话 O(k), k 是该用户的设备数
-    if(uid.has_value()) {
-        auto range = sessions_by_user_.equal_range(uid.value());
-        for(auto map_it = range.first; map_it != range.second; ) {
-            auto locked = map_it->second.lock();
-            if(!locked || locked.get() == ptr) {
-                map_it = sessions_by_user_.erase(map_it);
-            } else {
-                ++map_it;
-            }
+        // 仅在已认证的情况下清理用户索引
+        // 优化: 仅遍历该用户的会话 O(k), k 是该用户的设备数
+        if(!uid.has_value()) {
+            return;
         }
-    }
+        auto& user_shard = shard_for_user(uid.value());
+        asio::dispatch(user_shard.strand, [this, &user_shard, ptr, uid = uid.value()]() {
+            auto range = user_shard.sessions_by_user.equal_range(uid);
+            for(auto map_it = range.first; map_it != range.second; ) {
+                auto locked = map_it->second.lock();
+                if(!locked || locked.get() == ptr) {
+                    map_it = user_shard.sessions_by_user.erase(map_it);
+                } else {
+                    ++map_it;
+                }
+            }
+            // 最后一个连接下线后不再接收任何会话的推送
+            if(!user_shard.sessions_by_user.contains(uid)) {
+                drop_user_subscriptions(user_shard, uid);
+            }
+        });
+    });
 }
 
 /**
  * @brief 在会话通过鉴权后，按用户维度建立索引。
  *
  * 若会话为空或尚未认证，则不会执行任何操作。
- * 会先清理该用户下已失效或重复的弱引用，再插入最新的会话条目。
+ * 在 user_id 所属分片上先清理该用户下已失效或重复的弱引用，再插入最新的会话条目，
+ * 并为用户登记订阅表；会话订阅随后由 `subscribe_user` 填入。
+ * 协程在登记完成后才恢复（仍在调用方的执行器上），调用方随后读取的会话列表因此不会与并发的加入操作错过。
  *
  * @param session 已通过鉴权的会话智能指针。
  */
-auto Server::index_authenticated_session(std::shared_ptr<Session> const& session) -> void
+auto Server::index_authenticated_session(std::shared_ptr<Session> session) -> asio::awaitable<void>
 {
-    dispatch_on_strand([this, session]() {
-        if(!session || !session->is_authenticated()) {
-            return;
-        }
+    if(!session || !session->is_authenticated()) {
+        co_return;
+    }
 
-        auto const uid = session->user_id();
-        auto range = sessions_by_user_.equal_range(uid);
+    auto const uid = session->user_id();
+    auto& shard = shard_for_user(uid);
+    co_await asio::co_spawn(shard.strand, [&shard, uid, session]() -> asio::awaitable<void> {
+        auto range = shard.sessions_by_user.equal_range(uid);
         for(auto it = range.first; it != range.second; ) {
             auto existing = it->second.lock();
             if(!existing || existing.get() == session.get()) {
-                it = sessions_by_user_.erase(it);
+                it = shard.sessions_by_user.erase(it);
             } else {
                 ++it;
             }
         }
 
-        sessions_by_user_.emplace(uid, session);
-    });
+        shard.sessions_by_user.emplace(uid, session);
+        // 先登记空的订阅表，此后的加入会话操作会直接写入，见 subscriptions.cpp
+        shard.subscriptions.try_emplace(uid);
+        co_return;
+    }, asio::use_awaitable);
 }
 
 /**
@@ -171,8 +281,7 @@ auto Server::index_authenticated_session(std::shared_ptr<Session> const& session
  *
  * 系统消息的 `senderId` 固定为 "0"，`senderDisplayName` 为空，
  * `conversationType` 固定为 "GROUP"。
- * 优先从会话缓存中获取成员列表；若缓存缺失或成员列表为空，则退化为
- * 向所有已认证会话广播。
+ * 经 `fan_out_conversation` 推送给订阅该会话的在线设备。
  *
  * @param conversation_id 目标会话（群/频道）的唯一标识。
  * @param stored 已持久化的消息元信息（ID、类型、时间戳、序列号等）。
@@ -184,51 +293,32 @@ auto Server::broadcast_system_message(
     std::string const& content
 ) -> void
 {
-    dispatch_on_strand([=, this]() {
-        json push;
-        push["conversationId"] = std::to_string(conversation_id);
-        push["conversationType"] = "GROUP";
-        push["serverMsgId"] = std::to_string(stored.id);
-        push["senderId"] = "0";
-        push["senderDisplayName"] = "";
-        push["msgType"] = stored.msg_type.empty() ? "TEXT" : stored.msg_type;
-        push["serverTimeMs"] = stored.server_time_ms;
-        push["seq"] = stored.seq;
-        push["content"] = content;
+    json push;
+    push["conversationId"] = std::to_string(conversation_id);
+    push["conversationType"] = "GROUP";
+    push["serverMsgId"] = std::to_string(stored.id);
+    push["senderId"] = "0";
+    push["senderDisplayName"] = "";
+    push["msgType"] = stored.msg_type.empty() ? "TEXT" : stored.msg_type;
+    push["serverTimeMs"] = stored.server_time_ms;
+    push["seq"] = stored.seq;
+    push["content"] = content;
 
-        auto const line = protocol::make_line("MSG_PUSH", push.dump());
+    auto line = protocol::make_shared_frame("MSG_PUSH", push.dump());
 
-        // 使用缓存获取成员列表,大幅减少数据库查询
-        std::vector<i64> member_ids;
-        if(auto cache = get_conversation_cache(conversation_id)) {
-            member_ids = cache->member_ids;
-        }
-
-        auto const send_line = [&line](std::shared_ptr<Session> const& session) {
-            if(session->is_authenticated()) {
-                session->send_text(line);
-            }
-        };
-
-        if(member_ids.empty()) {
-            for_all_authenticated_sessions(send_line);
-            return;
-        }
-
-        std::unordered_set<i64> member_set{ member_ids.begin(), member_ids.end() };
-        for(auto const uid : member_set) {
-            for_user_sessions(uid, send_line);
-        }
+    // 与同一会话的其他推送一起排队，缓存回源期间也保持先后顺序
+    fan_out_conversation(conversation_id, [line = std::move(line)](std::string const&) {
+        return line;
     });
 }
 
 /**
  * @brief 向指定会话的在线成员广播一条普通消息（用户消息或系统消息）。
  *
- * 会话类型和成员列表优先从本地缓存读取，必要时才访问数据库。
- * 对于非 SYSTEM 消息，会按需查询发送者的 `display_name`，查询失败时降级为空字符串。
+ * 会话类型从读穿缓存读取，未命中时由缓存回源一次后再投递；接收者取自在线订阅索引。
+ * 发送者昵称由调用方传入，缺失时留空。
  * 系统消息通过 msg_type 区分，不再依赖 senderId=0。
- * 当成员列表为空时退化为向所有已认证会话广播，否则仅向目标会话成员的在线设备推送。
+ * 仅向目标会话成员的在线设备推送。
  *
  * @param stored 数据库中已持久化的消息记录，包含会话 ID、消息类型等。
  * @param sender_id 发送者用户 ID；系统消息同样保留真实 sender_id，由 msg_type 区分。
@@ -236,48 +326,20 @@ auto Server::broadcast_system_message(
  */
 auto Server::broadcast_world_message(database::StoredMessage const& stored,i64 sender_id,std::string const& content,std::string const& sender_display_name) -> void
 {
-    dispatch_on_strand([=, this]() {
-        json push;
-        push["conversationId"] = std::to_string(stored.conversation_id);
-        
-        // 优化：使用缓存获取会话信息,从 3 次数据库查询减少到 0-1 次
-        std::string conv_type{ "GROUP" };
-        std::string sender_name = sender_display_name;
-        std::vector<i64> member_ids;
-        
-        // 从缓存获取会话类型和成员列表
-        if(auto cache = get_conversation_cache(stored.conversation_id)) {
-            conv_type = cache->type;
-            member_ids = cache->member_ids;
-        }
-        
-        // 若缺失昵称则留空，客户端可自行降级展示
-        
-        push["conversationType"] = conv_type;
-        push["serverMsgId"] = std::to_string(stored.id);
-        push["senderId"] = std::to_string(sender_id);
-        push["senderDisplayName"] = sender_name;
-        push["msgType"] = stored.msg_type.empty() ? "TEXT" : stored.msg_type;
-        push["serverTimeMs"] = stored.server_time_ms;
-        push["seq"] = stored.seq;
-        push["content"] = content;
-
-        auto const line = protocol::make_line("MSG_PUSH", push.dump());
-
-        auto const send_line = [&line](std::shared_ptr<Session> const& session) {
-            if(session->is_authenticated()) {
-                session->send_text(line);
-            }
-        };
+    json push;
+    push["conversationId"] = std::to_string(stored.conversation_id);
+    // 若缺失昵称则留空，客户端可自行降级展示
+    push["serverMsgId"] = std::to_string(stored.id);
+    push["senderId"] = std::to_string(sender_id);
+    push["senderDisplayName"] = sender_display_name;
+    push["msgType"] = stored.msg_type.empty() ? "TEXT" : stored.msg_type;
+    push["serverTimeMs"] = stored.server_time_ms;
+    push["seq"] = stored.seq;
+    push["content"] = content;
 
-        if(member_ids.empty()) {
-            for_all_authenticated_sessions(send_line);
-            return;
-        }
-
-        std::unordered_set<i64> member_set{ member_ids.begin(), member_ids.end() };
-        for(auto const uid : member_set) {
-            for_user_sessions(uid, send_line);
-        }
+    // 会话类型来自缓存，命中时不访问数据库
+    fan_out_conversation(stored.conversation_id, [push = std::move(push)](std::string const& type) mutable {
+        push["conversationType"] = type;
+        return protocol::make_shared_frame("MSG_PUSH", push.dump());
     });
 }
@@ -11,44 +11,237 @@
 #include <database.h>
 #include <database/conversation.h>
 
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/detached.hpp>
+#include <boost/asio/use_awaitable.hpp>
+#include <boost/asio/redirect_error.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/this_coro.hpp>
+#include <boost/asio/experimental/concurrent_channel.hpp>
+
 #include <optional>
 #include <print>
 #include <algorithm>
+#include <stdexcept>
+#include <string>
 
 /**
- * @brief 获取指定会话的缓存信息。
+ * @brief 一次进行中的会话缓存回源。
+ *
+ * 同一会话的所有未命中共享一个实例：推送类调用把帧构造函数排进 `pending`，
+ * 协程类调用登记 `waiters` 等待结果。回源期间若成员发生变化则置 `stale`，
+ * 加载结果仍用于排队的推送（它们发生在变化之前），但不写入缓存。
+ * 除 `result` 外的字段均受 `cache_mutex_` 保护；`result` 在唤醒等待方之前写入。
+ */
+struct Server::ConversationCacheLoad
+{
+    using Signal = asio::experimental::concurrent_channel<void(boost::system::error_code)>;
+
+    std::vector<ConversationFrameBuilder> pending{};
+    std::vector<std::shared_ptr<Signal>> waiters{};
+    std::optional<ConversationCache> result{};
+    /// \brief 回源失败时的错误信息，与“会话不存在”（result 为空且无错误）区分。
+    std::optional<std::string> error{};
+    bool stale{ false };
+};
+
+/**
+ * @brief 登记一次缓存未命中（调用方已持有 `cache_mutex_`）。
+ *
+ * @param conversation_id 会话 ID。
+ * @param started 新建回源时置为 true，调用方须在解锁后启动回源协程。
+ * @return 该会话进行中的回源。
+ */
+auto Server::join_conversation_cache_load(i64 conversation_id, bool& started) -> std::shared_ptr<ConversationCacheLoad>
+{
+    auto& load = conv_cache_loads_[conversation_id];
+    started = !load;
+    if(!load) {
+        load = std::make_shared<ConversationCacheLoad>();
+    }
+    return load;
+}
+
+/**
+ * @brief 回源加载会话类型与成员列表。
+ *
+ * 加载完成后在锁内写入缓存、摘除进行中的回源，并按排队顺序投递推送；
+ * `publish_conversation` 只向分片 strand 投递任务，因此在锁内调用是安全的，
+ * 也保证了排队的推送先于此后命中缓存的推送进入各分片。
+ * 会话不存在或加载失败时排队的推送被丢弃（不再退化为全员广播）。
+ *
+ * @param conversation_id 会话 ID。
+ */
+auto Server::load_conversation_cache(i64 conversation_id) -> asio::awaitable<void>
+{
+    std::optional<ConversationCache> loaded;
+    std::optional<std::string> error;
+    try {
+        auto type = co_await database::get_conversation_type(conversation_id);
+        if(!type.empty()) {
+            auto const members = co_await database::load_conversation_members(conversation_id);
+            ConversationCache cache{};
+            cache.type = std::move(type);
+            cache.member_ids.reserve(members.size());
+            for(auto const& m : members) {
+                cache.member_ids.push_back(m.user_id);
+                if(m.muted_until_ms > 0) {
+                    cache.muted_until_ms[m.user_id] = m.muted_until_ms;
+                }
+            }
+            loaded = std::move(cache);
+        }
+    } catch(std::exception const& ex) {
+        std::println("[cache] load conversation {} failed: {}", conversation_id, ex.what());
+        error = ex.what();
+    }
+
+    std::shared_ptr<ConversationCacheLoad> load;
+    {
+        std::lock_guard lock{ cache_mutex_ };
+        auto it = conv_cache_loads_.find(conversation_id);
+        if(it == conv_cache_loads_.end()) {
+            co_return;
+        }
+        load = std::move(it->second);
+        conv_cache_loads_.erase(it);
+
+        if(loaded) {
+            loaded->last_access = std::chrono::steady_clock::now();
+            if(!load->stale) {
+                conv_cache_[conversation_id] = *loaded;
+            }
+            for(auto const& build : load->pending) {
+                if(auto frame = build(loaded->type)) {
+                    publish_conversation(conversation_id, std::move(frame));
+                }
+            }
+        }
+        load->pending.clear();
+    }
+
+    load->result = std::move(loaded);
+    load->error = std::move(error);
+    for(auto const& waiter : load->waiters) {
+        waiter->try_send(boost::system::error_code{});
+    }
+}
+
+/**
+ * @brief 在后台执行器上启动回源协程，协程持有 Server 的强引用。
+ */
+auto Server::start_conversation_cache_load(i64 conversation_id) -> void
+{
+    asio::co_spawn(
+        exec_,
+        [self = shared_from_this(), conversation_id]() -> asio::awaitable<void> {
+            co_await self->load_conversation_cache(conversation_id);
+        },
+        asio::detached
+    );
+}
+
+/**
+ * @brief 获取指定会话的缓存信息（读穿）。
  *
  * 优先从内存缓存中读取会话类型与成员列表；若缓存未命中，则回源数据库，
- * 将结果写入缓存并返回。若会话 ID 非法或加载失败，则返回空。
+ * 同一会话的并发未命中只触发一次加载，结果写入缓存后返回。
  *
  * @param conversation_id 会话 ID，小于等于 0 时直接返回空。
- * @return 对应会话的缓存对象；当不存在或加载失败时为 `std::nullopt`。
+ * @return 对应会话的缓存对象；会话不存在时为 `std::nullopt`。
+ * @throws std::runtime_error 回源查询失败。
  */
-auto Server::get_conversation_cache(i64 conversation_id) -> std::optional<ConversationCache>
+auto Server::get_conversation_cache_checked(i64 conversation_id) -> asio::awaitable<std::optional<ConversationCache>>
 {
     if(conversation_id <= 0) {
-        return std::nullopt;
+        co_return std::nullopt;
+    }
+
+    auto const exec = co_await asio::this_coro::executor;
+    auto const signal = std::make_shared<ConversationCacheLoad::Signal>(exec, 1);
+    std::shared_ptr<ConversationCacheLoad> load;
+    bool started = false;
+    {
+        std::lock_guard lock{ cache_mutex_ };
+        if(auto it = conv_cache_.find(conversation_id); it != conv_cache_.end()) {
+            it->second.last_access = std::chrono::steady_clock::now();
+            co_return it->second;
+        }
+        load = join_conversation_cache_load(conversation_id, started);
+        load->waiters.push_back(signal);
+    }
+
+    if(started) {
+        start_conversation_cache_load(conversation_id);
     }
 
-    // 先尝试从缓存获取
+    boost::system::error_code ec;
+    co_await signal->async_receive(asio::redirect_error(asio::use_awaitable, ec));
+    if(load->error) {
+        throw std::runtime_error{ *load->error };
+    }
+    co_return load->result;
+}
+
+/**
+ * @brief 与 `get_conversation_cache_checked` 相同，但把加载失败也当作不存在。
+ *
+ * @param conversation_id 会话 ID。
+ * @return 对应会话的缓存对象；当不存在或加载失败时为 `std::nullopt`。
+ */
+auto Server::get_conversation_cache(i64 conversation_id) -> asio::awaitable<std::optional<ConversationCache>>
+{
+    try {
+        co_return co_await get_conversation_cache_checked(conversation_id);
+    } catch(std::runtime_error const&) {
+        co_return std::nullopt;
+    }
+}
+
+/**
+ * @brief 向会话的在线成员推送一帧。
+ *
+ * 命中缓存时在锁外构造帧并投递；未命中时把构造函数排进进行中的回源，
+ * 由回源协程在加载完成后按顺序投递，调用方不必等待。
+ *
+ * @param conversation_id 会话 ID，小于等于 0 时不做处理。
+ * @param build 帧构造函数，返回空帧表示不推送。
+ */
+auto Server::fan_out_conversation(i64 conversation_id, ConversationFrameBuilder build) -> void
+{
+    if(conversation_id <= 0 || !build) {
+        return;
+    }
+
+    // 接收者来自在线订阅索引，命中时只需复制会话类型，不再复制成员列表
+    std::optional<std::string> type;
+    bool started = false;
     {
         std::lock_guard lock{ cache_mutex_ };
-        auto it = conv_cache_.find(conversation_id);
-        if(it != conv_cache_.end()) {
-            // 更新最后访问时间
+        if(auto it = conv_cache_.find(conversation_id); it != conv_cache_.end()) {
             it->second.last_access = std::chrono::steady_clock::now();
-            return it->second;
+            type = it->second.type;
+        } else {
+            join_conversation_cache_load(conversation_id, started)->pending.push_back(std::move(build));
         }
     }
 
-    // 暂不从数据库回源，直接返回空，调用方将退化为广播给所有在线会话
-    return std::nullopt;
+    if(type) {
+        if(auto frame = build(*type)) {
+            publish_conversation(conversation_id, std::move(frame));
+        }
+        return;
+    }
+    if(started) {
+        start_conversation_cache_load(conversation_id);
+    }
 }
 
 /**
  * @brief 使指定会话的缓存条目失效。
  *
- * 从 `conv_cache_` 中移除给定会话 ID 对应的缓存记录。
+ * 从 `conv_cache_` 中移除给定会话 ID 对应的缓存记录；
+ * 若该会话正在回源，则本次加载结果不再写入缓存。
  *
  * @param conversation_id 目标会话 ID，小于等于 0 时不做处理。
  */
@@ -60,13 +253,172 @@ auto Server::invalidate_conversation_cache(i64 conversation_id) -> void
 
     std::lock_guard lock{ cache_mutex_ };
     conv_cache_.erase(conversation_id);
+    if(auto it = conv_cache_loads_.find(conversation_id); it != conv_cache_loads_.end()) {
+        it->second->stale = true;
+    }
+}
+
+/**
+ * @brief 成员加入后就地更新会话缓存。
+ *
+ * 已缓存时追加成员（已存在则忽略）；正在回源时无法确定加载结果是否包含该成员，
+ * 标记为过期；未缓存时无需处理，下次未命中会从数据库加载到最新成员。
+ */
+auto Server::add_conversation_cache_member(i64 conversation_id, i64 user_id) -> void
+{
+    if(conversation_id <= 0 || user_id <= 0) {
+        return;
+    }
+
+    std::lock_guard lock{ cache_mutex_ };
+    if(auto it = conv_cache_.find(conversation_id); it != conv_cache_.end()) {
+        auto& ids = it->second.member_ids;
+        if(std::ranges::find(ids, user_id) == ids.end()) {
+            ids.push_back(user_id);
+        }
+    }
+    if(auto it = conv_cache_loads_.find(conversation_id); it != conv_cache_loads_.end()) {
+        it->second->stale = true;
+    }
+}
+
+/**
+ * @brief 成员离开后就地更新会话缓存，处理方式与 `add_conversation_cache_member` 对称。
+ */
+auto Server::remove_conversation_cache_member(i64 conversation_id, i64 user_id) -> void
+{
+    if(conversation_id <= 0 || user_id <= 0) {
+        return;
+    }
+
+    std::lock_guard lock{ cache_mutex_ };
+    if(auto it = conv_cache_.find(conversation_id); it != conv_cache_.end()) {
+        std::erase(it->second.member_ids, user_id);
+        it->second.muted_until_ms.erase(user_id);
+    }
+    if(auto it = conv_cache_loads_.find(conversation_id); it != conv_cache_loads_.end()) {
+        it->second->stale = true;
+    }
+}
+
+/**
+ * @brief 禁言状态变化后就地更新会话缓存。
+ *
+ * 已缓存时写入或清除该成员的禁言截止时间；正在回源时标记为过期。
+ *
+ * @param muted_until_ms 禁言截止毫秒时间戳，小于等于 0 表示解除禁言。
+ */
+auto Server::set_conversation_cache_mute(i64 conversation_id, i64 user_id, i64 muted_until_ms) -> void
+{
+    if(conversation_id <= 0 || user_id <= 0) {
+        return;
+    }
+
+    std::lock_guard lock{ cache_mutex_ };
+    if(auto it = conv_cache_.find(conversation_id); it != conv_cache_.end()) {
+        if(muted_until_ms > 0) {
+            it->second.muted_until_ms[user_id] = muted_until_ms;
+        } else {
+            it->second.muted_until_ms.erase(user_id);
+        }
+    }
+    if(auto it = conv_cache_loads_.find(conversation_id); it != conv_cache_loads_.end()) {
+        it->second->stale = true;
+    }
+}
+
+/**
+ * @brief 取发送者在会话中的鉴权信息。
+ *
+ * 命中缓存时直接在锁内计算，不复制成员列表；未命中时经 `get_conversation_cache` 回源。
+ * 单聊对端取成员中第一个不是发送者的用户，与 `database::get_single_peer_user_id` 一致。
+ *
+ * @param conversation_id 会话 ID。
+ * @param user_id 发送者用户 ID。
+ * @return 会话不存在时为 `std::nullopt`。
+ * @throws std::runtime_error 回源查询失败，调用方不能据此放行发送。
+ */
+auto Server::get_send_context(i64 conversation_id, i64 user_id) -> asio::awaitable<std::optional<SendContext>>
+{
+    auto const make = [user_id](ConversationCache const& cache) {
+        SendContext ctx{};
+        ctx.type = cache.type;
+        if(auto it = cache.muted_until_ms.find(user_id); it != cache.muted_until_ms.end()) {
+            ctx.muted_until_ms = it->second;
+        }
+        if(cache.type == "SINGLE") {
+            auto const peer = std::ranges::find_if(cache.member_ids, [user_id](i64 id) { return id != user_id; });
+            if(peer != cache.member_ids.end()) {
+                ctx.peer_id = *peer;
+            }
+        }
+        return ctx;
+    };
+
+    {
+        std::lock_guard lock{ cache_mutex_ };
+        if(auto it = conv_cache_.find(conversation_id); it != conv_cache_.end()) {
+            it->second.last_access = std::chrono::steady_clock::now();
+            co_return make(it->second);
+        }
+    }
+
+    auto const cache = co_await get_conversation_cache_checked(conversation_id);
+    if(!cache) {
+        co_return std::nullopt;
+    }
+    co_return make(*cache);
+}
+
+/**
+ * @brief 查询两人是否为好友。
+ *
+ * 好友关系总是双向建立与解除，因此按无序用户对缓存；未命中时查询数据库，
+ * 若查询期间有好友关系变更（`friend_cache_epoch_` 变化）或缓存已满则不写入缓存。
+ */
+auto Server::is_friend_cached(i64 user_id, i64 peer_id) -> asio::awaitable<bool>
+{
+    auto const key = std::pair{ std::min(user_id, peer_id), std::max(user_id, peer_id) };
+    u64 epoch = 0;
+    {
+        std::lock_guard lock{ cache_mutex_ };
+        if(auto it = friend_cache_.find(key); it != friend_cache_.end()) {
+            it->second.last_access = std::chrono::steady_clock::now();
+            co_return it->second.is_friend;
+        }
+        epoch = friend_cache_epoch_;
+    }
+
+    auto const is_friend = co_await database::is_friend(user_id, peer_id);
+
+    std::lock_guard lock{ cache_mutex_ };
+    if(friend_cache_epoch_ == epoch && friend_cache_.size() < MAX_FRIEND_CACHE_ENTRIES) {
+        friend_cache_[key] = FriendCacheEntry{ is_friend, std::chrono::steady_clock::now() };
+    }
+    co_return is_friend;
+}
+
+/**
+ * @brief 好友关系建立或解除后更新缓存。
+ */
+auto Server::set_friend_cache(i64 user_id, i64 peer_id, bool is_friend) -> void
+{
+    if(user_id <= 0 || peer_id <= 0) {
+        return;
+    }
+
+    std::lock_guard lock{ cache_mutex_ };
+    ++friend_cache_epoch_;
+    // 变更必须覆盖旧值，即使缓存已满也写入
+    friend_cache_[std::pair{ std::min(user_id, peer_id), std::max(user_id, peer_id) }]
+        = FriendCacheEntry{ is_friend, std::chrono::steady_clock::now() };
 }
 
 /**
  * @brief 清理超时未访问的会话缓存。
  *
- * 遍历 `conv_cache_`，删除 `last_access` 超过 `CACHE_EXPIRE_DURATION`
- * 的缓存条目，用于限制缓存大小和过期数据驻留时间。
+ * 遍历 `conv_cache_`、`member_cache_` 与 `friend_cache_`，删除 `last_access` 超过
+ * `CACHE_EXPIRE_DURATION` 的缓存条目，用于限制缓存大小和过期数据驻留时间。
  */
 auto Server::cleanup_expired_cache() -> void
 {
@@ -82,6 +434,31 @@ auto Server::cleanup_expired_cache() -> void
         auto const age = now - pair.second.last_access;
         return age > CACHE_EXPIRE_DURATION;
     });
+
+    std::erase_if(friend_cache_, [&](auto const& pair) {
+        auto const age = now - pair.second.last_access;
+        return age > CACHE_EXPIRE_DURATION;
+    });
+}
+
+/**
+ * @brief 周期性清理过期缓存，直到执行器停止。
+ *
+ * 未命中时会话缓存与成员列表缓存都会回源写入（包括世界频道的完整成员列表），
+ * 只靠访问时间无法回收不再访问的条目，因此由本协程定期清理。
+ */
+auto Server::cache_cleanup_loop() -> asio::awaitable<void>
+{
+    asio::steady_timer timer{ exec_ };
+    while(true) {
+        timer.expires_after(CACHE_CLEANUP_INTERVAL);
+        boost::system::error_code ec;
+        co_await timer.async_wait(asio::redirect_error(asio::use_awaitable, ec));
+        if(ec) {
+            co_return;
+        }
+        cleanup_expired_cache();
+    }
 }
 
 auto Server::get_member_list_cache(i64 conversation_id) -> std::optional<MemberListCache>
@@ -0,0 +1,259 @@
+/**
+ * @file
+ * @brief 推送扇出：把一帧已序列化的负载投递给一组接收者的在线会话。
+ *
+ * 接收者按 user_id 所属分片分桶，每个分片维护一个扇出队列，
+ * 在分片 strand 上按 `Server::fan_out_chunk_size` 分块投递；
+ * 每投递完一块就重新 post 自己，让登录、下线等注册表操作插在两块之间执行，
+ * 万人会话的一次推送不会长时间独占分片。不同分片的队列在各自 strand 上并行推进。
+ *
+ * 同一分片内的任务严格按入队顺序完成，同一用户的会话总在同一分片，
+ * 因此先后两次推送到达同一会话的顺序不变。
+ *
+ * 会话内推送走 `publish_conversation`：接收者取自各分片的在线订阅索引（见 subscriptions.cpp），
+ * 而不是会话的全部成员。
+ */
+#include <session.h>
+#include <server.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+
+namespace
+{
+    using clock = std::chrono::steady_clock;
+
+    auto elapsed_us(clock::time_point from, clock::time_point to) -> u64
+    {
+        return static_cast<u64>(std::max<i64>(
+            std::chrono::duration_cast<std::chrono::microseconds>(to - from).count(), 0
+        ));
+    }
+
+    auto update_max(std::atomic<u64>& target, u64 value) -> void
+    {
+        auto prev = target.load(std::memory_order_relaxed);
+        while(value > prev && !target.compare_exchange_weak(prev, value, std::memory_order_relaxed)) {
+        }
+    }
+} // namespace
+
+/**
+ * @brief 一次扇出在各分片间共享的状态，用于统计从首个接收者到最后一个接收者的耗时。
+ */
+struct Server::FanoutJob
+{
+    explicit FanoutJob(std::size_t shards)
+        : pending_shards(shards)
+    {}
+
+    protocol::SharedFrame frame;
+    clock::time_point queued{ clock::now() };
+    /// \brief 尚未投递完的分片数，归零时记录本次扇出的统计。
+    std::atomic<std::size_t> pending_shards;
+    /// \brief 首块开始投递的时间（steady_clock 计数），0 表示尚未开始。
+    std::atomic<clock::rep> first_ticks{ 0 };
+    std::atomic<u64> deliveries{ 0 };
+};
+
+/**
+ * @brief 将一帧推送给一组用户的在线会话。
+ *
+ * 先对接收者去重，再按 user_id 所属分片分桶，每个非空桶作为一个任务
+ * post 到对应分片的扇出队列，调用方不会被任何分片阻塞。
+ *
+ * @param user_ids 接收者用户 ID 列表，允许重复。
+ * @param frame 共享的只读出站帧，所有接收方引用同一份内存。
+ */
+auto Server::fan_out(std::vector<i64> user_ids, protocol::SharedFrame frame) -> void
+{
+    if(!frame || user_ids.empty()) {
+        return;
+    }
+
+    std::ranges::sort(user_ids);
+    auto const dup = std::ranges::unique(user_ids);
+    user_ids.erase(dup.begin(), dup.end());
+
+    std::vector<std::vector<i64>> buckets(shards_.size());
+    for(auto const uid : user_ids) {
+        buckets[shard_index(uid)].push_back(uid);
+    }
+
+    auto const shards = static_cast<std::size_t>(std::ranges::count_if(buckets, [](auto const& b) {
+        return !b.empty();
+    }));
+    auto job = std::make_shared<FanoutJob>(shards);
+    job->frame = std::move(frame);
+
+    for(std::size_t i = 0; i < buckets.size(); ++i) {
+        if(buckets[i].empty()) {
+            continue;
+        }
+        auto& shard = *shards_[i];
+        asio::post(shard.strand, [this, &shard, task = FanoutTask{ job, std::move(buckets[i]) }]() mutable {
+            enqueue_fan_out(shard, std::move(task));
+        });
+    }
+}
+
+/**
+ * @brief 将一帧推送给订阅了该会话的所有在线会话。
+ *
+ * 每个分片在自己的 strand 上取该会话的订阅者快照并排入扇出队列，
+ * 开销只与在线成员数相关，不再展开会话的全部成员。
+ * 快照在入队时取得，此前已投递的订阅变更（加入、退出、解散）对本次推送可见。
+ *
+ * @param conversation_id 会话 ID。
+ * @param frame 共享的只读出站帧。
+ */
+auto Server::publish_conversation(i64 conversation_id, protocol::SharedFrame frame) -> void
+{
+    if(!frame || conversation_id <= 0) {
+        return;
+    }
+
+    auto job = std::make_shared<FanoutJob>(shards_.size());
+    job->frame = std::move(frame);
+    for(auto& shard_ptr : shards_) {
+        auto& shard = *shard_ptr;
+        asio::post(shard.strand, [this, &shard, conversation_id, job]() {
+            auto task = FanoutTask{ job, {} };
+            if(auto it = shard.subscribers.find(conversation_id); it != shard.subscribers.end()) {
+                task.user_ids.assign(it->second.begin(), it->second.end());
+            }
+            enqueue_fan_out(shard, std::move(task));
+        });
+    }
+}
+
+/**
+ * @brief 把一个扇出任务排入分片队列，队列空闲时立即开始投递。
+ *
+ * 没有接收者的任务直接视为完成，不占用队列。
+ *
+ * @param shard 目标分片，调用方已位于其 strand 上。
+ * @param task 该分片内的接收者。
+ */
+auto Server::enqueue_fan_out(SessionShard& shard, FanoutTask task) -> void
+{
+    if(task.user_ids.empty()) {
+        if(task.job->pending_shards.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            finish_fan_out(*task.job);
+        }
+        return;
+    }
+    shard.fanout_queue.push_back(std::move(task));
+    if(!shard.fanout_draining) {
+        shard.fanout_draining = true;
+        drain_fan_out(shard);
+    }
+}
+
+/**
+ * @brief 在分片 strand 上投递队首任务的下一块接收者。
+ *
+ * 每块结束后若队列未空则重新 post 自己，而不是在同一次调度中继续，
+ * 使期间排入该 strand 的其他操作得以执行。
+ *
+ * @param shard 当前分片，调用方已位于其 strand 上。
+ */
+auto Server::drain_fan_out(SessionShard& shard) -> void
+{
+    auto& task = shard.fanout_queue.front();
+    auto& job = *task.job;
+    auto const start = clock::now();
+    clock::rep unset = 0;
+    job.first_ticks.compare_exchange_strong(unset, start.time_since_epoch().count(), std::memory_order_relaxed);
+
+    auto const chunk = std::max<std::size_t>(fan_out_chunk_size, 1);
+    auto const end = std::min(task.user_ids.size(), task.next + chunk);
+    u64 delivered = 0;
+    for(; task.next < end; ++task.next) {
+        for(auto [it,last] = shard.sessions_by_user.equal_range(task.user_ids[task.next]); it != last; ) {
+            if(auto s = it->second.lock()) {
+                if(s->is_authenticated()) {
+                    s->send_frame(job.frame);
+                    ++delivered;
+                }
+                ++it;
+            } else {
+                it = shard.sessions_by_user.erase(it);
+            }
+        }
+    }
+    fanout_counters_.chunks.fetch_add(1, std::memory_order_relaxed);
+    job.deliveries.fetch_add(delivered, std::memory_order_relaxed);
+
+    if(task.next == task.user_ids.size()) {
+        if(job.pending_shards.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            finish_fan_out(job);
+        }
+        shard.fanout_queue.pop_front();
+    }
+
+    if(shard.fanout_queue.empty()) {
+        shard.fanout_draining = false;
+        return;
+    }
+    asio::post(shard.strand, [this, &shard]() {
+        drain_fan_out(shard);
+    });
+}
+
+/**
+ * @brief 最后一个分片投递完成时记录本次扇出的耗时。
+ */
+auto Server::finish_fan_out(FanoutJob const& job) -> void
+{
+    auto const first_ticks = job.first_ticks.load(std::memory_order_relaxed);
+    if(first_ticks == 0) {
+        // 所有分片都没有在线接收者
+        return;
+    }
+    auto const now = clock::now();
+    auto const first = clock::time_point{ clock::duration{ first_ticks } };
+    auto const span_us = elapsed_us(first, now);
+    auto const delay_us = elapsed_us(job.queued, first);
+
+    auto& c = fanout_counters_;
+    c.fanouts.fetch_add(1, std::memory_order_relaxed);
+    c.deliveries.fetch_add(job.deliveries.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    c.total_span_us.fetch_add(span_us, std::memory_order_relaxed);
+    c.total_delay_us.fetch_add(delay_us, std::memory_order_relaxed);
+    update_max(c.max_span_us, span_us);
+    update_max(c.max_delay_us, delay_us);
+}
+
+/**
+ * @brief 读取扇出统计快照。
+ */
+auto Server::fanout_stats() const -> FanoutStats
+{
+    auto const& c = fanout_counters_;
+    return {
+        .fanouts = c.fanouts.load(std::memory_order_relaxed),
+        .chunks = c.chunks.load(std::memory_order_relaxed),
+        .deliveries = c.deliveries.load(std::memory_order_relaxed),
+        .total_span_us = c.total_span_us.load(std::memory_order_relaxed),
+        .max_span_us = c.max_span_us.load(std::memory_order_relaxed),
+        .total_delay_us = c.total_delay_us.load(std::memory_order_relaxed),
+        .max_delay_us = c.max_delay_us.load(std::memory_order_relaxed),
+    };
+}
+
+/**
+ * @brief 将一帧推送给所有已鉴权会话（每个分片并行执行）。
+ *
+ * @param frame 共享的只读出站帧。
+ */
+auto Server::fan_out_all(protocol::SharedFrame frame) -> void
+{
+    if(!frame) {
+        return;
+    }
+    for_all_authenticated_sessions([frame](std::shared_ptr<Session> const& session) {
+        session->send_frame(frame);
+    });
+}
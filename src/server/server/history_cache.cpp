@@ -0,0 +1,89 @@
+/**
+ * @file
+ * @brief 已序列化 HISTORY_RESP 页的缓存。
+ *
+ * 大量客户端重连后会请求同一会话的同一页历史（典型是世界频道最新一页），
+ * 每次都重新构造 json 并序列化是重复劳动。这里按 (会话, 游标, 条数) 缓存
+ * 组装好的出站帧，所有请求方共享同一份字节。
+ *
+ * 失效不靠逐条通知：每页记录生成时的会话历史版本号，
+ * 查询时与 `database::message_cache_version` 比较，不一致即丢弃。
+ */
+#include <server.h>
+
+#include <mutex>
+
+namespace
+{
+    /// \brief 估算一页缓存占用的内存。
+    auto page_bytes(protocol::OutboundFrame const& frame) -> std::size_t
+    {
+        return sizeof(protocol::OutboundFrame) + frame.prefix.size() + frame.payload.size() + 64;
+    }
+} // namespace
+
+auto Server::get_history_page(HistoryPageKey const& key, u64 version) -> protocol::SharedFrame
+{
+    std::lock_guard lock{ history_mutex_ };
+    auto it = history_pages_.find(key);
+    if(it == history_pages_.end()) {
+        ++history_stats_.misses;
+        return nullptr;
+    }
+    if(it->second.version != version) {
+        // 会话历史已变化，旧页不会再被命中
+        history_bytes_ -= page_bytes(*it->second.frame);
+        history_lru_.erase(it->second.lru);
+        history_pages_.erase(it);
+        ++history_stats_.misses;
+        return nullptr;
+    }
+
+    ++history_stats_.hits;
+    history_lru_.splice(history_lru_.begin(), history_lru_, it->second.lru);
+    return it->second.frame;
+}
+
+auto Server::put_history_page(HistoryPageKey const& key, u64 version, protocol::SharedFrame frame) -> void
+{
+    if(!frame) {
+        return;
+    }
+    auto const bytes = page_bytes(*frame);
+    if(bytes > history_page_cache_bytes) {
+        return;
+    }
+
+    std::lock_guard lock{ history_mutex_ };
+    auto it = history_pages_.find(key);
+    if(it != history_pages_.end()) {
+        // 并发未命中时可能先后写入，只保留版本更新的一份
+        if(it->second.version > version) {
+            return;
+        }
+        history_bytes_ -= page_bytes(*it->second.frame);
+        history_lru_.splice(history_lru_.begin(), history_lru_, it->second.lru);
+        it->second.version = version;
+        it->second.frame = std::move(frame);
+    } else {
+        history_lru_.push_front(key);
+        history_pages_.emplace(key, HistoryPage{ version, std::move(frame), history_lru_.begin() });
+    }
+    history_bytes_ += bytes;
+
+    while(history_bytes_ > history_page_cache_bytes && !history_lru_.empty()) {
+        auto victim = history_pages_.find(history_lru_.back());
+        history_bytes_ -= page_bytes(*victim->second.frame);
+        history_pages_.erase(victim);
+        history_lru_.pop_back();
+    }
+}
+
+auto Server::history_page_stats() -> HistoryPageStats
+{
+    std::lock_guard lock{ history_mutex_ };
+    auto stats = history_stats_;
+    stats.pages = history_pages_.size();
+    stats.bytes = history_bytes_;
+    return stats;
+}
@@ -6,47 +6,65 @@
 
 #include <nlohmann/json.hpp>
 
-#include <unordered_set>
+#include <algorithm>
 #include <vector>
 #include <print>
 
 using nlohmann::json;
 
-auto Server::send_friend_request_list_to(i64 target_user_id) -> void
+namespace
 {
-    if(target_user_id <= 0) {
+    /// \brief 会话列表项，字段与 CONV_LIST_RESP 中的元素一致。
+    auto conversation_json(database::ConversationInfo const& conv) -> json
+    {
+        json c;
+        c["conversationId"] = std::to_string(conv.id);
+        c["conversationType"] = conv.type;
+        c["title"] = conv.title;
+        c["lastSeq"] = conv.last_seq;
+        c["lastServerTimeMs"] = conv.last_server_time_ms;
+        c["avatarPath"] = conv.avatar_path;
+        c["lastReadSeq"] = conv.last_read_seq;
+        c["unreadCount"] = conv.unread_count;
+        c["preview"] = conv.last_message_preview;
+        c["time"] = conv.last_message_time;
+        return c;
+    }
+
+    /// \brief 只在值非空时写入字段，增量推送据此区分“未变化”与“清空”。
+    auto put_if_set(json& obj, char const* key, std::string const& value) -> void
+    {
+        if(!value.empty()) {
+            obj[key] = value;
+        }
+    }
+} // namespace
+
+/**
+ * @brief 向若干成员推送某个会话在各自视角下的列表项。
+ *
+ * 标题（单聊为对端昵称）、未读数与预览因人而异，每人一帧；
+ * 全部成员的行由一次按会话主键的查询取得，代价与接收者数量成正比，与其会话总数无关。
+ *
+ * @param conversation_id 会话 ID。
+ * @param user_ids 接收者，不是该会话成员的用户被忽略。
+ */
+auto Server::push_conv_upsert(i64 conversation_id, std::vector<i64> user_ids) -> void
+{
+    if(conversation_id <= 0 || user_ids.empty()) {
         return;
     }
 
     asio::co_spawn(
-        strand_,
-        [this, target_user_id]() -> asio::awaitable<void> {
+        exec_,
+        [this, conversation_id, user_ids = std::move(user_ids)]() -> asio::awaitable<void> {
             try {
-                auto const requests = co_await database::load_incoming_friend_requests(target_user_id);
-
-                json resp;
-                resp["ok"] = true;
-
-                json items = json::array();
-                for(auto const& r : requests) {
-                    json obj;
-                    obj["requestId"] = std::to_string(r.id);
-                    obj["fromUserId"] = std::to_string(r.from_user_id);
-                    obj["account"] = r.account;
-                    obj["displayName"] = Session::normalize_whitespace(r.display_name);
-                    obj["status"] = r.status;
-                    obj["helloMsg"] = r.hello_msg;
-                    items.push_back(std::move(obj));
+                auto const rows = co_await database::load_conversation_for_members(conversation_id, user_ids);
+                for(auto const& [uid, conv] : rows) {
+                    json push;
+                    push["conversation"] = conversation_json(conv);
+                    fan_out({ uid }, protocol::make_shared_frame("CONV_UPSERT_PUSH", push.dump()));
                 }
-
-                resp["requests"] = std::move(items);
-                auto const line = protocol::make_line("FRIEND_REQ_LIST_RESP", resp.dump());
-
-                for_user_sessions(target_user_id, [&line](std::shared_ptr<Session> const& s) {
-                    if(s->authenticated_) {
-                        s->send_text(line);
-                    }
-                });
             } catch(...) {
             }
             co_return;
@@ -55,93 +73,94 @@ auto Server::send_friend_request_list_to(i64 target_user_id) -> void
     );
 }
 
-auto Server::send_friend_list_to(i64 target_user_id) -> void
+/**
+ * @brief 群名变化对所有成员相同，一帧经订阅索引推送给在线成员，无需查询数据库。
+ */
+auto Server::push_conv_title(i64 conversation_id, std::string const& title) -> void
 {
-    if(target_user_id <= 0) {
+    if(conversation_id <= 0) {
         return;
     }
 
-    asio::co_spawn(
-        strand_,
-        [this, target_user_id]() -> asio::awaitable<void> {
-            try {
-                auto const friends = co_await database::load_user_friends(target_user_id);
-
-                json resp;
-                resp["ok"] = true;
-
-                json items = json::array();
-                for(auto const& f : friends) {
-                    json u;
-                    u["userId"] = std::to_string(f.id);
-                    u["account"] = f.account;
-                    u["displayName"] = Session::normalize_whitespace(f.display_name);
-                    u["region"] = "";
-                    u["signature"] = "";
-                    items.push_back(std::move(u));
-                }
+    json conv;
+    conv["conversationId"] = std::to_string(conversation_id);
+    conv["title"] = title;
+    json push;
+    push["conversation"] = std::move(conv);
+    publish_conversation(conversation_id, protocol::make_shared_frame("CONV_UPSERT_PUSH", push.dump()));
+}
 
-                resp["friends"] = std::move(items);
-                auto const line = protocol::make_line("FRIEND_LIST_RESP", resp.dump());
+auto Server::push_conv_remove(i64 conversation_id, std::vector<i64> user_ids) -> void
+{
+    if(conversation_id <= 0) {
+        return;
+    }
 
-                for_user_sessions(target_user_id, [&line](std::shared_ptr<Session> const& s) {
-                    if(s->is_authenticated()) {
-                        s->send_text(line);
-                    }
-                });
-            } catch(...) {
-            }
-            co_return;
-        },
-        asio::detached
-    );
+    json push;
+    push["conversationId"] = std::to_string(conversation_id);
+    fan_out(std::move(user_ids), protocol::make_shared_frame("CONV_REMOVE_PUSH", push.dump()));
 }
 
-auto Server::send_conv_list_to(i64 target_user_id) -> void
+auto Server::push_friend_upsert(i64 target_user_id, database::FriendInfo const& info) -> void
 {
-    if(target_user_id <= 0) {
+    if(target_user_id <= 0 || info.id <= 0) {
         return;
     }
 
-    asio::co_spawn(
-        strand_,
-        [this, target_user_id]() -> asio::awaitable<void> {
-            try {
-                auto const conversations = co_await database::load_user_conversations(target_user_id);
-
-                json resp;
-                resp["ok"] = true;
-
-                json items = json::array();
-                for(auto const& conv : conversations) {
-                    json c;
-                    c["conversationId"] = std::to_string(conv.id);
-                    c["conversationType"] = conv.type;
-                    c["title"] = conv.title;
-                    c["lastSeq"] = conv.last_seq;
-                    c["lastServerTimeMs"] = conv.last_server_time_ms;
-                    c["avatarPath"] = conv.avatar_path;
-                    c["lastReadSeq"] = conv.last_read_seq;
-                    c["unreadCount"] = conv.unread_count;
-                    c["preview"] = conv.last_message_preview;
-                    c["time"] = conv.last_message_time;
-                    items.push_back(std::move(c));
-                }
+    // 字段与 FRIEND_LIST_RESP 中的元素一致
+    json u;
+    u["userId"] = std::to_string(info.id);
+    u["account"] = info.account;
+    u["displayName"] = Session::normalize_whitespace(info.display_name);
+    u["avatarPath"] = info.avatar_path;
+    u["region"] = "";
+    u["signature"] = "";
+    json push;
+    push["friend"] = std::move(u);
+    fan_out({ target_user_id }, protocol::make_shared_frame("FRIEND_UPSERT_PUSH", push.dump()));
+}
 
-                resp["conversations"] = std::move(items);
-                auto const line = protocol::make_line("CONV_LIST_RESP", resp.dump());
+auto Server::push_friend_remove(i64 target_user_id, i64 friend_user_id) -> void
+{
+    if(target_user_id <= 0 || friend_user_id <= 0) {
+        return;
+    }
 
-                for_user_sessions(target_user_id, [&line](std::shared_ptr<Session> const& s) {
-                    if(s->is_authenticated()) {
-                        s->send_text(line);
-                    }
-                });
-            } catch(...) {
-            }
-            co_return;
-        },
-        asio::detached
-    );
+    json push;
+    push["userId"] = std::to_string(friend_user_id);
+    fan_out({ target_user_id }, protocol::make_shared_frame("FRIEND_REMOVE_PUSH", push.dump()));
+}
+
+auto Server::push_friend_request_upsert(i64 target_user_id, database::FriendRequestInfo const& info) -> void
+{
+    if(target_user_id <= 0 || info.id <= 0) {
+        return;
+    }
+
+    json r;
+    r["requestId"] = std::to_string(info.id);
+    if(info.from_user_id > 0) {
+        r["fromUserId"] = std::to_string(info.from_user_id);
+    }
+    put_if_set(r, "account", info.account);
+    put_if_set(r, "displayName", Session::normalize_whitespace(info.display_name));
+    put_if_set(r, "status", info.status);
+    put_if_set(r, "helloMsg", info.hello_msg);
+    put_if_set(r, "avatarPath", info.avatar_path);
+    json push;
+    push["request"] = std::move(r);
+    fan_out({ target_user_id }, protocol::make_shared_frame("FRIEND_REQ_UPSERT_PUSH", push.dump()));
+}
+
+auto Server::push_friend_request_remove(i64 target_user_id, i64 request_id) -> void
+{
+    if(target_user_id <= 0 || request_id <= 0) {
+        return;
+    }
+
+    json push;
+    push["requestId"] = std::to_string(request_id);
+    fan_out({ target_user_id }, protocol::make_shared_frame("FRIEND_REQ_REMOVE_PUSH", push.dump()));
 }
 
 auto Server::send_conv_members(i64 conversation_id, i64 only_user_id) -> void
@@ -151,7 +170,7 @@ auto Server::send_conv_members(i64 conversation_id, i64 only_user_id) -> void
     }
 
     asio::co_spawn(
-        strand_,
+        exec_,
         [this, conversation_id, only_user_id]() -> asio::awaitable<void> {
             std::vector<database::MemberInfo> members;
             try {
@@ -175,82 +194,51 @@ auto Server::send_conv_members(i64 conversation_id, i64 only_user_id) -> void
             }
             resp["members"] = std::move(arr);
 
-            auto const line = protocol::make_line("CONV_MEMBERS_RESP", resp.dump());
-            std::unordered_set<i64> member_ids;
+            auto line = protocol::make_shared_frame("CONV_MEMBERS_RESP", resp.dump());
+            std::vector<i64> member_ids;
             member_ids.reserve(members.size());
             for(auto const& m : members) {
-                member_ids.insert(m.user_id);
+                member_ids.push_back(m.user_id);
             }
 
-            if(only_user_id > 0 && !member_ids.contains(only_user_id)) {
-                co_return;
-            }
-
-            auto const send_to = [&line, this](i64 uid) {
-                for_user_sessions(uid, [&line](std::shared_ptr<Session> const& session) {
-                    if(session->is_authenticated()) {
-                        session->send_text(line);
-                    }
-                });
-            };
-
             if(only_user_id > 0) {
-                send_to(only_user_id);
+                if(std::ranges::find(member_ids, only_user_id) != member_ids.end()) {
+                    fan_out({ only_user_id }, std::move(line));
+                }
                 co_return;
             }
 
-            for(auto const uid : member_ids) {
-                send_to(uid);
-            }
+            fan_out(std::move(member_ids), std::move(line));
             co_return;
         },
         asio::detached
     );
 }
 
-auto Server::send_group_join_request_list_to(i64 target_user_id) -> void
+auto Server::push_group_join_request_upsert(std::vector<i64> admin_ids, database::GroupJoinRequestInfo const& info)
+    -> void
 {
-    if(target_user_id <= 0) {
+    if(info.id <= 0) {
         return;
     }
 
-    asio::co_spawn(
-        strand_,
-        [this, target_user_id]() -> asio::awaitable<void> {
-            try {
-                auto const requests = co_await database::load_group_join_requests_for_admin(target_user_id);
-
-                json resp;
-                resp["ok"] = true;
-
-                json items = json::array();
-                for(auto const& r : requests) {
-                    json obj;
-                    obj["requestId"] = std::to_string(r.id);
-                    obj["fromUserId"] = std::to_string(r.from_user_id);
-                    obj["account"] = r.account;
-                    obj["displayName"] = Session::normalize_whitespace(r.display_name);
-                    obj["groupId"] = std::to_string(r.group_id);
-                    obj["groupName"] = r.group_name;
-                    obj["status"] = r.status;
-                    obj["helloMsg"] = r.hello_msg;
-                    items.push_back(std::move(obj));
-                }
-
-                resp["requests"] = std::move(items);
-                auto const line = protocol::make_line("GROUP_JOIN_REQ_LIST_RESP", resp.dump());
-
-                for_user_sessions(target_user_id, [&line](std::shared_ptr<Session> const& s) {
-                    if(s->is_authenticated()) {
-                        s->send_text(line);
-                    }
-                });
-            } catch(...) {
-            }
-            co_return;
-        },
-        asio::detached
-    );
+    json r;
+    r["requestId"] = std::to_string(info.id);
+    if(info.from_user_id > 0) {
+        r["fromUserId"] = std::to_string(info.from_user_id);
+    }
+    if(info.group_id > 0) {
+        r["groupId"] = std::to_string(info.group_id);
+    }
+    put_if_set(r, "account", info.account);
+    put_if_set(r, "displayName", Session::normalize_whitespace(info.display_name));
+    put_if_set(r, "groupName", info.group_name);
+    put_if_set(r, "status", info.status);
+    put_if_set(r, "helloMsg", info.hello_msg);
+    put_if_set(r, "avatarPath", info.avatar_path);
+    json push;
+    push["request"] = std::move(r);
+    fan_out(std::move(admin_ids), protocol::make_shared_frame("GROUP_JOIN_REQ_UPSERT_PUSH", push.dump()));
 }
 
 auto Server::broadcast_message_recalled(
@@ -260,37 +248,18 @@ auto Server::broadcast_message_recalled(
     std::string const& recaller_name
 ) -> void
 {
-    dispatch_on_strand([=, this]() {
-        // 构造撤回推送消息
-        json push;
-        push["conversationId"] = std::to_string(conversation_id);
-        push["serverMsgId"] = std::to_string(message_id);
-        push["recallerId"] = std::to_string(recaller_id);
-        push["recallerName"] = recaller_name;
-
-        auto const line = protocol::make_line("MSG_RECALLED_PUSH", push.dump());
-
-        // 从缓存获取成员列表
-        std::vector<i64> member_ids;
-        if(auto cache = get_conversation_cache(conversation_id)) {
-            member_ids = cache->member_ids;
-        }
-
-        auto const send_line = [&line](std::shared_ptr<Session> const& session) {
-            if(session->is_authenticated()) {
-                session->send_text(line);
-            }
-        };
-
-        if(member_ids.empty()) {
-            for_all_authenticated_sessions(send_line);
-            return;
-        }
-
-        std::unordered_set<i64> member_set{ member_ids.begin(), member_ids.end() };
-        for(auto const uid : member_set) {
-            for_user_sessions(uid, send_line);
-        }
+    // 构造撤回推送消息
+    json push;
+    push["conversationId"] = std::to_string(conversation_id);
+    push["serverMsgId"] = std::to_string(message_id);
+    push["recallerId"] = std::to_string(recaller_id);
+    push["recallerName"] = recaller_name;
+
+    auto line = protocol::make_shared_frame("MSG_RECALLED_PUSH", push.dump());
+
+    // 接收者取自会话的在线订阅索引
+    fan_out_conversation(conversation_id, [line = std::move(line)](std::string const&) {
+        return line;
     });
 }
 
@@ -300,47 +269,28 @@ auto Server::broadcast_message_reaction(
     std::vector<database::MessageReaction> const& reactions
 ) -> void
 {
-    dispatch_on_strand([=, this]() {
-        // 构造反应对象 {LIKE: [{userId, displayName}, ...], DISLIKE: [...]}
-        json reactions_obj = json::object();
-        reactions_obj["LIKE"] = json::array();
-        reactions_obj["DISLIKE"] = json::array();
-
-        for(auto const& reaction : reactions) {
-            json user_obj;
-            user_obj["userId"] = std::to_string(reaction.user_id);
-            user_obj["displayName"] = reaction.display_name;
-            reactions_obj[reaction.reaction_type].push_back(user_obj);
-        }
-
-        // 构造推送消息
-        json push;
-        push["conversationId"] = std::to_string(conversation_id);
-        push["serverMsgId"] = std::to_string(message_id);
-        push["reactions"] = reactions_obj;
-
-        auto const line = protocol::make_line("MSG_REACTION_PUSH", push.dump());
-
-        // 从缓存获取成员列表
-        std::vector<i64> member_ids;
-        if(auto cache = get_conversation_cache(conversation_id)) {
-            member_ids = cache->member_ids;
-        }
+    // 构造反应对象 {LIKE: [{userId, displayName}, ...], DISLIKE: [...]}
+    json reactions_obj = json::object();
+    reactions_obj["LIKE"] = json::array();
+    reactions_obj["DISLIKE"] = json::array();
+
+    for(auto const& reaction : reactions) {
+        json user_obj;
+        user_obj["userId"] = std::to_string(reaction.user_id);
+        user_obj["displayName"] = reaction.display_name;
+        reactions_obj[reaction.reaction_type].push_back(user_obj);
+    }
 
-        auto const send_line = [&line](std::shared_ptr<Session> const& session) {
-            if(session->is_authenticated()) {
-                session->send_text(line);
-            }
-        };
+    // 构造推送消息
+    json push;
+    push["conversationId"] = std::to_string(conversation_id);
+    push["serverMsgId"] = std::to_string(message_id);
+    push["reactions"] = reactions_obj;
 
-        if(member_ids.empty()) {
-            for_all_authenticated_sessions(send_line);
-            return;
-        }
+    auto line = protocol::make_shared_frame("MSG_REACTION_PUSH", push.dump());
 
-        std::unordered_set<i64> member_set{ member_ids.begin(), member_ids.end() };
-        for(auto const uid : member_set) {
-            for_user_sessions(uid, send_line);
-        }
+    // 接收者取自会话的在线订阅索引
+    fan_out_conversation(conversation_id, [line = std::move(line)](std::string const&) {
+        return line;
     });
 }
@@ -0,0 +1,107 @@
+/**
+ * @file
+ * @brief 服务器运行统计的周期性输出。
+ *
+ * 各子系统只负责累加各自的原子计数，本文件按 `Server::stats_interval`
+ * 定期读取快照并打印，便于压测时观察各命令的吞吐与耗时分布。
+ */
+#include <session.h>
+#include <server.h>
+#include <database/connection.h>
+#include <database/write_pipeline.h>
+#include <database/message_cache.h>
+
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/redirect_error.hpp>
+namespace asio = boost::asio;
+
+#include <print>
+
+/**
+ * @brief 周期性输出统计信息，直到执行器停止。
+ *
+ * 仅输出有调用记录的命令，随后输出数据库连接池、消息组提交、各级缓存与推送扇出的状态；计数为进程启动以来的累计值。
+ */
+auto Server::stats_loop() -> asio::awaitable<void>
+{
+    asio::steady_timer timer{ exec_ };
+    while(true) {
+        timer.expires_after(stats_interval);
+        boost::system::error_code ec;
+        co_await timer.async_wait(asio::redirect_error(asio::use_awaitable, ec));
+        if(ec) {
+            co_return;
+        }
+
+        for(auto const& s : Session::command_stats()) {
+            if(s.calls == 0 && s.rejected == 0) {
+                continue;
+            }
+            std::println(
+                "[stats] cmd={} calls={} errors={} rejected={} avg_us={} max_us={}",
+                s.command, s.calls, s.errors, s.rejected,
+                s.calls > 0 ? s.total_us / s.calls : 0, s.max_us
+            );
+        }
+
+        auto const batches = Session::push_batch_stats();
+        std::println(
+            "[stats] push_batch frames={} messages={} avg_size={}",
+            batches.frames, batches.messages, batches.frames > 0 ? batches.messages / batches.frames : 0
+        );
+
+        auto const pool = database::pool_stats();
+        std::println(
+            "[stats] db_pool in_use={} idle={} waiting={} acquires={} waits={} timeouts={} "
+            "creates={} reconnects={} rollbacks={} avg_wait_us={} max_wait_us={}",
+            pool.in_use, pool.idle, pool.waiting, pool.acquires, pool.waits, pool.timeouts,
+            pool.creates, pool.reconnects, pool.rollbacks, pool.acquires > 0 ? pool.total_wait_us / pool.acquires : 0, pool.max_wait_us
+        );
+
+        if(database::has_replicas()) {
+            auto const replica = database::pool_stats(database::Route::replica);
+            std::println(
+                "[stats] db_replica in_use={} idle={} waiting={} acquires={} waits={} timeouts={} "
+                "creates={} fallbacks={} avg_wait_us={} max_wait_us={}",
+                replica.in_use, replica.idle, replica.waiting, replica.acquires, replica.waits,
+                replica.timeouts, replica.creates, replica.fallbacks,
+                replica.acquires > 0 ? replica.total_wait_us / replica.acquires : 0, replica.max_wait_us
+            );
+        }
+
+        auto const writes = database::write_pipeline_stats();
+        std::println(
+            "[stats] msg_write batches={} rows={} avg_batch={} max_batch={} fallbacks={} failures={} "
+            "avg_commit_us={} max_commit_us={}",
+            writes.batches, writes.rows, writes.batches > 0 ? writes.rows / writes.batches : 0, writes.max_batch,
+            writes.fallbacks, writes.failures,
+            writes.batches > 0 ? writes.total_commit_us / writes.batches : 0, writes.max_commit_us
+        );
+
+        auto const cache = database::message_cache_stats();
+        auto const lookups = cache.hits + cache.misses;
+        std::println(
+            "[stats] msg_cache hits={} misses={} hit_rate={:.1f}% conversations={} messages={} bytes={} evictions={}",
+            cache.hits, cache.misses, lookups > 0 ? 100.0 * static_cast<double>(cache.hits) / static_cast<double>(lookups) : 0.0,
+            cache.conversations, cache.messages, cache.bytes, cache.evictions
+        );
+
+        auto const fanout = fanout_stats();
+        std::println(
+            "[stats] fanout count={} chunks={} deliveries={} avg_span_us={} max_span_us={} "
+            "avg_delay_us={} max_delay_us={}",
+            fanout.fanouts, fanout.chunks, fanout.deliveries,
+            fanout.fanouts > 0 ? fanout.total_span_us / fanout.fanouts : 0, fanout.max_span_us,
+            fanout.fanouts > 0 ? fanout.total_delay_us / fanout.fanouts : 0, fanout.max_delay_us
+        );
+
+        auto const pages = history_page_stats();
+        auto const page_lookups = pages.hits + pages.misses;
+        std::println(
+            "[stats] history_pages hits={} misses={} hit_rate={:.1f}% pages={} bytes={}",
+            pages.hits, pages.misses,
+            page_lookups > 0 ? 100.0 * static_cast<double>(pages.hits) / static_cast<double>(page_lookups) : 0.0,
+            pages.pages, pages.bytes
+        );
+    }
+}
@@ -0,0 +1,151 @@
+/**
+ * @file
+ * @brief 会话的在线订阅索引：conversation_id -> 在线用户。
+ *
+ * 每个分片只记录 user_id 落在本分片的在线用户，两张表互为反向索引：
+ *   - `subscriptions`：在线用户 -> 其所属会话，用户下线时据此清理；
+ *   - `subscribers`：会话 -> 本分片内订阅它的在线用户，推送时直接取用。
+ *
+ * 维护时机：登录时整体建立，加入 / 退出会话时增删，用户最后一个连接断开时整体移除，
+ * 会话解散时关闭。所有读写都在分片 strand 上进行。
+ *
+ * 登录与加入会话的竞争：登录先等待 `index_authenticated_session` 在分片 strand 上登记完空的订阅表，
+ * 之后才从数据库读取会话列表。加入操作先提交数据库再向分片投递订阅：
+ * 投递排在登记之后的，直接写入订阅表；排在登记之前的，其提交也早于读取，一定被读取看到。
+ * 两条路径合并后不会遗漏。
+ */
+#include <session.h>
+#include <server.h>
+
+/**
+ * @brief 登录后用数据库中的会话列表建立用户的订阅。
+ *
+ * 用户已全部下线（订阅表已移除）时忽略。
+ *
+ * @param user_id 用户 ID。
+ * @param conversation_ids 用户所属的全部会话。
+ */
+auto Server::subscribe_user(i64 user_id, std::vector<i64> conversation_ids) -> void
+{
+    if(user_id <= 0) {
+        return;
+    }
+
+    auto& shard = shard_for_user(user_id);
+    asio::dispatch(shard.strand, [&shard, user_id, ids = std::move(conversation_ids)]() {
+        auto it = shard.subscriptions.find(user_id);
+        if(it == shard.subscriptions.end()) {
+            return;
+        }
+        for(auto const conv_id : ids) {
+            it->second.insert(conv_id);
+            shard.subscribers[conv_id].insert(user_id);
+        }
+    });
+}
+
+/**
+ * @brief 成员加入会话后，为其中在线的用户增加订阅。
+ *
+ * @param conversation_id 会话 ID。
+ * @param user_ids 新加入的成员，允许包含不在线或已订阅的用户。
+ */
+auto Server::subscribe_conversation(i64 conversation_id, std::vector<i64> user_ids) -> void
+{
+    if(conversation_id <= 0) {
+        return;
+    }
+
+    for(auto const uid : user_ids) {
+        auto& shard = shard_for_user(uid);
+        asio::dispatch(shard.strand, [&shard, conversation_id, uid]() {
+            auto it = shard.subscriptions.find(uid);
+            if(it == shard.subscriptions.end()) {
+                return;
+            }
+            it->second.insert(conversation_id);
+            shard.subscribers[conversation_id].insert(uid);
+        });
+    }
+}
+
+/**
+ * @brief 成员离开会话后移除其订阅。
+ *
+ * @param conversation_id 会话 ID。
+ * @param user_ids 离开的成员。
+ */
+auto Server::unsubscribe_conversation(i64 conversation_id, std::vector<i64> user_ids) -> void
+{
+    if(conversation_id <= 0) {
+        return;
+    }
+
+    for(auto const uid : user_ids) {
+        auto& shard = shard_for_user(uid);
+        asio::dispatch(shard.strand, [&shard, conversation_id, uid]() {
+            if(auto it = shard.subscriptions.find(uid); it != shard.subscriptions.end()) {
+                it->second.erase(conversation_id);
+            }
+            if(auto it = shard.subscribers.find(conversation_id); it != shard.subscribers.end()) {
+                it->second.erase(uid);
+                if(it->second.empty()) {
+                    shard.subscribers.erase(it);
+                }
+            }
+        });
+    }
+}
+
+/**
+ * @brief 会话解散后移除所有分片上该会话的订阅。
+ *
+ * 解散前发出的推送已先一步排入各分片，仍会送达原成员。
+ *
+ * @param conversation_id 会话 ID。
+ */
+auto Server::close_conversation_topic(i64 conversation_id) -> void
+{
+    if(conversation_id <= 0) {
+        return;
+    }
+
+    for(auto& shard_ptr : shards_) {
+        auto& shard = *shard_ptr;
+        asio::post(shard.strand, [&shard, conversation_id]() {
+            auto it = shard.subscribers.find(conversation_id);
+            if(it == shard.subscribers.end()) {
+                return;
+            }
+            for(auto const uid : it->second) {
+                if(auto sub = shard.subscriptions.find(uid); sub != shard.subscriptions.end()) {
+                    sub->second.erase(conversation_id);
+                }
+            }
+            shard.subscribers.erase(it);
+        });
+    }
+}
+
+/**
+ * @brief 用户最后一个连接下线后移除其全部订阅（调用方已位于分片 strand 上）。
+ *
+ * @param shard 用户所属分片。
+ * @param user_id 用户 ID。
+ */
+auto Server::drop_user_subscriptions(SessionShard& shard, i64 user_id) -> void
+{
+    auto it = shard.subscriptions.find(user_id);
+    if(it == shard.subscriptions.end()) {
+        return;
+    }
+    for(auto const conv_id : it->second) {
+        if(auto sub = shard.subscribers.find(conv_id); sub != shard.subscribers.end()) {
+            sub->second.erase(user_id);
+            if(sub->second.empty()) {
+                shard.subscribers.erase(sub);
+            }
+        }
+    }
+    shard.subscriptions.erase(it);
+}
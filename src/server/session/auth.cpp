@@ -5,17 +5,17 @@
 
 using nlohmann::json;
 
-auto Session::handle_register(std::string const& payload) -> asio::awaitable<std::string>
+auto Session::handle_register(std::string_view payload) -> asio::awaitable<CommandReply>
 {
     // 使用非抛出版本的JSON解析,减少异常开销
     auto j = json::parse(payload, nullptr, false);
     if(j.is_discarded()) {
-        co_return make_error_payload("INVALID_JSON", "请求 JSON 解析失败");
+        co_return fail("INVALID_JSON", "请求 JSON 解析失败");
     }
 
     try {
         if(!j.contains("account") || !j.contains("password") || !j.contains("confirmPassword")) {
-            co_return make_error_payload("INVALID_PARAM", "缺少必要字段");
+            co_return fail("INVALID_PARAM", "缺少必要字段");
         }
 
         auto const account = j.at("account").get<std::string>();
@@ -23,12 +23,22 @@ auto Session::handle_register(std::string const& payload) -> asio::awaitable<std
         auto const confirm = j.at("confirmPassword").get<std::string>();
 
         if(password != confirm) {
-            co_return make_error_payload("PASSWORD_MISMATCH", "两次密码不一致");
+            co_return fail("PASSWORD_MISMATCH", "两次密码不一致");
         }
 
         auto const result = co_await database::register_user(account, password);
         if(!result.ok) {
-            co_return make_error_payload(result.error_code, result.error_msg);
+            co_return fail(result.error_code, result.error_msg);
+        }
+
+        // 新用户已加入世界频道，同步到会话缓存
+        if(auto server = server_.lock()) {
+            try {
+                auto const world_id = co_await database::get_world_conversation_id();
+                server->add_conversation_cache_member(world_id, result.user.id);
+            } catch(std::exception const&) {
+                // 世界频道缺失不影响注册结果
+            }
         }
 
         json resp;
@@ -38,21 +48,21 @@ auto Session::handle_register(std::string const& payload) -> asio::awaitable<std
         resp["avatarPath"] = result.user.avatar_path;
         co_return resp.dump();
     } catch(std::exception const& ex) {
-        co_return make_error_payload("SERVER_ERROR", ex.what());
+        co_return fail("SERVER_ERROR", ex.what());
     }
 }
 
-auto Session::handle_login(std::string const& payload) -> asio::awaitable<std::string>
+auto Session::handle_login(std::string_view payload) -> asio::awaitable<CommandReply>
 {
     // 使用非抛出版本的JSON解析
     auto j = json::parse(payload, nullptr, false);
     if(j.is_discarded()) {
-        co_return make_error_payload("INVALID_JSON", "请求 JSON 解析失败");
+        co_return fail("INVALID_JSON", "请求 JSON 解析失败");
     }
 
     try {
         if(!j.contains("account") || !j.contains("password")) {
-            co_return make_error_payload("INVALID_PARAM", "缺少必要字段");
+            co_return fail("INVALID_PARAM", "缺少必要字段");
         }
 
         auto const account = j.at("account").get<std::string>();
@@ -60,7 +70,7 @@ auto Session::handle_login(std::string const& payload) -> asio::awaitable<std::s
 
         auto const result = co_await database::login_user(account, password);
         if(!result.ok) {
-            co_return make_error_payload(result.error_code, result.error_msg);
+            co_return fail(result.error_code, result.error_msg);
         }
 
         authenticated_ = true;
@@ -69,8 +79,20 @@ auto Session::handle_login(std::string const& payload) -> asio::awaitable<std::s
         display_name_ = result.user.display_name;
         avatar_path_ = result.user.avatar_path;
 
+        // 客户端声明支持 MSG_PUSH_BATCH 时按其申请的周期合并推送，周期上限由服务器限定
+        if(j.contains("pushBatchMs") && j["pushBatchMs"].is_number_integer()) {
+            auto const ms = std::clamp<i64>(j["pushBatchMs"].get<i64>(), 0, MAX_PUSH_BATCH_MS);
+            push_batch_tick_ = std::chrono::milliseconds{ ms };
+        }
+
+        if(auto server = server_.lock()) {
+            co_await server->index_authenticated_session(shared_from_this());
+        }
+
+        // 订阅表已在分片上登记完成，此后读取会话列表，与并发加入的会话合并后不会遗漏
+        auto conversation_ids = co_await database::load_user_conversation_ids(user_id_);
         if(auto server = server_.lock()) {
-            server->index_authenticated_session(shared_from_this());
+            server->subscribe_user(user_id_, std::move(conversation_ids));
         }
 
         auto const world_id = co_await database::get_world_conversation_id();
@@ -81,11 +103,12 @@ auto Session::handle_login(std::string const& payload) -> asio::awaitable<std::s
         resp["displayName"] = display_name_;
         resp["avatarPath"] = avatar_path_;
         resp["worldConversationId"] = std::to_string(world_id);
+        resp["pushBatchMs"] = push_batch_tick_.count();
         co_return resp.dump();
     } catch(json::parse_error const&) {
-        co_return make_error_payload("INVALID_JSON", "请求 JSON 解析失败");
+        co_return fail("INVALID_JSON", "请求 JSON 解析失败");
     } catch(std::exception const& ex) {
-        co_return make_error_payload("SERVER_ERROR", ex.what());
+        co_return fail("SERVER_ERROR", ex.what());
     }
 }
 
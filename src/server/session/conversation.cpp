@@ -47,12 +47,8 @@ static auto base64_decode(std::string const& input) -> std::vector<u8>
     return out;
 }
 
-auto Session::handle_conv_list_req(std::string const& payload) -> asio::awaitable<std::string>
+auto Session::handle_conv_list_req(std::string_view payload) -> asio::awaitable<CommandReply>
 {
-    if(!authenticated_) {
-        co_return make_error_payload("NOT_AUTHENTICATED", "请先登录");
-    }
-
     try {
         if(!payload.empty() && payload != "{}") {
             // 预留将来扩展过滤参数，目前仅校验 JSON 格式。
@@ -60,7 +56,7 @@ auto Session::handle_conv_list_req(std::string const& payload) -> asio::awaitabl
             (void)_;
         }
 
-        auto const conversations = co_await database::load_user_conversations(user_id_);
+        auto const conversations = co_await database::load_user_conversations(user_id_, read_route());
 
         json resp;
         resp["ok"] = true;
@@ -84,23 +80,19 @@ auto Session::handle_conv_list_req(std::string const& payload) -> asio::awaitabl
         resp["conversations"] = std::move(items);
         co_return resp.dump();
     } catch(json::parse_error const&) {
-        co_return make_error_payload("INVALID_JSON", "请求 JSON 解析失败");
+        co_return fail("INVALID_JSON", "请求 JSON 解析失败");
     } catch(std::exception const& ex) {
-        co_return make_error_payload("SERVER_ERROR", ex.what());
+        co_return fail("SERVER_ERROR", ex.what());
     }
 }
 
-auto Session::handle_mark_read_req(std::string const& payload) -> asio::awaitable<std::string>
+auto Session::handle_mark_read_req(std::string_view payload) -> asio::awaitable<CommandReply>
 {
-    if(!authenticated_) {
-        co_return make_error_payload("NOT_AUTHENTICATED", "请先登录");
-    }
-
     try {
         auto j = json::parse(payload);
 
         if(!j.contains("conversationId") || !j.contains("seq")) {
-            co_return make_error_payload("INVALID_PARAM", "缺少 conversationId 或 seq 字段");
+            co_return fail("INVALID_PARAM", "缺少 conversationId 或 seq 字段");
         }
 
         auto conv_id_str = j.at("conversationId").get<std::string>();
@@ -111,7 +103,7 @@ auto Session::handle_mark_read_req(std::string const& payload) -> asio::awaitabl
         // 验证用户是否是该会话成员
         auto member = co_await database::get_conversation_member(conv_id, user_id_);
         if(!member) {
-            co_return make_error_payload("NOT_MEMBER", "您不是该会话成员");
+            co_return fail("NOT_MEMBER", "您不是该会话成员");
         }
 
         // 更新已读位置
@@ -123,23 +115,19 @@ auto Session::handle_mark_read_req(std::string const& payload) -> asio::awaitabl
         resp["seq"] = seq;
         co_return resp.dump();
     } catch(json::parse_error const&) {
-        co_return make_error_payload("INVALID_JSON", "请求 JSON 解析失败");
+        co_return fail("INVALID_JSON", "请求 JSON 解析失败");
     } catch(std::exception const& ex) {
-        co_return make_error_payload("SERVER_ERROR", ex.what());
+        co_return fail("SERVER_ERROR", ex.what());
     }
 }
 
-auto Session::handle_profile_update(std::string const& payload) -> asio::awaitable<std::string>
+auto Session::handle_profile_update(std::string_view payload) -> asio::awaitable<CommandReply>
 {
-    if(!authenticated_) {
-        co_return make_error_payload("NOT_AUTHENTICATED", "请先登录");
-    }
-
     try {
         auto j = json::parse(payload);
 
         if(!j.contains("displayName")) {
-            co_return make_error_payload("INVALID_PARAM", "缺少 displayName 字段");
+            co_return fail("INVALID_PARAM", "缺少 displayName 字段");
         }
 
         auto new_name = j.at("displayName").get<std::string>();
@@ -153,15 +141,15 @@ auto Session::handle_profile_update(std::string const& payload) -> asio::awaitab
         trim(new_name);
 
         if(new_name.empty()) {
-            co_return make_error_payload("INVALID_PARAM", "昵称不能为空");
+            co_return fail("INVALID_PARAM", "昵称不能为空");
         }
         if(new_name.size() > 64) {
-            co_return make_error_payload("INVALID_PARAM", "昵称长度过长");
+            co_return fail("INVALID_PARAM", "昵称长度过长");
         }
 
         auto const result = co_await database::update_display_name(user_id_, new_name);
         if(!result.ok) {
-            co_return make_error_payload(result.error_code, result.error_msg);
+            co_return fail(result.error_code, result.error_msg);
         }
 
         // 更新当前会话缓存的昵称。
@@ -172,26 +160,22 @@ auto Session::handle_profile_update(std::string const& payload) -> asio::awaitab
         resp["displayName"] = display_name_;
         co_return resp.dump();
     } catch(json::parse_error const&) {
-        co_return make_error_payload("INVALID_JSON", "请求 JSON 解析失败");
+        co_return fail("INVALID_JSON", "请求 JSON 解析失败");
     } catch(std::exception const& ex) {
-        co_return make_error_payload("SERVER_ERROR", ex.what());
+        co_return fail("SERVER_ERROR", ex.what());
     }
 }
 
-auto Session::handle_avatar_update(std::string const& payload) -> asio::awaitable<std::string>
+auto Session::handle_avatar_update(std::string_view payload) -> asio::awaitable<CommandReply>
 {
-    if(!authenticated_) {
-        co_return make_error_payload("NOT_AUTHENTICATED", "请先登录");
-    }
-
     try {
         auto j = json::parse(payload);
 
-        if(!j.contains("avatarData")) {
-            co_return make_error_payload("INVALID_PARAM", "缺少 avatarData 字段");
+        // v2 帧可直接携带原始字节附件，省去 base64 编解码
+        if(attachment_.empty() && !j.contains("avatarData")) {
+            co_return fail("INVALID_PARAM", "缺少 avatarData 字段");
         }
 
-        auto const base64_data = j.at("avatarData").get<std::string>();
         auto extension = std::string{"jpg"};
         if(j.contains("extension")) {
             extension = j.at("extension").get<std::string>();
@@ -202,12 +186,14 @@ auto Session::handle_avatar_update(std::string const& payload) -> asio::awaitabl
         }
 
         // 解码数据
-        auto const data = base64_decode(base64_data);
+        auto const data = attachment_.empty()
+            ? base64_decode(j.at("avatarData").get<std::string>())
+            : std::vector<u8>(attachment_.begin(), attachment_.end());
         if(data.empty()) {
-            co_return make_error_payload("INVALID_PARAM", "无效的头像数据");
+            co_return fail("INVALID_PARAM", "无效的头像数据");
         }
         if(data.size() > 5 * 1024 * 1024) { // 再次校验大小
-            co_return make_error_payload("INVALID_PARAM", "头像文件过大");
+            co_return fail("INVALID_PARAM", "头像文件过大");
         }
 
         // 确保目录存在
@@ -221,7 +207,7 @@ auto Session::handle_avatar_update(std::string const& payload) -> asio::awaitabl
         }
         if(ec) {
              std::println("Create directory failed: {}", ec.message());
-             co_return make_error_payload("SERVER_ERROR", "服务器存储错误");
+             co_return fail("SERVER_ERROR", "服务器存储错误");
         }
 
         // 构造文件名: userId_timestamp.ext (加上时间戳防止缓存)
@@ -241,7 +227,7 @@ auto Session::handle_avatar_update(std::string const& payload) -> asio::awaitabl
         std::ofstream ofs(filepath, std::ios::binary | std::ios::trunc);
         if(!ofs.is_open()) {
              std::println("Open file failed: {}", filepath.string());
-             co_return make_error_payload("SERVER_ERROR", "无法保存头像文件");
+             co_return fail("SERVER_ERROR", "无法保存头像文件");
         }
         ofs.write(reinterpret_cast<char const*>(data.data()), data.size());
         ofs.close();
@@ -304,7 +290,7 @@ auto Session::handle_avatar_update(std::string const& payload) -> asio::awaitabl
         // 更新数据库
         auto const db_res = co_await database::update_avatar(user_id_, relative_path);
         if(!db_res.ok) {
-            co_return make_error_payload(db_res.error_code, db_res.error_msg);
+            co_return fail(db_res.error_code, db_res.error_msg);
         }
 
         avatar_path_ = db_res.user.avatar_path;
@@ -314,27 +300,26 @@ auto Session::handle_avatar_update(std::string const& payload) -> asio::awaitabl
         resp["avatarPath"] = avatar_path_;
         co_return resp.dump();
     } catch(json::parse_error const&) {
-        co_return make_error_payload("INVALID_JSON", "请求 JSON 解析失败");
+        co_return fail("INVALID_JSON", "请求 JSON 解析失败");
     } catch(std::exception const& ex) {
-        co_return make_error_payload("SERVER_ERROR", ex.what());
+        co_return fail("SERVER_ERROR", ex.what());
     }
 }
 
-auto Session::handle_group_avatar_update(std::string const& payload) -> asio::awaitable<std::string>
+auto Session::handle_group_avatar_update(std::string_view payload) -> asio::awaitable<CommandReply>
 {
-    if(!authenticated_) {
-        co_return make_error_payload("NOT_AUTHENTICATED", "请先登录");
-    }
-
     try {
         auto j = json::parse(payload);
 
-        if(!j.contains("conversationId") || !j.contains("avatarData")) {
-            co_return make_error_payload("INVALID_PARAM", "缺少必要字段");
+        if(!j.contains("conversationId") || (attachment_.empty() && !j.contains("avatarData"))) {
+            co_return fail("INVALID_PARAM", "缺少必要字段");
         }
 
         auto const conv_id = j.at("conversationId").get<i64>();
-        auto const base64_data = j.at("avatarData").get<std::string>();
+        // 附件视图只在本帧分发期间有效，这里先复制出来
+        auto const raw_data = attachment_.empty()
+            ? base64_decode(j.at("avatarData").get<std::string>())
+            : std::vector<u8>(attachment_.begin(), attachment_.end());
         auto extension = std::string{"jpg"};
         if(j.contains("extension")) {
             extension = j.at("extension").get<std::string>();
@@ -347,19 +332,18 @@ auto Session::handle_group_avatar_update(std::string const& payload) -> asio::aw
         // 验证权限：检查用户是否为群主或管理员
         auto member = co_await database::get_conversation_member(conv_id, user_id_);
         if(!member.has_value()) {
-            co_return make_error_payload("NOT_MEMBER", "您不是该群成员");
+            co_return fail("NOT_MEMBER", "您不是该群成员");
         }
         if(member->role != "OWNER" && member->role != "ADMIN") {
-            co_return make_error_payload("PERMISSION_DENIED", "只有群主和管理员可以更换群头像");
+            co_return fail("PERMISSION_DENIED", "只有群主和管理员可以更换群头像");
         }
 
-        // 解码数据
-        auto const data = base64_decode(base64_data);
+        auto const& data = raw_data;
         if(data.empty()) {
-            co_return make_error_payload("INVALID_PARAM", "无效的头像数据");
+            co_return fail("INVALID_PARAM", "无效的头像数据");
         }
         if(data.size() > 5 * 1024 * 1024) {
-            co_return make_error_payload("INVALID_PARAM", "头像文件过大");
+            co_return fail("INVALID_PARAM", "头像文件过大");
         }
 
         // 确保目录存在
@@ -372,7 +356,7 @@ auto Session::handle_group_avatar_update(std::string const& payload) -> asio::aw
         }
         if(ec) {
             std::println("Create directory failed: {}", ec.message());
-            co_return make_error_payload("SERVER_ERROR", "服务器存储错误");
+            co_return fail("SERVER_ERROR", "服务器存储错误");
         }
 
         // 构造文件名: group_conversationId.ext
@@ -383,7 +367,7 @@ auto Session::handle_group_avatar_update(std::string const& payload) -> asio::aw
         std::ofstream ofs(filepath, std::ios::binary | std::ios::trunc);
         if(!ofs.is_open()) {
             std::println("Open file failed: {}", filepath.string());
-            co_return make_error_payload("SERVER_ERROR", "无法保存头像文件");
+            co_return fail("SERVER_ERROR", "无法保存头像文件");
         }
         ofs.write(reinterpret_cast<char const*>(data.data()), data.size());
         ofs.close();
@@ -394,7 +378,7 @@ auto Session::handle_group_avatar_update(std::string const& payload) -> asio::aw
         // 更新数据库
         auto const success = co_await database::update_group_avatar(conv_id, relative_path);
         if(!success) {
-            co_return make_error_payload("SERVER_ERROR", "更新数据库失败");
+            co_return fail("SERVER_ERROR", "更新数据库失败");
         }
 
         // 注意: 群头像更新后，客户端收到响应会自动调用 needRequestConversationList 刷新会话列表
@@ -406,23 +390,19 @@ auto Session::handle_group_avatar_update(std::string const& payload) -> asio::aw
         resp["avatarPath"] = relative_path;
         co_return resp.dump();
     } catch(json::parse_error const&) {
-        co_return make_error_payload("INVALID_JSON", "请求 JSON 解析失败");
+        co_return fail("INVALID_JSON", "请求 JSON 解析失败");
     } catch(std::exception const& ex) {
-        co_return make_error_payload("SERVER_ERROR", ex.what());
+        co_return fail("SERVER_ERROR", ex.what());
     }
 }
 
-auto Session::handle_create_group_req(std::string const& payload) -> asio::awaitable<std::string>
+auto Session::handle_create_group_req(std::string_view payload) -> asio::awaitable<CommandReply>
 {
-    if(!authenticated_) {
-        co_return make_error_payload("NOT_AUTHENTICATED", "请先登录");
-    }
-
     try {
         auto j = payload.empty() ? json::object() : json::parse(payload);
 
         if(!j.contains("memberUserIds") || !j.at("memberUserIds").is_array()) {
-            co_return make_error_payload("INVALID_PARAM", "缺少 memberUserIds 数组");
+            co_return fail("INVALID_PARAM", "缺少 memberUserIds 数组");
         }
 
         auto const arr = j.at("memberUserIds");
@@ -434,7 +414,7 @@ auto Session::handle_create_group_req(std::string const& payload) -> asio::await
             try {
                 id = std::stoll(str);
             } catch(std::exception const&) {
-                co_return make_error_payload("INVALID_PARAM", "memberUserIds 中存在非法 ID");
+                co_return fail("INVALID_PARAM", "memberUserIds 中存在非法 ID");
             }
             if(id > 0) {
                 members.push_back(id);
@@ -443,7 +423,7 @@ auto Session::handle_create_group_req(std::string const& payload) -> asio::await
 
         // 至少要两位好友，加上创建者总计>=3
         if(members.size() < 2) {
-            co_return make_error_payload("INVALID_PARAM", "群成员不足");
+            co_return fail("INVALID_PARAM", "群成员不足");
         }
 
         auto name = std::string{};
@@ -457,19 +437,24 @@ auto Session::handle_create_group_req(std::string const& payload) -> asio::await
             trim(name);
         }
 
+        // pending 为 true 时其余成员随后经 GROUP_MEMBERS_ADD_REQ 分块加入，建群通知推迟到最后一块
+        auto const pending = j.value("pending", false);
+
         auto const conv_id = co_await database::create_group_conversation(user_id_, members, name);
 
         // 清除新会话的缓存(虽然是新创建,但确保一致性)
         if(auto server = server_.lock()) {
             server->invalidate_conversation_cache(conv_id);
             server->invalidate_member_list_cache(conv_id);
+            server->subscribe_conversation(conv_id, { user_id_ });
+            server->subscribe_conversation(conv_id, members);
         }
 
         // 取实际群名
         std::string conv_name = name;
         if(conv_name.empty()) {
             try {
-                auto conn_h = co_await database::acquire_connection();
+                auto conn_h = co_await database::acquire_handle();
                 boost::mysql::results r;
                 co_await conn_h->async_execute(
                     mysql::with_params(
@@ -485,11 +470,6 @@ auto Session::handle_create_group_req(std::string const& payload) -> asio::await
             if(conv_name.empty()) conv_name = "群聊";
         }
 
-        // 写首条系统消息（使用创建者作为 sender，消息类型标记为 SYSTEM）
-        auto const sys_content = std::string{ "你们创建了群聊：" } + conv_name;
-        auto const stored =
-            co_await database::append_text_message(conv_id, user_id_, sys_content, "SYSTEM");
-
         json resp;
         resp["ok"] = true;
         resp["conversationId"] = std::to_string(conv_id);
@@ -497,38 +477,121 @@ auto Session::handle_create_group_req(std::string const& payload) -> asio::await
         resp["title"] = conv_name;
         resp["memberCount"] = static_cast<i64>(members.size() + 1);
 
-        // 推送会话列表 & 系统消息给全体成员
-        if(auto server = server_.lock()) {
-            // 推送 creator + members
-            server->send_conv_list_to(user_id_);
-            for(auto const uid : members) {
-                server->send_conv_list_to(uid);
+        if(pending) {
+            pending_groups_[conv_id] = PendingGroup{ .title = conv_name, .member_ids = std::move(members) };
+            resp["pending"] = true;
+            co_return resp.dump();
+        }
+
+        co_await announce_group_created(conv_id, conv_name, members);
+        co_return resp.dump();
+    } catch(json::parse_error const&) {
+        co_return fail("INVALID_JSON", "请求 JSON 解析失败");
+    } catch(std::exception const& ex) {
+        co_return fail("SERVER_ERROR", ex.what());
+    }
+}
+
+auto Session::handle_group_members_add_req(std::string_view payload) -> asio::awaitable<CommandReply>
+{
+    try {
+        auto j = payload.empty() ? json::object() : json::parse(payload);
+
+        auto conv_id = i64{};
+        if(j.contains("conversationId")) {
+            conv_id = std::stoll(j.at("conversationId").get<std::string>());
+        }
+        auto const it = pending_groups_.find(conv_id);
+        if(it == pending_groups_.end()) {
+            co_return fail("INVALID_PARAM", "该群不在分块创建中");
+        }
+
+        if(!j.contains("memberUserIds") || !j.at("memberUserIds").is_array()) {
+            co_return fail("INVALID_PARAM", "缺少 memberUserIds 数组");
+        }
+        auto const& arr = j.at("memberUserIds");
+        if(arr.size() > MAX_GROUP_MEMBERS_CHUNK) {
+            co_return fail("INVALID_PARAM", "单次加入的成员过多");
+        }
+
+        std::vector<i64> members;
+        members.reserve(arr.size());
+        for(auto const& item : arr) {
+            auto id = i64{};
+            try {
+                id = std::stoll(item.get<std::string>());
+            } catch(std::exception const&) {
+                co_return fail("INVALID_PARAM", "memberUserIds 中存在非法 ID");
             }
-            server->broadcast_system_message(conv_id, stored, sys_content);
+            if(id > 0 && id != user_id_) {
+                members.push_back(id);
+            }
+        }
+
+        auto const added = co_await database::add_group_members(conv_id, members);
+
+        if(auto server = server_.lock()) {
+            server->invalidate_conversation_cache(conv_id);
+            server->invalidate_member_list_cache(conv_id);
+            server->subscribe_conversation(conv_id, members);
+        }
+
+        auto& group = it->second;
+        group.member_ids.insert(group.member_ids.end(), members.begin(), members.end());
+        std::ranges::sort(group.member_ids);
+        auto const dup = std::ranges::unique(group.member_ids);
+        group.member_ids.erase(dup.begin(), dup.end());
+
+        auto const is_final = j.value("final", false);
+
+        json resp;
+        resp["ok"] = true;
+        resp["conversationId"] = std::to_string(conv_id);
+        resp["added"] = static_cast<i64>(added);
+        resp["memberCount"] = static_cast<i64>(group.member_ids.size() + 1);
+        resp["final"] = is_final;
+
+        if(is_final) {
+            auto done = std::move(group);
+            pending_groups_.erase(it);
+            co_await announce_group_created(conv_id, done.title, done.member_ids);
         }
 
         co_return resp.dump();
     } catch(json::parse_error const&) {
-        co_return make_error_payload("INVALID_JSON", "请求 JSON 解析失败");
+        co_return fail("INVALID_JSON", "请求 JSON 解析失败");
     } catch(std::exception const& ex) {
-        co_return make_error_payload("SERVER_ERROR", ex.what());
+        co_return fail("SERVER_ERROR", ex.what());
     }
 }
 
-auto Session::handle_open_single_conv_req(std::string const& payload) -> asio::awaitable<std::string>
+auto Session::announce_group_created(i64 conv_id, std::string const& title, std::vector<i64> const& members)
+    -> asio::awaitable<void>
 {
-    std::println("[handle_open_single_conv_req] 收到请求, payload: {}", payload);
-    if(!authenticated_) {
-        std::println("[handle_open_single_conv_req] 用户未认证");
-        co_return make_error_payload("NOT_AUTHENTICATED", "请先登录");
+    // 写首条系统消息（使用创建者作为 sender，消息类型标记为 SYSTEM）
+    auto const sys_content = std::string{ "你们创建了群聊：" } + title;
+    auto const stored =
+        co_await database::append_text_message(conv_id, user_id_, sys_content, "SYSTEM", display_name_);
+
+    // 推送新会话的列表项 & 系统消息给全体成员
+    if(auto server = server_.lock()) {
+        // creator + members 的列表项由一次查询取得
+        auto recipients = members;
+        recipients.push_back(user_id_);
+        server->push_conv_upsert(conv_id, std::move(recipients));
+        server->broadcast_system_message(conv_id, stored, sys_content);
     }
+}
 
+auto Session::handle_open_single_conv_req(std::string_view payload) -> asio::awaitable<CommandReply>
+{
+    std::println("[handle_open_single_conv_req] 收到请求, payload: {}", payload);
     try {
         auto j = payload.empty() ? json::object() : json::parse(payload);
 
         if(!j.contains("peerUserId")) {
             std::println("[handle_open_single_conv_req] 缺少 peerUserId");
-            co_return make_error_payload("INVALID_PARAM", "缺少 peerUserId 字段");
+            co_return fail("INVALID_PARAM", "缺少 peerUserId 字段");
         }
 
         auto const peer_str = j.at("peerUserId").get<std::string>();
@@ -538,21 +601,21 @@ auto Session::handle_open_single_conv_req(std::string const& payload) -> asio::a
             peer_id = std::stoll(peer_str);
         } catch(std::exception const&) {
             std::println("[handle_open_single_conv_req] peerUserId 解析失败");
-            co_return make_error_payload("INVALID_PARAM", "peerUserId 非法");
+            co_return fail("INVALID_PARAM", "peerUserId 非法");
         }
         if(peer_id <= 0) {
             std::println("[handle_open_single_conv_req] peerUserId <= 0");
-            co_return make_error_payload("INVALID_PARAM", "peerUserId 非法");
+            co_return fail("INVALID_PARAM", "peerUserId 非法");
         }
         if(peer_id == user_id_) {
             std::println("[handle_open_single_conv_req] peerUserId == 自己");
-            co_return make_error_payload("INVALID_PARAM", "不能与自己建立单聊");
+            co_return fail("INVALID_PARAM", "不能与自己建立单聊");
         }
 
         std::println("[handle_open_single_conv_req] 检查是否为好友, user_id: {}, peer_id: {}", user_id_, peer_id);
         if(!co_await database::is_friend(user_id_, peer_id)) {
             std::println("[handle_open_single_conv_req] 不是好友");
-            co_return make_error_payload("NOT_FRIEND", "对方还不是你的好友");
+            co_return fail("NOT_FRIEND", "对方还不是你的好友");
         }
 
         std::println("[handle_open_single_conv_req] 是好友，获取或创建会话");
@@ -563,6 +626,7 @@ auto Session::handle_open_single_conv_req(std::string const& payload) -> asio::a
         if(auto server = server_.lock()) {
             server->invalidate_conversation_cache(conv_id);
             server->invalidate_member_list_cache(conv_id);
+            server->subscribe_conversation(conv_id, { user_id_, peer_id });
         }
 
         json resp;
@@ -573,23 +637,19 @@ auto Session::handle_open_single_conv_req(std::string const& payload) -> asio::a
         co_return resp.dump();
     } catch(json::parse_error const&) {
         std::println("[handle_open_single_conv_req] JSON 解析失败");
-        co_return make_error_payload("INVALID_JSON", "请求 JSON 解析失败");
+        co_return fail("INVALID_JSON", "请求 JSON 解析失败");
     } catch(std::exception const& ex) {
         std::println("[handle_open_single_conv_req] 异常: {}", ex.what());
-        co_return make_error_payload("SERVER_ERROR", ex.what());
+        co_return fail("SERVER_ERROR", ex.what());
     }
 }
 
-auto Session::handle_conv_members_req(std::string const& payload) -> asio::awaitable<std::string>
+auto Session::handle_conv_members_req(std::string_view payload) -> asio::awaitable<CommandReply>
 {
-    if(!authenticated_) {
-        co_return make_error_payload("NOT_AUTHENTICATED", "请先登录");
-    }
-
     try {
         auto j = payload.empty() ? json::object() : json::parse(payload);
         if(!j.contains("conversationId")) {
-            co_return make_error_payload("INVALID_PARAM", "缺少 conversationId 字段");
+            co_return fail("INVALID_PARAM", "缺少 conversationId 字段");
         }
 
         auto const conv_str = j.at("conversationId").get<std::string>();
@@ -597,15 +657,15 @@ auto Session::handle_conv_members_req(std::string const& payload) -> asio::await
         try {
             conv_id = std::stoll(conv_str);
         } catch(std::exception const&) {
-            co_return make_error_payload("INVALID_PARAM", "conversationId 非法");
+            co_return fail("INVALID_PARAM", "conversationId 非法");
         }
         if(conv_id <= 0) {
-            co_return make_error_payload("INVALID_PARAM", "conversationId 非法");
+            co_return fail("INVALID_PARAM", "conversationId 非法");
         }
 
         auto const member = co_await database::get_conversation_member(conv_id, user_id_);
         if(!member.has_value()) {
-            co_return make_error_payload("FORBIDDEN", "你不是该会话成员");
+            co_return fail("FORBIDDEN", "你不是该会话成员");
         }
 
         // 分页参数：offset / limit，默认 0 / 50，最大 200
@@ -655,22 +715,18 @@ auto Session::handle_conv_members_req(std::string const& payload) -> asio::await
         resp["members"] = std::move(arr);
         co_return resp.dump();
     } catch(json::parse_error const&) {
-        co_return make_error_payload("INVALID_JSON", "请求 JSON 解析失败");
+        co_return fail("INVALID_JSON", "请求 JSON 解析失败");
     } catch(std::exception const& ex) {
-        co_return make_error_payload("SERVER_ERROR", ex.what());
+        co_return fail("SERVER_ERROR", ex.what());
     }
 }
 
-auto Session::handle_mute_member_req(std::string const& payload) -> asio::awaitable<std::string>
+auto Session::handle_mute_member_req(std::string_view payload) -> asio::awaitable<CommandReply>
 {
-    if(!authenticated_) {
-        co_return make_error_payload("NOT_AUTHENTICATED", "请先登录");
-    }
-
     try {
         auto j = payload.empty() ? json::object() : json::parse(payload);
         if(!j.contains("conversationId") || !j.contains("targetUserId") || !j.contains("durationSeconds")) {
-            co_return make_error_payload("INVALID_PARAM", "缺少必要字段");
+            co_return fail("INVALID_PARAM", "缺少必要字段");
         }
 
         auto conv_id = i64{};
@@ -680,36 +736,36 @@ auto Session::handle_mute_member_req(std::string const& payload) -> asio::awaita
             conv_id = std::stoll(j.at("conversationId").get<std::string>());
             target_id = std::stoll(j.at("targetUserId").get<std::string>());
         } catch(std::exception const&) {
-            co_return make_error_payload("INVALID_PARAM", "conversationId 或 targetUserId 非法");
+            co_return fail("INVALID_PARAM", "conversationId 或 targetUserId 非法");
         }
         duration = j.at("durationSeconds").get<i64>();
 
         if(conv_id <= 0 || target_id <= 0) {
-            co_return make_error_payload("INVALID_PARAM", "参数非法");
+            co_return fail("INVALID_PARAM", "参数非法");
         }
         if(duration <= 0) {
-            co_return make_error_payload("INVALID_PARAM", "禁言时长必须大于 0");
+            co_return fail("INVALID_PARAM", "禁言时长必须大于 0");
         }
 
         auto const self_member = co_await database::get_conversation_member(conv_id, user_id_);
         if(!self_member.has_value()) {
-            co_return make_error_payload("FORBIDDEN", "你不是该会话成员");
+            co_return fail("FORBIDDEN", "你不是该会话成员");
         }
         // 群主和管理员都可以禁言
         if(self_member->role != "OWNER" && self_member->role != "ADMIN") {
-            co_return make_error_payload("FORBIDDEN", "仅群主和管理员可禁言成员");
+            co_return fail("FORBIDDEN", "仅群主和管理员可禁言成员");
         }
 
         auto const target_member = co_await database::get_conversation_member(conv_id, target_id);
         if(!target_member.has_value()) {
-            co_return make_error_payload("NOT_FOUND", "目标成员不存在");
+            co_return fail("NOT_FOUND", "目标成员不存在");
         }
         if(target_member->role == "OWNER") {
-            co_return make_error_payload("FORBIDDEN", "不能禁言群主");
+            co_return fail("FORBIDDEN", "不能禁言群主");
         }
         // 管理员不能禁言其他管理员
         if(self_member->role == "ADMIN" && target_member->role == "ADMIN") {
-            co_return make_error_payload("FORBIDDEN", "管理员不能禁言其他管理员");
+            co_return fail("FORBIDDEN", "管理员不能禁言其他管理员");
         }
 
         auto const now_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
@@ -721,6 +777,7 @@ auto Session::handle_mute_member_req(std::string const& payload) -> asio::awaita
         co_await database::set_member_mute_until(conv_id, target_id, muted_until_ms);
 
         if(auto server = server_.lock()) {
+            server->set_conversation_cache_mute(conv_id, target_id, muted_until_ms);
             server->invalidate_member_list_cache(conv_id);
         }
 
@@ -739,7 +796,7 @@ auto Session::handle_mute_member_req(std::string const& payload) -> asio::awaita
             "已将 " + target_name + " 禁言至 " + std::string{ buf };
 
         auto const stored =
-            co_await database::append_text_message(conv_id, user_id_, sys_content, "SYSTEM");
+            co_await database::append_text_message(conv_id, user_id_, sys_content, "SYSTEM", display_name_);
 
         if(auto server = server_.lock()) {
             server->broadcast_system_message(conv_id, stored, sys_content);
@@ -753,23 +810,19 @@ auto Session::handle_mute_member_req(std::string const& payload) -> asio::awaita
         resp["mutedUntilMs"] = muted_until_ms;
         co_return resp.dump();
     } catch(json::parse_error const&) {
-        co_return make_error_payload("INVALID_JSON", "请求 JSON 解析失败");
+        co_return fail("INVALID_JSON", "请求 JSON 解析失败");
     } catch(std::exception const& ex) {
-        co_return make_error_payload("SERVER_ERROR", ex.what());
+        co_return fail("SERVER_ERROR", ex.what());
     }
 }
 
-auto Session::handle_unmute_member_req(std::string const& payload) -> asio::awaitable<std::string>
+auto Session::handle_unmute_member_req(std::string_view payload) -> asio::awaitable<CommandReply>
 {
-    if(!authenticated_) {
-        co_return make_error_payload("NOT_AUTHENTICATED", "请先登录");
-    }
-
     try {
         auto j = payload.empty() ? json::object() : json::parse(payload);
 
         if(!j.contains("conversationId") || !j.contains("targetUserId")) {
-            co_return make_error_payload("INVALID_PARAM", "缺少必要字段");
+            co_return fail("INVALID_PARAM", "缺少必要字段");
         }
 
         auto conv_id = i64{};
@@ -778,33 +831,34 @@ auto Session::handle_unmute_member_req(std::string const& payload) -> asio::awai
             conv_id = std::stoll(j.at("conversationId").get<std::string>());
             target_id = std::stoll(j.at("targetUserId").get<std::string>());
         } catch(std::exception const&) {
-            co_return make_error_payload("INVALID_PARAM", "conversationId 或 targetUserId 非法");
+            co_return fail("INVALID_PARAM", "conversationId 或 targetUserId 非法");
         }
         if(conv_id <= 0 || target_id <= 0) {
-            co_return make_error_payload("INVALID_PARAM", "参数非法");
+            co_return fail("INVALID_PARAM", "参数非法");
         }
 
         auto const self_member = co_await database::get_conversation_member(conv_id, user_id_);
         if(!self_member.has_value()) {
-            co_return make_error_payload("FORBIDDEN", "你不是该会话成员");
+            co_return fail("FORBIDDEN", "你不是该会话成员");
         }
         // 群主和管理员都可以解禁
         if(self_member->role != "OWNER" && self_member->role != "ADMIN") {
-            co_return make_error_payload("FORBIDDEN", "仅群主和管理员可解除禁言");
+            co_return fail("FORBIDDEN", "仅群主和管理员可解除禁言");
         }
 
         auto const target_member = co_await database::get_conversation_member(conv_id, target_id);
         if(!target_member.has_value()) {
-            co_return make_error_payload("NOT_FOUND", "目标成员不存在");
+            co_return fail("NOT_FOUND", "目标成员不存在");
         }
         // 管理员不能解禁其他管理员（虽然不能禁言也就不需要解禁，但为了逻辑完整性）
         if(self_member->role == "ADMIN" && target_member->role == "ADMIN") {
-            co_return make_error_payload("FORBIDDEN", "管理员不能操作其他管理员");
+            co_return fail("FORBIDDEN", "管理员不能操作其他管理员");
         }
 
         co_await database::set_member_mute_until(conv_id, target_id, 0);
 
         if(auto server = server_.lock()) {
+            server->set_conversation_cache_mute(conv_id, target_id, 0);
             server->invalidate_member_list_cache(conv_id);
         }
 
@@ -812,7 +866,7 @@ auto Session::handle_unmute_member_req(std::string const& payload) -> asio::awai
         auto const sys_content =
             "已解除 " + target_name + " 的禁言";
         auto const stored =
-            co_await database::append_text_message(conv_id, user_id_, sys_content, "SYSTEM");
+            co_await database::append_text_message(conv_id, user_id_, sys_content, "SYSTEM", display_name_);
 
         if(auto server = server_.lock()) {
             server->broadcast_system_message(conv_id, stored, sys_content);
@@ -825,23 +879,19 @@ auto Session::handle_unmute_member_req(std::string const& payload) -> asio::awai
         resp["targetUserId"] = std::to_string(target_id);
         co_return resp.dump();
     } catch(json::parse_error const&) {
-        co_return make_error_payload("INVALID_JSON", "请求 JSON 解析失败");
+        co_return fail("INVALID_JSON", "请求 JSON 解析失败");
     } catch(std::exception const& ex) {
-        co_return make_error_payload("SERVER_ERROR", ex.what());
+        co_return fail("SERVER_ERROR", ex.what());
     }
 }
 
-auto Session::handle_leave_conv_req(std::string const& payload) -> asio::awaitable<std::string>
+auto Session::handle_leave_conv_req(std::string_view payload) -> asio::awaitable<CommandReply>
 {
-    if(!authenticated_) {
-        co_return make_error_payload("NOT_AUTHENTICATED", "请先登录");
-    }
-
     try {
         auto j = payload.empty() ? json::object() : json::parse(payload);
 
         if(!j.contains("conversationId")) {
-            co_return make_error_payload("INVALID_PARAM", "缺少 conversationId 字段");
+            co_return fail("INVALID_PARAM", "缺少 conversationId 字段");
         }
 
         auto const conv_str = j.at("conversationId").get<std::string>();
@@ -849,17 +899,17 @@ auto Session::handle_leave_conv_req(std::string const& payload) -> asio::awaitab
         try {
             conv_id = std::stoll(conv_str);
         } catch(std::exception const&) {
-            co_return make_error_payload("INVALID_PARAM", "conversationId 非法");
+            co_return fail("INVALID_PARAM", "conversationId 非法");
         }
         if(conv_id <= 0) {
-            co_return make_error_payload("INVALID_PARAM", "conversationId 非法");
+            co_return fail("INVALID_PARAM", "conversationId 非法");
         }
 
         // 默认“世界”会话不允许退出 / 解散。
         try {
             auto const world_id = co_await database::get_world_conversation_id();
             if(conv_id == world_id) {
-                co_return make_error_payload("FORBIDDEN", "无法退出默认会话");
+                co_return fail("FORBIDDEN", "无法退出默认会话");
             }
         } catch(std::exception const&) {
             // 若世界会话缺失，忽略该保护。
@@ -868,7 +918,7 @@ auto Session::handle_leave_conv_req(std::string const& payload) -> asio::awaitab
         // 校验会话存在且为群聊。
         std::string conv_type;
         {
-            auto conn_h = co_await database::acquire_connection();
+            auto conn_h = co_await database::acquire_handle();
             boost::mysql::results r;
             co_await conn_h->async_execute(
                 mysql::with_params(
@@ -878,18 +928,18 @@ auto Session::handle_leave_conv_req(std::string const& payload) -> asio::awaitab
                 asio::use_awaitable
             );
             if(r.rows().empty()) {
-                co_return make_error_payload("NOT_FOUND", "会话不存在");
+                co_return fail("NOT_FOUND", "会话不存在");
             }
             conv_type = r.rows().front().at(0).as_string();
         }
 
         if(conv_type != "GROUP") {
-            co_return make_error_payload("INVALID_PARAM", "仅支持群聊会话");
+            co_return fail("INVALID_PARAM", "仅支持群聊会话");
         }
 
         auto const self_member = co_await database::get_conversation_member(conv_id, user_id_);
         if(!self_member.has_value()) {
-            co_return make_error_payload("FORBIDDEN", "你不是该会话成员");
+            co_return fail("FORBIDDEN", "你不是该会话成员");
         }
 
         auto members = co_await database::load_conversation_members(conv_id);
@@ -905,7 +955,7 @@ auto Session::handle_leave_conv_req(std::string const& payload) -> asio::awaitab
             // 普通成员退出群聊，群继续存在。
             auto const sys_content = leaver_name + " 退出了群聊";
             auto const stored =
-                co_await database::append_text_message(conv_id, user_id_, sys_content, "SYSTEM");
+                co_await database::append_text_message(conv_id, user_id_, sys_content, "SYSTEM", display_name_);
 
             if(auto server = server_.lock()) {
                 server->broadcast_system_message(conv_id, stored, sys_content);
@@ -914,8 +964,11 @@ auto Session::handle_leave_conv_req(std::string const& payload) -> asio::awaitab
             co_await database::remove_conversation_member(conv_id, user_id_);
 
             if(auto server = server_.lock()) {
-                // 退出者的会话列表需要刷新；群内其他成员刷新成员列表。
-                server->send_conv_list_to(user_id_);
+                server->remove_conversation_cache_member(conv_id, user_id_);
+                server->unsubscribe_conversation(conv_id, { user_id_ });
+                server->invalidate_member_list_cache(conv_id);
+                // 退出者的会话列表移除该群；群内其他成员刷新成员列表。
+                server->push_conv_remove(conv_id, { user_id_ });
                 server->send_conv_members(conv_id);
             }
 
@@ -942,9 +995,11 @@ auto Session::handle_leave_conv_req(std::string const& payload) -> asio::awaitab
         }
 
         auto const stored =
-            co_await database::append_text_message(conv_id, user_id_, sys_content, "SYSTEM");
+            co_await database::append_text_message(conv_id, user_id_, sys_content, "SYSTEM", display_name_);
 
         if(auto server = server_.lock()) {
+            // 先确保成员列表已缓存，否则异步回源可能晚于解散而查不到成员
+            co_await server->get_conversation_cache(conv_id);
             server->broadcast_system_message(conv_id, stored, sys_content);
         }
 
@@ -954,9 +1009,8 @@ auto Session::handle_leave_conv_req(std::string const& payload) -> asio::awaitab
         if(auto server = server_.lock()) {
             server->invalidate_conversation_cache(conv_id);
             server->invalidate_member_list_cache(conv_id);
-            for(auto const uid : member_ids) {
-                server->send_conv_list_to(uid);
-            }
+            server->close_conversation_topic(conv_id);
+            server->push_conv_remove(conv_id, std::move(member_ids));
         }
 
         json resp;
@@ -966,22 +1020,18 @@ auto Session::handle_leave_conv_req(std::string const& payload) -> asio::awaitab
         resp["memberCountBefore"] = member_count;
         co_return resp.dump();
     } catch(json::parse_error const&) {
-        co_return make_error_payload("INVALID_JSON", "请求 JSON 解析失败");
+        co_return fail("INVALID_JSON", "请求 JSON 解析失败");
     } catch(std::exception const& ex) {
-        co_return make_error_payload("SERVER_ERROR", ex.what());
+        co_return fail("SERVER_ERROR", ex.what());
     }
 }
 
-auto Session::handle_set_admin_req(std::string const& payload) -> asio::awaitable<std::string>
+auto Session::handle_set_admin_req(std::string_view payload) -> asio::awaitable<CommandReply>
 {
-    if(!authenticated_) {
-        co_return make_error_payload("NOT_AUTHENTICATED", "请先登录");
-    }
-
     try {
         auto j = payload.empty() ? json::object() : json::parse(payload);
         if(!j.contains("conversationId") || !j.contains("targetUserId") || !j.contains("isAdmin")) {
-            co_return make_error_payload("INVALID_PARAM", "缺少必要字段");
+            co_return fail("INVALID_PARAM", "缺少必要字段");
         }
 
         auto conv_id = i64{};
@@ -992,26 +1042,26 @@ auto Session::handle_set_admin_req(std::string const& payload) -> asio::awaitabl
             target_id = std::stoll(j.at("targetUserId").get<std::string>());
             is_admin = j.at("isAdmin").get<bool>();
         } catch(std::exception const&) {
-            co_return make_error_payload("INVALID_PARAM", "conversationId 或 targetUserId 非法");
+            co_return fail("INVALID_PARAM", "conversationId 或 targetUserId 非法");
         }
         if(conv_id <= 0 || target_id <= 0) {
-            co_return make_error_payload("INVALID_PARAM", "参数非法");
+            co_return fail("INVALID_PARAM", "参数非法");
         }
 
         auto const self_member = co_await database::get_conversation_member(conv_id, user_id_);
         if(!self_member.has_value()) {
-            co_return make_error_payload("FORBIDDEN", "你不是该会话成员");
+            co_return fail("FORBIDDEN", "你不是该会话成员");
         }
         if(self_member->role != "OWNER") {
-            co_return make_error_payload("FORBIDDEN", "仅群主可设置管理员");
+            co_return fail("FORBIDDEN", "仅群主可设置管理员");
         }
 
         auto const target_member = co_await database::get_conversation_member(conv_id, target_id);
         if(!target_member.has_value()) {
-            co_return make_error_payload("NOT_FOUND", "目标成员不存在");
+            co_return fail("NOT_FOUND", "目标成员不存在");
         }
         if(target_member->role == "OWNER") {
-            co_return make_error_payload("FORBIDDEN", "不能更改群主角色");
+            co_return fail("FORBIDDEN", "不能更改群主角色");
         }
 
         auto const new_role = is_admin ? "ADMIN" : "MEMBER";
@@ -1037,7 +1087,7 @@ auto Session::handle_set_admin_req(std::string const& payload) -> asio::awaitabl
             : ("已取消 " + target_name + " 的管理员身份");
         
         auto const stored =
-            co_await database::append_text_message(conv_id, user_id_, sys_content, "SYSTEM");
+            co_await database::append_text_message(conv_id, user_id_, sys_content, "SYSTEM", display_name_);
 
         if(auto server = server_.lock()) {
             server->broadcast_system_message(conv_id, stored, sys_content);
@@ -1051,23 +1101,19 @@ auto Session::handle_set_admin_req(std::string const& payload) -> asio::awaitabl
         resp["isAdmin"] = is_admin;
         co_return resp.dump();
     } catch(json::parse_error const&) {
-        co_return make_error_payload("INVALID_JSON", "请求 JSON 解析失败");
+        co_return fail("INVALID_JSON", "请求 JSON 解析失败");
     } catch(std::exception const& ex) {
-        co_return make_error_payload("SERVER_ERROR", ex.what());
+        co_return fail("SERVER_ERROR", ex.what());
     }
 }
 
-auto Session::handle_rename_group_req(std::string const& payload) -> asio::awaitable<std::string>
+auto Session::handle_rename_group_req(std::string_view payload) -> asio::awaitable<CommandReply>
 {
-    if(!authenticated_) {
-        co_return make_error_payload("NOT_AUTHENTICATED", "请先登录");
-    }
-
     try {
         auto j = payload.empty() ? json::object() : json::parse(payload);
 
         if(!j.contains("conversationId") || !j.contains("newName")) {
-            co_return make_error_payload("INVALID_PARAM", "缺少必要字段");
+            co_return fail("INVALID_PARAM", "缺少必要字段");
         }
 
         auto const conv_str = j.at("conversationId").get<std::string>();
@@ -1075,10 +1121,10 @@ auto Session::handle_rename_group_req(std::string const& payload) -> asio::await
         try {
             conv_id = std::stoll(conv_str);
         } catch(std::exception const&) {
-            co_return make_error_payload("INVALID_PARAM", "conversationId 非法");
+            co_return fail("INVALID_PARAM", "conversationId 非法");
         }
         if(conv_id <= 0) {
-            co_return make_error_payload("INVALID_PARAM", "conversationId 非法");
+            co_return fail("INVALID_PARAM", "conversationId 非法");
         }
 
         auto new_name = j.at("newName").get<std::string>();
@@ -1091,16 +1137,16 @@ auto Session::handle_rename_group_req(std::string const& payload) -> asio::await
         trim(new_name);
 
         if(new_name.empty()) {
-            co_return make_error_payload("INVALID_PARAM", "群名称不能为空");
+            co_return fail("INVALID_PARAM", "群名称不能为空");
         }
         if(new_name.size() > 64) {
-            co_return make_error_payload("INVALID_PARAM", "群名称过长");
+            co_return fail("INVALID_PARAM", "群名称过长");
         }
 
         // 校验是群聊
         std::string conv_type;
         {
-            auto conn_h = co_await database::acquire_connection();
+            auto conn_h = co_await database::acquire_handle();
             boost::mysql::results r;
             co_await conn_h->async_execute(
                 mysql::with_params(
@@ -1110,26 +1156,26 @@ auto Session::handle_rename_group_req(std::string const& payload) -> asio::await
                 asio::use_awaitable
             );
             if(r.rows().empty()) {
-                co_return make_error_payload("NOT_FOUND", "会话不存在");
+                co_return fail("NOT_FOUND", "会话不存在");
             }
             conv_type = r.rows().front().at(0).as_string();
         }
         if(conv_type != "GROUP") {
-            co_return make_error_payload("INVALID_PARAM", "仅支持群聊会话");
+            co_return fail("INVALID_PARAM", "仅支持群聊会话");
         }
 
         // 校验权限：仅群主和管理员可修改群名
         auto const self_member = co_await database::get_conversation_member(conv_id, user_id_);
         if(!self_member.has_value()) {
-            co_return make_error_payload("FORBIDDEN", "你不是该会话成员");
+            co_return fail("FORBIDDEN", "你不是该会话成员");
         }
         if(self_member->role != "OWNER" && self_member->role != "ADMIN") {
-            co_return make_error_payload("FORBIDDEN", "仅群主和管理员可修改群名");
+            co_return fail("FORBIDDEN", "仅群主和管理员可修改群名");
         }
 
         // 更新群名
         {
-            auto conn_h = co_await database::acquire_connection();
+            auto conn_h = co_await database::acquire_handle();
             boost::mysql::results r;
             co_await conn_h->async_execute(
                 mysql::with_params(
@@ -1140,24 +1186,15 @@ auto Session::handle_rename_group_req(std::string const& payload) -> asio::await
             );
         }
 
-        // 清除会话缓存
-        if(auto server = server_.lock()) {
-            server->invalidate_conversation_cache(conv_id);
-        }
-
         // 系统消息通知
         auto const operator_name = self_member->display_name;
         auto const sys_content = operator_name + " 将群名修改为 \"" + new_name + "\"";
-        auto const stored = co_await database::append_text_message(conv_id, user_id_, sys_content, "SYSTEM");
+        auto const stored = co_await database::append_text_message(conv_id, user_id_, sys_content, "SYSTEM", display_name_);
 
-        // 广播系统消息并刷新所有成员的会话列表
+        // 广播系统消息，并只推送新群名（对所有成员相同），不重新加载成员与会话列表
         if(auto server = server_.lock()) {
             server->broadcast_system_message(conv_id, stored, sys_content);
-            // 刷新所有成员的会话列表以显示新群名
-            auto members = co_await database::load_conversation_members(conv_id);
-            for(auto const& m : members) {
-                server->send_conv_list_to(m.user_id);
-            }
+            server->push_conv_title(conv_id, new_name);
         }
 
         json resp;
@@ -1166,8 +1203,8 @@ auto Session::handle_rename_group_req(std::string const& payload) -> asio::await
         resp["newName"] = new_name;
         co_return resp.dump();
     } catch(json::parse_error const&) {
-        co_return make_error_payload("INVALID_JSON", "请求 JSON 解析失败");
+        co_return fail("INVALID_JSON", "请求 JSON 解析失败");
     } catch(std::exception const& ex) {
-        co_return make_error_payload("SERVER_ERROR", ex.what());
+        co_return fail("SERVER_ERROR", ex.what());
     }
 }
@@ -0,0 +1,310 @@
+#include <session.h>
+#include <database/connection.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <limits>
+
+using nlohmann::json;
+namespace asio = boost::asio;
+
+namespace
+{
+    /// \brief 带种子的 FNV-1a，用于构造命令名的完美哈希。
+    constexpr auto hash_command(std::string_view name, u64 seed) noexcept -> u64
+    {
+        auto h = u64{ 14695981039346656037ull } ^ seed;
+        for(char c : name) {
+            h ^= static_cast<u8>(c);
+            h *= u64{ 1099511628211ull };
+        }
+        return h ^ (h >> 29);
+    }
+
+    /// \brief 编译期构造的无冲突哈希表：命令名 -> 注册表下标。
+    /// \tparam Slots 槽位数，必须是 2 的幂，取命令数的数倍以便快速找到无冲突种子。
+    template<std::size_t Slots>
+    struct PerfectHash
+    {
+        static_assert((Slots & (Slots - 1)) == 0, "slot count must be a power of two");
+
+        u64 seed{ 0 };
+        /// \brief 0 表示空槽，否则为注册表下标 + 1。
+        std::array<u8, Slots> slots{};
+
+        constexpr auto slot_of(std::string_view name) const noexcept -> std::size_t
+        {
+            return static_cast<std::size_t>(hash_command(name, seed) & (Slots - 1));
+        }
+    };
+
+    /// \brief 逐个尝试种子，直到所有命令名落在不同槽位。
+    /// \note 命令名重复时永远找不到种子，编译期直接报错。
+    template<std::size_t Slots, typename Table>
+    consteval auto build_perfect_hash(Table const& table) -> PerfectHash<Slots>
+    {
+        static_assert(std::tuple_size_v<Table> < std::numeric_limits<u8>::max());
+        for(u64 seed = 1; seed < 100000; ++seed) {
+            PerfectHash<Slots> hash{ seed, {} };
+            auto ok = true;
+            for(std::size_t i = 0; i < table.size() && ok; ++i) {
+                auto& slot = hash.slots[hash.slot_of(table[i].name)];
+                if(slot != 0) {
+                    ok = false;
+                } else {
+                    slot = static_cast<u8>(i + 1);
+                }
+            }
+            if(ok) {
+                return hash;
+            }
+        }
+        throw "command table contains duplicate names";
+    }
+
+    /// \brief 单个命令的原子计数器，处理函数可能在多个线程上并发执行。
+    struct CommandCounters
+    {
+        std::atomic<u64> calls{ 0 };
+        std::atomic<u64> errors{ 0 };
+        std::atomic<u64> rejected{ 0 };
+        std::atomic<u64> total_us{ 0 };
+        std::atomic<u64> max_us{ 0 };
+    };
+} // namespace
+
+/// \brief 命令注册表：命令名到处理函数及其元数据的编译期映射。
+/// \details 新增命令时只需在 table 中追加一行；查找走完美哈希，
+///          与命令在表中的位置无关，同一张表同时驱动鉴权、派发方式与统计。
+struct CommandRegistry
+{
+    using Handler = auto (Session::*)(std::string_view payload) -> asio::awaitable<CommandReply>;
+
+    /// \brief 命令执行方式。
+    enum class DispatchMode : u8
+    {
+        /// 读循环等待处理完成后再读下一帧，同一连接上的请求按序处理。
+        inline_call,
+        /// 复制负载后派生到独立协程，读循环立即继续。
+        spawned,
+    };
+
+    /// \brief 命令对数据的访问方式，决定之后的读请求能否走只读副本。
+    enum class Access : u8
+    {
+        /// 只读，按会话最近的写入时间选择主库或副本。
+        read,
+        /// 会修改数据，执行前后刷新会话的写入时间。
+        write,
+    };
+
+    struct Spec
+    {
+        std::string_view name;
+        /// \brief 响应命令名；为空表示处理函数自行写回，未登录时也不回包。
+        std::string_view response;
+        Handler handler;
+        bool requires_auth;
+        DispatchMode mode;
+        Access access;
+    };
+
+    static constexpr auto npos = std::numeric_limits<std::size_t>::max();
+
+    static constexpr auto table = std::to_array<Spec>({
+        { "PING", "PONG", &Session::handle_ping, false, DispatchMode::inline_call, Access::read },
+        { "HELLO", "HELLO_RESP", &Session::handle_hello, false, DispatchMode::inline_call, Access::read },
+        { "REGISTER", "REGISTER_RESP", &Session::handle_register, false, DispatchMode::inline_call, Access::write },
+        { "LOGIN", "LOGIN_RESP", &Session::handle_login, false, DispatchMode::inline_call, Access::read },
+        { "SEND_MSG", "", &Session::handle_send_msg, true, DispatchMode::spawned, Access::write },
+        { "HISTORY_REQ", "HISTORY_RESP", &Session::handle_history_req, true, DispatchMode::inline_call, Access::read },
+        { "CONV_LIST_REQ", "CONV_LIST_RESP", &Session::handle_conv_list_req, true, DispatchMode::inline_call, Access::read },
+        { "SYNC_REQ", "SYNC_RESP", &Session::handle_sync_req, true, DispatchMode::inline_call, Access::read },
+        { "MARK_READ_REQ", "MARK_READ_RESP", &Session::handle_mark_read_req, true, DispatchMode::inline_call, Access::write },
+        { "PROFILE_UPDATE", "PROFILE_UPDATE_RESP", &Session::handle_profile_update, true, DispatchMode::inline_call, Access::write },
+        { "AVATAR_UPDATE", "AVATAR_UPDATE_RESP", &Session::handle_avatar_update, true, DispatchMode::inline_call, Access::write },
+        { "GROUP_AVATAR_UPDATE", "GROUP_AVATAR_UPDATE_RESP", &Session::handle_group_avatar_update, true, DispatchMode::inline_call, Access::write },
+        { "FRIEND_LIST_REQ", "FRIEND_LIST_RESP", &Session::handle_friend_list_req, true, DispatchMode::inline_call, Access::read },
+        { "FRIEND_SEARCH_REQ", "FRIEND_SEARCH_RESP", &Session::handle_friend_search_req, true, DispatchMode::inline_call, Access::read },
+        { "FRIEND_ADD_REQ", "FRIEND_ADD_RESP", &Session::handle_friend_add_req, true, DispatchMode::inline_call, Access::write },
+        { "FRIEND_REQ_LIST_REQ", "FRIEND_REQ_LIST_RESP", &Session::handle_friend_req_list_req, true, DispatchMode::inline_call, Access::read },
+        { "FRIEND_ACCEPT_REQ", "FRIEND_ACCEPT_RESP", &Session::handle_friend_accept_req, true, DispatchMode::inline_call, Access::write },
+        { "FRIEND_REJECT_REQ", "FRIEND_REJECT_RESP", &Session::handle_friend_reject_req, true, DispatchMode::inline_call, Access::write },
+        { "FRIEND_DELETE_REQ", "FRIEND_DELETE_RESP", &Session::handle_friend_delete_req, true, DispatchMode::inline_call, Access::write },
+        { "CREATE_GROUP_REQ", "CREATE_GROUP_RESP", &Session::handle_create_group_req, true, DispatchMode::inline_call, Access::write },
+        { "GROUP_MEMBERS_ADD_REQ", "GROUP_MEMBERS_ADD_RESP", &Session::handle_group_members_add_req, true, DispatchMode::inline_call, Access::write },
+        { "OPEN_SINGLE_CONV_REQ", "OPEN_SINGLE_CONV_RESP", &Session::handle_open_single_conv_req, true, DispatchMode::inline_call, Access::write },
+        { "MUTE_MEMBER_REQ", "MUTE_MEMBER_RESP", &Session::handle_mute_member_req, true, DispatchMode::inline_call, Access::write },
+        { "UNMUTE_MEMBER_REQ", "UNMUTE_MEMBER_RESP", &Session::handle_unmute_member_req, true, DispatchMode::inline_call, Access::write },
+        { "SET_ADMIN_REQ", "SET_ADMIN_RESP", &Session::handle_set_admin_req, true, DispatchMode::inline_call, Access::write },
+        { "CONV_MEMBERS_REQ", "CONV_MEMBERS_RESP", &Session::handle_conv_members_req, true, DispatchMode::inline_call, Access::read },
+        { "LEAVE_CONV_REQ", "LEAVE_CONV_RESP", &Session::handle_leave_conv_req, true, DispatchMode::inline_call, Access::write },
+        { "GROUP_SEARCH_REQ", "GROUP_SEARCH_RESP", &Session::handle_group_search_req, true, DispatchMode::inline_call, Access::read },
+        { "GROUP_JOIN_REQ", "GROUP_JOIN_RESP", &Session::handle_group_join_req, true, DispatchMode::inline_call, Access::write },
+        { "GROUP_JOIN_REQ_LIST_REQ", "GROUP_JOIN_REQ_LIST_RESP", &Session::handle_group_join_req_list_req, true, DispatchMode::inline_call, Access::read },
+        { "GROUP_JOIN_ACCEPT_REQ", "GROUP_JOIN_ACCEPT_RESP", &Session::handle_group_join_accept_req, true, DispatchMode::inline_call, Access::write },
+        { "RENAME_GROUP_REQ", "RENAME_GROUP_RESP", &Session::handle_rename_group_req, true, DispatchMode::inline_call, Access::write },
+        { "RECALL_MSG_REQ", "RECALL_MSG_RESP", &Session::handle_recall_msg_req, true, DispatchMode::inline_call, Access::write },
+        { "MSG_REACTION_REQ", "MSG_REACTION_RESP", &Session::handle_msg_reaction_req, true, DispatchMode::inline_call, Access::write },
+        { "MSG_UNREACTION_REQ", "MSG_UNREACTION_RESP", &Session::handle_msg_unreaction_req, true, DispatchMode::inline_call, Access::write },
+    });
+
+    static constexpr auto index = build_perfect_hash<256>(table);
+
+    static inline std::array<CommandCounters, table.size()> counters{};
+
+    /// \brief 查找命令在注册表中的下标，未注册时返回 npos。
+    static auto find(std::string_view name) noexcept -> std::size_t
+    {
+        auto const slot = index.slots[index.slot_of(name)];
+        if(slot == 0 || table[slot - 1].name != name) {
+            return npos;
+        }
+        return slot - 1;
+    }
+
+    /// \brief 执行处理函数、记录统计并按元数据写回响应。
+    static auto invoke(Session& session, std::size_t i, std::string_view payload) -> asio::awaitable<void>
+    {
+        auto const& spec = table[i];
+        auto const start = std::chrono::steady_clock::now();
+        // 执行前后各记一次：执行期间的读走主库，完成后的读窗口从写入提交时算起
+        if(spec.access == Access::write) {
+            mark_write(session, start);
+        }
+
+        CommandReply reply;
+        try {
+            reply = co_await (session.*spec.handler)(payload);
+        } catch(...) {
+            record(i, start, true);
+            if(spec.access == Access::write) {
+                mark_write(session, std::chrono::steady_clock::now());
+            }
+            throw;
+        }
+        record(i, start, reply.failed);
+        if(spec.access == Access::write) {
+            mark_write(session, std::chrono::steady_clock::now());
+        }
+
+        if(!reply.payload.empty() && !spec.response.empty()) {
+            session.send_frame(spec.response, std::move(reply.payload));
+        }
+    }
+
+    static auto mark_write(Session& session, std::chrono::steady_clock::time_point at) -> void
+    {
+        session.last_write_ticks_.store(at.time_since_epoch().count(), std::memory_order_relaxed);
+    }
+
+    static auto record(std::size_t i, std::chrono::steady_clock::time_point start, bool failed) -> void
+    {
+        using namespace std::chrono;
+        auto const us = static_cast<u64>(duration_cast<microseconds>(steady_clock::now() - start).count());
+        auto& c = counters[i];
+        c.calls.fetch_add(1, std::memory_order_relaxed);
+        c.total_us.fetch_add(us, std::memory_order_relaxed);
+        if(failed) {
+            c.errors.fetch_add(1, std::memory_order_relaxed);
+        }
+        auto prev = c.max_us.load(std::memory_order_relaxed);
+        while(us > prev && !c.max_us.compare_exchange_weak(prev, us, std::memory_order_relaxed)) {
+        }
+    }
+};
+
+auto Session::dispatch_frame(std::string_view command, std::string_view payload) -> asio::awaitable<void>
+{
+    auto const i = CommandRegistry::find(command);
+    if(i == CommandRegistry::npos) {
+        // 默认 echo，方便用 nc 观察未知命令。
+        auto resp = std::string{ "{\"command\":\"" + std::string{ command } + "\"}" };
+        send_frame("ECHO", std::move(resp));
+        co_return;
+    }
+
+    auto const& spec = CommandRegistry::table[i];
+    if(spec.requires_auth && !authenticated_) {
+        CommandRegistry::counters[i].rejected.fetch_add(1, std::memory_order_relaxed);
+        if(spec.response.empty()) {
+            std::println("{} from unauthenticated session ignored", spec.name);
+        } else {
+            send_frame(spec.response, make_error_payload("NOT_AUTHENTICATED", "请先登录"));
+        }
+        co_return;
+    }
+
+    if(spec.mode == CommandRegistry::DispatchMode::inline_call) {
+        co_await CommandRegistry::invoke(*this, i, payload);
+        co_return;
+    }
+
+    auto self = shared_from_this();
+    ++pending_ops_;  // 增加未完成操作计数
+    asio::co_spawn(
+        strand_,  // 使用 strand_ 而非 socket_.get_executor()，避免 socket 关闭后 executor 失效
+        [self, i, payload = std::string{ payload }]() -> asio::awaitable<void> {
+            // RAII 守卫：确保无论如何都会减少计数
+            struct PendingGuard {
+                std::shared_ptr<Session> s;
+                ~PendingGuard() { --s->pending_ops_; }
+            } guard{ self };
+
+            try {
+                // 检查 session 是否正在关闭
+                if(self->closing_.load() || !self->socket_.is_open()) {
+                    co_return;
+                }
+                co_await CommandRegistry::invoke(*self, i, payload);
+            } catch(std::exception const& e) {
+                std::println("{} unhandled exception: {}", CommandRegistry::table[i].name, e.what());
+            }
+        },
+        asio::detached
+    );
+}
+
+auto Session::read_route() const -> database::Route
+{
+    // 从未写过时为时钟纪元，远早于读己之写窗口
+    auto const ticks = std::chrono::steady_clock::duration{ last_write_ticks_.load(std::memory_order_relaxed) };
+    return database::read_route_after_write(std::chrono::steady_clock::time_point{ ticks });
+}
+
+auto Session::handle_ping(std::string_view) -> asio::awaitable<CommandReply>
+{
+    co_return std::string{ "{}" };
+}
+
+auto Session::handle_hello(std::string_view payload) -> asio::awaitable<CommandReply>
+{
+    auto const version = negotiate_protocol(payload);
+    json resp;
+    resp["ok"] = true;
+    resp["protocol"] = version;
+    // HELLO_RESP 本身仍按 v1 写出，之后的出站帧才切换编码
+    send_frame("HELLO_RESP", resp.dump());
+    protocol_version_ = version;
+    co_return std::string{};
+}
+
+auto Session::command_stats() -> std::vector<CommandStats>
+{
+    std::vector<CommandStats> out;
+    out.reserve(CommandRegistry::table.size());
+    for(std::size_t i = 0; i < CommandRegistry::table.size(); ++i) {
+        auto const& c = CommandRegistry::counters[i];
+        out.push_back({
+            .command = CommandRegistry::table[i].name,
+            .calls = c.calls.load(std::memory_order_relaxed),
+            .errors = c.errors.load(std::memory_order_relaxed),
+            .rejected = c.rejected.load(std::memory_order_relaxed),
+            .total_us = c.total_us.load(std::memory_order_relaxed),
+            .max_us = c.max_us.load(std::memory_order_relaxed),
+        });
+    }
+    return out;
+}
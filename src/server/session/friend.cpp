@@ -5,19 +5,15 @@
 
 using nlohmann::json;
 
-auto Session::handle_friend_list_req(std::string const& payload) -> asio::awaitable<std::string>
+auto Session::handle_friend_list_req(std::string_view payload) -> asio::awaitable<CommandReply>
 {
-    if(!authenticated_) {
-        co_return make_error_payload("NOT_AUTHENTICATED", "请先登录");
-    }
-
     try {
         if(!payload.empty() && payload != "{}") {
             auto _ = json::parse(payload);
             (void)_;
         }
 
-        auto const friends = co_await database::load_user_friends(user_id_);
+        auto const friends = co_await database::load_user_friends(user_id_, read_route());
 
         json resp;
         resp["ok"] = true;
@@ -39,30 +35,26 @@ auto Session::handle_friend_list_req(std::string const& payload) -> asio::awaita
         resp["friends"] = std::move(items);
         co_return resp.dump();
     } catch(json::parse_error const&) {
-        co_return make_error_payload("INVALID_JSON", "请求 JSON 解析失败");
+        co_return fail("INVALID_JSON", "请求 JSON 解析失败");
     } catch(std::exception const& ex) {
-        co_return make_error_payload("SERVER_ERROR", ex.what());
+        co_return fail("SERVER_ERROR", ex.what());
     }
 }
 
-auto Session::handle_friend_search_req(std::string const& payload) -> asio::awaitable<std::string>
+auto Session::handle_friend_search_req(std::string_view payload) -> asio::awaitable<CommandReply>
 {
-    if(!authenticated_) {
-        co_return make_error_payload("NOT_AUTHENTICATED", "请先登录");
-    }
-
     try {
         auto j = payload.empty() ? json::object() : json::parse(payload);
 
         if(!j.contains("account")) {
-            co_return make_error_payload("INVALID_PARAM", "缺少 account 字段");
+            co_return fail("INVALID_PARAM", "缺少 account 字段");
         }
 
         auto const account = j.at("account").get<std::string>();
 
-        auto const result = co_await database::search_friend_by_account(user_id_, account);
+        auto const result = co_await database::search_friend_by_account(user_id_, account, read_route());
         if(!result.ok) {
-            co_return make_error_payload(result.error_code, result.error_msg);
+            co_return fail(result.error_code, result.error_msg);
         }
 
         json resp;
@@ -84,23 +76,19 @@ auto Session::handle_friend_search_req(std::string const& payload) -> asio::awai
         resp["isSelf"] = result.is_self;
         co_return resp.dump();
     } catch(json::parse_error const&) {
-        co_return make_error_payload("INVALID_JSON", "请求 JSON 解析失败");
+        co_return fail("INVALID_JSON", "请求 JSON 解析失败");
     } catch(std::exception const& ex) {
-        co_return make_error_payload("SERVER_ERROR", ex.what());
+        co_return fail("SERVER_ERROR", ex.what());
     }
 }
 
-auto Session::handle_friend_add_req(std::string const& payload) -> asio::awaitable<std::string>
+auto Session::handle_friend_add_req(std::string_view payload) -> asio::awaitable<CommandReply>
 {
-    if(!authenticated_) {
-        co_return make_error_payload("NOT_AUTHENTICATED", "请先登录");
-    }
-
     try {
         auto j = payload.empty() ? json::object() : json::parse(payload);
 
         if(!j.contains("peerUserId")) {
-            co_return make_error_payload("INVALID_PARAM", "缺少 peerUserId 字段");
+            co_return fail("INVALID_PARAM", "缺少 peerUserId 字段");
         }
 
         auto const peer_str = j.at("peerUserId").get<std::string>();
@@ -108,10 +96,10 @@ auto Session::handle_friend_add_req(std::string const& payload) -> asio::awaitab
         try {
             peer_id = std::stoll(peer_str);
         } catch(std::exception const&) {
-            co_return make_error_payload("INVALID_PARAM", "peerUserId 非法");
+            co_return fail("INVALID_PARAM", "peerUserId 非法");
         }
         if(peer_id <= 0) {
-            co_return make_error_payload("INVALID_PARAM", "peerUserId 非法");
+            co_return fail("INVALID_PARAM", "peerUserId 非法");
         }
 
         auto const source =
@@ -122,31 +110,36 @@ auto Session::handle_friend_add_req(std::string const& payload) -> asio::awaitab
         auto const result =
             co_await database::create_friend_request(user_id_, peer_id, source, hello_msg);
         if(!result.ok) {
-            co_return make_error_payload(result.error_code, result.error_msg);
+            co_return fail(result.error_code, result.error_msg);
         }
 
         json resp;
         resp["ok"] = true;
         resp["requestId"] = std::to_string(result.request_id);
 
+        // 对方的“新的朋友”只增加这一条申请
         if(auto server = server_.lock()) {
-            server->send_friend_request_list_to(peer_id);
+            server->push_friend_request_upsert(peer_id, {
+                .id = result.request_id,
+                .from_user_id = user_id_,
+                .account = account_,
+                .display_name = display_name_,
+                .status = "PENDING",
+                .hello_msg = hello_msg,
+                .avatar_path = avatar_path_,
+            });
         }
 
         co_return resp.dump();
     } catch(json::parse_error const&) {
-        co_return make_error_payload("INVALID_JSON", "请求 JSON 解析失败");
+        co_return fail("INVALID_JSON", "请求 JSON 解析失败");
     } catch(std::exception const& ex) {
-        co_return make_error_payload("SERVER_ERROR", ex.what());
+        co_return fail("SERVER_ERROR", ex.what());
     }
 }
 
-auto Session::handle_friend_req_list_req(std::string const& payload) -> asio::awaitable<std::string>
+auto Session::handle_friend_req_list_req(std::string_view payload) -> asio::awaitable<CommandReply>
 {
-    if(!authenticated_) {
-        co_return make_error_payload("NOT_AUTHENTICATED", "请先登录");
-    }
-
     try {
         if(!payload.empty() && payload != "{}") {
             auto _ = json::parse(payload);
@@ -173,23 +166,19 @@ auto Session::handle_friend_req_list_req(std::string const& payload) -> asio::aw
         resp["requests"] = std::move(items);
         co_return resp.dump();
     } catch(json::parse_error const&) {
-        co_return make_error_payload("INVALID_JSON", "请求 JSON 解析失败");
+        co_return fail("INVALID_JSON", "请求 JSON 解析失败");
     } catch(std::exception const& ex) {
-        co_return make_error_payload("SERVER_ERROR", ex.what());
+        co_return fail("SERVER_ERROR", ex.what());
     }
 }
 
-auto Session::handle_friend_accept_req(std::string const& payload) -> asio::awaitable<std::string>
+auto Session::handle_friend_accept_req(std::string_view payload) -> asio::awaitable<CommandReply>
 {
-    if(!authenticated_) {
-        co_return make_error_payload("NOT_AUTHENTICATED", "请先登录");
-    }
-
     try {
         auto j = payload.empty() ? json::object() : json::parse(payload);
 
         if(!j.contains("requestId")) {
-            co_return make_error_payload("INVALID_PARAM", "缺少 requestId 字段");
+            co_return fail("INVALID_PARAM", "缺少 requestId 字段");
         }
 
         auto const id_str = j.at("requestId").get<std::string>();
@@ -197,15 +186,15 @@ auto Session::handle_friend_accept_req(std::string const& payload) -> asio::awai
         try {
             request_id = std::stoll(id_str);
         } catch(std::exception const&) {
-            co_return make_error_payload("INVALID_PARAM", "requestId 非法");
+            co_return fail("INVALID_PARAM", "requestId 非法");
         }
         if(request_id <= 0) {
-            co_return make_error_payload("INVALID_PARAM", "requestId 非法");
+            co_return fail("INVALID_PARAM", "requestId 非法");
         }
 
         auto const result = co_await database::accept_friend_request(request_id, user_id_);
         if(!result.ok) {
-            co_return make_error_payload(result.error_code, result.error_msg);
+            co_return fail(result.error_code, result.error_msg);
         }
 
         json resp;
@@ -228,35 +217,51 @@ auto Session::handle_friend_accept_req(std::string const& payload) -> asio::awai
         }
 
         if(auto server = server_.lock()) {
-            server->send_friend_list_to(user_id_);
-            server->send_friend_list_to(result.friend_user.id);
-            server->send_friend_request_list_to(user_id_);
-            server->send_friend_request_list_to(result.friend_user.id);
+            server->set_friend_cache(user_id_, result.friend_user.id, true);
+            // 双方好友列表各增加对方，同意方的这条申请变为 ACCEPTED
+            server->push_friend_upsert(user_id_, {
+                .id = result.friend_user.id,
+                .account = result.friend_user.account,
+                .display_name = result.friend_user.display_name,
+                .avatar_path = result.friend_user.avatar_path,
+            });
+            server->push_friend_upsert(result.friend_user.id, {
+                .id = user_id_,
+                .account = account_,
+                .display_name = display_name_,
+                .avatar_path = avatar_path_,
+            });
+            server->push_friend_request_upsert(user_id_, {
+                .id = request_id,
+                .from_user_id = result.friend_user.id,
+                .account = result.friend_user.account,
+                .display_name = result.friend_user.display_name,
+                .status = "ACCEPTED",
+                .avatar_path = result.friend_user.avatar_path,
+            });
             if(result.conversation_id > 0) {
-                server->send_conv_list_to(user_id_);
-                server->send_conv_list_to(result.friend_user.id);
+                // 单聊可能是新建的，也可能把之前删好友时移出的一方重新加入
+                server->invalidate_conversation_cache(result.conversation_id);
+                server->subscribe_conversation(result.conversation_id, { user_id_, result.friend_user.id });
+                server->push_conv_upsert(result.conversation_id, { user_id_, result.friend_user.id });
             }
         }
 
         co_return resp.dump();
     } catch(json::parse_error const&) {
-        co_return make_error_payload("INVALID_JSON", "请求 JSON 解析失败");
+        co_return fail("INVALID_JSON", "请求 JSON 解析失败");
     } catch(std::exception const& ex) {
-        co_return make_error_payload("SERVER_ERROR", ex.what());
+        co_return fail("SERVER_ERROR", ex.what());
     }
 }
 
-auto Session::handle_friend_reject_req(std::string const& payload) -> asio::awaitable<std::string>
+auto Session::handle_friend_reject_req(std::string_view payload) -> asio::awaitable<CommandReply>
 {
-    if(!authenticated_) {
-        co_return make_error_payload("NOT_AUTHENTICATED", "请先登录");
-    }
-
     try {
         auto j = payload.empty() ? json::object() : json::parse(payload);
 
         if(!j.contains("requestId")) {
-            co_return make_error_payload("INVALID_PARAM", "缺少 requestId 字段");
+            co_return fail("INVALID_PARAM", "缺少 requestId 字段");
         }
 
         auto const id_str = j.at("requestId").get<std::string>();
@@ -264,45 +269,40 @@ auto Session::handle_friend_reject_req(std::string const& payload) -> asio::awai
         try {
             request_id = std::stoll(id_str);
         } catch(std::exception const&) {
-            co_return make_error_payload("INVALID_PARAM", "requestId 非法");
+            co_return fail("INVALID_PARAM", "requestId 非法");
         }
         if(request_id <= 0) {
-            co_return make_error_payload("INVALID_PARAM", "requestId 非法");
+            co_return fail("INVALID_PARAM", "requestId 非法");
         }
 
         auto const result = co_await database::reject_friend_request(request_id, user_id_);
         if(!result.ok) {
-            co_return make_error_payload(result.error_code, result.error_msg);
+            co_return fail(result.error_code, result.error_msg);
         }
 
         json resp;
         resp["ok"] = true;
 
-        // 通知双方刷新好友请求列表
+        // 被拒绝的申请不再出现在“新的朋友”中；申请方的列表只含收到的申请，不受影响
         if(auto server = server_.lock()) {
-            server->send_friend_request_list_to(user_id_);
-            server->send_friend_request_list_to(result.from_user_id);
+            server->push_friend_request_remove(user_id_, request_id);
         }
 
         co_return resp.dump();
     } catch(json::parse_error const&) {
-        co_return make_error_payload("INVALID_JSON", "请求 JSON 解析失败");
+        co_return fail("INVALID_JSON", "请求 JSON 解析失败");
     } catch(std::exception const& ex) {
-        co_return make_error_payload("SERVER_ERROR", ex.what());
+        co_return fail("SERVER_ERROR", ex.what());
     }
 }
 
-auto Session::handle_friend_delete_req(std::string const& payload) -> asio::awaitable<std::string>
+auto Session::handle_friend_delete_req(std::string_view payload) -> asio::awaitable<CommandReply>
 {
-    if(!authenticated_) {
-        co_return make_error_payload("NOT_AUTHENTICATED", "请先登录");
-    }
-
     try {
         auto j = payload.empty() ? json::object() : json::parse(payload);
 
         if(!j.contains("friendUserId")) {
-            co_return make_error_payload("INVALID_PARAM", "缺少 friendUserId 字段");
+            co_return fail("INVALID_PARAM", "缺少 friendUserId 字段");
         }
 
         auto const friend_str = j.at("friendUserId").get<std::string>();
@@ -310,16 +310,16 @@ auto Session::handle_friend_delete_req(std::string const& payload) -> asio::awai
         try {
             friend_id = std::stoll(friend_str);
         } catch(std::exception const&) {
-            co_return make_error_payload("INVALID_PARAM", "friendUserId 非法");
+            co_return fail("INVALID_PARAM", "friendUserId 非法");
         }
         if(friend_id <= 0) {
-            co_return make_error_payload("INVALID_PARAM", "friendUserId 非法");
+            co_return fail("INVALID_PARAM", "friendUserId 非法");
         }
 
         // 调用数据库删除好友关系
         auto const result = co_await database::delete_friend(user_id_, friend_id);
         if(!result) {
-            co_return make_error_payload("SERVER_ERROR", "删除好友失败");
+            co_return fail("SERVER_ERROR", "删除好友失败");
         }
 
         json resp;
@@ -331,18 +331,23 @@ auto Session::handle_friend_delete_req(std::string const& payload) -> asio::awai
             co_await database::remove_conversation_member(conv_id_opt.value(), user_id_);
         }
 
-        // 通知双方刷新好友列表和会话列表
+        // 双方好友列表各移除对方
         if(auto server = server_.lock()) {
-            server->send_friend_list_to(user_id_);
-            server->send_friend_list_to(friend_id);
-            // 刷新A的会话列表（B的会话列表不受影响）
-            server->send_conv_list_to(user_id_);
+            server->set_friend_cache(user_id_, friend_id, false);
+            server->push_friend_remove(user_id_, friend_id);
+            server->push_friend_remove(friend_id, user_id_);
+            if(conv_id_opt.has_value()) {
+                server->remove_conversation_cache_member(conv_id_opt.value(), user_id_);
+                server->unsubscribe_conversation(conv_id_opt.value(), { user_id_ });
+                // 只有A的会话列表移除该单聊（B的会话列表不受影响）
+                server->push_conv_remove(conv_id_opt.value(), { user_id_ });
+            }
         }
 
         co_return resp.dump();
     } catch(json::parse_error const&) {
-        co_return make_error_payload("INVALID_JSON", "请求 JSON 解析失败");
+        co_return fail("INVALID_JSON", "请求 JSON 解析失败");
     } catch(std::exception const& ex) {
-        co_return make_error_payload("SERVER_ERROR", ex.what());
+        co_return fail("SERVER_ERROR", ex.what());
     }
 }
\ No newline at end of file
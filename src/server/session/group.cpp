@@ -5,17 +5,13 @@
 
 using nlohmann::json;
 
-auto Session::handle_group_search_req(std::string const& payload) -> asio::awaitable<std::string>
+auto Session::handle_group_search_req(std::string_view payload) -> asio::awaitable<CommandReply>
 {
-    if(!authenticated_) {
-        co_return make_error_payload("NOT_AUTHENTICATED", "请先登录");
-    }
-
     try {
         auto j = payload.empty() ? json::object() : json::parse(payload);
 
         if(!j.contains("groupId")) {
-            co_return make_error_payload("INVALID_PARAM", "缺少 groupId 字段");
+            co_return fail("INVALID_PARAM", "缺少 groupId 字段");
         }
 
         auto const group_id_str = j.at("groupId").get<std::string>();
@@ -23,15 +19,15 @@ auto Session::handle_group_search_req(std::string const& payload) -> asio::await
         try {
             group_id = std::stoll(group_id_str);
         } catch(std::exception const&) {
-            co_return make_error_payload("INVALID_PARAM", "groupId 格式错误");
+            co_return fail("INVALID_PARAM", "groupId 格式错误");
         }
         if(group_id <= 0) {
-            co_return make_error_payload("INVALID_PARAM", "groupId 非法");
+            co_return fail("INVALID_PARAM", "groupId 非法");
         }
 
-        auto const result = co_await database::search_group_by_id(user_id_, group_id);
+        auto const result = co_await database::search_group_by_id(user_id_, group_id, read_route());
         if(!result.ok) {
-            co_return make_error_payload(result.error_code, result.error_msg);
+            co_return fail(result.error_code, result.error_msg);
         }
 
         json resp;
@@ -46,23 +42,19 @@ auto Session::handle_group_search_req(std::string const& payload) -> asio::await
         resp["isMember"] = result.is_member;
         co_return resp.dump();
     } catch(json::parse_error const&) {
-        co_return make_error_payload("INVALID_JSON", "请求 JSON 解析失败");
+        co_return fail("INVALID_JSON", "请求 JSON 解析失败");
     } catch(std::exception const& ex) {
-        co_return make_error_payload("SERVER_ERROR", ex.what());
+        co_return fail("SERVER_ERROR", ex.what());
     }
 }
 
-auto Session::handle_group_join_req(std::string const& payload) -> asio::awaitable<std::string>
+auto Session::handle_group_join_req(std::string_view payload) -> asio::awaitable<CommandReply>
 {
-    if(!authenticated_) {
-        co_return make_error_payload("NOT_AUTHENTICATED", "请先登录");
-    }
-
     try {
         auto j = payload.empty() ? json::object() : json::parse(payload);
 
         if(!j.contains("groupId")) {
-            co_return make_error_payload("INVALID_PARAM", "缺少 groupId 字段");
+            co_return fail("INVALID_PARAM", "缺少 groupId 字段");
         }
 
         auto const group_id_str = j.at("groupId").get<std::string>();
@@ -70,10 +62,10 @@ auto Session::handle_group_join_req(std::string const& payload) -> asio::awaitab
         try {
             group_id = std::stoll(group_id_str);
         } catch(std::exception const&) {
-            co_return make_error_payload("INVALID_PARAM", "groupId 格式错误");
+            co_return fail("INVALID_PARAM", "groupId 格式错误");
         }
         if(group_id <= 0) {
-            co_return make_error_payload("INVALID_PARAM", "groupId 非法");
+            co_return fail("INVALID_PARAM", "groupId 非法");
         }
 
         auto const hello_msg =
@@ -82,35 +74,39 @@ auto Session::handle_group_join_req(std::string const& payload) -> asio::awaitab
         auto const result =
             co_await database::create_group_join_request(user_id_, group_id, hello_msg);
         if(!result.ok) {
-            co_return make_error_payload(result.error_code, result.error_msg);
+            co_return fail(result.error_code, result.error_msg);
         }
 
         json resp;
         resp["ok"] = true;
         resp["requestId"] = std::to_string(result.request_id);
 
-        // 推送给群主和所有管理员
+        // 推送给群主和所有管理员，各自的入群申请列表只增加这一条
         if(auto server = server_.lock()) {
             auto admins = co_await database::get_group_admins(group_id);
-            for(auto const admin_id : admins) {
-                server->send_group_join_request_list_to(admin_id);
-            }
+            server->push_group_join_request_upsert(std::move(admins), {
+                .id = result.request_id,
+                .from_user_id = user_id_,
+                .account = account_,
+                .display_name = display_name_,
+                .group_id = group_id,
+                .group_name = result.group_name,
+                .status = "PENDING",
+                .hello_msg = hello_msg,
+                .avatar_path = avatar_path_,
+            });
         }
 
         co_return resp.dump();
     } catch(json::parse_error const&) {
-        co_return make_error_payload("INVALID_JSON", "请求 JSON 解析失败");
+        co_return fail("INVALID_JSON", "请求 JSON 解析失败");
     } catch(std::exception const& ex) {
-        co_return make_error_payload("SERVER_ERROR", ex.what());
+        co_return fail("SERVER_ERROR", ex.what());
     }
 }
 
-auto Session::handle_group_join_req_list_req(std::string const& payload) -> asio::awaitable<std::string>
+auto Session::handle_group_join_req_list_req(std::string_view payload) -> asio::awaitable<CommandReply>
 {
-    if(!authenticated_) {
-        co_return make_error_payload("NOT_AUTHENTICATED", "请先登录");
-    }
-
     try {
         if(!payload.empty() && payload != "{}") {
             auto _ = json::parse(payload);
@@ -140,23 +136,19 @@ auto Session::handle_group_join_req_list_req(std::string const& payload) -> asio
         resp["requests"] = std::move(items);
         co_return resp.dump();
     } catch(json::parse_error const&) {
-        co_return make_error_payload("INVALID_JSON", "请求 JSON 解析失败");
+        co_return fail("INVALID_JSON", "请求 JSON 解析失败");
     } catch(std::exception const& ex) {
-        co_return make_error_payload("SERVER_ERROR", ex.what());
+        co_return fail("SERVER_ERROR", ex.what());
     }
 }
 
-auto Session::handle_group_join_accept_req(std::string const& payload) -> asio::awaitable<std::string>
+auto Session::handle_group_join_accept_req(std::string_view payload) -> asio::awaitable<CommandReply>
 {
-    if(!authenticated_) {
-        co_return make_error_payload("NOT_AUTHENTICATED", "请先登录");
-    }
-
     try {
         auto j = payload.empty() ? json::object() : json::parse(payload);
 
         if(!j.contains("requestId")) {
-            co_return make_error_payload("INVALID_PARAM", "缺少 requestId 字段");
+            co_return fail("INVALID_PARAM", "缺少 requestId 字段");
         }
 
         auto const id_str = j.at("requestId").get<std::string>();
@@ -164,10 +156,10 @@ auto Session::handle_group_join_accept_req(std::string const& payload) -> asio::
         try {
             request_id = std::stoll(id_str);
         } catch(std::exception const&) {
-            co_return make_error_payload("INVALID_PARAM", "requestId 非法");
+            co_return fail("INVALID_PARAM", "requestId 非法");
         }
         if(request_id <= 0) {
-            co_return make_error_payload("INVALID_PARAM", "requestId 非法");
+            co_return fail("INVALID_PARAM", "requestId 非法");
         }
 
         // 默认同意，可通过 accept 字段控制
@@ -175,7 +167,7 @@ auto Session::handle_group_join_accept_req(std::string const& payload) -> asio::
 
         auto const result = co_await database::handle_group_join_request(request_id, user_id_, accept);
         if(!result.ok) {
-            co_return make_error_payload(result.error_code, result.error_msg);
+            co_return fail(result.error_code, result.error_msg);
         }
 
         json resp;
@@ -193,19 +185,28 @@ auto Session::handle_group_join_accept_req(std::string const& payload) -> asio::
         resp["groupName"] = result.group_name;
 
         if(auto server = server_.lock()) {
-            // 清除缓存
-            server->invalidate_conversation_cache(result.group_id);
-            server->invalidate_member_list_cache(result.group_id);
+            // 新成员直接加入会话缓存，成员详情缓存失效
+            if(accept) {
+                server->add_conversation_cache_member(result.group_id, result.new_member.id);
+                server->subscribe_conversation(result.group_id, { result.new_member.id });
+                server->invalidate_member_list_cache(result.group_id);
+            }
 
-            // 推送给所有群主/管理员刷新申请列表
+            // 所有群主/管理员的申请列表中只更新这一条的状态
             auto admins = co_await database::get_group_admins(result.group_id);
-            for(auto const admin_id : admins) {
-                server->send_group_join_request_list_to(admin_id);
-            }
+            server->push_group_join_request_upsert(std::move(admins), {
+                .id = request_id,
+                .from_user_id = result.new_member.id,
+                .account = result.new_member.account,
+                .display_name = result.new_member.display_name,
+                .group_id = result.group_id,
+                .group_name = result.group_name,
+                .status = accept ? "ACCEPTED" : "REJECTED",
+            });
 
             if(accept) {
-                // 推送会话列表给新成员
-                server->send_conv_list_to(result.new_member.id);
+                // 新成员的会话列表增加该群
+                server->push_conv_upsert(result.group_id, { result.new_member.id });
                 // 推送成员列表给所有群成员
                 server->send_conv_members(result.group_id);
 
@@ -215,7 +216,8 @@ auto Session::handle_group_join_accept_req(std::string const& payload) -> asio::
                     result.group_id,
                     result.new_member.id,
                     sys_content,
-                    "SYSTEM"
+                    "SYSTEM",
+                    result.new_member.display_name
                 );
                 server->broadcast_system_message(result.group_id, stored, sys_content);
             }
@@ -223,8 +225,8 @@ auto Session::handle_group_join_accept_req(std::string const& payload) -> asio::
 
         co_return resp.dump();
     } catch(json::parse_error const&) {
-        co_return make_error_payload("INVALID_JSON", "请求 JSON 解析失败");
+        co_return fail("INVALID_JSON", "请求 JSON 解析失败");
     } catch(std::exception const& ex) {
-        co_return make_error_payload("SERVER_ERROR", ex.what());
+        co_return fail("SERVER_ERROR", ex.what());
     }
 }
@@ -2,12 +2,13 @@
 #include <server.h>
 
 #include <database.h>
-#include <database/friend.h>
 
 #include <chrono>
 #include <ctime>
 #include <cstdio>
+#include <optional>
 #include <atomic>
+#include <unordered_set>
 
 using nlohmann::json;
 namespace asio = boost::asio;
@@ -23,28 +24,48 @@ namespace
         cached.store(id, std::memory_order_relaxed);
         co_return id;
     }
-} // namespace
 
-auto Session::handle_send_msg(std::string payload) -> asio::awaitable<void>
-{
-    if(!authenticated_) {
-        std::println("SEND_MSG from unauthenticated session ignored");
-        co_return;
+    // HISTORY_RESP / SYNC_RESP 中的单条消息
+    auto history_message_json(database::LoadedMessage const& msg) -> json
+    {
+        json m;
+        m["serverMsgId"] = std::to_string(msg.id);
+        m["senderId"] = std::to_string(msg.sender_id);
+        m["senderDisplayName"] = msg.sender_display_name;
+        m["msgType"] = msg.msg_type;
+        m["serverTimeMs"] = msg.server_time_ms;
+        m["seq"] = msg.seq;
+        m["content"] = msg.content;
+        m["isRecalled"] = msg.is_recalled;
+
+        // 构造 reactions 对象 {LIKE: [{userId, displayName}, ...], DISLIKE: [...]}
+        json reactions_obj = json::object();
+        reactions_obj["LIKE"] = json::array();
+        reactions_obj["DISLIKE"] = json::array();
+
+        for(auto const& reaction : msg.reactions) {
+            json user_obj;
+            user_obj["userId"] = std::to_string(reaction.user_id);
+            user_obj["displayName"] = reaction.display_name;
+            reactions_obj[reaction.reaction_type].push_back(user_obj);
+        }
+
+        m["reactions"] = reactions_obj;
+        return m;
     }
+} // namespace
 
+auto Session::handle_send_msg(std::string_view payload) -> asio::awaitable<CommandReply>
+{
     auto j = json::parse(payload, nullptr, false);
     if(j.is_discarded()) {
-        auto const err = make_error_payload("INVALID_JSON", "请求 JSON 解析失败");
-        auto msg = protocol::make_line("ERROR", err);
-        send_text(std::move(msg));
-        co_return;
+        send_frame("ERROR", make_error_payload("INVALID_JSON", "请求 JSON 解析失败"));
+        co_return CommandReply::failed_sent();
     }
 
     if(!j.contains("content")) {
-        auto const err = make_error_payload("INVALID_PARAM", "缺少 content 字段");
-        auto msg = protocol::make_line("ERROR", err);
-        send_text(std::move(msg));
-        co_return;
+        send_frame("ERROR", make_error_payload("INVALID_PARAM", "缺少 content 字段"));
+        co_return CommandReply::failed_sent();
     }
 
     auto const world_id = co_await cached_world_conversation_id();
@@ -59,19 +80,33 @@ auto Session::handle_send_msg(std::string payload) -> asio::awaitable<void>
         conversation_id = world_id;
     }
 
-    // 世界频道无需禁言校验，减少一次数据库访问
-    if(conversation_id != world_id) {
-        auto member = co_await database::get_conversation_member(conversation_id, user_id_);
+    // 世界频道无需禁言校验；其余会话的鉴权信息来自服务器缓存，稳态下不访问数据库
+    auto const server = server_.lock();
+    if(conversation_id != world_id && server) {
+        // 鉴权信息加载失败时不能当作无需校验，直接拒绝发送
+        std::optional<Server::SendContext> ctx;
+        auto is_friend = true;
+        try {
+            ctx = co_await server->get_send_context(conversation_id, user_id_);
+            // 单聊需要检查好友关系
+            if(ctx && ctx->type == "SINGLE" && ctx->peer_id > 0) {
+                is_friend = co_await server->is_friend_cached(user_id_, ctx->peer_id);
+            }
+        } catch(std::exception const& ex) {
+            std::println("send context load failed: {}", ex.what());
+            send_frame("ERROR", make_error_payload("SERVER_ERROR_DB", ex.what()));
+            co_return CommandReply::failed_sent();
+        }
 
-        if(member) {
+        if(ctx) {
             auto const now_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
                                     std::chrono::system_clock::now().time_since_epoch()
                                 )
                                     .count();
-            if(member->muted_until_ms > now_ms) {
+            if(ctx->muted_until_ms > now_ms) {
                 std::time_t tt = std::chrono::system_clock::to_time_t(
                     std::chrono::system_clock::time_point(
-                        std::chrono::milliseconds(member->muted_until_ms)));
+                        std::chrono::milliseconds(ctx->muted_until_ms)));
                 std::tm tm = *std::localtime(&tt);
                 char buf[32]{};
                 std::snprintf(buf, sizeof(buf), "%04d-%02d-%02d %02d:%02d:%02d",
@@ -80,31 +115,21 @@ auto Session::handle_send_msg(std::string payload) -> asio::awaitable<void>
 
                 auto const err =
                     make_error_payload("MUTED", std::string{ "你已被禁言至 " } + buf);
-                auto msg = protocol::make_line("ERROR", err);
-                send_text(std::move(msg));
-                co_return;
+                send_frame("ERROR", err);
+                co_return CommandReply::failed_sent();
             }
         }
 
-        // 单聊需要检查好友关系
-        auto const conv_type = co_await database::get_conversation_type(conversation_id);
-        if(conv_type == "SINGLE") {
-            auto const peer_id = co_await database::get_single_peer_user_id(conversation_id, user_id_);
-            if(peer_id > 0) {
-                auto const is_friend = co_await database::is_friend(user_id_, peer_id);
-                if(!is_friend) {
-                    json err_obj;
-                    err_obj["errorCode"] = "NOT_FRIEND";
-                    err_obj["errorMsg"] = "请添加对方为好友";
-                    err_obj["conversationId"] = std::to_string(conversation_id);
-                    if(j.contains("content")) err_obj["content"] = j["content"];
-                    err_obj["type"] = j.value("type", "TEXT");
-
-                    auto msg = protocol::make_line("SEND_FAILED", err_obj.dump());
-                    send_text(std::move(msg));
-                    co_return;
-                }
-            }
+        if(!is_friend) {
+            json err_obj;
+            err_obj["errorCode"] = "NOT_FRIEND";
+            err_obj["errorMsg"] = "请添加对方为好友";
+            err_obj["conversationId"] = std::to_string(conversation_id);
+            if(j.contains("content")) err_obj["content"] = j["content"];
+            err_obj["type"] = j.value("type", "TEXT");
+
+            send_frame("SEND_FAILED", err_obj.dump());
+            co_return CommandReply::failed_sent();
         }
     }
 
@@ -121,39 +146,37 @@ auto Session::handle_send_msg(std::string payload) -> asio::awaitable<void>
     try {
         // 检查 session 是否正在关闭
         if(closing_.load()) {
-            co_return;
+            co_return std::string{};
         }
         // 直接使用数据库写入消息，append_text_message 会生成 id 和 seq
-        stored = co_await database::append_text_message(conversation_id, user_id_, content, msg_type);
+        stored = co_await database::append_text_message(conversation_id, user_id_, content, msg_type, display_name_);
     } catch(boost::system::system_error const& ex) {
         // Operation canceled / connection reset 是 session 关闭导致的正常情况，静默处理
         if(ex.code() == asio::error::operation_aborted ||
            ex.code() == asio::error::connection_reset ||
            ex.code() == asio::error::broken_pipe) {
             std::println("database write canceled (session closing)");
-            co_return;
+            co_return std::string{};
         }
         std::println("database write failed: {} ({})", ex.what(), ex.code().value());
         // socket 可能已关闭，检查后再发送错误
         if(socket_.is_open() && !closing_.load()) {
             auto const err = make_error_payload("SERVER_ERROR_DB", ex.what());
-            auto msg = protocol::make_line("ERROR", err);
-            send_text(std::move(msg));
+            send_frame("ERROR", err);
         }
-        co_return;
+        co_return CommandReply::failed_sent();
     } catch(std::exception const& ex) {
         std::println("database write failed: {}", ex.what());
         if(socket_.is_open() && !closing_.load()) {
             auto const err = make_error_payload("SERVER_ERROR_DB", ex.what());
-            auto msg = protocol::make_line("ERROR", err);
-            send_text(std::move(msg));
+            send_frame("ERROR", err);
         }
-        co_return;
+        co_return CommandReply::failed_sent();
     }
 
     // 检查 session 是否正在关闭或 socket 已关闭
     if(closing_.load() || !socket_.is_open()) {
-        co_return;
+        co_return std::string{};
     }
 
     json ack;
@@ -162,34 +185,29 @@ auto Session::handle_send_msg(std::string payload) -> asio::awaitable<void>
     ack["serverTimeMs"] = stored.server_time_ms;
     ack["seq"] = stored.seq;
 
-    auto ack_msg = protocol::make_line("SEND_ACK", ack.dump());
-    send_text(std::move(ack_msg));
+    send_frame("SEND_ACK", ack.dump());
 
-    if(auto server = server_.lock()) {
+    if(server) {
         try {
             server->broadcast_world_message(stored, user_id_, content, display_name_);
         } catch(std::exception const& ex) {
             if(socket_.is_open()) {
                 auto const err = make_error_payload("SERVER_ERROR_PUSH", ex.what());
-                auto msg = protocol::make_line("ERROR", err);
-                send_text(std::move(msg));
+                send_frame("ERROR", err);
             }
+            co_return CommandReply::failed_sent();
         }
     }
 
-    co_return;
+    co_return std::string{};
 }
 
-auto Session::handle_history_req(std::string const& payload) -> asio::awaitable<std::string>
+auto Session::handle_history_req(std::string_view payload) -> asio::awaitable<CommandReply>
 {
-    if(!authenticated_) {
-        co_return make_error_payload("NOT_AUTHENTICATED", "请先登录");
-    }
-
     // 使用非抛出版本的JSON解析
     auto j = json::parse(payload, nullptr, false);
     if(j.is_discarded()) {
-        co_return make_error_payload("INVALID_JSON", "请求 JSON 解析失败");
+        co_return fail("INVALID_JSON", "请求 JSON 解析失败");
     }
 
     try {
@@ -218,12 +236,29 @@ auto Session::handle_history_req(std::string const& payload) -> asio::awaitable<
             conversation_id = co_await cached_world_conversation_id();
         }
 
-        // 直接从数据库加载历史消息
+        // 同一页在会话历史未变化时直接复用已序列化的帧，版本号须在读取历史之前取得
+        auto const server = server_.lock();
+        auto const page_key = Server::HistoryPageKey{
+            .conversation_id = conversation_id,
+            .before_seq = after_seq > 0 ? 0 : before_seq,
+            .after_seq = after_seq,
+            .limit = limit,
+        };
+        auto const version = database::message_cache_version(conversation_id);
+        if(server) {
+            if(auto frame = server->get_history_page(page_key, version)) {
+                send_frame(std::move(frame));
+                co_return std::string{};
+            }
+        }
+
+        // 副本可能落后于版本号，从副本读出的页不进入共享缓存
+        auto const route = read_route();
         std::vector<database::LoadedMessage> messages;
         if(after_seq > 0) {
-            messages = co_await database::load_user_conversation_since(conversation_id, after_seq, limit);
+            messages = co_await database::load_user_conversation_since(conversation_id, after_seq, limit, route);
         } else {
-            messages = co_await database::load_user_conversation_history(conversation_id, before_seq, limit);
+            messages = co_await database::load_user_conversation_history(conversation_id, before_seq, limit, route);
         }
 
         json resp;
@@ -231,40 +266,94 @@ auto Session::handle_history_req(std::string const& payload) -> asio::awaitable<
 
         json items = json::array();
         for(auto const& msg : messages) {
-            json m;
-            m["serverMsgId"] = std::to_string(msg.id);
-            m["senderId"] = std::to_string(msg.sender_id);
-            m["senderDisplayName"] = msg.sender_display_name;
-            m["msgType"] = msg.msg_type;
-            m["serverTimeMs"] = msg.server_time_ms;
-            m["seq"] = msg.seq;
-            m["content"] = msg.content;
-            
-            // 构造 reactions 对象 {LIKE: [{userId, displayName}, ...], DISLIKE: [...]}
-            json reactions_obj = json::object();
-            reactions_obj["LIKE"] = json::array();
-            reactions_obj["DISLIKE"] = json::array();
-            
-            for(auto const& reaction : msg.reactions) {
-                json user_obj;
-                user_obj["userId"] = std::to_string(reaction.user_id);
-                user_obj["displayName"] = reaction.display_name;
-                reactions_obj[reaction.reaction_type].push_back(user_obj);
-            }
-            
-            m["reactions"] = reactions_obj;
-            
-            items.push_back(std::move(m));
+            items.push_back(history_message_json(msg));
         }
 
         resp["messages"] = std::move(items);
         resp["hasMore"] = static_cast<i64>(messages.size()) >= limit;
         resp["nextBeforeSeq"] = messages.empty() ? 0 : messages.front().seq;
 
-        co_return resp.dump();
+        if(!server) {
+            co_return resp.dump();
+        }
+        auto frame = protocol::make_shared_frame("HISTORY_RESP", resp.dump());
+        if(route == database::Route::primary) {
+            server->put_history_page(page_key, version, frame);
+        }
+        send_frame(std::move(frame));
+        co_return std::string{};
+    } catch(json::parse_error const&) {
+        co_return fail("INVALID_JSON", "请求 JSON 解析失败");
+    } catch(std::exception const& ex) {
+        co_return fail("SERVER_ERROR", ex.what());
+    }
+}
+
+auto Session::handle_sync_req(std::string_view payload) -> asio::awaitable<CommandReply>
+{
+    auto j = json::parse(payload, nullptr, false);
+    if(j.is_discarded()) {
+        co_return fail("INVALID_JSON", "请求 JSON 解析失败");
+    }
+
+    try {
+        if(!j.contains("conversations") || !j.at("conversations").is_array()) {
+            co_return fail("INVALID_PARAM", "缺少 conversations 字段");
+        }
+
+        auto limit = DEFAULT_SYNC_LIMIT;
+        if(j.contains("limit")) {
+            limit = std::clamp<i64>(j.at("limit").get<i64>(), 1, MAX_SYNC_LIMIT);
+        }
+
+        // 每项为 [conversationId, localLastSeq]，重复的会话只取第一次出现
+        std::vector<database::SyncCursor> cursors;
+        std::unordered_set<i64> seen;
+        for(auto const& item : j.at("conversations")) {
+            if(cursors.size() >= MAX_SYNC_CONVERSATIONS) {
+                break;
+            }
+            if(!item.is_array() || item.size() != 2) {
+                continue;
+            }
+            auto const& id = item.at(0);
+            auto const conversation_id = id.is_string() ? std::stoll(id.get<std::string>()) : id.get<i64>();
+            auto const after_seq = std::max<i64>(item.at(1).get<i64>(), 0);
+            if(conversation_id > 0 && seen.insert(conversation_id).second) {
+                cursors.push_back({ conversation_id, after_seq });
+            }
+        }
+
+        auto const synced = co_await database::load_conversations_since(user_id_, cursors, limit, read_route());
+
+        // 按块写出，最后一帧带 done: true；没有任何变化时只写一帧空列表
+        std::size_t i = 0;
+        do {
+            json items = json::array();
+            auto const end = std::min(synced.size(), i + SYNC_RESP_CHUNK);
+            for(; i < end; ++i) {
+                auto const& conv = synced[i];
+                json messages = json::array();
+                for(auto const& msg : conv.messages) {
+                    messages.push_back(history_message_json(msg));
+                }
+                json c;
+                c["conversationId"] = std::to_string(conv.conversation_id);
+                c["messages"] = std::move(messages);
+                c["hasMore"] = static_cast<i64>(conv.messages.size()) >= limit;
+                items.push_back(std::move(c));
+            }
+
+            json resp;
+            resp["conversations"] = std::move(items);
+            resp["done"] = i == synced.size();
+            send_frame("SYNC_RESP", resp.dump());
+        } while(i < synced.size());
+
+        co_return std::string{};
     } catch(json::parse_error const&) {
-        co_return make_error_payload("INVALID_JSON", "请求 JSON 解析失败");
+        co_return fail("INVALID_JSON", "请求 JSON 解析失败");
     } catch(std::exception const& ex) {
-        co_return make_error_payload("SERVER_ERROR", ex.what());
+        co_return fail("SERVER_ERROR", ex.what());
     }
 }
@@ -0,0 +1,89 @@
+#include <session.h>
+
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/detached.hpp>
+#include <boost/asio/redirect_error.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+#include <atomic>
+
+namespace asio = boost::asio;
+
+namespace
+{
+    std::atomic<u64> batch_frames{ 0 };
+    std::atomic<u64> batch_messages{ 0 };
+} // namespace
+
+// 世界频道刷屏时每条 MSG_PUSH 各占一个信封和一次写入；协商了合并周期的会话
+// 先缓冲推送，周期到期（或缓冲已满、需要写出其他帧）时合并为一帧 MSG_PUSH_BATCH。
+auto Session::buffer_push(protocol::SharedFrame frame) -> void
+{
+    push_batch_bytes_ += frame->payload.size();
+    push_batch_.push_back(std::move(frame));
+    if(push_batch_.size() >= MAX_PUSH_BATCH_MESSAGES || push_batch_bytes_ >= max_write_batch_bytes) {
+        flush_push_batch();
+        return;
+    }
+    if(push_batch_armed_) {
+        return;
+    }
+
+    // 计时协程持有会话，最多延长一个合并周期的生命期
+    push_batch_armed_ = true;
+    asio::co_spawn(
+        strand_,
+        [self = shared_from_this()]() -> asio::awaitable<void> {
+            asio::steady_timer timer{ self->strand_ };
+            timer.expires_after(self->push_batch_tick_);
+            boost::system::error_code ec;
+            co_await timer.async_wait(asio::redirect_error(asio::use_awaitable, ec));
+            self->push_batch_armed_ = false;
+            self->flush_push_batch();
+        },
+        asio::detached
+    );
+}
+
+auto Session::flush_push_batch() -> void
+{
+    if(push_batch_.empty()) {
+        return;
+    }
+    auto batch = std::move(push_batch_);
+    push_batch_.clear();
+    push_batch_bytes_ = 0;
+
+    if(batch.size() == 1) {
+        write_frame(std::move(batch.front()));
+        return;
+    }
+
+    // 各条负载已是完整的 JSON 对象，直接拼接为数组，不再解析
+    std::string payload;
+    auto bytes = std::size_t{ 16 };
+    for(auto const& f : batch) {
+        bytes += f->payload.size() + 1;
+    }
+    payload.reserve(bytes);
+    payload += R"({"messages":[)";
+    for(std::size_t i = 0; i < batch.size(); ++i) {
+        if(i > 0) {
+            payload += ',';
+        }
+        payload += batch[i]->payload;
+    }
+    payload += "]}";
+
+    batch_frames.fetch_add(1, std::memory_order_relaxed);
+    batch_messages.fetch_add(batch.size(), std::memory_order_relaxed);
+    write_frame(protocol::make_shared_frame("MSG_PUSH_BATCH", std::move(payload)));
+}
+
+auto Session::push_batch_stats() -> PushBatchStats
+{
+    return {
+        .frames = batch_frames.load(std::memory_order_relaxed),
+        .messages = batch_messages.load(std::memory_order_relaxed),
+    };
+}
@@ -10,20 +10,16 @@ using nlohmann::json;
 namespace asio = boost::asio;
 
 // 消息撤回请求处理
-auto Session::handle_recall_msg_req(std::string const& payload) -> asio::awaitable<std::string>
+auto Session::handle_recall_msg_req(std::string_view payload) -> asio::awaitable<CommandReply>
 {
-    if(!authenticated_) {
-        co_return make_error_payload("NOT_AUTHENTICATED", "请先登录");
-    }
-
     auto j = json::parse(payload, nullptr, false);
     if(j.is_discarded()) {
-        co_return make_error_payload("INVALID_JSON", "请求 JSON 解析失败");
+        co_return fail("INVALID_JSON", "请求 JSON 解析失败");
     }
 
     try {
         if(!j.contains("conversationId") || !j.contains("serverMsgId")) {
-            co_return make_error_payload("INVALID_PARAM", "缺少必要参数");
+            co_return fail("INVALID_PARAM", "缺少必要参数");
         }
 
         auto conversation_id_str = j.at("conversationId").get<std::string>();
@@ -32,19 +28,21 @@ auto Session::handle_recall_msg_req(std::string const& payload) -> asio::awaitab
         auto conversation_id = std::stoll(conversation_id_str);
         auto message_id = std::stoll(message_id_str);
 
-        // 1. 查询消息信息
-        auto conn_h = co_await database::acquire_connection();
+        // 1. 查询消息信息（连接只在本次查询期间持有，避免后续 database:: 调用嵌套借连接）
         boost::mysql::results r_msg;
-        co_await conn_h->async_execute(
-            boost::mysql::with_params(
-                "SELECT sender_id, conversation_id FROM messages WHERE id = {}",
-                message_id),
-            r_msg,
-            asio::use_awaitable
-        );
+        {
+            auto conn_h = co_await database::acquire_handle();
+            co_await conn_h->async_execute(
+                boost::mysql::with_params(
+                    "SELECT sender_id, conversation_id FROM messages WHERE id = {}",
+                    message_id),
+                r_msg,
+                asio::use_awaitable
+            );
+        }
 
         if(r_msg.rows().empty()) {
-            co_return make_error_payload("MESSAGE_NOT_FOUND", "消息不存在");
+            co_return fail("MESSAGE_NOT_FOUND", "消息不存在");
         }
 
         auto row = r_msg.rows().at(0);
@@ -65,14 +63,14 @@ auto Session::handle_recall_msg_req(std::string const& payload) -> asio::awaitab
         }
 
         if(!has_permission) {
-            co_return make_error_payload("NO_PERMISSION", "无权撤回该消息");
+            co_return fail("NO_PERMISSION", "无权撤回该消息");
         }
 
         // 3. 执行撤回操作
         auto result = co_await database::recall_message(message_id, user_id_);
 
         if(!result.ok) {
-            co_return make_error_payload(result.error_code, result.error_msg);
+            co_return fail(result.error_code, result.error_msg);
         }
 
         // 4. 广播撤回通知
@@ -93,28 +91,24 @@ auto Session::handle_recall_msg_req(std::string const& payload) -> asio::awaitab
         co_return resp.dump();
 
     } catch(json::parse_error const&) {
-        co_return make_error_payload("INVALID_JSON", "请求 JSON 解析失败");
+        co_return fail("INVALID_JSON", "请求 JSON 解析失败");
     } catch(std::exception const& ex) {
         std::println("handle_recall_msg_req error: {}", ex.what());
-        co_return make_error_payload("SERVER_ERROR", ex.what());
+        co_return fail("SERVER_ERROR", ex.what());
     }
 }
 
 // 消息反应(点赞/踩)请求处理
-auto Session::handle_msg_reaction_req(std::string const& payload) -> asio::awaitable<std::string>
+auto Session::handle_msg_reaction_req(std::string_view payload) -> asio::awaitable<CommandReply>
 {
-    if(!authenticated_) {
-        co_return make_error_payload("NOT_AUTHENTICATED", "请先登录");
-    }
-
     auto j = json::parse(payload, nullptr, false);
     if(j.is_discarded()) {
-        co_return make_error_payload("INVALID_JSON", "请求 JSON 解析失败");
+        co_return fail("INVALID_JSON", "请求 JSON 解析失败");
     }
 
     try {
         if(!j.contains("conversationId") || !j.contains("serverMsgId") || !j.contains("reactionType")) {
-            co_return make_error_payload("INVALID_PARAM", "缺少必要参数");
+            co_return fail("INVALID_PARAM", "缺少必要参数");
         }
 
         auto conversation_id_str = j.at("conversationId").get<std::string>();
@@ -126,36 +120,38 @@ auto Session::handle_msg_reaction_req(std::string const& payload) -> asio::await
 
         // 验证反应类型
         if(reaction_type != "LIKE" && reaction_type != "DISLIKE") {
-            co_return make_error_payload("INVALID_PARAM", "无效的反应类型");
+            co_return fail("INVALID_PARAM", "无效的反应类型");
         }
 
         // 1. 检查消息是否存在
-        auto conn_h = co_await database::acquire_connection();
         boost::mysql::results r_msg;
-        co_await conn_h->async_execute(
-            boost::mysql::with_params(
-                "SELECT sender_id FROM messages WHERE id = {}",
-                message_id),
-            r_msg,
-            asio::use_awaitable
-        );
+        {
+            auto conn_h = co_await database::acquire_handle();
+            co_await conn_h->async_execute(
+                boost::mysql::with_params(
+                    "SELECT sender_id FROM messages WHERE id = {}",
+                    message_id),
+                r_msg,
+                asio::use_awaitable
+            );
+        }
 
         if(r_msg.rows().empty()) {
-            co_return make_error_payload("MESSAGE_NOT_FOUND", "消息不存在");
+            co_return fail("MESSAGE_NOT_FOUND", "消息不存在");
         }
 
         auto sender_id = r_msg.rows().at(0).at(0).as_int64();
 
         // 2. 不能给自己的消息点赞/踩
         if(sender_id == user_id_) {
-            co_return make_error_payload("CANNOT_REACT_OWN", "不能给自己的消息点赞/踩");
+            co_return fail("CANNOT_REACT_OWN", "不能给自己的消息点赞/踩");
         }
 
         // 3. 添加反应
         auto result = co_await database::add_message_reaction(message_id, user_id_, reaction_type);
 
         if(!result.ok) {
-            co_return make_error_payload(result.error_code, result.error_msg);
+            co_return fail(result.error_code, result.error_msg);
         }
 
         // 4. 广播反应更新
@@ -189,28 +185,24 @@ auto Session::handle_msg_reaction_req(std::string const& payload) -> asio::await
         co_return resp.dump();
 
     } catch(json::parse_error const&) {
-        co_return make_error_payload("INVALID_JSON", "请求 JSON 解析失败");
+        co_return fail("INVALID_JSON", "请求 JSON 解析失败");
     } catch(std::exception const& ex) {
         std::println("handle_msg_reaction_req error: {}", ex.what());
-        co_return make_error_payload("SERVER_ERROR", ex.what());
+        co_return fail("SERVER_ERROR", ex.what());
     }
 }
 
 // 取消消息反应请求处理
-auto Session::handle_msg_unreaction_req(std::string const& payload) -> asio::awaitable<std::string>
+auto Session::handle_msg_unreaction_req(std::string_view payload) -> asio::awaitable<CommandReply>
 {
-    if(!authenticated_) {
-        co_return make_error_payload("NOT_AUTHENTICATED", "请先登录");
-    }
-
     auto j = json::parse(payload, nullptr, false);
     if(j.is_discarded()) {
-        co_return make_error_payload("INVALID_JSON", "请求 JSON 解析失败");
+        co_return fail("INVALID_JSON", "请求 JSON 解析失败");
     }
 
     try {
         if(!j.contains("conversationId") || !j.contains("serverMsgId") || !j.contains("reactionType")) {
-            co_return make_error_payload("INVALID_PARAM", "缺少必要参数");
+            co_return fail("INVALID_PARAM", "缺少必要参数");
         }
 
         auto conversation_id_str = j.at("conversationId").get<std::string>();
@@ -224,7 +216,7 @@ auto Session::handle_msg_unreaction_req(std::string const& payload) -> asio::awa
         auto result = co_await database::remove_message_reaction(message_id, user_id_, reaction_type);
 
         if(!result.ok) {
-            co_return make_error_payload(result.error_code, result.error_msg);
+            co_return fail(result.error_code, result.error_msg);
         }
 
         // 2. 广播反应更新
@@ -258,9 +250,9 @@ auto Session::handle_msg_unreaction_req(std::string const& payload) -> asio::awa
         co_return resp.dump();
 
     } catch(json::parse_error const&) {
-        co_return make_error_payload("INVALID_JSON", "请求 JSON 解析失败");
+        co_return fail("INVALID_JSON", "请求 JSON 解析失败");
     } catch(std::exception const& ex) {
         std::println("handle_msg_unreaction_req error: {}", ex.what());
-        co_return make_error_payload("SERVER_ERROR", ex.what());
+        co_return fail("SERVER_ERROR", ex.what());
     }
 }